@@ -0,0 +1,172 @@
+#include "breakpoint.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "mem.h"
+
+
+
+static inline uint32_t breakpoint_hash(uint32_t address)
+{
+  return (address ^ (address >> 12)) & (BREAKPOINT_SET_SIZE - 1);
+}
+
+
+
+static uint32_t breakpoint_slot(breakpoint_t *bp, uint32_t address)
+{
+  uint32_t i;
+
+  /* Linear probing, ends at the address or the first free slot. */
+  i = breakpoint_hash(address);
+  while (bp->set[i] != address && bp->set[i] != BREAKPOINT_NONE) {
+    i = (i + 1) & (BREAKPOINT_SET_SIZE - 1);
+  }
+  return i;
+}
+
+
+
+static int breakpoint_compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+
+
+void breakpoint_init(breakpoint_t *bp)
+{
+  breakpoint_clear(bp);
+}
+
+
+
+void breakpoint_clear(breakpoint_t *bp)
+{
+  int i;
+
+  for (i = 0; i < BREAKPOINT_SET_SIZE; i++) {
+    bp->set[i] = BREAKPOINT_NONE;
+  }
+  for (i = 0; i < MEM_SIZE_MAX / MEM_SECTION; i++) {
+    bp->section[i] = 0;
+  }
+  bp->count = 0;
+  bp->resume = BREAKPOINT_NONE;
+  bp->hit = false;
+}
+
+
+
+bool breakpoint_add(breakpoint_t *bp, mem_t *mem, uint32_t address)
+{
+  uint32_t i;
+
+  i = breakpoint_slot(bp, address);
+  if (bp->set[i] == address) {
+    return true; /* Already set. */
+  }
+  if (bp->count >= BREAKPOINT_MAX) {
+    return false;
+  }
+
+  bp->set[i] = address;
+  bp->count++;
+  if (bp->section[address / MEM_SECTION]++ == 0) {
+    /* Instructions already decoded in the section would run past it. */
+    mem_code_invalidate(mem, address - (address % MEM_SECTION),
+      MEM_SECTION);
+  }
+  bp->resume = BREAKPOINT_NONE;
+  return true;
+}
+
+
+
+bool breakpoint_remove(breakpoint_t *bp, uint32_t address)
+{
+  uint32_t i;
+  uint32_t j;
+  uint32_t k;
+
+  i = breakpoint_slot(bp, address);
+  if (bp->set[i] != address) {
+    return false;
+  }
+  bp->set[i] = BREAKPOINT_NONE;
+  bp->count--;
+  bp->section[address / MEM_SECTION]--;
+  bp->resume = BREAKPOINT_NONE;
+
+  /* Move entries further along the probe sequence back into the gap, so
+     lookups never stop early at it. */
+  j = i;
+  while (1) {
+    j = (j + 1) & (BREAKPOINT_SET_SIZE - 1);
+    if (bp->set[j] == BREAKPOINT_NONE) {
+      break;
+    }
+    k = breakpoint_hash(bp->set[j]);
+    if ((i < j) ? (k <= i || k > j) : (k <= i && k > j)) {
+      bp->set[i] = bp->set[j];
+      bp->set[j] = BREAKPOINT_NONE;
+      i = j;
+    }
+  }
+  return true;
+}
+
+
+
+bool breakpoint_find(breakpoint_t *bp, uint32_t address)
+{
+  return bp->set[breakpoint_slot(bp, address)] == address;
+}
+
+
+
+bool breakpoint_stop(breakpoint_t *bp, uint32_t address)
+{
+  if (! breakpoint_find(bp, address)) {
+    return false;
+  }
+  if (bp->resume == address) {
+    bp->resume = BREAKPOINT_NONE; /* Continuing from this breakpoint. */
+    return false;
+  }
+  bp->resume = address;
+  bp->hit = true;
+  return true;
+}
+
+
+
+void breakpoint_dump(FILE *fh, breakpoint_t *bp)
+{
+  uint32_t list[BREAKPOINT_MAX];
+  uint32_t n;
+  uint32_t i;
+
+  n = 0;
+  for (i = 0; i < BREAKPOINT_SET_SIZE; i++) {
+    if (bp->set[i] != BREAKPOINT_NONE) {
+      list[n++] = bp->set[i];
+    }
+  }
+  if (n == 0) {
+    fprintf(fh, "No breakpoints set.\n");
+    return;
+  }
+
+  qsort(list, n, sizeof(uint32_t), breakpoint_compare);
+  for (i = 0; i < n; i++) {
+    fprintf(fh, "%05X\n", list[i]);
+  }
+}
+
+
+
@@ -0,0 +1,31 @@
+#ifndef _BREAKPOINT_H
+#define _BREAKPOINT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "mem.h"
+
+#define BREAKPOINT_SET_SIZE 4096 /* Must be a power of two. */
+#define BREAKPOINT_MAX (BREAKPOINT_SET_SIZE / 2) /* Keeps probing short. */
+#define BREAKPOINT_NONE 0xFFFFFFFF
+
+/* Execution breakpoints as a hashed set of linear addresses. The count per
+   memory section lets the CPU skip the set for code anywhere else. */
+typedef struct breakpoint_s {
+  uint32_t set[BREAKPOINT_SET_SIZE]; /* BREAKPOINT_NONE if free. */
+  uint16_t section[MEM_SIZE_MAX / MEM_SECTION];
+  uint32_t count;
+  uint32_t resume; /* Breakpoint to run past once after stopping at it. */
+  bool hit;
+} breakpoint_t;
+
+void breakpoint_init(breakpoint_t *bp);
+bool breakpoint_add(breakpoint_t *bp, mem_t *mem, uint32_t address);
+bool breakpoint_remove(breakpoint_t *bp, uint32_t address);
+void breakpoint_clear(breakpoint_t *bp);
+bool breakpoint_find(breakpoint_t *bp, uint32_t address);
+bool breakpoint_stop(breakpoint_t *bp, uint32_t address);
+void breakpoint_dump(FILE *fh, breakpoint_t *bp);
+
+#endif /* _BREAKPOINT_H */
@@ -0,0 +1,427 @@
+#include "callgraph.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "mem.h"
+
+#define CALLGRAPH_ROUTINES_MAX (CALLGRAPH_ROUTINES / 4 * 3)
+#define CALLGRAPH_EDGES_MAX (CALLGRAPH_EDGES / 4 * 3)
+
+
+
+static uint32_t callgraph_routine(callgraph_t *cg, uint32_t address)
+{
+  uint32_t i;
+
+  /* Linear probing, adding the routine if not found and there is room. */
+  i = (address ^ (address >> 12)) & (CALLGRAPH_ROUTINES - 1);
+  while (cg->routine[i].address != address) {
+    if (cg->routine[i].address == CALLGRAPH_FREE) {
+      if (cg->routines >= CALLGRAPH_ROUTINES_MAX) {
+        return CALLGRAPH_FREE;
+      }
+      cg->routine[i].address = address;
+      cg->routines++;
+      break;
+    }
+    i = (i + 1) & (CALLGRAPH_ROUTINES - 1);
+  }
+  return i;
+}
+
+
+
+static void callgraph_edge(callgraph_t *cg, uint16_t caller, uint16_t callee)
+{
+  uint32_t i;
+
+  i = ((caller * 31) ^ callee) & (CALLGRAPH_EDGES - 1);
+  while (cg->edge[i].count != 0) {
+    if (cg->edge[i].caller == caller && cg->edge[i].callee == callee) {
+      cg->edge[i].count++;
+      return;
+    }
+    i = (i + 1) & (CALLGRAPH_EDGES - 1);
+  }
+
+  if (cg->edges >= CALLGRAPH_EDGES_MAX) {
+    cg->dropped++;
+    return;
+  }
+  cg->edge[i].caller = caller;
+  cg->edge[i].callee = callee;
+  cg->edge[i].count = 1;
+  cg->edges++;
+}
+
+
+
+static void callgraph_finish(callgraph_t *cg, callgraph_frame_t *frame)
+{
+  callgraph_routine_t *routine;
+  callgraph_service_t *service;
+
+  /* Only the outermost frame of a recursive routine adds to the total. */
+  routine = &cg->routine[frame->routine];
+  routine->active--;
+  if (routine->active == 0) {
+    routine->total += cg->instructions - frame->start;
+  }
+
+  if (frame->vector != CALLGRAPH_NONE) {
+    service = &cg->vector[frame->vector];
+    service->active--;
+    if (service->active == 0) {
+      service->total += cg->instructions - frame->start;
+    }
+  }
+  if (frame->function != CALLGRAPH_NONE) {
+    service = &cg->function[frame->vector][frame->function];
+    service->active--;
+    if (service->active == 0) {
+      service->total += cg->instructions - frame->start;
+    }
+  }
+}
+
+
+
+static uint64_t callgraph_total(callgraph_t *cg, uint16_t index)
+{
+  uint32_t i;
+
+  /* Include the calls still running, from their outermost frame. */
+  if (cg->routine[index].active > 0) {
+    for (i = 0; i < cg->depth; i++) {
+      if (cg->frame[i].routine == index) {
+        return cg->routine[index].total +
+          (cg->instructions - cg->frame[i].start);
+      }
+    }
+  }
+  return cg->routine[index].total;
+}
+
+
+
+static uint64_t callgraph_service_total(callgraph_t *cg, uint8_t vector,
+  uint16_t function)
+{
+  callgraph_service_t *service;
+  uint32_t i;
+
+  if (function == CALLGRAPH_NONE) {
+    service = &cg->vector[vector];
+  } else {
+    service = &cg->function[vector][function];
+  }
+
+  /* Include the interrupts still running, like callgraph_total(). */
+  if (service->active > 0) {
+    for (i = 1; i < cg->depth; i++) {
+      if (cg->frame[i].vector == vector && (function == CALLGRAPH_NONE ||
+          cg->frame[i].function == function)) {
+        return service->total + (cg->instructions - cg->frame[i].start);
+      }
+    }
+  }
+  return service->total;
+}
+
+
+
+static int callgraph_compare(const void *a, const void *b)
+{
+  const callgraph_sorted_t *x = a;
+  const callgraph_sorted_t *y = b;
+
+  /* Highest total first. */
+  return (x->total < y->total) - (x->total > y->total);
+}
+
+
+
+static void callgraph_address(FILE *fh, uint32_t address)
+{
+  if (address == CALLGRAPH_ROOT) {
+    fprintf(fh, "root  ");
+  } else {
+    fprintf(fh, "%05X ", address);
+  }
+}
+
+
+
+void callgraph_init(callgraph_t *cg)
+{
+  callgraph_clear(cg);
+}
+
+
+
+void callgraph_clear(callgraph_t *cg)
+{
+  uint32_t i;
+
+  memset(cg->count, 0, sizeof(cg->count));
+  for (i = 0; i < CALLGRAPH_ROUTINES; i++) {
+    cg->routine[i].address = CALLGRAPH_FREE;
+    cg->routine[i].active = 0;
+    cg->routine[i].calls = 0;
+    cg->routine[i].self = 0;
+    cg->routine[i].total = 0;
+  }
+  memset(cg->edge, 0, sizeof(cg->edge));
+  memset(cg->vector, 0, sizeof(cg->vector));
+  memset(cg->function, 0, sizeof(cg->function));
+  cg->routines = 0;
+  cg->edges = 0;
+  cg->instructions = 0;
+  cg->dropped = 0;
+
+  cg->frame[0].routine = callgraph_routine(cg, CALLGRAPH_ROOT);
+  cg->frame[0].ss = 0;
+  cg->frame[0].sp = 0;
+  cg->frame[0].vector = CALLGRAPH_NONE;
+  cg->frame[0].function = CALLGRAPH_NONE;
+  cg->frame[0].start = 0;
+  cg->routine[cg->frame[0].routine].active = 1;
+  cg->depth = 1;
+}
+
+
+
+void callgraph_count(callgraph_t *cg, uint32_t address)
+{
+  cg->count[address]++;
+  cg->instructions++;
+  cg->routine[cg->frame[cg->depth - 1].routine].self++;
+}
+
+
+
+void callgraph_call(callgraph_t *cg, uint16_t ss, uint16_t sp,
+  uint32_t address)
+{
+  callgraph_frame_t *frame;
+  uint32_t caller;
+  uint32_t index;
+
+  caller = cg->frame[cg->depth - 1].routine;
+  index = callgraph_routine(cg, address);
+  if (index == CALLGRAPH_FREE) {
+    cg->dropped++;
+    index = caller; /* Counted as part of the caller. */
+  } else {
+    cg->routine[index].calls++;
+    callgraph_edge(cg, caller, index);
+  }
+
+  if (cg->depth >= CALLGRAPH_DEPTH) {
+    /* Most likely left by code switching stacks, give up the oldest. */
+    callgraph_finish(cg, &cg->frame[1]);
+    memmove(&cg->frame[1], &cg->frame[2],
+      (CALLGRAPH_DEPTH - 2) * sizeof(callgraph_frame_t));
+    cg->depth--;
+  }
+
+  frame = &cg->frame[cg->depth];
+  frame->routine = index;
+  frame->ss = ss;
+  frame->sp = sp;
+  frame->vector = CALLGRAPH_NONE;
+  frame->function = CALLGRAPH_NONE;
+  frame->start = cg->instructions;
+  cg->routine[index].active++;
+  cg->depth++;
+}
+
+
+
+void callgraph_interrupt(callgraph_t *cg, uint16_t ss, uint16_t sp,
+  uint32_t address, uint8_t vector)
+{
+  callgraph_call(cg, ss, sp, address);
+  cg->frame[cg->depth - 1].vector = vector;
+  cg->vector[vector].calls++;
+  cg->vector[vector].active++;
+}
+
+
+
+void callgraph_service(callgraph_t *cg, uint8_t function)
+{
+  callgraph_frame_t *frame;
+
+  /* Right after callgraph_interrupt() for an INT instruction. */
+  frame = &cg->frame[cg->depth - 1];
+  if (frame->vector == CALLGRAPH_NONE) {
+    return;
+  }
+  frame->function = function;
+  cg->function[frame->vector][function].calls++;
+  cg->function[frame->vector][function].active++;
+}
+
+
+
+void callgraph_return(callgraph_t *cg, uint16_t ss, uint16_t sp)
+{
+  uint32_t i;
+
+  /* A return not matching any frame, like a RET used as a jump, is
+     ignored. */
+  for (i = cg->depth - 1; i > 0; i--) {
+    if (cg->frame[i].ss == ss && cg->frame[i].sp == sp) {
+      while (cg->depth > i) {
+        cg->depth--;
+        callgraph_finish(cg, &cg->frame[cg->depth]);
+      }
+      return;
+    }
+  }
+}
+
+
+
+void callgraph_dump(FILE *fh, callgraph_t *cg, uint32_t top)
+{
+  callgraph_sorted_t *sorted;
+  uint32_t n;
+  uint32_t i;
+
+  fprintf(fh, "Instructions: %llu, dropped: %llu\n",
+    (unsigned long long)cg->instructions,
+    (unsigned long long)cg->dropped);
+
+  n = 0;
+  for (i = 0; i < CALLGRAPH_ROUTINES; i++) {
+    if (cg->routine[i].address != CALLGRAPH_FREE) {
+      cg->sorted[n].routine = i;
+      cg->sorted[n].total = callgraph_total(cg, i);
+      n++;
+    }
+  }
+  qsort(cg->sorted, n, sizeof(callgraph_sorted_t), callgraph_compare);
+
+  fprintf(fh, "Entry         Calls      Exclusive      Inclusive\n");
+  for (i = 0; i < n && i < top; i++) {
+    sorted = &cg->sorted[i];
+    callgraph_address(fh, cg->routine[sorted->routine].address);
+    fprintf(fh, " %12llu %14llu %14llu\n",
+      (unsigned long long)cg->routine[sorted->routine].calls,
+      (unsigned long long)cg->routine[sorted->routine].self,
+      (unsigned long long)sorted->total);
+  }
+}
+
+
+
+void callgraph_service_dump(FILE *fh, callgraph_t *cg)
+{
+  int vector;
+  int function;
+
+  fprintf(fh, "Service            Calls   Instructions\n");
+  for (vector = 0; vector < 256; vector++) {
+    if (cg->vector[vector].calls == 0) {
+      continue;
+    }
+    fprintf(fh, "INT %02Xh     %12llu %14llu\n", vector,
+      (unsigned long long)cg->vector[vector].calls,
+      (unsigned long long)callgraph_service_total(cg, vector,
+      CALLGRAPH_NONE));
+    for (function = 0; function < 256; function++) {
+      if (cg->function[vector][function].calls == 0) {
+        continue;
+      }
+      fprintf(fh, "  AH=%02Xh    %12llu %14llu\n", function,
+        (unsigned long long)cg->function[vector][function].calls,
+        (unsigned long long)callgraph_service_total(cg, vector, function));
+    }
+  }
+}
+
+
+
+void callgraph_service_csv(FILE *fh, callgraph_t *cg)
+{
+  int vector;
+  int function;
+
+  /* Function left empty for the totals of the vector. */
+  fprintf(fh, "vector,function,calls,instructions\n");
+  for (vector = 0; vector < 256; vector++) {
+    if (cg->vector[vector].calls == 0) {
+      continue;
+    }
+    fprintf(fh, "%02X,,%llu,%llu\n", vector,
+      (unsigned long long)cg->vector[vector].calls,
+      (unsigned long long)callgraph_service_total(cg, vector,
+      CALLGRAPH_NONE));
+    for (function = 0; function < 256; function++) {
+      if (cg->function[vector][function].calls == 0) {
+        continue;
+      }
+      fprintf(fh, "%02X,%02X,%llu,%llu\n", vector, function,
+        (unsigned long long)cg->function[vector][function].calls,
+        (unsigned long long)callgraph_service_total(cg, vector, function));
+    }
+  }
+}
+
+
+
+int callgraph_write(callgraph_t *cg, const char *filename)
+{
+  char csv_filename[PATH_MAX];
+  FILE *fh;
+  uint32_t i;
+
+  fh = fopen(filename, "w");
+  if (fh == NULL) {
+    fprintf(stderr, "fopen() for '%s' failed with errno: %d\n",
+      filename, errno);
+    return -1;
+  }
+
+  callgraph_dump(fh, cg, CALLGRAPH_ROUTINES);
+
+  fprintf(fh, "\nCaller  Callee       Calls\n");
+  for (i = 0; i < CALLGRAPH_EDGES; i++) {
+    if (cg->edge[i].count != 0) {
+      callgraph_address(fh, cg->routine[cg->edge[i].caller].address);
+      fprintf(fh, " ");
+      callgraph_address(fh, cg->routine[cg->edge[i].callee].address);
+      fprintf(fh, " %12llu\n", (unsigned long long)cg->edge[i].count);
+    }
+  }
+
+  fprintf(fh, "\nAddress       Count\n");
+  for (i = 0; i < MEM_SIZE_MAX; i++) {
+    if (cg->count[i] != 0) {
+      fprintf(fh, "%05X  %12llu\n", i, (unsigned long long)cg->count[i]);
+    }
+  }
+  fclose(fh);
+
+  snprintf(csv_filename, PATH_MAX, "%s.csv", filename);
+  fh = fopen(csv_filename, "w");
+  if (fh == NULL) {
+    fprintf(stderr, "fopen() for '%s' failed with errno: %d\n",
+      csv_filename, errno);
+    return -1;
+  }
+  callgraph_service_csv(fh, cg);
+  fclose(fh);
+
+  return 0;
+}
+
+
+
@@ -0,0 +1,86 @@
+#ifndef _CALLGRAPH_H
+#define _CALLGRAPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "mem.h"
+
+#define CALLGRAPH_ROUTINES 4096 /* Must be a power of two. */
+#define CALLGRAPH_EDGES 16384 /* Must be a power of two. */
+#define CALLGRAPH_DEPTH 256
+#define CALLGRAPH_FREE 0xFFFFFFFF
+#define CALLGRAPH_NONE 0xFFFF /* Frame not from an interrupt or service. */
+#define CALLGRAPH_ROOT MEM_SIZE_MAX /* Code run outside of any call. */
+#define CALLGRAPH_TOP 20
+
+typedef struct callgraph_routine_s {
+  uint32_t address; /* Linear address of the entry, CALLGRAPH_FREE if free. */
+  uint32_t active; /* Frames of it on the shadow stack. */
+  uint64_t calls;
+  uint64_t self; /* Instructions run in the routine itself. */
+  uint64_t total; /* Also those in routines called, once returned. */
+} callgraph_routine_t;
+
+typedef struct callgraph_service_s {
+  uint32_t active; /* Frames of it on the shadow stack. */
+  uint64_t calls;
+  uint64_t total; /* Instructions until the return, once returned. */
+} callgraph_service_t;
+
+typedef struct callgraph_edge_s {
+  uint16_t caller; /* Routine index. */
+  uint16_t callee;
+  uint64_t count; /* Zero if free. */
+} callgraph_edge_t;
+
+typedef struct callgraph_sorted_s {
+  uint16_t routine; /* Routine index. */
+  uint64_t total;
+} callgraph_sorted_t;
+
+typedef struct callgraph_frame_s {
+  uint16_t routine;
+  uint16_t ss; /* Stack with the return address on top. */
+  uint16_t sp;
+  uint16_t vector; /* Interrupt, or CALLGRAPH_NONE. */
+  uint16_t function; /* AH of a software interrupt, or CALLGRAPH_NONE. */
+  uint64_t start; /* Instructions run before the call. */
+} callgraph_frame_t;
+
+/* Exact counts of instructions run per linear address, and of calls
+   between routines from CALL, CALL FAR and interrupts. A shadow stack of
+   the calls is popped by the return that takes the return address of a
+   frame off the stack, along with any frames above it left unreturned.
+   Interrupts are also counted per vector, and software interrupts per
+   function in AH, with the instructions run until their return. */
+typedef struct callgraph_s {
+  uint64_t count[MEM_SIZE_MAX];
+  callgraph_routine_t routine[CALLGRAPH_ROUTINES];
+  callgraph_edge_t edge[CALLGRAPH_EDGES];
+  callgraph_frame_t frame[CALLGRAPH_DEPTH];
+  callgraph_service_t vector[256];
+  callgraph_service_t function[256][256]; /* By vector and AH. */
+  uint32_t depth; /* The first frame is always the root. */
+  uint32_t routines;
+  uint32_t edges;
+  uint64_t instructions;
+  uint64_t dropped; /* Calls of routines or edges not fitting. */
+  callgraph_sorted_t sorted[CALLGRAPH_ROUTINES]; /* Scratch for dumping. */
+} callgraph_t;
+
+void callgraph_init(callgraph_t *cg);
+void callgraph_clear(callgraph_t *cg);
+void callgraph_count(callgraph_t *cg, uint32_t address);
+void callgraph_call(callgraph_t *cg, uint16_t ss, uint16_t sp,
+  uint32_t address);
+void callgraph_interrupt(callgraph_t *cg, uint16_t ss, uint16_t sp,
+  uint32_t address, uint8_t vector);
+void callgraph_service(callgraph_t *cg, uint8_t function);
+void callgraph_return(callgraph_t *cg, uint16_t ss, uint16_t sp);
+void callgraph_dump(FILE *fh, callgraph_t *cg, uint32_t top);
+void callgraph_service_dump(FILE *fh, callgraph_t *cg);
+void callgraph_service_csv(FILE *fh, callgraph_t *cg);
+int callgraph_write(callgraph_t *cg, const char *filename);
+
+#endif /* _CALLGRAPH_H */
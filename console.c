@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <string.h>
 #include <curses.h>
 
 #include "mem.h"
@@ -15,7 +16,7 @@
 #define CGA_MODE_REGISTER   0x3D8
 #define CGA_STATUS_REGISTER 0x3DA
 
-#define CONSOLE_SCANCODE_FIFO_SIZE 8
+#define CGA_VRAM 0xB8000
 
 static const short console_color_map[8] = {
   COLOR_BLACK,
@@ -28,26 +29,18 @@ static const short console_color_map[8] = {
   COLOR_WHITE,
 };
 
-static uint8_t console_cga_mode = 0;
-static uint8_t console_crtc_register_select = 0;
-static uint8_t console_crtc_register[UINT8_MAX] = {0};
 
-static uint8_t console_scancode_fifo[CONSOLE_SCANCODE_FIFO_SIZE] = {0};
-static int console_scancode_fifo_head = 0;
-static int console_scancode_fifo_tail = 0;
 
-
-
-static uint8_t console_scancode_fifo_read(void)
+static uint8_t console_scancode_fifo_read(console_t *console)
 {
   uint8_t scancode;
 
-  if (console_scancode_fifo_tail == console_scancode_fifo_head) {
+  if (console->scancode_fifo_tail == console->scancode_fifo_head) {
     return 0; /* Empty */
   }
 
-  scancode = console_scancode_fifo[console_scancode_fifo_tail];
-  console_scancode_fifo_tail = (console_scancode_fifo_tail + 1) %
+  scancode = console->scancode_fifo[console->scancode_fifo_tail];
+  console->scancode_fifo_tail = (console->scancode_fifo_tail + 1) %
     CONSOLE_SCANCODE_FIFO_SIZE;
 
   return scancode;
@@ -55,15 +48,15 @@ static uint8_t console_scancode_fifo_read(void)
 
 
 
-static void console_scancode_fifo_write(uint8_t scancode)
+static void console_scancode_fifo_write(console_t *console, uint8_t scancode)
 {
-  if (((console_scancode_fifo_head + 1) %
-    CONSOLE_SCANCODE_FIFO_SIZE) == console_scancode_fifo_tail) {
+  if (((console->scancode_fifo_head + 1) %
+    CONSOLE_SCANCODE_FIFO_SIZE) == console->scancode_fifo_tail) {
     return; /* Full */
   }
 
-  console_scancode_fifo[console_scancode_fifo_head] = scancode;
-  console_scancode_fifo_head = (console_scancode_fifo_head + 1) %
+  console->scancode_fifo[console->scancode_fifo_head] = scancode;
+  console->scancode_fifo_head = (console->scancode_fifo_head + 1) %
     CONSOLE_SCANCODE_FIFO_SIZE;
 }
 
@@ -400,68 +393,78 @@ void console_exit(void)
 
 
 
-static uint8_t cga_status_read(void *dummy, uint16_t port)
+static uint8_t cga_status_read(void *console, uint16_t port)
 {
-  (void)dummy;
   (void)port;
-  static bool toggle = false;
-  if (toggle) {
-    toggle = false;
+  if (((console_t *)console)->status_toggle) {
+    ((console_t *)console)->status_toggle = false;
     return 0x00;
   } else {
-    toggle = true;
+    ((console_t *)console)->status_toggle = true;
     return 0x09; /* Toggle retrace and vsync status bits. */
   }
 }
 
 
 
-static void cga_mode_write(void *dummy, uint16_t port, uint8_t value)
+static void cga_mode_write(void *console, uint16_t port, uint8_t value)
 {
-  (void)dummy;
   (void)port;
-  console_cga_mode = value;
+  ((console_t *)console)->cga_mode = value;
 }
 
 
 
-static void cga_crtc_select_write(void *dummy, uint16_t port, uint8_t value)
+static void cga_crtc_select_write(void *console, uint16_t port, uint8_t value)
 {
-  (void)dummy;
   (void)port;
-  console_crtc_register_select = value;
+  ((console_t *)console)->crtc_register_select = value;
 }
 
 
 
-static void cga_crtc_register_write(void *dummy, uint16_t port, uint8_t value)
+static void cga_crtc_register_write(void *console, uint16_t port,
+  uint8_t value)
 {
-  (void)dummy;
   (void)port;
-  console_crtc_register[console_crtc_register_select] = value;
+  ((console_t *)console)->crtc_register[
+    ((console_t *)console)->crtc_register_select] = value;
 }
 
 
 
-static uint8_t cga_crtc_register_read(void *dummy, uint16_t port)
+static uint8_t cga_crtc_register_read(void *console, uint16_t port)
 {
-  (void)dummy;
   (void)port;
-  return console_crtc_register[console_crtc_register_select];
+  return ((console_t *)console)->crtc_register[
+    ((console_t *)console)->crtc_register_select];
 }
 
 
 
-void console_init(io_t *io)
+void console_init(console_t *console, io_t *io)
 {
-  int bg;
-  int fg;
+  memset(console, 0, sizeof(console_t));
+  console->screen_dirty = true;
 
   io->read[CGA_STATUS_REGISTER].func = cga_status_read;
-  io->write[CGA_MODE_REGISTER].func  = cga_mode_write;
-  io->write[CGA_CRTC_SELECT].func    = cga_crtc_select_write;
-  io->write[CGA_CRTC_REGISTER].func  = cga_crtc_register_write;
-  io->read[CGA_CRTC_REGISTER].func   = cga_crtc_register_read;
+  io->read[CGA_STATUS_REGISTER].cookie = console;
+  io->write[CGA_MODE_REGISTER].func = cga_mode_write;
+  io->write[CGA_MODE_REGISTER].cookie = console;
+  io->write[CGA_CRTC_SELECT].func = cga_crtc_select_write;
+  io->write[CGA_CRTC_SELECT].cookie = console;
+  io->write[CGA_CRTC_REGISTER].func = cga_crtc_register_write;
+  io->write[CGA_CRTC_REGISTER].cookie = console;
+  io->read[CGA_CRTC_REGISTER].func = cga_crtc_register_read;
+  io->read[CGA_CRTC_REGISTER].cookie = console;
+}
+
+
+
+void console_start(void)
+{
+  int bg;
+  int fg;
 
   initscr();
   atexit(console_exit);
@@ -485,9 +488,9 @@ void console_init(io_t *io)
 
 
 
-void console_execute_keyboard(fe2010_t *fe2010, mos5720_t *mos5720)
+void console_execute_keyboard(console_t *console, fe2010_t *fe2010,
+  mos5720_t *mos5720)
 {
-  static bool alt_toggle = false;
   uint8_t scancode;
   int ch;
 #ifdef NCURSES_MOUSE_VERSION
@@ -495,7 +498,7 @@ void console_execute_keyboard(fe2010_t *fe2010, mos5720_t *mos5720)
 #endif /* NCURSES_MOUSE_VERSION */
 
   /* Keyboard scancode handling. */
-  scancode = console_scancode_fifo_read();
+  scancode = console_scancode_fifo_read(console);
   if (scancode == 0) {
     /* Nothing in FIFO, check for input. */
     ch = getch();
@@ -515,35 +518,35 @@ void console_execute_keyboard(fe2010_t *fe2010, mos5720_t *mos5720)
     if (ch != ERR) {
       if (ch == KEY_F(12)) { /* Special Ctrl+SL for breaking BASIC. */
         fe2010_keyboard_press(fe2010, 0x1D); /* Left Ctrl Make */
-        console_scancode_fifo_write(0x46); /* Scroll Lock Make */
-        console_scancode_fifo_write(0xC6); /* Scroll Lock Break */
-        console_scancode_fifo_write(0x9D); /* Left Ctrl Break */
+        console_scancode_fifo_write(console, 0x46); /* Scroll Lock Make */
+        console_scancode_fifo_write(console, 0xC6); /* Scroll Lock Break */
+        console_scancode_fifo_write(console, 0x9D); /* Left Ctrl Break */
         return;
       } else if (ch == KEY_F(11)) { /* Special Alt toggle. */
-        alt_toggle = true;
+        console->alt_toggle = true;
         return;
       }
 
       scancode = console_xt_keyboard_scancode(ch);
       if (console_character_is_shifted(ch)) {
-        fe2010_keyboard_press(fe2010, 0x2A);          /* Left Shift Make */
-        console_scancode_fifo_write(scancode);        /* Make */
-        console_scancode_fifo_write(scancode + 0x80); /* Break */
-        console_scancode_fifo_write(0xAA);            /* Left Shift Break */
+        fe2010_keyboard_press(fe2010, 0x2A); /* Left Shift Make */
+        console_scancode_fifo_write(console, scancode); /* Make */
+        console_scancode_fifo_write(console, scancode + 0x80); /* Break */
+        console_scancode_fifo_write(console, 0xAA); /* Left Shift Break */
       } else if (console_character_is_control(ch)) {
-        fe2010_keyboard_press(fe2010, 0x1D);          /* Left Ctrl Make */
-        console_scancode_fifo_write(scancode);        /* Make */
-        console_scancode_fifo_write(scancode + 0x80); /* Break */
-        console_scancode_fifo_write(0x9D);            /* Left Ctrl Break */
-      } else if (alt_toggle) {
-        fe2010_keyboard_press(fe2010, 0x38);          /* Left Alt Make */
-        console_scancode_fifo_write(scancode);        /* Make */
-        console_scancode_fifo_write(scancode + 0x80); /* Break */
-        console_scancode_fifo_write(0xB8);            /* Left Alt Break */
-        alt_toggle = false;
+        fe2010_keyboard_press(fe2010, 0x1D); /* Left Ctrl Make */
+        console_scancode_fifo_write(console, scancode); /* Make */
+        console_scancode_fifo_write(console, scancode + 0x80); /* Break */
+        console_scancode_fifo_write(console, 0x9D); /* Left Ctrl Break */
+      } else if (console->alt_toggle) {
+        fe2010_keyboard_press(fe2010, 0x38); /* Left Alt Make */
+        console_scancode_fifo_write(console, scancode); /* Make */
+        console_scancode_fifo_write(console, scancode + 0x80); /* Break */
+        console_scancode_fifo_write(console, 0xB8); /* Left Alt Break */
+        console->alt_toggle = false;
       } else {
-        fe2010_keyboard_press(fe2010, scancode);      /* Make */
-        console_scancode_fifo_write(scancode + 0x80); /* Break */
+        fe2010_keyboard_press(fe2010, scancode); /* Make */
+        console_scancode_fifo_write(console, scancode + 0x80); /* Break */
       }
     }
   } else {
@@ -553,57 +556,71 @@ void console_execute_keyboard(fe2010_t *fe2010, mos5720_t *mos5720)
 
 
 
-void console_execute_screen(mem_t *mem)
+void console_execute_screen(console_t *console, mem_t *mem)
 {
   uint8_t ch;
   uint8_t attrib;
   uint16_t pos;
   int columns;
+  int size;
   int bg;
   int fg;
   bool bold;
   bool blink;
   int i;
 
-  /* Draw CGA screen buffer. */
-  columns = (console_cga_mode & 1) ? 80 : 40;
-  for (i = 0; i < (25 * columns); i++) {
-    ch = mem_read(mem, 0xB8000 + (i * 2));
-    attrib = mem_read(mem, 0xB8000 + (i * 2) + 1);
-    fg    =  attrib       & 0x7;
-    bold  = (attrib >> 3) & 1;
-    bg    = (attrib >> 4) & 0x7;
-    if ((console_cga_mode >> 5) & 1) { /* Blink enabled? */
-      blink = (attrib >> 7) & 1;
-    } else {
-      blink = false;
+  /* Draw CGA screen buffer, if changed or the mode changed. It is only
+     compared with the copy last drawn after any memory writes. */
+  columns = (console->cga_mode & 1) ? 80 : 40;
+  size = 25 * columns * 2;
+  if (mem->write_count != console->screen_writes) {
+    console->screen_writes = mem->write_count;
+    if (memcmp(console->screen, &mem->m[CGA_VRAM], size) != 0) {
+      console->screen_dirty = true;
     }
+  }
+  if (console->screen_dirty || console->cga_mode != console->screen_mode) {
+    console->screen_dirty = false;
+    console->screen_mode = console->cga_mode;
+    memcpy(console->screen, &mem->m[CGA_VRAM], size);
+    for (i = 0; i < (25 * columns); i++) {
+      ch = mem_read(mem, CGA_VRAM + (i * 2));
+      attrib = mem_read(mem, CGA_VRAM + (i * 2) + 1);
+      fg    =  attrib       & 0x7;
+      bold  = (attrib >> 3) & 1;
+      bg    = (attrib >> 4) & 0x7;
+      if ((console->cga_mode >> 5) & 1) { /* Blink enabled? */
+        blink = (attrib >> 7) & 1;
+      } else {
+        blink = false;
+      }
 
-    if (bold) {
-      attron(A_BOLD);
-    }
-    if (blink) {
-      attron(A_BLINK);
-    }
-    if (has_colors()) {
-      attron(COLOR_PAIR((bg * 8) + fg + 1));
-    }
+      if (bold) {
+        attron(A_BOLD);
+      }
+      if (blink) {
+        attron(A_BLINK);
+      }
+      if (has_colors()) {
+        attron(COLOR_PAIR((bg * 8) + fg + 1));
+      }
 
-    mvaddch(i / columns, i % columns, console_graphic(ch));
+      mvaddch(i / columns, i % columns, console_graphic(ch));
 
-    if (has_colors()) {
-      attroff(COLOR_PAIR((bg * 8) + fg + 1));
-    }
-    if (blink) {
-      attroff(A_BLINK);
-    }
-    if (bold) {
-      attroff(A_BOLD);
+      if (has_colors()) {
+        attroff(COLOR_PAIR((bg * 8) + fg + 1));
+      }
+      if (blink) {
+        attroff(A_BLINK);
+      }
+      if (bold) {
+        attroff(A_BOLD);
+      }
     }
   }
 
   /* Move cursor. */
-  pos = console_crtc_register[0xF] + (console_crtc_register[0xE] * 0x100);
+  pos = console->crtc_register[0xF] + (console->crtc_register[0xE] * 0x100);
   move(pos / columns, pos % columns);
 
   /* Update screen. */
@@ -1,16 +1,39 @@
 #ifndef _CONSOLE_H
 #define _CONSOLE_H
 
+#include <stdint.h>
+#include <stdbool.h>
 #include "mem.h"
 #include "io.h"
 #include "fe2010.h"
 #include "mos5720.h"
 
+#define CONSOLE_SCANCODE_FIFO_SIZE 8
+#define CONSOLE_SCREEN_SIZE (80 * 25 * 2) /* Characters and attributes. */
+
+typedef struct console_s {
+  uint8_t cga_mode;
+  uint8_t crtc_register_select;
+  uint8_t crtc_register[UINT8_MAX];
+  bool status_toggle;
+  bool screen_dirty; /* Screen buffer must be drawn again. */
+  uint8_t screen_mode; /* Mode register when last drawn. */
+  uint32_t screen_writes; /* Memory write count when last compared. */
+  uint8_t screen[CONSOLE_SCREEN_SIZE]; /* Screen buffer as last drawn. */
+
+  uint8_t scancode_fifo[CONSOLE_SCANCODE_FIFO_SIZE];
+  int scancode_fifo_head;
+  int scancode_fifo_tail;
+  bool alt_toggle;
+} console_t;
+
 void console_pause(void);
 void console_resume(void);
 void console_exit(void);
-void console_init(io_t *io);
-void console_execute_keyboard(fe2010_t *fe2010, mos5720_t *mos5720);
-void console_execute_screen(mem_t *mem);
+void console_init(console_t *console, io_t *io);
+void console_start(void);
+void console_execute_keyboard(console_t *console, fe2010_t *fe2010,
+  mos5720_t *mos5720);
+void console_execute_screen(console_t *console, mem_t *mem);
 
 #endif /* _CONSOLE_H */
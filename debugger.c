@@ -8,11 +8,17 @@
 #include <sys/stat.h>
 
 #include "i8088.h"
+#include "i8087.h"
+#include "breakpoint.h"
+#include "callgraph.h"
+#include "opstat.h"
 #include "i8088_trace.h"
 #include "mem.h"
 #include "fe2010.h"
 #include "fdc9268.h"
 #include "xthdc.h"
+#include "lockstep.h"
+#include "profile.h"
 #include "i8250.h"
 #include "dp8390.h"
 #include "net.h"
@@ -20,10 +26,6 @@
 
 #define DEBUGGER_ARGS 3
 
-#ifdef BREAKPOINT
-int32_t debugger_breakpoint_cs = -1;
-int32_t debugger_breakpoint_ip = -1;
-#endif /* BREAKPOINT */
 #ifdef MEM_BREAKPOINT
 int32_t debugger_breakpoint_mem = -1;
 #endif /* MEM_BREAKPOINT */
@@ -37,17 +39,22 @@ static void debugger_help(void)
   fprintf(stdout, "  ? | h          - Help\n");
   fprintf(stdout, "  c              - Continue\n");
   fprintf(stdout, "  s              - Step\n");
-#ifdef BREAKPOINT
-  fprintf(stdout, "  k <addr>       - CPU Breakpoint\n");
-#endif /* BREAKPOINT */
+  fprintf(stdout, "  k [addr | *]   - Toggle/List/Clear CPU Breakpoints\n");
 #ifdef MEM_BREAKPOINT
   fprintf(stdout, "  K <addr>       - Memory Write Breakpoint\n");
 #endif /* MEM_BREAKPOINT */
   fprintf(stdout, "  t [extended]   - CPU Trace\n");
+  fprintf(stdout, "  T              - Toggle CPU Trace\n");
   fprintf(stdout, "  i              - Interrupt Trace\n");
   fprintf(stdout, "  d <addr> [end] - Dump Memory\n");
   fprintf(stdout, "  D <filename>   - Dump All Memory to File\n");
   fprintf(stdout, "  g              - FE2010 Status\n");
+  fprintf(stdout, "  F              - 8087 Status\n");
+  fprintf(stdout, "  l              - Lockstep Status\n");
+  fprintf(stdout, "  P [*]          - Guest Profile/Clear Profile\n");
+  fprintf(stdout, "  C [*]          - Call Graph Counts/Clear Counts\n");
+  fprintf(stdout, "  I [filename]   - Interrupt Service Counts/Save as CSV\n");
+  fprintf(stdout, "  O [file | *]   - Opcode Counts/Save as JSON/Clear\n");
   fprintf(stdout, "  f              - FDC9268 Trace\n");
   fprintf(stdout, "  x              - XT HDC Trace\n");
   fprintf(stdout, "  e              - COM1/8250 Trace\n");
@@ -104,7 +111,8 @@ static bool debugger_overwrite(FILE *out, FILE *in, const char *filename)
 
 
 bool debugger(i8088_t *cpu, mem_t *mem, fe2010_t *fe2010,
-  fdc9268_t *fdc9268, xthdc_t *xthdc)
+  fdc9268_t *fdc9268, xthdc_t *xthdc, lockstep_t *lockstep,
+  profile_t *profile)
 {
   char input[512];
   char *argv[DEBUGGER_ARGS];
@@ -155,37 +163,34 @@ bool debugger(i8088_t *cpu, mem_t *mem, fe2010_t *fe2010,
     } else if (strncmp(argv[0], "s", 1) == 0) {
       return true;
 
-#ifdef BREAKPOINT
     } else if (strncmp(argv[0], "k", 1) == 0) {
-      if (argc >= 2) {
+      if (cpu->breakpoint == NULL) {
+        fprintf(stdout, "Breakpoints not available!\n");
+      } else if (argc < 2) {
+        breakpoint_dump(stdout, cpu->breakpoint);
+      } else if (strcmp(argv[1], "*") == 0) {
+        breakpoint_clear(cpu->breakpoint);
+        fprintf(stdout, "All breakpoints removed.\n");
+      } else {
+        /* Segment and offset, or a linear address. */
         if (sscanf(argv[1], "%4x:%4x", &value1, &value2) == 2) {
-          debugger_breakpoint_cs = (value1 & 0xFFFF);
-          debugger_breakpoint_ip = (value2 & 0xFFFF);
-          fprintf(stdout, "Breakpoint at %04X:%04X set.\n",
-            debugger_breakpoint_cs, debugger_breakpoint_ip);
-        } else if (sscanf(argv[1], "%4x", &value1) == 1) {
-          debugger_breakpoint_ip = (value1 & 0xFFFF);
-          fprintf(stdout, "Breakpoint at *:%04X set.\n",
-            debugger_breakpoint_ip);
+          value1 = ((value1 << 4) + value2) & 0xFFFFF;
+        } else if (sscanf(argv[1], "%5x", &value1) == 1) {
+          value1 &= 0xFFFFF;
         } else {
-          fprintf(stdout, "Invalid argument!\n");
+          value1 = -1;
         }
-      } else {
-        if (debugger_breakpoint_ip < 0) {
-          fprintf(stdout, "Missing argument!\n");
+
+        if (value1 < 0) {
+          fprintf(stdout, "Invalid argument!\n");
+        } else if (breakpoint_remove(cpu->breakpoint, value1)) {
+          fprintf(stdout, "Breakpoint at %05X removed.\n", value1);
+        } else if (breakpoint_add(cpu->breakpoint, mem, value1)) {
+          fprintf(stdout, "Breakpoint at %05X set.\n", value1);
         } else {
-          if (debugger_breakpoint_cs < 0) {
-            fprintf(stdout, "Breakpoint at *:%04X removed.\n",
-              debugger_breakpoint_ip);
-          } else {
-            fprintf(stdout, "Breakpoint at %04X:%04X removed.\n",
-              debugger_breakpoint_cs, debugger_breakpoint_ip);
-          }
+          fprintf(stdout, "Too many breakpoints!\n");
         }
-        debugger_breakpoint_ip = -1;
-        debugger_breakpoint_cs = -1;
       }
-#endif /* BREAKPOINT */
 
 #ifdef MEM_BREAKPOINT
     } else if (strncmp(argv[0], "K", 1) == 0) {
@@ -216,6 +221,11 @@ bool debugger(i8088_t *cpu, mem_t *mem, fe2010_t *fe2010,
         i8088_trace_dump(stdout, false);
       }
 
+    } else if (strncmp(argv[0], "T", 1) == 0) {
+      cpu->instrumented = ! cpu->instrumented;
+      fprintf(stdout, "CPU trace %s.\n",
+        cpu->instrumented ? "enabled" : "disabled");
+
     } else if (strncmp(argv[0], "i", 1) == 0) {
       i8088_trace_int_dump(stdout);
 
@@ -251,6 +261,77 @@ bool debugger(i8088_t *cpu, mem_t *mem, fe2010_t *fe2010,
     } else if (strncmp(argv[0], "g", 1) == 0) {
       fe2010_dump(stdout, fe2010);
 
+    } else if (strncmp(argv[0], "F", 1) == 0) {
+      if (cpu->fpu != NULL) {
+        i8087_dump(stdout, cpu->fpu);
+      } else {
+        fprintf(stdout, "No 8087 installed.\n");
+      }
+
+    } else if (strncmp(argv[0], "l", 1) == 0) {
+      if (lockstep != NULL) {
+        lockstep_dump(stdout, lockstep);
+      } else {
+        fprintf(stdout, "Lockstep not enabled.\n");
+      }
+
+    } else if (strncmp(argv[0], "P", 1) == 0) {
+      if (profile == NULL) {
+        fprintf(stdout, "Profiling not enabled.\n");
+      } else if (argc >= 2 && strcmp(argv[1], "*") == 0) {
+        profile_clear(profile);
+        fprintf(stdout, "Profile cleared.\n");
+      } else {
+        profile_dump(stdout, profile, PROFILE_TOP);
+      }
+
+    } else if (strncmp(argv[0], "C", 1) == 0) {
+      if (cpu->callgraph == NULL) {
+        fprintf(stdout, "Counting not enabled.\n");
+      } else if (argc >= 2 && strcmp(argv[1], "*") == 0) {
+        callgraph_clear(cpu->callgraph);
+        fprintf(stdout, "Counts cleared.\n");
+      } else {
+        callgraph_dump(stdout, cpu->callgraph, CALLGRAPH_TOP);
+      }
+
+    } else if (strncmp(argv[0], "I", 1) == 0) {
+      if (cpu->callgraph == NULL) {
+        fprintf(stdout, "Counting not enabled.\n");
+      } else if (argc >= 2) {
+        if (debugger_overwrite(stdout, stdin, argv[1])) {
+          fh = fopen(argv[1], "w");
+          if (fh != NULL) {
+            callgraph_service_csv(fh, cpu->callgraph);
+            fclose(fh);
+          } else {
+            fprintf(stdout, "fopen() failed with errno: %d\n", errno);
+          }
+        }
+      } else {
+        callgraph_service_dump(stdout, cpu->callgraph);
+      }
+
+    } else if (strncmp(argv[0], "O", 1) == 0) {
+      if (cpu->opstat == NULL) {
+        fprintf(stdout, "Opcode counting not enabled.\n");
+      } else if (argc >= 2 && strcmp(argv[1], "*") == 0) {
+        opstat_clear(cpu->opstat);
+        fprintf(stdout, "Opcode counts cleared.\n");
+      } else if (argc >= 2) {
+        if (debugger_overwrite(stdout, stdin, argv[1])) {
+          fh = fopen(argv[1], "w");
+          if (fh != NULL) {
+            opstat_json(fh, cpu->opstat);
+            fclose(fh);
+          } else {
+            fprintf(stdout, "fopen() failed with errno: %d\n", errno);
+          }
+        }
+      } else {
+        opstat_dump(stdout, cpu->opstat);
+      }
+
     } else if (strncmp(argv[0], "f", 1) == 0) {
       fdc9268_trace_dump(stdout);
 
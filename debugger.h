@@ -7,13 +7,12 @@
 #include "fe2010.h"
 #include "fdc9268.h"
 #include "xthdc.h"
+#include "lockstep.h"
+#include "profile.h"
 
 bool debugger(i8088_t *cpu, mem_t *mem, fe2010_t *fe2010,
-  fdc9268_t *fdc9268, xthdc_t *xthdc);
-#ifdef BREAKPOINT
-extern int32_t debugger_breakpoint_cs;
-extern int32_t debugger_breakpoint_ip;
+  fdc9268_t *fdc9268, xthdc_t *xthdc, lockstep_t *lockstep,
+  profile_t *profile);
 extern int32_t debugger_breakpoint_mem;
-#endif /* BREAKPOINT */
 
 #endif /* _DEBUGGER_H */
@@ -68,8 +68,9 @@
 
 #define dp8390_page(x) (((dp8390_t *)x)->cr >> 6)
 
-static char dp8390_trace_buffer[DP8390_TRACE_BUFFER_SIZE][DP8390_TRACE_MAX];
-static int dp8390_trace_buffer_n = 0;
+static _Thread_local char
+  dp8390_trace_buffer[DP8390_TRACE_BUFFER_SIZE][DP8390_TRACE_MAX];
+static _Thread_local int dp8390_trace_buffer_n = 0;
 
 
 
@@ -15,10 +15,6 @@
 #include "net.h"
 #include "panic.h"
 
-#define EDFS_CLUSTER_MAX 1024 /* Can be increased up to UINT16_MAX. */
-#define EDFS_PATH83_MAX  260  /* In DOS, with limited 8.3 filenames. */
-#define EDFS_PATH_MAX    512  /* In Linux with possibly longer filenames. */
-
 #define EDFS_RMDIR       0x01
 #define EDFS_MKDIR       0x03
 #define EDFS_CHDIR       0x05
@@ -46,21 +42,13 @@
 #define EDFS_RESULT_ACCESS_DENIED    0x05
 #define EDFS_RESULT_NO_MORE_MATCH    0x12
 
-typedef struct edfs_cluster_s {
-  char path[EDFS_PATH_MAX];
-  char path83[EDFS_PATH83_MAX];
-} edfs_cluster_t;
-
 #define EDFS_TRACE_BUFFER_SIZE 2048
 #define EDFS_TRACE_MAX 256
 
-static char edfs_trace_buffer[EDFS_TRACE_BUFFER_SIZE][EDFS_TRACE_MAX];
-static int edfs_trace_buffer_n = 0;
+static _Thread_local char
+  edfs_trace_buffer[EDFS_TRACE_BUFFER_SIZE][EDFS_TRACE_MAX];
+static _Thread_local int edfs_trace_buffer_n = 0;
 
-static bool edfs_inited = false;
-static char edfs_root[EDFS_PATH_MAX];
-static edfs_cluster_t edfs_cluster[EDFS_CLUSTER_MAX];
-static uint16_t edfs_cluster_used = 0;
 
 
 
@@ -246,29 +234,30 @@ static uint16_t bsd_checksum(uint8_t buffer[], size_t len)
 
 
 
-static void edfs_cluster_register(const char *path, const char *path83)
+static void edfs_cluster_register(edfs_t *edfs, const char *path,
+  const char *path83)
 {
   uint16_t cluster;
 
   /* If path already exists, then don't register again: */
-  for (cluster = 0; cluster < edfs_cluster_used; cluster++) {
-    if ((strlen(edfs_cluster[cluster].path) == strlen(path)) &&
-        (strncmp(edfs_cluster[cluster].path, path, strlen(path)) == 0)) {
+  for (cluster = 0; cluster < edfs->cluster_used; cluster++) {
+    if ((strlen(edfs->cluster[cluster].path) == strlen(path)) &&
+        (strncmp(edfs->cluster[cluster].path, path, strlen(path)) == 0)) {
       return;
     }
   }
 
   /* Bail out if limit has been reached: */
-  if (edfs_cluster_used >= EDFS_CLUSTER_MAX) {
+  if (edfs->cluster_used >= EDFS_CLUSTER_MAX) {
     panic("No more EtherDFS clusters available!\n");
     return;
   }
 
   /* Register new: */
-  cluster = edfs_cluster_used;
-  strncpy(edfs_cluster[cluster].path, path, EDFS_PATH_MAX);
-  strncpy(edfs_cluster[cluster].path83, path83, EDFS_PATH83_MAX);
-  edfs_cluster_used++;
+  cluster = edfs->cluster_used;
+  strncpy(edfs->cluster[cluster].path, path, EDFS_PATH_MAX);
+  strncpy(edfs->cluster[cluster].path83, path83, EDFS_PATH83_MAX);
+  edfs->cluster_used++;
 
   edfs_trace(" register: 0x%04x -> '%s' -> '%s'\n",
     cluster, path, path83);
@@ -276,17 +265,17 @@ static void edfs_cluster_register(const char *path, const char *path83)
 
 
 
-static void edfs_cluster_unregister(const char *path)
+static void edfs_cluster_unregister(edfs_t *edfs, const char *path)
 {
   uint16_t cluster;
 
-  for (cluster = 0; cluster < edfs_cluster_used; cluster++) {
-    if ((strlen(edfs_cluster[cluster].path) == strlen(path)) &&
-        (strncmp(edfs_cluster[cluster].path, path, strlen(path)) == 0)) {
+  for (cluster = 0; cluster < edfs->cluster_used; cluster++) {
+    if ((strlen(edfs->cluster[cluster].path) == strlen(path)) &&
+        (strncmp(edfs->cluster[cluster].path, path, strlen(path)) == 0)) {
       edfs_trace(" unregister: 0x%04x -> '%s'\n", cluster,
-        edfs_cluster[cluster].path);
-      edfs_cluster[cluster].path[0] = '\0';
-      edfs_cluster[cluster].path83[0] = '\0';
+        edfs->cluster[cluster].path);
+      edfs->cluster[cluster].path[0] = '\0';
+      edfs->cluster[cluster].path83[0] = '\0';
       return;
     }
   }
@@ -296,16 +285,16 @@ static void edfs_cluster_unregister(const char *path)
 
 
 
-static char *edfs_cluster_lookup(uint16_t cluster)
+static char *edfs_cluster_lookup(edfs_t *edfs, uint16_t cluster)
 {
   if (cluster < EDFS_CLUSTER_MAX) {
-    if (cluster >= edfs_cluster_used) {
+    if (cluster >= edfs->cluster_used) {
       edfs_trace(" lookup: 0x%04x (not found)\n", cluster);
       return NULL;
     } else {
       edfs_trace(" lookup: 0x%04x -> '%s'\n", cluster,
-        edfs_cluster[cluster].path);
-      return edfs_cluster[cluster].path;
+        edfs->cluster[cluster].path);
+      return edfs->cluster[cluster].path;
     }
   } else {
     edfs_trace(" lookup: 0x%04x (out of bounds)\n", cluster);
@@ -315,7 +304,8 @@ static char *edfs_cluster_lookup(uint16_t cluster)
 
 
 
-static char *edfs_cluster_lookup_83(const char *path83, uint16_t *cluster_out)
+static char *edfs_cluster_lookup_83(edfs_t *edfs, const char *path83,
+  uint16_t *cluster_out)
 {
   uint16_t cluster;
 
@@ -331,13 +321,13 @@ static char *edfs_cluster_lookup_83(const char *path83, uint16_t *cluster_out)
     return "";
   }
 
-  for (cluster = 0; cluster < edfs_cluster_used; cluster++) {
-    if ((strlen(edfs_cluster[cluster].path83) == strlen(path83)) &&
-        (strncmp(edfs_cluster[cluster].path83, path83, strlen(path83)) == 0)) {
+  for (cluster = 0; cluster < edfs->cluster_used; cluster++) {
+    if ((strlen(edfs->cluster[cluster].path83) == strlen(path83)) &&
+        (strncmp(edfs->cluster[cluster].path83, path83, strlen(path83)) == 0)) {
       edfs_trace(" lookup: '%s' -> '%s'\n", path83,
-        edfs_cluster[cluster].path);
+        edfs->cluster[cluster].path);
       *cluster_out = cluster;
-      return edfs_cluster[cluster].path;
+      return edfs->cluster[cluster].path;
     }
   }
 
@@ -347,7 +337,7 @@ static char *edfs_cluster_lookup_83(const char *path83, uint16_t *cluster_out)
 
 
 
-static char *path83_to_unixpath(const char *in, char *out)
+static char *path83_to_unixpath(edfs_t *edfs, const char *in, char *out)
 {
   char dir83[EDFS_PATH83_MAX];
   uint16_t cluster;
@@ -356,7 +346,7 @@ static char *path83_to_unixpath(const char *in, char *out)
   int n;
 
   path83_dirname(in, dir83);
-  p = edfs_cluster_lookup_83(dir83, &cluster);
+  p = edfs_cluster_lookup_83(edfs, dir83, &cluster);
   if (p != NULL) {
     /* Ideally use the correctly mapped directory and convert only basename. */
     strncpy(out, p, EDFS_PATH_MAX);
@@ -384,24 +374,25 @@ static char *path83_to_unixpath(const char *in, char *out)
 
 
 
-void edfs_init(const char *root)
+void edfs_init(edfs_t *edfs, net_t *net, const char *root)
 {
   int i;
 
-  strncpy(edfs_root, root, EDFS_PATH_MAX);
+  strncpy(edfs->root, root, EDFS_PATH_MAX);
 
   for (i = 0; i < EDFS_CLUSTER_MAX; i++) {
-    edfs_cluster[i].path[0] = '\0';
-    edfs_cluster[i].path83[0] = '\0';
+    edfs->cluster[i].path[0] = '\0';
+    edfs->cluster[i].path83[0] = '\0';
   }
-  edfs_cluster_register("", ""); /* Register root directory as cluster 0. */
+  edfs->cluster_used = 0;
+  edfs_cluster_register(edfs, "", ""); /* Root directory is cluster 0. */
 
   for (i = 0; i < EDFS_TRACE_BUFFER_SIZE; i++) {
     edfs_trace_buffer[i][0] = '\0';
   }
   edfs_trace_buffer_n = 0;
 
-  edfs_inited = true;
+  net->edfs = edfs;
 }
 
 
@@ -451,8 +442,8 @@ static void edfs_set_result(uint8_t rx_frame[], uint16_t code)
 
 
 
-static uint16_t edfs_find(uint8_t rx_frame[], uint8_t attrib, char *pattern,
-  uint16_t cluster, uint16_t target_pos)
+static uint16_t edfs_find(edfs_t *edfs, uint8_t rx_frame[], uint8_t attrib,
+  char *pattern, uint16_t cluster, uint16_t target_pos)
 {
   DIR *dh;
   struct dirent *entry;
@@ -473,7 +464,7 @@ static uint16_t edfs_find(uint8_t rx_frame[], uint8_t attrib, char *pattern,
 
   if (target_pos == 0) { /* FINDFIRST */
     path83_dirname(pattern, path83);
-    p = edfs_cluster_lookup_83(path83, &cluster);
+    p = edfs_cluster_lookup_83(edfs, path83, &cluster);
     if (p == NULL) {
       edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
       return 0x3C;
@@ -481,7 +472,7 @@ static uint16_t edfs_find(uint8_t rx_frame[], uint8_t attrib, char *pattern,
     strncpy(path, p, EDFS_PATH_MAX);
 
   } else { /* FINDNEXT */
-    p = edfs_cluster_lookup(cluster);
+    p = edfs_cluster_lookup(edfs, cluster);
     if (p == NULL) {
       edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
       return 0x3C;
@@ -489,7 +480,7 @@ static uint16_t edfs_find(uint8_t rx_frame[], uint8_t attrib, char *pattern,
     strncpy(path, p, EDFS_PATH_MAX);
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, path);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, path);
   dh = opendir(tmp_path);
   if (dh == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
@@ -510,7 +501,7 @@ static uint16_t edfs_find(uint8_t rx_frame[], uint8_t attrib, char *pattern,
       }
     }
 
-    snprintf(tmp_path, PATH_MAX, "%s/%s/%s", edfs_root, path, entry->d_name);
+    snprintf(tmp_path, PATH_MAX, "%s/%s/%s", edfs->root, path, entry->d_name);
     if (stat(tmp_path, &st) != 0) {
       edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
       return 0x3C;
@@ -534,7 +525,7 @@ static uint16_t edfs_find(uint8_t rx_frame[], uint8_t attrib, char *pattern,
     /* Register all valid entries: */
     snprintf(tmp_path, PATH_MAX, "%s/%s", path, entry->d_name);
     unixpath_to_path83(tmp_path, path83);
-    edfs_cluster_register(tmp_path, path83);
+    edfs_cluster_register(edfs, tmp_path, path83);
 
     unixpath_to_path83(entry->d_name, path83);
     path83_to_filefcb(path83, filefcb);
@@ -592,7 +583,7 @@ static uint16_t edfs_find(uint8_t rx_frame[], uint8_t attrib, char *pattern,
 
 
 
-static uint16_t edfs_open(uint8_t rx_frame[], char *path83,
+static uint16_t edfs_open(edfs_t *edfs, uint8_t rx_frame[], char *path83,
   uint16_t attrib, uint16_t action)
 {
   FILE *fh;
@@ -605,19 +596,19 @@ static uint16_t edfs_open(uint8_t rx_frame[], char *path83,
   uint16_t dos_date;
   uint16_t dos_time;
 
-  p = edfs_cluster_lookup_83(path83, &cluster);
+  p = edfs_cluster_lookup_83(edfs, path83, &cluster);
   if (p == NULL) {
     if ((action & 0xF0) == 0x10) { /* Create if it does not exist. */
-      path83_to_unixpath(path83, path);
-      snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, path);
+      path83_to_unixpath(edfs, path83, path);
+      snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, path);
       fh = fopen(tmp_path, "w+b"); /* Open and close the file to create it. */
       if (fh == NULL) {
         edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
         return 0x3C;
       }
       fclose(fh);
-      edfs_cluster_register(path, path83);
-      p = edfs_cluster_lookup_83(path83, &cluster);
+      edfs_cluster_register(edfs, path, path83);
+      p = edfs_cluster_lookup_83(edfs, path83, &cluster);
       if (p == NULL) {
         edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
         return 0x3C;
@@ -628,8 +619,8 @@ static uint16_t edfs_open(uint8_t rx_frame[], char *path83,
     }
   } else {
     if ((action & 0x0F) == 0x02) { /* Exists, but truncate the file. */
-      path83_to_unixpath(path83, path);
-      snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, path);
+      path83_to_unixpath(edfs, path83, path);
+      snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, path);
       fh = fopen(tmp_path, "w+b"); /* Open and close the file to truncate. */
       if (fh == NULL) {
         edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
@@ -639,7 +630,7 @@ static uint16_t edfs_open(uint8_t rx_frame[], char *path83,
     }
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, p);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, p);
   if (stat(tmp_path, &st) != 0) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
@@ -693,7 +684,7 @@ static uint16_t edfs_open(uint8_t rx_frame[], char *path83,
 
 
 
-static uint16_t edfs_read(uint8_t rx_frame[], uint32_t offset,
+static uint16_t edfs_read(edfs_t *edfs, uint8_t rx_frame[], uint32_t offset,
   uint16_t cluster, uint16_t len)
 {
   FILE *fh;
@@ -701,7 +692,7 @@ static uint16_t edfs_read(uint8_t rx_frame[], uint32_t offset,
   char tmp_path[PATH_MAX];
   char *p;
 
-  p = edfs_cluster_lookup(cluster);
+  p = edfs_cluster_lookup(edfs, cluster);
   if (p == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
@@ -713,7 +704,7 @@ static uint16_t edfs_read(uint8_t rx_frame[], uint32_t offset,
     return 0x3C;
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, p);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, p);
   fh = fopen(tmp_path, "rb");
   if (fh == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_ACCESS_DENIED);
@@ -730,7 +721,7 @@ static uint16_t edfs_read(uint8_t rx_frame[], uint32_t offset,
 
 
 
-static uint16_t edfs_write(uint8_t rx_frame[], uint32_t offset,
+static uint16_t edfs_write(edfs_t *edfs, uint8_t rx_frame[], uint32_t offset,
   uint16_t cluster, uint8_t data[], uint16_t len)
 {
   FILE *fh;
@@ -739,13 +730,13 @@ static uint16_t edfs_write(uint8_t rx_frame[], uint32_t offset,
   char tmp_path[PATH_MAX];
   char *p;
 
-  p = edfs_cluster_lookup(cluster);
+  p = edfs_cluster_lookup(edfs, cluster);
   if (p == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, p);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, p);
   if (stat(tmp_path, &st) != 0) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
@@ -775,21 +766,21 @@ static uint16_t edfs_write(uint8_t rx_frame[], uint32_t offset,
 
 
 
-static uint16_t edfs_rmdir(uint8_t rx_frame[], char *path83)
+static uint16_t edfs_rmdir(edfs_t *edfs, uint8_t rx_frame[], char *path83)
 {
   char tmp_path[PATH_MAX];
   char *p;
   uint16_t cluster;
 
-  p = edfs_cluster_lookup_83(path83, &cluster);
+  p = edfs_cluster_lookup_83(edfs, path83, &cluster);
   if (p == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, p);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, p);
   if (rmdir(tmp_path) == 0) {
-    edfs_cluster_unregister(p);
+    edfs_cluster_unregister(edfs, p);
     edfs_set_result(rx_frame, EDFS_RESULT_OK);
   } else {
     edfs_set_result(rx_frame, EDFS_RESULT_ACCESS_DENIED);
@@ -800,16 +791,16 @@ static uint16_t edfs_rmdir(uint8_t rx_frame[], char *path83)
 
 
 
-static uint16_t edfs_mkdir(uint8_t rx_frame[], char *path83)
+static uint16_t edfs_mkdir(edfs_t *edfs, uint8_t rx_frame[], char *path83)
 {
   char tmp_path[PATH_MAX];
   char path[EDFS_PATH_MAX];
 
-  path83_to_unixpath(path83, path);
+  path83_to_unixpath(edfs, path83, path);
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, path);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, path);
   if (mkdir(tmp_path, 0777) == 0) {
-    edfs_cluster_register(path, path83);
+    edfs_cluster_register(edfs, path, path83);
     edfs_set_result(rx_frame, EDFS_RESULT_OK);
   } else {
     edfs_set_result(rx_frame, EDFS_RESULT_ACCESS_DENIED);
@@ -820,20 +811,20 @@ static uint16_t edfs_mkdir(uint8_t rx_frame[], char *path83)
 
 
 
-static uint16_t edfs_chdir(uint8_t rx_frame[], char *path83)
+static uint16_t edfs_chdir(edfs_t *edfs, uint8_t rx_frame[], char *path83)
 {
   struct stat st;
   char tmp_path[PATH_MAX];
   char *p;
   uint16_t cluster;
 
-  p = edfs_cluster_lookup_83(path83, &cluster);
+  p = edfs_cluster_lookup_83(edfs, path83, &cluster);
   if (p == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, p);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, p);
   if (stat(tmp_path, &st) != 0) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
@@ -850,7 +841,7 @@ static uint16_t edfs_chdir(uint8_t rx_frame[], char *path83)
 
 
 
-static uint16_t edfs_rename(uint8_t rx_frame[],
+static uint16_t edfs_rename(edfs_t *edfs, uint8_t rx_frame[],
   char *path83_src, char *path83_dst)
 {
   char tmp_path_src[PATH_MAX];
@@ -859,19 +850,19 @@ static uint16_t edfs_rename(uint8_t rx_frame[],
   char *p;
   uint16_t cluster;
 
-  p = edfs_cluster_lookup_83(path83_src, &cluster);
+  p = edfs_cluster_lookup_83(edfs, path83_src, &cluster);
   if (p == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_FILE_NOT_FOUND);
     return 0x3C;
   }
 
-  path83_to_unixpath(path83_dst, path);
+  path83_to_unixpath(edfs, path83_dst, path);
 
-  snprintf(tmp_path_src, PATH_MAX, "%s/%s", edfs_root, p);
-  snprintf(tmp_path_dst, PATH_MAX, "%s/%s", edfs_root, path);
+  snprintf(tmp_path_src, PATH_MAX, "%s/%s", edfs->root, p);
+  snprintf(tmp_path_dst, PATH_MAX, "%s/%s", edfs->root, path);
   if (rename(tmp_path_src, tmp_path_dst) == 0) {
-    edfs_cluster_unregister(p);
-    edfs_cluster_register(path, path83_dst);
+    edfs_cluster_unregister(edfs, p);
+    edfs_cluster_register(edfs, path, path83_dst);
     edfs_set_result(rx_frame, EDFS_RESULT_OK);
   } else {
     edfs_set_result(rx_frame, EDFS_RESULT_ACCESS_DENIED);
@@ -882,7 +873,7 @@ static uint16_t edfs_rename(uint8_t rx_frame[],
 
 
 
-static uint16_t edfs_delete(uint8_t rx_frame[], char *path83)
+static uint16_t edfs_delete(edfs_t *edfs, uint8_t rx_frame[], char *path83)
 {
   char tmp_path[PATH_MAX];
   char *p;
@@ -890,15 +881,15 @@ static uint16_t edfs_delete(uint8_t rx_frame[], char *path83)
 
   /* NOTE: Patterns like "????????.???" to delete all files not supported! */
 
-  p = edfs_cluster_lookup_83(path83, &cluster);
+  p = edfs_cluster_lookup_83(edfs, path83, &cluster);
   if (p == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_FILE_NOT_FOUND);
     return 0x3C;
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, p);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, p);
   if (unlink(tmp_path) == 0) {
-    edfs_cluster_unregister(p);
+    edfs_cluster_unregister(edfs, p);
     edfs_set_result(rx_frame, EDFS_RESULT_OK);
   } else {
     edfs_set_result(rx_frame, EDFS_RESULT_ACCESS_DENIED);
@@ -909,7 +900,7 @@ static uint16_t edfs_delete(uint8_t rx_frame[], char *path83)
 
 
 
-static uint16_t edfs_getattr(uint8_t rx_frame[], char *path83)
+static uint16_t edfs_getattr(edfs_t *edfs, uint8_t rx_frame[], char *path83)
 {
   struct stat st;
   char tmp_path[PATH_MAX];
@@ -918,13 +909,13 @@ static uint16_t edfs_getattr(uint8_t rx_frame[], char *path83)
   uint16_t dos_date;
   uint16_t dos_time;
 
-  p = edfs_cluster_lookup_83(path83, &cluster);
+  p = edfs_cluster_lookup_83(edfs, path83, &cluster);
   if (p == NULL) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
   }
 
-  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs_root, p);
+  snprintf(tmp_path, PATH_MAX, "%s/%s", edfs->root, p);
   if (stat(tmp_path, &st) != 0) {
     edfs_set_result(rx_frame, EDFS_RESULT_PATH_NOT_FOUND);
     return 0x3C;
@@ -954,7 +945,8 @@ static uint16_t edfs_getattr(uint8_t rx_frame[], char *path83)
 
 
 
-void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
+void edfs_handle_packet(edfs_t *edfs, net_t *net, uint8_t tx_frame[],
+  uint16_t tx_len)
 {
   uint8_t func;
   uint8_t ver;
@@ -969,10 +961,6 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
   char path[PATH_MAX];
   char path_dst[PATH_MAX];
 
-  if (edfs_inited == false) {
-    return;
-  }
-
   ver   = tx_frame[0x38] & 0x7F;
   func  = tx_frame[0x3B];
 
@@ -984,19 +972,19 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
   switch (func) {
   case EDFS_RMDIR:
     edfs_trace("RMDIR, s='%s'\n", edfs_path(tx_frame, tx_len, 0x3C, path));
-    net->rx_len = edfs_rmdir(net->rx_frame,
+    net->rx_len = edfs_rmdir(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x3C, path));
     break;
 
   case EDFS_MKDIR:
     edfs_trace("MKDIR, s='%s'\n", edfs_path(tx_frame, tx_len, 0x3C, path));
-    net->rx_len = edfs_mkdir(net->rx_frame,
+    net->rx_len = edfs_mkdir(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x3C, path));
     break;
 
   case EDFS_CHDIR:
     edfs_trace("CHDIR, s='%s'\n", edfs_path(tx_frame, tx_len, 0x3C, path));
-    net->rx_len = edfs_chdir(net->rx_frame,
+    net->rx_len = edfs_chdir(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x3C, path));
     break;
 
@@ -1019,7 +1007,7 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     len     += tx_frame[0x43] << 8;
     edfs_trace("READFILE, O=0x%08x, S=0x%04x, L=0x%04x\n",
       offset, cluster, len);
-    net->rx_len = edfs_read(net->rx_frame, offset, cluster, len);
+    net->rx_len = edfs_read(edfs, net->rx_frame, offset, cluster, len);
     break;
 
   case EDFS_WRITEFILE:
@@ -1031,7 +1019,7 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     cluster += tx_frame[0x41] << 8;
     edfs_trace("WRITEFILE, O=0x%08x, S=0x%04x L=0x%04x\n", offset, cluster,
       tx_len - 0x42);
-    net->rx_len = edfs_write(net->rx_frame, offset, cluster,
+    net->rx_len = edfs_write(edfs, net->rx_frame, offset, cluster,
       &tx_frame[0x42], tx_len - 0x42);
     break;
 
@@ -1059,14 +1047,14 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
 
   case EDFS_GETATTR:
     edfs_trace("GETATTR, f='%s'\n", edfs_path(tx_frame, tx_len, 0x3C, path));
-    net->rx_len = edfs_getattr(net->rx_frame,
+    net->rx_len = edfs_getattr(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x3C, path));
     break;
 
   case EDFS_FINDFIRST:
     edfs_trace("FINDFIRST, A=0x%02x, f='%s'\n", tx_frame[0x3C],
       edfs_path(tx_frame, tx_len, 0x3D, path));
-    net->rx_len = edfs_find(net->rx_frame, tx_frame[0x3C],
+    net->rx_len = edfs_find(edfs, net->rx_frame, tx_frame[0x3C],
       edfs_path(tx_frame, tx_len, 0x3D, path), 0, 0);
     break;
 
@@ -1077,7 +1065,7 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     pos     += tx_frame[0x3F] << 8;
     edfs_trace("FINDNEXT, C=0x%04x, p=0x%04x, A=0x%02x, f='%s'\n", cluster,
       pos, tx_frame[0x40], edfs_path(tx_frame, tx_len, 0x41, path));
-    net->rx_len = edfs_find(net->rx_frame, tx_frame[0x40],
+    net->rx_len = edfs_find(edfs, net->rx_frame, tx_frame[0x40],
       edfs_path(tx_frame, tx_len, 0x41, path), cluster, pos);
     break;
 
@@ -1085,14 +1073,14 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     edfs_trace("RENAME, L=%d, S='%s', D='%s'\n", tx_frame[0x3C],
       edfs_path(tx_frame, 61 + tx_frame[0x3C], 0x3D, path),
       edfs_path(tx_frame, tx_len, 0x3D + tx_frame[0x3C], path_dst));
-    net->rx_len = edfs_rename(net->rx_frame,
+    net->rx_len = edfs_rename(edfs, net->rx_frame,
       edfs_path(tx_frame, 61 + tx_frame[0x3C], 0x3D, path),
       edfs_path(tx_frame, tx_len, 0x3D + tx_frame[0x3C], path_dst));
     break;
 
   case EDFS_DELETE:
     edfs_trace("DELETE, f='%s'\n", edfs_path(tx_frame, tx_len, 0x3C, path));
-    net->rx_len = edfs_delete(net->rx_frame,
+    net->rx_len = edfs_delete(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x3C, path));
     break;
 
@@ -1101,7 +1089,7 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     attrib += tx_frame[0x3D] << 8;
     edfs_trace("OPEN, f='%s', S=0x%04x\n",
       edfs_path(tx_frame, tx_len, 0x42, path), attrib);
-    net->rx_len = edfs_open(net->rx_frame,
+    net->rx_len = edfs_open(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x42, path), attrib, 0x0001);
     break;
 
@@ -1110,7 +1098,7 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     attrib += tx_frame[0x3D] << 8;
     edfs_trace("CREATE, f='%s', S=0x%04x\n",
       edfs_path(tx_frame, tx_len, 0x42, path), attrib);
-    net->rx_len = edfs_open(net->rx_frame,
+    net->rx_len = edfs_open(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x42, path), 0x0002, 0x0012);
     break;
 
@@ -1123,7 +1111,7 @@ void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     mode   += tx_frame[0x41] << 8;
     edfs_trace("SPOPNFIL, f='%s', S=0x%04x, C=0x%04x, M=0x%04x\n",
       edfs_path(tx_frame, tx_len, 0x42, path), attrib, action, mode);
-    net->rx_len = edfs_open(net->rx_frame,
+    net->rx_len = edfs_open(edfs, net->rx_frame,
       edfs_path(tx_frame, tx_len, 0x42, path), mode, action);
     break;
 
@@ -4,8 +4,24 @@
 #include <stdint.h>
 #include "net.h"
 
-void edfs_init(const char *root);
-void edfs_handle_packet(net_t *net, uint8_t tx_frame[], uint16_t tx_len);
+#define EDFS_CLUSTER_MAX 1024 /* Can be increased up to UINT16_MAX. */
+#define EDFS_PATH83_MAX  260  /* In DOS, with limited 8.3 filenames. */
+#define EDFS_PATH_MAX    512  /* In Linux with possibly longer filenames. */
+
+typedef struct edfs_cluster_s {
+  char path[EDFS_PATH_MAX];
+  char path83[EDFS_PATH83_MAX];
+} edfs_cluster_t;
+
+typedef struct edfs_s {
+  char root[EDFS_PATH_MAX];
+  edfs_cluster_t cluster[EDFS_CLUSTER_MAX];
+  uint16_t cluster_used;
+} edfs_t;
+
+void edfs_init(edfs_t *edfs, net_t *net, const char *root);
+void edfs_handle_packet(edfs_t *edfs, net_t *net, uint8_t tx_frame[],
+  uint16_t tx_len);
 void edfs_trace_dump(FILE *fh);
 
 #endif /* _EDFS_H */
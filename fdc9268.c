@@ -70,8 +70,9 @@
 #define fdc_st0_clear(x, bit) (((fdc9268_t *)x)->st0 &= ~(1 << bit));
 #define fdc_state_set(x, st)  (((fdc9268_t *)x)->state = st);
 
-static char fdc_trace_buffer[FDC_TRACE_BUFFER_SIZE][FDC_TRACE_MAX];
-static int fdc_trace_buffer_n = 0;
+static _Thread_local char
+  fdc_trace_buffer[FDC_TRACE_BUFFER_SIZE][FDC_TRACE_MAX];
+static _Thread_local int fdc_trace_buffer_n = 0;
 
 
 
@@ -465,15 +465,14 @@ void fe2010_init(fe2010_t *fe2010, io_t *io, i8088_t *cpu, mem_t *mem)
 
 void fe2010_execute(fe2010_t *fe2010)
 {
-  static int cycle = 0;
   int i;
   int j;
 
   /* NOTE: Counting is currently not synchronized at all against CPU! */
   /* This particular cycle counting makes the POST timer 2 check succeed. */
-  cycle++;
-  if (cycle > 6) {
-    cycle = 0;
+  fe2010->pit_prescaler++;
+  if (fe2010->pit_prescaler > 6) {
+    fe2010->pit_prescaler = 0;
 
     /* Check for pending IRQs. */
     for (i = 0; i < 8; i++) {
@@ -500,6 +499,48 @@ void fe2010_execute(fe2010_t *fe2010)
 
 
 
+uint32_t fe2010_idle_cycles(fe2010_t *fe2010)
+{
+  uint32_t ticks;
+  uint32_t counter;
+  int i;
+
+  /* Number of fe2010_execute() calls that would only count down, before
+     one that checks a pending IRQ or has a timer reach zero. */
+  for (i = 0; i < 8; i++) {
+    if (fe2010->irq_pending[i]) {
+      return 6 - fe2010->pit_prescaler;
+    }
+  }
+
+  ticks = UINT32_MAX;
+  for (i = 0; i < 3; i += 2) { /* Timer 1 has no output. */
+    counter = (fe2010->pit[i].counter == 0) ? 0x10000 : fe2010->pit[i].counter;
+    if ((counter - 1) / 3 < ticks) {
+      ticks = (counter - 1) / 3;
+    }
+  }
+  return (6 - fe2010->pit_prescaler) + (ticks * 7);
+}
+
+
+
+void fe2010_idle_skip(fe2010_t *fe2010, uint32_t cycles)
+{
+  uint32_t ticks;
+  int i;
+
+  /* Same as calling fe2010_execute() for as many cycles, as long as no
+     more than fe2010_idle_cycles() are skipped. */
+  ticks = (fe2010->pit_prescaler + cycles) / 7;
+  fe2010->pit_prescaler = (fe2010->pit_prescaler + cycles) % 7;
+  for (i = 0; i < 3; i++) {
+    fe2010->pit[i].counter -= ticks * 3;
+  }
+}
+
+
+
 void fe2010_irq(fe2010_t *fe2010, int irq_no)
 {
   if (((fe2010->irq_mask >> irq_no) & 1) == 0) {
@@ -56,6 +56,7 @@ typedef struct fe2010_s {
   bool irq_pending[8];
 
   pit_t pit[3];
+  uint8_t pit_prescaler;
 
   i8088_t *cpu;
   mem_t *mem;
@@ -70,11 +71,15 @@ typedef struct fe2010_s {
 #define FE2010_IRQ_FLOPPY_DISK 6
 #define FE2010_IRQ_LPT1        7
 
+#define FE2010_SWITCH_8087 0b00000010
+
 #define FE2010_DMA_FLOPPY_DISK 2
 #define FE2010_DMA_HARD_DISK   3
 
 void fe2010_init(fe2010_t *fe2010, io_t *io, i8088_t *cpu, mem_t *mem);
 void fe2010_execute(fe2010_t *fe2010);
+uint32_t fe2010_idle_cycles(fe2010_t *fe2010);
+void fe2010_idle_skip(fe2010_t *fe2010, uint32_t cycles);
 void fe2010_irq(fe2010_t *fe2010, int irq_no);
 void fe2010_dma_write(fe2010_t *fe2010, int channel_no,
   uint8_t (*callback_func)(void *), void *callback_data);
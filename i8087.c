@@ -0,0 +1,1005 @@
+#include "i8087.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fenv.h>
+
+#include "i8088.h"
+#include "mem.h"
+#include "panic.h"
+
+/* Default NaN stored on masked invalid operations. */
+#define INDEFINITE (-(long double)NAN)
+
+#define CONSTANT_L2T 3.32192809488736234787031942948939018L
+#define CONSTANT_L2E 1.44269504088896340735992468100189214L
+#define CONSTANT_PI  3.14159265358979323846264338327950288L
+#define CONSTANT_LG2 0.30102999566398119521373889472449302L
+#define CONSTANT_LN2 0.69314718055994530941723212145817656L
+
+/* Host rounding modes for the RC field in the control word. */
+static const int rounding_mode[4] = {
+  FE_TONEAREST,
+  FE_DOWNWARD,
+  FE_UPWARD,
+  FE_TOWARDZERO,
+};
+
+
+
+static uint64_t operand_read(mem_t *mem, uint32_t base, uint16_t offset,
+  int size)
+{
+  uint64_t value = 0;
+  int i;
+
+  /* Operands wrap around within the segment, like on the CPU. */
+  for (i = size - 1; i >= 0; i--) {
+    value = (value << 8) |
+      mem_read(mem, (base + (uint16_t)(offset + i)) & 0xFFFFF);
+  }
+  return value;
+}
+
+
+
+static void operand_write(mem_t *mem, uint32_t base, uint16_t offset,
+  uint64_t value, int size)
+{
+  int i;
+
+  for (i = 0; i < size; i++) {
+    mem_write(mem, (base + (uint16_t)(offset + i)) & 0xFFFFF, value & 0xFF);
+    value >>= 8;
+  }
+}
+
+
+
+static long double operand_read_int(mem_t *mem, uint32_t base,
+  uint16_t offset, int size)
+{
+  int shift = 64 - (size * 8);
+
+  return (int64_t)(operand_read(mem, base, offset, size) << shift) >> shift;
+}
+
+
+
+static long double operand_read_real_32(mem_t *mem, uint32_t base,
+  uint16_t offset)
+{
+  uint32_t bits;
+  float value;
+
+  bits = operand_read(mem, base, offset, 4);
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+
+
+static long double operand_read_real_64(mem_t *mem, uint32_t base,
+  uint16_t offset)
+{
+  uint64_t bits;
+  double value;
+
+  bits = operand_read(mem, base, offset, 8);
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+
+
+static long double operand_read_real_80(mem_t *mem, uint32_t base,
+  uint16_t offset)
+{
+  uint64_t mantissa;
+  uint16_t exponent;
+  long double value;
+
+  mantissa = operand_read(mem, base, offset, 8);
+  exponent = operand_read(mem, base, offset + 8, 2);
+
+  if ((exponent & 0x7FFF) == 0x7FFF) {
+    value = ((mantissa << 1) == 0) ? INFINITY : NAN;
+  } else if ((exponent & 0x7FFF) == 0) {
+    value = ldexpl(mantissa, -16382 - 63); /* Denormal */
+  } else {
+    value = ldexpl(mantissa, (exponent & 0x7FFF) - 16383 - 63);
+  }
+
+  return (exponent & 0x8000) ? -value : value;
+}
+
+
+
+static long double operand_read_bcd(mem_t *mem, uint32_t base,
+  uint16_t offset)
+{
+  uint64_t value = 0;
+  uint8_t digits;
+  int i;
+
+  for (i = 8; i >= 0; i--) {
+    digits = operand_read(mem, base, offset + i, 1);
+    value = (value * 100) + ((digits >> 4) * 10) + (digits & 0xF);
+  }
+
+  if (operand_read(mem, base, offset + 9, 1) & 0x80) {
+    return -(long double)value;
+  } else {
+    return value;
+  }
+}
+
+
+
+static void operand_write_real_32(mem_t *mem, uint32_t base, uint16_t offset,
+  long double value)
+{
+  uint32_t bits;
+  float short_real = value;
+
+  memcpy(&bits, &short_real, sizeof(bits));
+  operand_write(mem, base, offset, bits, 4);
+}
+
+
+
+static void operand_write_real_64(mem_t *mem, uint32_t base, uint16_t offset,
+  long double value)
+{
+  uint64_t bits;
+  double long_real = value;
+
+  memcpy(&bits, &long_real, sizeof(bits));
+  operand_write(mem, base, offset, bits, 8);
+}
+
+
+
+static void operand_write_real_80(mem_t *mem, uint32_t base, uint16_t offset,
+  long double value)
+{
+  uint64_t mantissa;
+  int16_t exponent;
+  int e;
+
+  if (isnan(value)) {
+    mantissa = 0xC000000000000000;
+    exponent = 0x7FFF;
+  } else if (isinf(value)) {
+    mantissa = 0x8000000000000000;
+    exponent = 0x7FFF;
+  } else if (value == 0) {
+    mantissa = 0;
+    exponent = 0;
+  } else {
+    mantissa = ldexpl(frexpl(fabsl(value), &e), 64);
+    exponent = e - 1 + 16383;
+    if (exponent <= 0) {
+      mantissa = ldexpl(fabsl(value), 16382 + 63); /* Denormal */
+      exponent = 0;
+    }
+  }
+
+  operand_write(mem, base, offset, mantissa, 8);
+  operand_write(mem, base, offset + 8,
+    exponent | (signbit(value) ? 0x8000 : 0), 2);
+}
+
+
+
+static void i8087_exception(i8087_t *fpu, uint16_t flags)
+{
+  fpu->sw |= flags;
+  if ((flags & ~fpu->cw & 0x3F) && ! (fpu->cw & I8087_CW_IEM)) {
+    /* Would interrupt the CPU through the NMI, which is not wired up. */
+    fpu->sw |= I8087_SW_IR;
+  }
+}
+
+
+
+static void operand_write_int(i8087_t *fpu, mem_t *mem, uint32_t base,
+  uint16_t offset, long double value, int size)
+{
+  long double limit = ldexpl(1, (size * 8) - 1);
+
+  /* Rounded with the host rounding mode, already set from the RC field. */
+  value = nearbyintl(value);
+  if (isnan(value) || value >= limit || value < -limit) {
+    i8087_exception(fpu, I8087_SW_IE);
+    operand_write(mem, base, offset, (uint64_t)1 << ((size * 8) - 1), size);
+  } else {
+    operand_write(mem, base, offset, (int64_t)value, size);
+  }
+}
+
+
+
+static void operand_write_bcd(i8087_t *fpu, mem_t *mem, uint32_t base,
+  uint16_t offset, long double value)
+{
+  uint64_t digits;
+  uint8_t byte;
+  int i;
+
+  value = nearbyintl(value);
+  if (isnan(value) || fabsl(value) >= 1e18L) {
+    i8087_exception(fpu, I8087_SW_IE);
+    operand_write(mem, base, offset, 0, 7);
+    operand_write(mem, base, offset + 7, 0xFFFFC0, 3); /* Indefinite */
+    return;
+  }
+
+  digits = fabsl(value);
+  for (i = 0; i < 9; i++) {
+    byte = digits % 10;
+    digits /= 10;
+    byte |= (digits % 10) << 4;
+    digits /= 10;
+    operand_write(mem, base, offset + i, byte, 1);
+  }
+  operand_write(mem, base, offset + 9, signbit(value) ? 0x80 : 0x00, 1);
+}
+
+
+
+static inline uint8_t tag_get(i8087_t *fpu, int reg)
+{
+  return (fpu->tw >> (reg * 2)) & 0b11;
+}
+
+
+
+static inline void tag_set(i8087_t *fpu, int reg, uint8_t tag)
+{
+  fpu->tw = (fpu->tw & ~(0b11 << (reg * 2))) | (tag << (reg * 2));
+}
+
+
+
+static uint8_t tag_of(long double value)
+{
+  switch (fpclassify(value)) {
+  case FP_NORMAL:
+    return I8087_TAG_VALID;
+  case FP_ZERO:
+    return I8087_TAG_ZERO;
+  default:
+    return I8087_TAG_SPECIAL;
+  }
+}
+
+
+
+static long double st_get(i8087_t *fpu, int i)
+{
+  int reg = (fpu->top + i) & 7;
+
+  if (tag_get(fpu, reg) == I8087_TAG_EMPTY) {
+    i8087_exception(fpu, I8087_SW_IE); /* Stack underflow. */
+    return INDEFINITE;
+  }
+  return fpu->st[reg];
+}
+
+
+
+static void st_set(i8087_t *fpu, int i, long double value)
+{
+  int reg = (fpu->top + i) & 7;
+
+  fpu->st[reg] = value;
+  tag_set(fpu, reg, tag_of(value));
+}
+
+
+
+static void st_push(i8087_t *fpu, long double value)
+{
+  fpu->top = (fpu->top - 1) & 7;
+  if (tag_get(fpu, fpu->top) != I8087_TAG_EMPTY) {
+    i8087_exception(fpu, I8087_SW_IE); /* Stack overflow. */
+    value = INDEFINITE;
+  }
+  st_set(fpu, 0, value);
+}
+
+
+
+static void st_pop(i8087_t *fpu)
+{
+  tag_set(fpu, fpu->top, I8087_TAG_EMPTY);
+  fpu->top = (fpu->top + 1) & 7;
+}
+
+
+
+static uint16_t i8087_status(i8087_t *fpu)
+{
+  return fpu->sw | (fpu->top << 11);
+}
+
+
+
+static void i8087_compare(i8087_t *fpu, long double a, long double b)
+{
+  fpu->sw &= ~(I8087_SW_C3 | I8087_SW_C2 | I8087_SW_C0);
+  if (isnan(a) || isnan(b)) {
+    i8087_exception(fpu, I8087_SW_IE);
+    fpu->sw |= I8087_SW_C3 | I8087_SW_C2 | I8087_SW_C0; /* Unordered */
+  } else if (a < b) {
+    fpu->sw |= I8087_SW_C0;
+  } else if (a == b) {
+    fpu->sw |= I8087_SW_C3;
+  }
+}
+
+
+
+static void i8087_arith(i8087_t *fpu, uint8_t op, int dst, long double src)
+{
+  long double value;
+
+  /* Operation from the REG field of the ModRM byte, on ST(dst) and src.
+     The compares always go against ST(0). */
+  value = st_get(fpu, dst);
+  switch (op) {
+  case 0:
+    st_set(fpu, dst, value + src);
+    break;
+  case 1:
+    st_set(fpu, dst, value * src);
+    break;
+  case 2:
+    i8087_compare(fpu, value, src);
+    break;
+  case 3:
+    i8087_compare(fpu, value, src);
+    st_pop(fpu);
+    break;
+  case 4:
+    st_set(fpu, dst, value - src);
+    break;
+  case 5:
+    st_set(fpu, dst, src - value);
+    break;
+  case 6:
+    st_set(fpu, dst, value / src);
+    break;
+  case 7:
+    st_set(fpu, dst, src / value);
+    break;
+  }
+}
+
+
+
+static void i8087_env_load(i8087_t *fpu, mem_t *mem, uint32_t base,
+  uint16_t offset)
+{
+  uint16_t sw;
+
+  fpu->cw = operand_read(mem, base, offset, 2);
+  sw = operand_read(mem, base, offset + 2, 2);
+  fpu->sw = sw & ~0x3800;
+  fpu->top = (sw >> 11) & 7;
+  fpu->tw = operand_read(mem, base, offset + 4, 2);
+  fpu->opcode = operand_read(mem, base, offset + 8, 2) & 0x7FF;
+  fpu->operand = operand_read(mem, base, offset + 10, 2) |
+    ((operand_read(mem, base, offset + 12, 2) >> 12) << 16);
+}
+
+
+
+static void i8087_env_store(i8087_t *fpu, mem_t *mem, uint32_t base,
+  uint16_t offset)
+{
+  operand_write(mem, base, offset, fpu->cw, 2);
+  operand_write(mem, base, offset + 2, i8087_status(fpu), 2);
+  operand_write(mem, base, offset + 4, fpu->tw, 2);
+  operand_write(mem, base, offset + 6, 0, 2); /* IP is not kept. */
+  operand_write(mem, base, offset + 8, fpu->opcode, 2);
+  operand_write(mem, base, offset + 10, fpu->operand & 0xFFFF, 2);
+  operand_write(mem, base, offset + 12, (fpu->operand >> 16) << 12, 2);
+}
+
+
+
+static void i8087_fxam(i8087_t *fpu)
+{
+  int reg = fpu->top;
+  long double value = fpu->st[reg];
+
+  fpu->sw &= ~(I8087_SW_C3 | I8087_SW_C2 | I8087_SW_C1 | I8087_SW_C0);
+  if (signbit(value)) {
+    fpu->sw |= I8087_SW_C1;
+  }
+
+  if (tag_get(fpu, reg) == I8087_TAG_EMPTY) {
+    fpu->sw |= I8087_SW_C3 | I8087_SW_C0;
+    return;
+  }
+  switch (fpclassify(value)) {
+  case FP_NAN:
+    fpu->sw |= I8087_SW_C0;
+    break;
+  case FP_INFINITE:
+    fpu->sw |= I8087_SW_C2 | I8087_SW_C0;
+    break;
+  case FP_ZERO:
+    fpu->sw |= I8087_SW_C3;
+    break;
+  case FP_SUBNORMAL:
+    fpu->sw |= I8087_SW_C3 | I8087_SW_C2;
+    break;
+  default:
+    fpu->sw |= I8087_SW_C2;
+    break;
+  }
+}
+
+
+
+static void i8087_fprem(i8087_t *fpu)
+{
+  long double a = st_get(fpu, 0);
+  long double b = st_get(fpu, 1);
+  long double r;
+  uint8_t q;
+
+  fpu->sw &= ~(I8087_SW_C3 | I8087_SW_C2 | I8087_SW_C1 | I8087_SW_C0);
+  if (isnan(a) || isnan(b) || isinf(a) || b == 0) {
+    i8087_exception(fpu, I8087_SW_IE);
+    st_set(fpu, 0, INDEFINITE);
+    return;
+  }
+
+  /* Always reduced completely, so C2 stays clear. The lowest three bits
+     of the quotient go into C0, C3 and C1. */
+  r = fmodl(a, b);
+  q = (uint64_t)fmodl(fabsl(roundl((a - r) / b)), 8);
+  if (q & 4) {
+    fpu->sw |= I8087_SW_C0;
+  }
+  if (q & 2) {
+    fpu->sw |= I8087_SW_C3;
+  }
+  if (q & 1) {
+    fpu->sw |= I8087_SW_C1;
+  }
+  st_set(fpu, 0, r);
+}
+
+
+
+static void i8087_fxtract(i8087_t *fpu)
+{
+  long double value = st_get(fpu, 0);
+  long double exponent;
+
+  if (value == 0) {
+    i8087_exception(fpu, I8087_SW_ZE);
+    st_set(fpu, 0, -INFINITY);
+    st_push(fpu, value);
+    return;
+  }
+  exponent = logbl(value);
+  st_set(fpu, 0, exponent);
+  st_push(fpu, scalbnl(value, -(int)exponent));
+}
+
+
+
+static void i8087_fscale(i8087_t *fpu)
+{
+  long double scale = truncl(st_get(fpu, 1));
+
+  if (scale > 100000) {
+    scale = 100000;
+  } else if (scale < -100000) {
+    scale = -100000;
+  }
+  st_set(fpu, 0, scalbnl(st_get(fpu, 0), (int)scale));
+}
+
+
+
+static bool i8087_execute_d9(i8087_t *fpu, uint8_t reg, uint8_t rm)
+{
+  long double value;
+
+  switch (reg) {
+  case 0: /* FLD ST(i) */
+    st_push(fpu, st_get(fpu, rm));
+    return true;
+
+  case 1: /* FXCH ST(i) */
+    value = st_get(fpu, 0);
+    st_set(fpu, 0, st_get(fpu, rm));
+    st_set(fpu, rm, value);
+    return true;
+
+  case 2: /* FNOP */
+    return (rm == 0);
+
+  case 3: /* FSTP ST(i), undocumented. */
+    st_set(fpu, rm, st_get(fpu, 0));
+    st_pop(fpu);
+    return true;
+
+  case 4:
+    switch (rm) {
+    case 0: /* FCHS */
+      st_set(fpu, 0, -st_get(fpu, 0));
+      return true;
+    case 1: /* FABS */
+      st_set(fpu, 0, fabsl(st_get(fpu, 0)));
+      return true;
+    case 4: /* FTST */
+      i8087_compare(fpu, st_get(fpu, 0), 0.0L);
+      return true;
+    case 5: /* FXAM */
+      i8087_fxam(fpu);
+      return true;
+    }
+    return false;
+
+  case 5:
+    switch (rm) {
+    case 0: /* FLD1 */
+      st_push(fpu, 1.0L);
+      return true;
+    case 1: /* FLDL2T */
+      st_push(fpu, CONSTANT_L2T);
+      return true;
+    case 2: /* FLDL2E */
+      st_push(fpu, CONSTANT_L2E);
+      return true;
+    case 3: /* FLDPI */
+      st_push(fpu, CONSTANT_PI);
+      return true;
+    case 4: /* FLDLG2 */
+      st_push(fpu, CONSTANT_LG2);
+      return true;
+    case 5: /* FLDLN2 */
+      st_push(fpu, CONSTANT_LN2);
+      return true;
+    case 6: /* FLDZ */
+      st_push(fpu, 0.0L);
+      return true;
+    }
+    return false;
+
+  case 6:
+    switch (rm) {
+    case 0: /* F2XM1 */
+      st_set(fpu, 0, expm1l(st_get(fpu, 0) * CONSTANT_LN2));
+      return true;
+    case 1: /* FYL2X */
+      value = st_get(fpu, 1) * log2l(st_get(fpu, 0));
+      st_set(fpu, 1, value);
+      st_pop(fpu);
+      return true;
+    case 2: /* FPTAN */
+      st_set(fpu, 0, tanl(st_get(fpu, 0)));
+      st_push(fpu, 1.0L);
+      return true;
+    case 3: /* FPATAN */
+      value = atan2l(st_get(fpu, 1), st_get(fpu, 0));
+      st_set(fpu, 1, value);
+      st_pop(fpu);
+      return true;
+    case 4: /* FXTRACT */
+      i8087_fxtract(fpu);
+      return true;
+    case 6: /* FDECSTP */
+      fpu->top = (fpu->top - 1) & 7;
+      return true;
+    case 7: /* FINCSTP */
+      fpu->top = (fpu->top + 1) & 7;
+      return true;
+    }
+    return false;
+
+  case 7:
+    switch (rm) {
+    case 0: /* FPREM */
+      i8087_fprem(fpu);
+      return true;
+    case 1: /* FYL2XP1 */
+      value = st_get(fpu, 1) * (log1pl(st_get(fpu, 0)) / CONSTANT_LN2);
+      st_set(fpu, 1, value);
+      st_pop(fpu);
+      return true;
+    case 2: /* FSQRT */
+      st_set(fpu, 0, sqrtl(st_get(fpu, 0)));
+      return true;
+    case 4: /* FRNDINT */
+      st_set(fpu, 0, nearbyintl(st_get(fpu, 0)));
+      return true;
+    case 5: /* FSCALE */
+      i8087_fscale(fpu);
+      return true;
+    }
+    return false;
+  }
+
+  return false;
+}
+
+
+
+static bool i8087_execute_register(i8087_t *fpu, uint8_t opcode,
+  uint8_t reg, uint8_t rm)
+{
+  switch (opcode) {
+  case 0xD8: /* Arithmetic on ST(0) and ST(i). */
+    i8087_arith(fpu, reg, 0, st_get(fpu, rm));
+    return true;
+
+  case 0xD9:
+    return i8087_execute_d9(fpu, reg, rm);
+
+  case 0xDB:
+    if (reg != 4) {
+      return false;
+    }
+    switch (rm) {
+    case 0: /* FENI */
+      fpu->cw &= ~I8087_CW_IEM;
+      return true;
+    case 1: /* FDISI */
+      fpu->cw |= I8087_CW_IEM;
+      return true;
+    case 2: /* FCLEX */
+      fpu->sw &= ~(0x3F | I8087_SW_IR);
+      return true;
+    case 3: /* FINIT */
+      i8087_init(fpu);
+      return true;
+    }
+    return false;
+
+  case 0xDC: /* Arithmetic on ST(i) and ST(0), with SUB/SUBR and DIV/DIVR
+                swapped around compared to the D8 opcode. */
+  case 0xDE: /* Same, and pop. */
+    if (opcode == 0xDE && reg == 3 && rm != 1) {
+      return false;
+    }
+    if (reg == 2 || reg == 3) {
+      i8087_arith(fpu, reg, 0, st_get(fpu, rm));
+    } else {
+      i8087_arith(fpu, (reg >= 4) ? (reg ^ 1) : reg, rm, st_get(fpu, 0));
+    }
+    if (opcode == 0xDE) {
+      st_pop(fpu); /* Together with the pop from FCOMP, this is FCOMPP. */
+    }
+    return true;
+
+  case 0xDD:
+    switch (reg) {
+    case 0: /* FFREE ST(i) */
+      tag_set(fpu, (fpu->top + rm) & 7, I8087_TAG_EMPTY);
+      return true;
+    case 2: /* FST ST(i) */
+      st_set(fpu, rm, st_get(fpu, 0));
+      return true;
+    case 3: /* FSTP ST(i) */
+      st_set(fpu, rm, st_get(fpu, 0));
+      st_pop(fpu);
+      return true;
+    }
+    return false;
+  }
+
+  return false;
+}
+
+
+
+static bool i8087_execute_memory(i8087_t *fpu, mem_t *mem, uint8_t opcode,
+  uint8_t reg, uint32_t base, uint16_t offset)
+{
+  int i;
+
+  switch (opcode) {
+  case 0xD8: /* Arithmetic with short real. */
+    i8087_arith(fpu, reg, 0, operand_read_real_32(mem, base, offset));
+    return true;
+
+  case 0xDA: /* Arithmetic with short integer. */
+    i8087_arith(fpu, reg, 0, operand_read_int(mem, base, offset, 4));
+    return true;
+
+  case 0xDC: /* Arithmetic with long real. */
+    i8087_arith(fpu, reg, 0, operand_read_real_64(mem, base, offset));
+    return true;
+
+  case 0xDE: /* Arithmetic with word integer. */
+    i8087_arith(fpu, reg, 0, operand_read_int(mem, base, offset, 2));
+    return true;
+
+  case 0xD9:
+    switch (reg) {
+    case 0: /* FLD short real */
+      st_push(fpu, operand_read_real_32(mem, base, offset));
+      return true;
+    case 2: /* FST short real */
+      operand_write_real_32(mem, base, offset, st_get(fpu, 0));
+      return true;
+    case 3: /* FSTP short real */
+      operand_write_real_32(mem, base, offset, st_get(fpu, 0));
+      st_pop(fpu);
+      return true;
+    case 4: /* FLDENV */
+      i8087_env_load(fpu, mem, base, offset);
+      return true;
+    case 5: /* FLDCW */
+      fpu->cw = operand_read(mem, base, offset, 2);
+      return true;
+    case 6: /* FSTENV */
+      i8087_env_store(fpu, mem, base, offset);
+      fpu->cw |= 0x3F; /* Masks all exceptions afterwards. */
+      return true;
+    case 7: /* FSTCW */
+      operand_write(mem, base, offset, fpu->cw, 2);
+      return true;
+    }
+    return false;
+
+  case 0xDB:
+    switch (reg) {
+    case 0: /* FILD short integer */
+      st_push(fpu, operand_read_int(mem, base, offset, 4));
+      return true;
+    case 2: /* FIST short integer */
+      operand_write_int(fpu, mem, base, offset, st_get(fpu, 0), 4);
+      return true;
+    case 3: /* FISTP short integer */
+      operand_write_int(fpu, mem, base, offset, st_get(fpu, 0), 4);
+      st_pop(fpu);
+      return true;
+    case 5: /* FLD temporary real */
+      st_push(fpu, operand_read_real_80(mem, base, offset));
+      return true;
+    case 7: /* FSTP temporary real */
+      operand_write_real_80(mem, base, offset, st_get(fpu, 0));
+      st_pop(fpu);
+      return true;
+    }
+    return false;
+
+  case 0xDD:
+    switch (reg) {
+    case 0: /* FLD long real */
+      st_push(fpu, operand_read_real_64(mem, base, offset));
+      return true;
+    case 2: /* FST long real */
+      operand_write_real_64(mem, base, offset, st_get(fpu, 0));
+      return true;
+    case 3: /* FSTP long real */
+      operand_write_real_64(mem, base, offset, st_get(fpu, 0));
+      st_pop(fpu);
+      return true;
+    case 4: /* FRSTOR */
+      i8087_env_load(fpu, mem, base, offset);
+      for (i = 0; i < 8; i++) {
+        fpu->st[(fpu->top + i) & 7] =
+          operand_read_real_80(mem, base, offset + 14 + (i * 10));
+      }
+      return true;
+    case 6: /* FSAVE */
+      i8087_env_store(fpu, mem, base, offset);
+      for (i = 0; i < 8; i++) {
+        operand_write_real_80(mem, base, offset + 14 + (i * 10),
+          fpu->st[(fpu->top + i) & 7]);
+      }
+      i8087_init(fpu);
+      return true;
+    case 7: /* FSTSW */
+      operand_write(mem, base, offset, i8087_status(fpu), 2);
+      return true;
+    }
+    return false;
+
+  case 0xDF:
+    switch (reg) {
+    case 0: /* FILD word integer */
+      st_push(fpu, operand_read_int(mem, base, offset, 2));
+      return true;
+    case 2: /* FIST word integer */
+      operand_write_int(fpu, mem, base, offset, st_get(fpu, 0), 2);
+      return true;
+    case 3: /* FISTP word integer */
+      operand_write_int(fpu, mem, base, offset, st_get(fpu, 0), 2);
+      st_pop(fpu);
+      return true;
+    case 4: /* FBLD */
+      st_push(fpu, operand_read_bcd(mem, base, offset));
+      return true;
+    case 5: /* FILD long integer */
+      st_push(fpu, operand_read_int(mem, base, offset, 8));
+      return true;
+    case 6: /* FBSTP */
+      operand_write_bcd(fpu, mem, base, offset, st_get(fpu, 0));
+      st_pop(fpu);
+      return true;
+    case 7: /* FISTP long integer */
+      operand_write_int(fpu, mem, base, offset, st_get(fpu, 0), 8);
+      st_pop(fpu);
+      return true;
+    }
+    return false;
+  }
+
+  return false;
+}
+
+
+
+static bool i8087_control(uint8_t opcode, uint8_t modrm)
+{
+  /* These leave the last instruction and operand pointers alone. */
+  if (opcode == 0xD9 && modrm < 0xC0) {
+    return modrm_reg(modrm) >= 4;
+  } else if (opcode == 0xDB && modrm >= 0xC0) {
+    return modrm_reg(modrm) == 4;
+  } else if (opcode == 0xDD && modrm < 0xC0) {
+    return modrm_reg(modrm) >= 4;
+  }
+  return false;
+}
+
+
+
+void i8087_init(i8087_t *fpu)
+{
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    fpu->st[i] = 0.0L;
+  }
+  fpu->top = 0;
+  fpu->cw = 0x03FF;
+  fpu->sw = 0x0000;
+  fpu->tw = 0xFFFF;
+  fpu->opcode = 0;
+  fpu->operand = 0;
+}
+
+
+
+void i8087_execute(i8087_t *fpu, mem_t *mem, uint8_t opcode, uint8_t modrm,
+  uint32_t base, uint16_t offset)
+{
+  uint8_t rc;
+  bool done;
+  int raised;
+
+  if (! i8087_control(opcode, modrm)) {
+    fpu->opcode = ((opcode & 7) << 8) | modrm;
+    if (modrm < 0xC0) {
+      fpu->operand = (base + offset) & 0xFFFFF;
+    }
+  }
+
+  /* Run on the host FPU with the same rounding, and pick up the
+     exceptions it raised. Precision control is not emulated, everything
+     is calculated with the full 64-bit mantissa. */
+  rc = (fpu->cw >> 10) & 3;
+  if (rc != 0) {
+    fesetround(rounding_mode[rc]);
+  }
+  feclearexcept(FE_ALL_EXCEPT);
+
+  if (modrm >= 0xC0) {
+    done = i8087_execute_register(fpu, opcode, modrm_reg(modrm),
+      modrm_rm(modrm));
+  } else {
+    done = i8087_execute_memory(fpu, mem, opcode, modrm_reg(modrm),
+      base, offset);
+  }
+
+  raised = fetestexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW |
+    FE_UNDERFLOW | FE_INEXACT);
+  if (rc != 0) {
+    fesetround(FE_TONEAREST);
+  }
+  if (raised) {
+    i8087_exception(fpu,
+      ((raised & FE_INVALID)   ? I8087_SW_IE : 0) |
+      ((raised & FE_DIVBYZERO) ? I8087_SW_ZE : 0) |
+      ((raised & FE_OVERFLOW)  ? I8087_SW_OE : 0) |
+      ((raised & FE_UNDERFLOW) ? I8087_SW_UE : 0) |
+      ((raised & FE_INEXACT)   ? I8087_SW_PE : 0));
+  }
+
+  if (! done) {
+    panic("Unhandled 8087 instruction: %02x %02x\n", opcode, modrm);
+  }
+}
+
+
+
+static const char *mnemonic_memory[8][8] = {
+  {"fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr"},
+  {"fld", NULL, "fst", "fstp", "fldenv", "fldcw", "fstenv", "fstcw"},
+  {"fiadd", "fimul", "ficom", "ficomp", "fisub", "fisubr", "fidiv", "fidivr"},
+  {"fild", NULL, "fist", "fistp", NULL, "fld", NULL, "fstp"},
+  {"fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr"},
+  {"fld", NULL, "fst", "fstp", "frstor", NULL, "fsave", "fstsw"},
+  {"fiadd", "fimul", "ficom", "ficomp", "fisub", "fisubr", "fidiv", "fidivr"},
+  {"fild", NULL, "fist", "fistp", "fbld", "fild", "fbstp", "fistp"},
+};
+
+static const char *mnemonic_register[8][8] = {
+  {"fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr"},
+  {"fld", "fxch", "fnop", "fstp", NULL, NULL, NULL, NULL},
+  {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+  {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+  {"fadd", "fmul", "fcom", "fcomp", "fsubr", "fsub", "fdivr", "fdiv"},
+  {"ffree", NULL, "fst", "fstp", NULL, NULL, NULL, NULL},
+  {"faddp", "fmulp", "fcomp", "fcompp", "fsubrp", "fsubp", "fdivrp", "fdivp"},
+  {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL},
+};
+
+static const char *mnemonic_d9[4][8] = {
+  {"fchs", "fabs", NULL, NULL, "ftst", "fxam", NULL, NULL},
+  {"fld1", "fldl2t", "fldl2e", "fldpi", "fldlg2", "fldln2", "fldz", NULL},
+  {"f2xm1", "fyl2x", "fptan", "fpatan", "fxtract", NULL, "fdecstp",
+   "fincstp"},
+  {"fprem", "fyl2xp1", "fsqrt", NULL, "frndint", "fscale", NULL, NULL},
+};
+
+static const char *mnemonic_db[8] = {
+  "feni", "fdisi", "fclex", "finit", NULL, NULL, NULL, NULL,
+};
+
+
+
+const char *i8087_mnemonic(uint8_t opcode, uint8_t modrm)
+{
+  const char *mnemonic;
+
+  if (modrm < 0xC0) {
+    mnemonic = mnemonic_memory[opcode & 7][modrm_reg(modrm)];
+  } else if (opcode == 0xD9 && modrm_reg(modrm) >= 4) {
+    mnemonic = mnemonic_d9[modrm_reg(modrm) - 4][modrm_rm(modrm)];
+  } else if (opcode == 0xDB && modrm_reg(modrm) == 4) {
+    mnemonic = mnemonic_db[modrm_rm(modrm)];
+  } else {
+    mnemonic = mnemonic_register[opcode & 7][modrm_reg(modrm)];
+  }
+
+  return (mnemonic == NULL) ? "esc" : mnemonic;
+}
+
+
+
+void i8087_dump(FILE *fh, i8087_t *fpu)
+{
+  int i;
+  int reg;
+
+  fprintf(fh, "CW=%04x SW=%04x TW=%04x TOP=%d\n",
+    fpu->cw, i8087_status(fpu), fpu->tw, fpu->top);
+  for (i = 0; i < 8; i++) {
+    reg = (fpu->top + i) & 7;
+    if (tag_get(fpu, reg) == I8087_TAG_EMPTY) {
+      fprintf(fh, "ST(%d) = Empty\n", i);
+    } else {
+      fprintf(fh, "ST(%d) = %.19Lg\n", i, fpu->st[reg]);
+    }
+  }
+}
+
+
+
@@ -0,0 +1,46 @@
+#ifndef _I8087_H
+#define _I8087_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "mem.h"
+
+#define I8087_SW_IE 0x0001 /* Invalid Operation */
+#define I8087_SW_DE 0x0002 /* Denormalized Operand */
+#define I8087_SW_ZE 0x0004 /* Zero Divide */
+#define I8087_SW_OE 0x0008 /* Overflow */
+#define I8087_SW_UE 0x0010 /* Underflow */
+#define I8087_SW_PE 0x0020 /* Precision */
+#define I8087_SW_IR 0x0080 /* Interrupt Request */
+#define I8087_SW_C0 0x0100
+#define I8087_SW_C1 0x0200
+#define I8087_SW_C2 0x0400
+#define I8087_SW_C3 0x4000
+
+#define I8087_CW_IEM 0x0080 /* Interrupt Enable Mask */
+
+#define I8087_TAG_VALID   0b00
+#define I8087_TAG_ZERO    0b01
+#define I8087_TAG_SPECIAL 0b10
+#define I8087_TAG_EMPTY   0b11
+
+typedef struct i8087_s {
+  long double st[8]; /* Physical registers, ST(0) is st[top]. */
+  uint8_t top;
+  uint16_t cw; /* Control Word */
+  uint16_t sw; /* Status Word, without the TOP field. */
+  uint16_t tw; /* Tag Word */
+
+  /* Last instruction, for FSTENV and FSAVE. */
+  uint16_t opcode; /* Lower 11 bits of the ESC opcode and ModRM. */
+  uint32_t operand; /* Linear address of the memory operand. */
+} i8087_t;
+
+void i8087_init(i8087_t *fpu);
+void i8087_execute(i8087_t *fpu, mem_t *mem, uint8_t opcode, uint8_t modrm,
+  uint32_t base, uint16_t offset);
+const char *i8087_mnemonic(uint8_t opcode, uint8_t modrm);
+void i8087_dump(FILE *fh, i8087_t *fpu);
+
+#endif /* _I8087_H */
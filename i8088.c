@@ -1,5 +1,6 @@
 #include "i8088.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
@@ -7,13 +8,59 @@
 #include "i8088_trace.h"
 #include "mem.h"
 #include "io.h"
+#include "i8087.h"
+#include "breakpoint.h"
+#include "callgraph.h"
+#include "opstat.h"
 #include "panic.h"
 
+/* This file is built three times, each with the public functions renamed
+   but the first. The second build adds tracing and counting, and the lean
+   build hands over to it while cpu->instrumented is set or execution or
+   opcodes are counted. The third is the plain reference interpreter for
+   the lockstep checker, built without lazy flags and with the fast paths
+   for memory operands, ModRM decoding and REP strings left out. */
+#ifdef I8088_INSTRUMENTED
+#define i8088_reset i8088_reset_instrumented
+#define i8088_irq i8088_irq_instrumented
+#define i8088_init i8088_init_instrumented
+#define i8088_execute i8088_execute_instrumented
+#define i8088_run i8088_run_instrumented
+#define i8088_execute_block i8088_execute_block_instrumented
+#define i8088_flags_sync i8088_flags_sync_instrumented
+#define i8088_segment_sync i8088_segment_sync_instrumented
+#define i8088_idle i8088_idle_instrumented
+#define i8088_idle_skip i8088_idle_skip_instrumented
+#elif defined(I8088_REFERENCE)
+#define i8088_reset i8088_reset_reference
+#define i8088_irq i8088_irq_reference
+#define i8088_init i8088_init_reference
+#define i8088_execute i8088_execute_reference
+#define i8088_run i8088_run_reference
+#define i8088_execute_block i8088_execute_block_reference
+#define i8088_flags_sync i8088_flags_sync_reference
+#define i8088_segment_sync i8088_segment_sync_reference
+#define i8088_idle i8088_idle_reference
+#define i8088_idle_skip i8088_idle_skip_reference
+#else
+#define I8088_LEAN
+bool i8088_irq_instrumented(i8088_t *cpu, mem_t *mem, int irq_no);
+void i8088_execute_instrumented(i8088_t *cpu, mem_t *mem);
+int i8088_run_instrumented(i8088_t *cpu, mem_t *mem, int budget);
+int i8088_execute_block_instrumented(i8088_t *cpu, mem_t *mem, int budget);
+
+static inline bool instrumented(i8088_t *cpu)
+{
+  return cpu->instrumented || cpu->callgraph != NULL || cpu->opstat != NULL;
+}
+#endif /* I8088_INSTRUMENTED */
+
 #define INT_DIVIDE_ERROR 0
 #define INT_SINGLE_STEP  1
 #define INT_NMI          2
 #define INT_1_BYTE       3
 #define INT_OVERFLOW     4
+#define INT_BOUND        5
 
 #define MODRM_OPCODE_ADD   0b000
 #define MODRM_OPCODE_OR    0b001
@@ -50,6 +97,41 @@
 #define MODRM_OPCODE_PUSH       0b110
 #define MODRM_OPCODE_PUSH_2     0b111
 
+#define FLAGS_NONE      0
+#define FLAGS_ADD_8     1
+#define FLAGS_ADD_16    2
+#define FLAGS_SUB_8     3
+#define FLAGS_SUB_16    4
+#define FLAGS_AND_8     5
+#define FLAGS_AND_16    6
+#define FLAGS_LOGIC_8   7 /* OR and XOR */
+#define FLAGS_LOGIC_16  8
+#define FLAGS_INC_8     9
+#define FLAGS_INC_16    10
+#define FLAGS_DEC_8     11
+#define FLAGS_DEC_16    12
+#define FLAGS_RESULT_8  13 /* Only P, S and Z. */
+#define FLAGS_RESULT_16 14
+
+#ifdef LAZY_FLAGS
+#define flags_sync(cpu) i8088_flags_sync(cpu)
+#else
+#define flags_sync(...)
+#endif /* LAZY_FLAGS */
+
+typedef void (*i8088_opcode_t)(i8088_t *cpu, mem_t *mem);
+
+#define BLOCK_NONE 0 /* Can be run inside a block. */
+#define BLOCK_END  1 /* Ends a block after being run. */
+#define BLOCK_IO   2 /* Must be run alone by the interpreter. */
+
+#define FUSE_NONE        0
+#define FUSE_DEC_JNZ     1 /* DEC reg16 ; JNZ */
+#define FUSE_CMP_JCC     2 /* CMP reg,imm ; Jcc */
+#define FUSE_INC_SI_DI   3 /* INC SI ; INC DI */
+#define FUSE_LODSB_STOSB 4 /* LODSB ; STOSB */
+#define FUSE_LOOP        5 /* LOOP to itself, repeated. */
+
 #ifndef CPU_TRACE
 #define i8088_trace_start(...)
 #define i8088_trace_mc(...)
@@ -67,6 +149,50 @@
 #define i8088_trace_int(...)
 #endif
 
+#ifdef I8088_INSTRUMENTED
+static inline void callgraph_hook_call(i8088_t *cpu)
+{
+  if (cpu->callgraph != NULL) {
+    callgraph_call(cpu->callgraph, cpu->ss, cpu->sp,
+      (cpu->cs_base + cpu->ip) & 0xFFFFF);
+  }
+}
+
+static inline void callgraph_hook_interrupt(i8088_t *cpu, uint8_t int_no)
+{
+  if (cpu->callgraph != NULL) {
+    callgraph_interrupt(cpu->callgraph, cpu->ss, cpu->sp,
+      (cpu->cs_base + cpu->ip) & 0xFFFFF, int_no);
+  }
+}
+
+static inline void callgraph_hook_service(i8088_t *cpu)
+{
+  if (cpu->callgraph != NULL) {
+    callgraph_service(cpu->callgraph, cpu->ah);
+  }
+}
+
+static inline void callgraph_hook_return(i8088_t *cpu)
+{
+  if (cpu->callgraph != NULL) {
+    callgraph_return(cpu->callgraph, cpu->ss, cpu->sp);
+  }
+}
+
+static inline void opstat_hook_prefix(i8088_t *cpu, uint8_t prefix)
+{
+  if (cpu->opstat != NULL) {
+    cpu->opstat->count[prefix]++; /* Replayed, so not timed. */
+  }
+}
+#else
+#define callgraph_hook_call(...)
+#define callgraph_hook_interrupt(...)
+#define callgraph_hook_service(...)
+#define callgraph_hook_return(...)
+#endif /* I8088_INSTRUMENTED */
+
 
 
 static inline bool parity_even(uint16_t value)
@@ -79,1148 +205,865 @@ static inline bool parity_even(uint16_t value)
 
 
 
-static inline uint8_t fetch(i8088_t *cpu, mem_t *mem)
+static void decode_record(i8088_t *cpu, uint32_t address, uint8_t mc)
 {
-  uint8_t mc;
-  mc = mem_read_by_segment(mem, cpu->cs, cpu->ip);
-  cpu->ip++;
-  i8088_trace_mc(mc);
-  return mc;
-}
-
-
+  i8088_decode_t *entry;
 
-static uint8_t eaddr_read_8(i8088_t *cpu, mem_t *mem,
-  uint16_t segment_default, uint16_t address, uint16_t *eaddr)
-{
-  if (eaddr != NULL) {
-    *eaddr = address; /* Store for later use. */
-  }
-  switch (cpu->segment_override) {
-  case SEGMENT_CS:
-    return mem_read_by_segment(mem, cpu->cs, address);
-  case SEGMENT_DS:
-    return mem_read_by_segment(mem, cpu->ds, address);
-  case SEGMENT_ES:
-    return mem_read_by_segment(mem, cpu->es, address);
-  case SEGMENT_SS:
-    return mem_read_by_segment(mem, cpu->ss, address);
-  case SEGMENT_NONE:
-  default:
-    return mem_read_by_segment(mem, segment_default, address);
+  entry = cpu->decode_fill;
+  if ((entry->mc_n >= I8088_DECODE_MC_MAX) ||
+      (address / MEM_CODE_GRANULE) !=
+      (cpu->decode_address / MEM_CODE_GRANULE)) {
+    cpu->decode_fill = NULL; /* Not cacheable. */
+    return;
   }
+  entry->mc[entry->mc_n++] = mc;
 }
 
 
 
-static void eaddr_write_8(i8088_t *cpu, mem_t *mem,
-  uint16_t segment_default, uint16_t address, uint8_t value)
+static inline void segment_override_set(i8088_t *cpu, segment_t segment)
 {
-  switch (cpu->segment_override) {
+  cpu->segment_override = segment;
+  switch (segment) {
   case SEGMENT_CS:
-    mem_write_by_segment(mem, cpu->cs, address, value);
+    cpu->eaddr_ds_base = cpu->cs_base;
+    cpu->eaddr_ss_base = cpu->cs_base;
     break;
   case SEGMENT_DS:
-    mem_write_by_segment(mem, cpu->ds, address, value);
+    cpu->eaddr_ds_base = cpu->ds_base;
+    cpu->eaddr_ss_base = cpu->ds_base;
     break;
   case SEGMENT_ES:
-    mem_write_by_segment(mem, cpu->es, address, value);
+    cpu->eaddr_ds_base = cpu->es_base;
+    cpu->eaddr_ss_base = cpu->es_base;
     break;
   case SEGMENT_SS:
-    mem_write_by_segment(mem, cpu->ss, address, value);
+    cpu->eaddr_ds_base = cpu->ss_base;
+    cpu->eaddr_ss_base = cpu->ss_base;
     break;
   case SEGMENT_NONE:
   default:
-    mem_write_by_segment(mem, segment_default, address, value);
+    cpu->eaddr_ds_base = cpu->ds_base;
+    cpu->eaddr_ss_base = cpu->ss_base;
     break;
   }
 }
 
 
 
-static uint16_t eaddr_read_16(i8088_t *cpu, mem_t *mem,
-  uint16_t segment_default, uint16_t address, uint16_t *eaddr)
+void i8088_segment_sync(i8088_t *cpu)
 {
-  uint16_t value;
-  if (eaddr != NULL) {
-    *eaddr = address; /* Store for later use. */
-  }
-  switch (cpu->segment_override) {
-  case SEGMENT_CS:
-    value  = mem_read_by_segment(mem, cpu->cs, address);
-    value += mem_read_by_segment(mem, cpu->cs, address+1) * 0x100;
-    break;
-  case SEGMENT_DS:
-    value  = mem_read_by_segment(mem, cpu->ds, address);
-    value += mem_read_by_segment(mem, cpu->ds, address+1) * 0x100;
-    break;
-  case SEGMENT_ES:
-    value  = mem_read_by_segment(mem, cpu->es, address);
-    value += mem_read_by_segment(mem, cpu->es, address+1) * 0x100;
-    break;
-  case SEGMENT_SS:
-    value  = mem_read_by_segment(mem, cpu->ss, address);
-    value += mem_read_by_segment(mem, cpu->ss, address+1) * 0x100;
-    break;
-  case SEGMENT_NONE:
-  default:
-    value  = mem_read_by_segment(mem, segment_default, address);
-    value += mem_read_by_segment(mem, segment_default, address+1) * 0x100;
-    break;
-  }
-  return value;
+  cpu->es_base = cpu->es << 4;
+  cpu->cs_base = cpu->cs << 4;
+  cpu->ss_base = cpu->ss << 4;
+  cpu->ds_base = cpu->ds << 4;
+  segment_override_set(cpu, cpu->segment_override);
 }
 
 
 
-static void eaddr_write_16(i8088_t *cpu, mem_t *mem,
-  uint16_t segment_default, uint16_t address, uint16_t value)
+static inline uint8_t fetch(i8088_t *cpu, mem_t *mem)
 {
-  switch (cpu->segment_override) {
-  case SEGMENT_CS:
-    mem_write_by_segment(mem, cpu->cs, address,   value % 0x100);
-    mem_write_by_segment(mem, cpu->cs, address+1, value / 0x100);
-    break;
-  case SEGMENT_DS:
-    mem_write_by_segment(mem, cpu->ds, address,   value % 0x100);
-    mem_write_by_segment(mem, cpu->ds, address+1, value / 0x100);
-    break;
-  case SEGMENT_ES:
-    mem_write_by_segment(mem, cpu->es, address,   value % 0x100);
-    mem_write_by_segment(mem, cpu->es, address+1, value / 0x100);
-    break;
-  case SEGMENT_SS:
-    mem_write_by_segment(mem, cpu->ss, address,   value % 0x100);
-    mem_write_by_segment(mem, cpu->ss, address+1, value / 0x100);
-    break;
-  case SEGMENT_NONE:
-  default:
-    mem_write_by_segment(mem, segment_default, address,   value % 0x100);
-    mem_write_by_segment(mem, segment_default, address+1, value / 0x100);
-    break;
+  uint8_t mc;
+  uint32_t address;
+
+  /* Replayed instructions take their opcode and operands from the entry
+     instead, so this only runs for those decoded from scratch. */
+  address = (cpu->cs_base + cpu->ip) & 0xFFFFF;
+  if (mem->page[address / MEM_SECTION].type == MEM_MMIO) {
+    mc = mem_read(mem, address);
+  } else {
+    mc = mem->m[address];
+  }
+  if (cpu->decode_fill != NULL) {
+    decode_record(cpu, address, mc);
   }
+  cpu->ip++;
+  i8088_trace_mc(mc);
+  return mc;
 }
 
 
 
-static uint8_t modrm_get_rm_8(i8088_t *cpu, mem_t *mem, uint8_t modrm,
-  uint16_t *eaddr)
+static inline uint8_t peek(i8088_t *cpu, mem_t *mem)
 {
-  uint16_t disp;
-  i8088_trace_op_bit_size(8);
+  return mem->m[(cpu->cs_base + cpu->ip) & 0xFFFFF];
+}
 
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG8_AL:
-      i8088_trace_op_src(false, "al");
-      return cpu->al;
-    case REG8_CL:
-      i8088_trace_op_src(false, "cl");
-      return cpu->cl;
-    case REG8_DL:
-      i8088_trace_op_src(false, "dl");
-      return cpu->dl;
-    case REG8_BL:
-      i8088_trace_op_src(false, "bl");
-      return cpu->bl;
-    case REG8_AH:
-      i8088_trace_op_src(false, "ah");
-      return cpu->ah;
-    case REG8_CH:
-      i8088_trace_op_src(false, "ch");
-      return cpu->ch;
-    case REG8_DH:
-      i8088_trace_op_src(false, "dh");
-      return cpu->dh;
-    case REG8_BH:
-      i8088_trace_op_src(false, "bh");
-      return cpu->bh;
-    }
-    break;
 
-  case MOD_DISP_LO_SIGN:
-    disp = (int8_t)fetch(cpu, mem);
-    i8088_trace_op_disp(disp);
-    break;
 
-  case MOD_DISP_HI_LO:
-    disp  = fetch(cpu, mem);
-    disp += fetch(cpu, mem) * 0x100;
-    i8088_trace_op_disp(disp);
-    break;
+static void decode_record_operand(i8088_t *cpu, uint16_t value)
+{
+  i8088_decode_t *entry;
 
-  case MOD_DISP_ZERO:
-    disp = 0;
-    break;
+  entry = cpu->decode_fill;
+  if (entry->imm_n >= I8088_DECODE_IMM_MAX) {
+    cpu->decode_fill = NULL; /* Not cacheable. */
+    return;
   }
+  entry->imm[entry->imm_n++] = value;
+}
 
-  switch (modrm_rm(modrm)) {
-  case EADDR_BX_SI:
-    i8088_trace_op_src(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_8(cpu, mem, cpu->ds, cpu->bx + cpu->si + disp, eaddr);
 
-  case EADDR_BX_DI:
-    i8088_trace_op_src(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_8(cpu, mem, cpu->ds, cpu->bx + cpu->di + disp, eaddr);
 
-  case EADDR_BP_SI:
-    i8088_trace_op_src(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    return eaddr_read_8(cpu, mem, cpu->ss, cpu->bp + cpu->si + disp, eaddr);
+/* Operands are taken from the entry being replayed, if any, instead of
+   reading memory again. They are recorded with the bytes otherwise. */
+static inline uint8_t fetch_modrm(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
 
-  case EADDR_BP_DI:
-    i8088_trace_op_src(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    return eaddr_read_8(cpu, mem, cpu->ss, cpu->bp + cpu->di + disp, eaddr);
+  if (cpu->decode_hit != NULL) {
+    cpu->ip++;
+    return cpu->decode_hit->modrm;
+  }
+  modrm = fetch(cpu, mem);
+  if (cpu->decode_fill != NULL) {
+    cpu->decode_fill->modrm = modrm;
+  }
+  return modrm;
+}
 
-  case EADDR_SI:
-    i8088_trace_op_src(true, "si");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_8(cpu, mem, cpu->ds, cpu->si + disp, eaddr);
 
-  case EADDR_DI:
-    i8088_trace_op_src(true, "di");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_8(cpu, mem, cpu->ds, cpu->di + disp, eaddr);
 
-  case EADDR_BP:
-    if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      disp  = fetch(cpu, mem);
-      disp += fetch(cpu, mem) * 0x100;
-      i8088_trace_op_disp(disp);
-      i8088_trace_op_src(true, "");
-      i8088_trace_op_seg_default("ds");
-      return eaddr_read_8(cpu, mem, cpu->ds, disp, eaddr);
-    } else {
-      i8088_trace_op_src(true, "bp");
-      i8088_trace_op_seg_default("ss");
-      return eaddr_read_8(cpu, mem, cpu->ss, cpu->bp + disp, eaddr);
-    }
+static inline uint8_t fetch_8(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data;
 
-  case EADDR_BX:
-    i8088_trace_op_src(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_8(cpu, mem, cpu->ds, cpu->bx + disp, eaddr);
+  if (cpu->decode_hit != NULL) {
+    cpu->ip++;
+    return cpu->decode_hit->imm[cpu->decode_imm++];
   }
-
-  return 0;
+  data = fetch(cpu, mem);
+  if (cpu->decode_fill != NULL) {
+    decode_record_operand(cpu, data);
+  }
+  return data;
 }
 
 
 
-static void modrm_set_rm_8(i8088_t *cpu, mem_t *mem, uint8_t modrm,
-  uint8_t value)
+static inline uint16_t fetch_16(i8088_t *cpu, mem_t *mem)
 {
-  uint16_t disp;
-  i8088_trace_op_bit_size(8);
+  uint16_t data;
 
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG8_AL:
-      i8088_trace_op_dst(false, "al");
-      cpu->al = value;
-      return;
-    case REG8_CL:
-      i8088_trace_op_dst(false, "cl");
-      cpu->cl = value;
-      return;
-    case REG8_DL:
-      i8088_trace_op_dst(false, "dl");
-      cpu->dl = value;
-      return;
-    case REG8_BL:
-      i8088_trace_op_dst(false, "bl");
-      cpu->bl = value;
-      return;
-    case REG8_AH:
-      i8088_trace_op_dst(false, "ah");
-      cpu->ah = value;
-      return;
-    case REG8_CH:
-      i8088_trace_op_dst(false, "ch");
-      cpu->ch = value;
-      return;
-    case REG8_DH:
-      i8088_trace_op_dst(false, "dh");
-      cpu->dh = value;
-      return;
-    case REG8_BH:
-      i8088_trace_op_dst(false, "bh");
-      cpu->bh = value;
-      return;
-    }
-    break;
+  if (cpu->decode_hit != NULL) {
+    cpu->ip += 2;
+    return cpu->decode_hit->imm[cpu->decode_imm++];
+  }
+  data  = fetch(cpu, mem);
+  data += fetch(cpu, mem) * 0x100;
+  if (cpu->decode_fill != NULL) {
+    decode_record_operand(cpu, data);
+  }
+  return data;
+}
 
-  case MOD_DISP_LO_SIGN:
-    disp = (int8_t)fetch(cpu, mem);
-    i8088_trace_op_disp(disp);
-    break;
 
-  case MOD_DISP_HI_LO:
-    disp  = fetch(cpu, mem);
-    disp += fetch(cpu, mem) * 0x100;
-    i8088_trace_op_disp(disp);
-    break;
 
-  case MOD_DISP_ZERO:
-    disp = 0;
-    break;
-  }
+static inline i8088_decode_t *decode_entry(i8088_t *cpu, uint32_t address)
+{
+  return &cpu->decode_cache->entry[(address ^ (address >> 13)) &
+    (I8088_DECODE_CACHE_SIZE - 1)];
+}
 
-  switch (modrm_rm(modrm)) {
-  case EADDR_BX_SI:
-    i8088_trace_op_dst(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, cpu->bx + cpu->si + disp, value);
-    break;
 
-  case EADDR_BX_DI:
-    i8088_trace_op_dst(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, cpu->bx + cpu->di + disp, value);
-    break;
 
-  case EADDR_BP_SI:
-    i8088_trace_op_dst(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_8(cpu, mem, cpu->ss, cpu->bp + cpu->si + disp, value);
-    break;
+static inline bool decode_valid(mem_t *mem, i8088_decode_t *entry,
+  uint32_t address)
+{
+  return (entry->address == address) &&
+    (entry->generation == mem->code_generation[address / MEM_CODE_GRANULE]);
+}
 
-  case EADDR_BP_DI:
-    i8088_trace_op_dst(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_8(cpu, mem, cpu->ss, cpu->bp + cpu->di + disp, value);
-    break;
 
-  case EADDR_SI:
-    i8088_trace_op_dst(true, "si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, cpu->si + disp, value);
-    break;
 
-  case EADDR_DI:
-    i8088_trace_op_dst(true, "di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, cpu->di + disp, value);
-    break;
+static uint8_t decode_block_class(uint8_t opcode)
+{
+  switch (opcode) {
+  case 0x70: case 0x71: case 0x72: case 0x73: /* Jcc */
+  case 0x74: case 0x75: case 0x76: case 0x77:
+  case 0x78: case 0x79: case 0x7A: case 0x7B:
+  case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+  case 0x62: /* BOUND */
+  case 0x9A: /* CALL FAR */
+  case 0x9D: /* POPF */
+  case 0xC2: case 0xC3: case 0xCA: case 0xCB: /* RET */
+  case 0xCC: case 0xCD: case 0xCE: case 0xCF: /* INT/IRET */
+  case 0xE0: case 0xE1: case 0xE2: case 0xE3: /* LOOP/JCXZ */
+  case 0xE8: case 0xE9: case 0xEA: case 0xEB: /* CALL/JMP */
+  case 0xF4: /* HLT */
+  case 0xFA: case 0xFB: /* CLI/STI */
+  case 0xFF: /* Indirect CALL/JMP */
+    return BLOCK_END;
 
-  case EADDR_BP:
-    if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      disp  = fetch(cpu, mem);
-      disp += fetch(cpu, mem) * 0x100;
-      i8088_trace_op_disp(disp);
-      i8088_trace_op_dst(true, "");
-      i8088_trace_op_seg_default("ds");
-      eaddr_write_8(cpu, mem, cpu->ds, disp, value);
-    } else {
-      i8088_trace_op_dst(true, "bp");
-      i8088_trace_op_seg_default("ss");
-      eaddr_write_8(cpu, mem, cpu->ss, cpu->bp + disp, value);
-    }
-    break;
+  case 0x6C: case 0x6D: case 0x6E: case 0x6F: /* INS/OUTS */
+  case 0xE4: case 0xE5: case 0xE6: case 0xE7: /* IN/OUT */
+  case 0xEC: case 0xED: case 0xEE: case 0xEF:
+    return BLOCK_IO;
 
-  case EADDR_BX:
-    i8088_trace_op_dst(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, cpu->bx + disp, value);
-    break;
+  default:
+    return BLOCK_NONE;
   }
 }
 
 
 
-static void modrm_set_rm_eaddr_8(i8088_t *cpu, mem_t *mem, uint8_t modrm,
-  uint16_t eaddr, uint8_t value)
+static uint8_t decode_fuse(mem_t *mem, i8088_decode_t *entry,
+  uint32_t address, uint16_t ip)
 {
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG8_AL:
-      i8088_trace_op_dst(false, "al");
-      cpu->al = value;
-      return;
-    case REG8_CL:
-      i8088_trace_op_dst(false, "cl");
-      cpu->cl = value;
-      return;
-    case REG8_DL:
-      i8088_trace_op_dst(false, "dl");
-      cpu->dl = value;
-      return;
-    case REG8_BL:
-      i8088_trace_op_dst(false, "bl");
-      cpu->bl = value;
-      return;
-    case REG8_AH:
-      i8088_trace_op_dst(false, "ah");
-      cpu->ah = value;
-      return;
-    case REG8_CH:
-      i8088_trace_op_dst(false, "ch");
-      cpu->ch = value;
-      return;
-    case REG8_DH:
-      i8088_trace_op_dst(false, "dh");
-      cpu->dh = value;
-      return;
-    case REG8_BH:
-      i8088_trace_op_dst(false, "bh");
-      cpu->bh = value;
-      return;
-    }
-    break;
-
-  case MOD_DISP_LO_SIGN:
-  case MOD_DISP_HI_LO:
-  case MOD_DISP_ZERO:
-    break;
+  uint32_t next;
+  uint8_t next_n;
+  uint8_t fuse;
+  int i;
+
+  /* Fusion class of the idiom started by an instruction just recorded.
+     The second instruction must follow in the same code granule, so the
+     generation check of this entry covers it too. Its bytes are kept
+     after those of the first, for the block engine to run both without
+     looking it up. */
+  if (entry->prefix_n != 0) {
+    return FUSE_NONE;
   }
 
-  switch (modrm_rm(modrm)) {
-  case EADDR_BX_SI:
-    i8088_trace_op_dst(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, eaddr, value);
+  switch (entry->mc[0]) {
+  case 0x48: case 0x49: case 0x4A: case 0x4B: /* DEC reg16 */
+  case 0x4C: case 0x4D: case 0x4E: case 0x4F:
+    fuse = FUSE_DEC_JNZ;
+    next_n = 2;
     break;
 
-  case EADDR_BX_DI:
-    i8088_trace_op_dst(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, eaddr, value);
+  case 0x80: case 0x81: case 0x82: case 0x83: /* CMP reg,imm */
+    if (modrm_mod(entry->mc[1]) != MOD_REGISTER ||
+        modrm_opcode(entry->mc[1]) != MODRM_OPCODE_CMP) {
+      return FUSE_NONE;
+    }
+    fuse = FUSE_CMP_JCC;
+    next_n = 2;
     break;
 
-  case EADDR_BP_SI:
-    i8088_trace_op_dst(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_8(cpu, mem, cpu->ss, eaddr, value);
+  case 0x46: /* INC SI */
+    fuse = FUSE_INC_SI_DI;
+    next_n = 1;
     break;
 
-  case EADDR_BP_DI:
-    i8088_trace_op_dst(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_8(cpu, mem, cpu->ss, eaddr, value);
+  case 0xAC: /* LODSB */
+    fuse = FUSE_LODSB_STOSB;
+    next_n = 1;
     break;
 
-  case EADDR_SI:
-    i8088_trace_op_dst(true, "si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, eaddr, value);
-    break;
+  case 0xE2: /* LOOP */
+    return ((int8_t)entry->mc[1] == -2) ? FUSE_LOOP : FUSE_NONE;
 
-  case EADDR_DI:
-    i8088_trace_op_dst(true, "di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, eaddr, value);
-    break;
+  default:
+    return FUSE_NONE;
+  }
 
-  case EADDR_BP:
-    if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      i8088_trace_op_dst(true, "");
-      i8088_trace_op_seg_default("ds");
-      eaddr_write_8(cpu, mem, cpu->ds, eaddr, value);
-    } else {
-      i8088_trace_op_dst(true, "bp");
-      i8088_trace_op_seg_default("ss");
-      eaddr_write_8(cpu, mem, cpu->ss, eaddr, value);
+  next = address + entry->mc_n;
+  if ((uint32_t)ip + entry->mc_n + next_n > 0x10000 ||
+      (next + next_n - 1) / MEM_CODE_GRANULE != address / MEM_CODE_GRANULE) {
+    return FUSE_NONE;
+  }
+
+  switch (fuse) {
+  case FUSE_DEC_JNZ:
+    if (mem->m[next] != 0x75) {
+      return FUSE_NONE;
     }
     break;
-
-  case EADDR_BX:
-    i8088_trace_op_dst(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_8(cpu, mem, cpu->ds, eaddr, value);
+  case FUSE_CMP_JCC:
+    if ((mem->m[next] & 0xF0) != 0x70) {
+      return FUSE_NONE;
+    }
+    break;
+  case FUSE_INC_SI_DI:
+    if (mem->m[next] != 0x47) {
+      return FUSE_NONE;
+    }
+    break;
+  case FUSE_LODSB_STOSB:
+    if (mem->m[next] != 0xAA) {
+      return FUSE_NONE;
+    }
     break;
   }
+
+  for (i = 0; i < next_n; i++) {
+    entry->mc[entry->mc_n + i] = mem->m[next + i];
+  }
+  return fuse;
 }
 
 
 
-static uint8_t modrm_get_reg_8(i8088_t *cpu, uint8_t modrm)
+static i8088_decode_t *decode_lookup(i8088_t *cpu, mem_t *mem)
 {
-  switch (modrm_reg(modrm)) {
-  case REG8_AL:
-    i8088_trace_op_src(false, "al");
-    return cpu->al;
-  case REG8_CL:
-    i8088_trace_op_src(false, "cl");
-    return cpu->cl;
-  case REG8_DL:
-    i8088_trace_op_src(false, "dl");
-    return cpu->dl;
-  case REG8_BL:
-    i8088_trace_op_src(false, "bl");
-    return cpu->bl;
-  case REG8_AH:
-    i8088_trace_op_src(false, "ah");
-    return cpu->ah;
-  case REG8_CH:
-    i8088_trace_op_src(false, "ch");
-    return cpu->ch;
-  case REG8_DH:
-    i8088_trace_op_src(false, "dh");
-    return cpu->dh;
-  case REG8_BH:
-    i8088_trace_op_src(false, "bh");
-    return cpu->bh;
+  i8088_decode_t *entry;
+  uint32_t address;
+
+  address = (cpu->cs_base + cpu->ip) & 0xFFFFF;
+  entry = decode_entry(cpu, address);
+
+  if (decode_valid(mem, entry, address)) {
+    return entry;
   }
-  return 0;
+
+  /* Sections with breakpoints are never cached, so only instructions
+     decoded from scratch have to be checked against them. */
+  if (cpu->breakpoint != NULL &&
+      cpu->breakpoint->section[address / MEM_SECTION] != 0) {
+    return NULL;
+  }
+
+  /* Code read through MMIO hooks may change without any write. */
+  if (mem->page[address / MEM_SECTION].type == MEM_MMIO) {
+    return NULL;
+  }
+
+  /* Record the instruction while it is decoded and executed. */
+  entry->address = I8088_DECODE_INVALID;
+  entry->generation = mem->code_generation[address / MEM_CODE_GRANULE];
+  entry->mc_n = 0;
+  entry->imm_n = 0;
+  mem->code[address / MEM_SECTION] = true;
+  cpu->decode_fill = entry;
+  cpu->decode_address = address;
+  return NULL;
 }
 
 
 
-static void modrm_set_reg_8(i8088_t *cpu, uint8_t modrm, uint8_t value)
+static inline void decode_replay_prefix(i8088_t *cpu, mem_t *mem,
+  i8088_decode_t *entry)
 {
-  switch (modrm_reg(modrm)) {
-  case REG8_AL:
-    i8088_trace_op_dst(false, "al");
-    cpu->al = value;
+#ifdef I8088_INSTRUMENTED
+  int i;
+
+  for (i = 0; i < entry->prefix_n; i++) {
+    opstat_hook_prefix(cpu, fetch(cpu, mem)); /* Only advance and trace. */
+  }
+#else
+  (void)mem;
+  cpu->ip += entry->prefix_n;
+#endif /* I8088_INSTRUMENTED */
+
+  segment_override_set(cpu, entry->segment_override);
+  switch (cpu->segment_override) {
+  case SEGMENT_ES:
+    i8088_trace_op_seg_override("es");
     break;
-  case REG8_CL:
-    i8088_trace_op_dst(false, "cl");
-    cpu->cl = value;
+  case SEGMENT_CS:
+    i8088_trace_op_seg_override("cs");
     break;
-  case REG8_DL:
-    i8088_trace_op_dst(false, "dl");
-    cpu->dl = value;
+  case SEGMENT_SS:
+    i8088_trace_op_seg_override("ss");
     break;
-  case REG8_BL:
-    i8088_trace_op_dst(false, "bl");
-    cpu->bl = value;
+  case SEGMENT_DS:
+    i8088_trace_op_seg_override("ds");
     break;
-  case REG8_AH:
-    i8088_trace_op_dst(false, "ah");
-    cpu->ah = value;
+  default:
     break;
-  case REG8_CH:
-    i8088_trace_op_dst(false, "ch");
-    cpu->ch = value;
+  }
+
+  cpu->repeat = entry->repeat;
+  switch (cpu->repeat) {
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("repne");
     break;
-  case REG8_DH:
-    i8088_trace_op_dst(false, "dh");
-    cpu->dh = value;
+  case REPEAT_EZ:
+    i8088_trace_op_prefix("repe");
     break;
-  case REG8_BH:
-    i8088_trace_op_dst(false, "bh");
-    cpu->bh = value;
+  default:
     break;
   }
 }
 
 
 
-static uint16_t modrm_get_rm_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
-  uint16_t *eaddr)
+#ifdef I8088_REFERENCE
+/* Word operands as two byte accesses, as the 8-bit bus makes them. */
+static uint16_t reference_read_16(mem_t *mem, uint32_t address)
 {
-  uint16_t disp;
-  i8088_trace_op_bit_size(16);
+  return mem_read(mem, address) +
+    (mem_read(mem, (address + 1) & 0xFFFFF) * 0x100);
+}
 
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG16_AX:
-      i8088_trace_op_src(false, "ax");
-      return cpu->ax;
-    case REG16_CX:
-      i8088_trace_op_src(false, "cx");
-      return cpu->cx;
-    case REG16_DX:
-      i8088_trace_op_src(false, "dx");
-      return cpu->dx;
-    case REG16_BX:
-      i8088_trace_op_src(false, "bx");
-      return cpu->bx;
-    case REG16_SP:
-      i8088_trace_op_src(false, "sp");
-      return cpu->sp;
-    case REG16_BP:
-      i8088_trace_op_src(false, "bp");
-      return cpu->bp;
-    case REG16_SI:
-      i8088_trace_op_src(false, "si");
-      return cpu->si;
-    case REG16_DI:
-      i8088_trace_op_src(false, "di");
-      return cpu->di;
-    }
-    break;
 
-  case MOD_DISP_LO_SIGN:
-    disp = (int8_t)fetch(cpu, mem);
-    i8088_trace_op_disp(disp);
-    break;
 
-  case MOD_DISP_HI_LO:
-    disp  = fetch(cpu, mem);
-    disp += fetch(cpu, mem) * 0x100;
-    i8088_trace_op_disp(disp);
-    break;
+static uint16_t reference_read_16_by_segment(mem_t *mem, uint16_t segment,
+  uint16_t offset)
+{
+  return mem_read_by_segment(mem, segment, offset) +
+    (mem_read_by_segment(mem, segment, offset + 1) * 0x100);
+}
 
-  case MOD_DISP_ZERO:
-    disp = 0;
-    break;
-  }
 
-  switch (modrm_rm(modrm)) {
-  case EADDR_BX_SI:
-    i8088_trace_op_src(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, cpu->bx + cpu->si + disp, eaddr);
 
-  case EADDR_BX_DI:
-    i8088_trace_op_src(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, cpu->bx + cpu->di + disp, eaddr);
+static void reference_write_16(mem_t *mem, uint32_t address, uint16_t value)
+{
+  mem_write(mem, address, value % 0x100);
+  mem_write(mem, (address + 1) & 0xFFFFF, value / 0x100);
+}
 
-  case EADDR_BP_SI:
-    i8088_trace_op_src(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    return eaddr_read_16(cpu, mem, cpu->ss, cpu->bp + cpu->si + disp, eaddr);
 
-  case EADDR_BP_DI:
-    i8088_trace_op_src(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    return eaddr_read_16(cpu, mem, cpu->ss, cpu->bp + cpu->di + disp, eaddr);
 
-  case EADDR_SI:
-    i8088_trace_op_src(true, "si");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, cpu->si + disp, eaddr);
+static void reference_write_16_by_segment(mem_t *mem, uint16_t segment,
+  uint16_t offset, uint16_t value)
+{
+  mem_write_by_segment(mem, segment, offset, value % 0x100);
+  mem_write_by_segment(mem, segment, offset + 1, value / 0x100);
+}
 
-  case EADDR_DI:
-    i8088_trace_op_src(true, "di");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, cpu->di + disp, eaddr);
+#define mem_read_16 reference_read_16
+#define mem_read_16_by_segment reference_read_16_by_segment
+#define mem_write_16 reference_write_16
+#define mem_write_16_by_segment reference_write_16_by_segment
+#endif /* I8088_REFERENCE */
 
-  case EADDR_BP:
-    if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      disp  = fetch(cpu, mem);
-      disp += fetch(cpu, mem) * 0x100;
-      i8088_trace_op_disp(disp);
-      i8088_trace_op_src(true, "");
-      i8088_trace_op_seg_default("ds");
-      return eaddr_read_16(cpu, mem, cpu->ds, disp, eaddr);
-    } else {
-      i8088_trace_op_src(true, "bp");
-      i8088_trace_op_seg_default("ss");
-      return eaddr_read_16(cpu, mem, cpu->ss, cpu->bp + disp, eaddr);
-    }
 
-  case EADDR_BX:
-    i8088_trace_op_src(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, cpu->bx + disp, eaddr);
+
+static inline uint8_t eaddr_read_8(mem_t *mem, uint32_t base,
+  uint16_t address, uint16_t *eaddr)
+{
+  uint32_t linear;
+
+  if (eaddr != NULL) {
+    *eaddr = address; /* Store for later use. */
+  }
+  linear = (base + address) & 0xFFFFF;
+  if (mem->page[linear / MEM_SECTION].type == MEM_MMIO) {
+    return mem_read(mem, linear);
   }
+  return mem->m[linear];
+}
 
-  return 0;
+
+
+static inline void eaddr_write_8(mem_t *mem, uint32_t base,
+  uint16_t address, uint8_t value)
+{
+  mem_write(mem, (base + address) & 0xFFFFF, value);
 }
 
 
 
-static uint16_t modrm_get_rm_eaddr_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
-  uint16_t eaddr)
+static inline uint16_t eaddr_read_16(mem_t *mem, uint32_t base,
+  uint16_t address, uint16_t *eaddr)
 {
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG16_AX:
-      i8088_trace_op_src(false, "ax");
-      return cpu->ax;
-    case REG16_CX:
-      i8088_trace_op_src(false, "cx");
-      return cpu->cx;
-    case REG16_DX:
-      i8088_trace_op_src(false, "dx");
-      return cpu->dx;
-    case REG16_BX:
-      i8088_trace_op_src(false, "bx");
-      return cpu->bx;
-    case REG16_SP:
-      i8088_trace_op_src(false, "sp");
-      return cpu->sp;
-    case REG16_BP:
-      i8088_trace_op_src(false, "bp");
-      return cpu->bp;
-    case REG16_SI:
-      i8088_trace_op_src(false, "si");
-      return cpu->si;
-    case REG16_DI:
-      i8088_trace_op_src(false, "di");
-      return cpu->di;
-    }
-    break;
+  if (eaddr != NULL) {
+    *eaddr = address; /* Store for later use. */
+  }
+  if (address == 0xFFFF) {
+    /* Second byte wraps around to the start of the segment. */
+    return mem_read(mem, (base + address) & 0xFFFFF) +
+      (mem_read(mem, base) * 0x100);
+  }
+  return mem_read_16(mem, (base + address) & 0xFFFFF);
+}
 
-  case MOD_DISP_LO_SIGN:
-  case MOD_DISP_HI_LO:
-  case MOD_DISP_ZERO:
-    break;
+
+
+static inline void eaddr_write_16(mem_t *mem, uint32_t base,
+  uint16_t address, uint16_t value)
+{
+  if (address == 0xFFFF) {
+    /* Second byte wraps around to the start of the segment. */
+    mem_write(mem, (base + address) & 0xFFFFF, value % 0x100);
+    mem_write(mem, base, value / 0x100);
+    return;
   }
+  mem_write_16(mem, (base + address) & 0xFFFFF, value);
+}
 
-  switch (modrm_rm(modrm)) {
-  case EADDR_BX_SI:
-    i8088_trace_op_src(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, eaddr, NULL);
 
-  case EADDR_BX_DI:
-    i8088_trace_op_src(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, eaddr, NULL);
 
-  case EADDR_BP_SI:
-    i8088_trace_op_src(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    return eaddr_read_16(cpu, mem, cpu->ss, eaddr, NULL);
+#define MODRM_NONE 0xFF
 
-  case EADDR_BP_DI:
-    i8088_trace_op_src(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    return eaddr_read_16(cpu, mem, cpu->ss, eaddr, NULL);
+/* What a ModRM byte selects, apart from the REG field. */
+typedef struct modrm_s {
+  bool memory;
+  uint8_t reg_8; /* Offset in i8088_t of the register operand, MOD 11. */
+  uint8_t reg_16;
+  uint8_t base; /* Offset in i8088_t, or MODRM_NONE. */
+  uint8_t index; /* Offset in i8088_t, or MODRM_NONE. */
+  uint8_t disp; /* Displacement size in bytes. */
+  uint8_t segment; /* Offset in i8088_t of the eaddr segment base. */
+  const char *name_8; /* For the trace. */
+  const char *name_16;
+  const char *segment_name;
+} modrm_t;
 
-  case EADDR_SI:
-    i8088_trace_op_src(true, "si");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, eaddr, NULL);
+#define MODRM_OFS(x) offsetof(i8088_t, x)
 
-  case EADDR_DI:
-    i8088_trace_op_src(true, "di");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, eaddr, NULL);
+#define MODRM_REG(r8, r16) \
+  { false, MODRM_OFS(r8), MODRM_OFS(r16), MODRM_NONE, MODRM_NONE, 0, 0, \
+    #r8, #r16, NULL }
 
-  case EADDR_BP:
-    if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      i8088_trace_op_src(true, "");
-      i8088_trace_op_seg_default("ds");
-      return eaddr_read_16(cpu, mem, cpu->ds, eaddr, NULL);
-    } else {
-      i8088_trace_op_src(true, "bp");
-      i8088_trace_op_seg_default("ss");
-      return eaddr_read_16(cpu, mem, cpu->ss, eaddr, NULL);
-    }
+#define MODRM_MEM(base, index, disp, segment, name) \
+  { true, 0, 0, base, index, disp, MODRM_OFS(eaddr_##segment##_base), \
+    name, name, #segment }
 
-  case EADDR_BX:
-    i8088_trace_op_src(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    return eaddr_read_16(cpu, mem, cpu->ds, eaddr, NULL);
-  }
+#define MODRM_ROW_MEM(disp) \
+  MODRM_MEM(MODRM_OFS(bx), MODRM_OFS(si), disp, ds, "bx+si"), \
+  MODRM_MEM(MODRM_OFS(bx), MODRM_OFS(di), disp, ds, "bx+di"), \
+  MODRM_MEM(MODRM_OFS(bp), MODRM_OFS(si), disp, ss, "bp+si"), \
+  MODRM_MEM(MODRM_OFS(bp), MODRM_OFS(di), disp, ss, "bp+di"), \
+  MODRM_MEM(MODRM_OFS(si), MODRM_NONE,    disp, ds, "si"),    \
+  MODRM_MEM(MODRM_OFS(di), MODRM_NONE,    disp, ds, "di")
 
-  return 0;
-}
+#define MODRM_ROW_00 \
+  MODRM_ROW_MEM(0), \
+  MODRM_MEM(MODRM_NONE,    MODRM_NONE, 2, ds, ""), /* Direct Addressing */ \
+  MODRM_MEM(MODRM_OFS(bx), MODRM_NONE, 0, ds, "bx")
 
+#define MODRM_ROW_DISP(disp) \
+  MODRM_ROW_MEM(disp), \
+  MODRM_MEM(MODRM_OFS(bp), MODRM_NONE, disp, ss, "bp"), \
+  MODRM_MEM(MODRM_OFS(bx), MODRM_NONE, disp, ds, "bx")
 
+#define MODRM_ROW_11 \
+  MODRM_REG(al, ax), MODRM_REG(cl, cx), MODRM_REG(dl, dx), \
+  MODRM_REG(bl, bx), MODRM_REG(ah, sp), MODRM_REG(ch, bp), \
+  MODRM_REG(dh, si), MODRM_REG(bh, di)
 
-static void modrm_set_rm_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
-  uint16_t value)
-{
-  uint16_t disp;
-  i8088_trace_op_bit_size(16);
+#define MODRM_ROWS(row) row, row, row, row, row, row, row, row
 
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG16_AX:
-      i8088_trace_op_dst(false, "ax");
-      cpu->ax = value;
-      return;
-    case REG16_CX:
-      i8088_trace_op_dst(false, "cx");
-      cpu->cx = value;
-      return;
-    case REG16_DX:
-      i8088_trace_op_dst(false, "dx");
-      cpu->dx = value;
-      return;
-    case REG16_BX:
-      i8088_trace_op_dst(false, "bx");
-      cpu->bx = value;
-      return;
-    case REG16_SP:
-      i8088_trace_op_dst(false, "sp");
-      cpu->sp = value;
-      return;
-    case REG16_BP:
-      i8088_trace_op_dst(false, "bp");
-      cpu->bp = value;
-      return;
-    case REG16_SI:
-      i8088_trace_op_dst(false, "si");
-      cpu->si = value;
-      return;
-    case REG16_DI:
-      i8088_trace_op_dst(false, "di");
-      cpu->di = value;
-      return;
-    }
-    break;
+#ifndef I8088_REFERENCE
+/* Indexed by the whole ModRM byte, the REG field makes no difference. */
+static const modrm_t modrm_table[256] = {
+  MODRM_ROWS(MODRM_ROW_00),
+  MODRM_ROWS(MODRM_ROW_DISP(1)),
+  MODRM_ROWS(MODRM_ROW_DISP(2)),
+  MODRM_ROWS(MODRM_ROW_11),
+};
 
-  case MOD_DISP_LO_SIGN:
-    disp = (int8_t)fetch(cpu, mem);
-    i8088_trace_op_disp(disp);
-    break;
 
-  case MOD_DISP_HI_LO:
-    disp  = fetch(cpu, mem);
-    disp += fetch(cpu, mem) * 0x100;
-    i8088_trace_op_disp(disp);
-    break;
 
-  case MOD_DISP_ZERO:
-    disp = 0;
-    break;
+static inline const modrm_t *modrm_lookup(uint8_t modrm, modrm_t *buffer)
+{
+  (void)buffer; /* Only filled by the reference build. */
+  return &modrm_table[modrm];
+}
+#else
+static const modrm_t *modrm_lookup(uint8_t modrm, modrm_t *buffer)
+{
+  static const uint8_t reg_8[8] = {
+    MODRM_OFS(al), MODRM_OFS(cl), MODRM_OFS(dl), MODRM_OFS(bl),
+    MODRM_OFS(ah), MODRM_OFS(ch), MODRM_OFS(dh), MODRM_OFS(bh),
+  };
+  static const uint8_t reg_16[8] = {
+    MODRM_OFS(ax), MODRM_OFS(cx), MODRM_OFS(dx), MODRM_OFS(bx),
+    MODRM_OFS(sp), MODRM_OFS(bp), MODRM_OFS(si), MODRM_OFS(di),
+  };
+  modrm_t *m = buffer;
+
+  /* Decoded from the MOD and R/M fields every time, without the table. */
+  memset(m, 0, sizeof(modrm_t));
+  if (modrm_mod(modrm) == MOD_REGISTER) {
+    m->reg_8 = reg_8[modrm_rm(modrm)];
+    m->reg_16 = reg_16[modrm_rm(modrm)];
+    return m;
   }
 
+  m->memory = true;
+  m->base = MODRM_NONE;
+  m->index = MODRM_NONE;
+  m->disp = (modrm_mod(modrm) == MOD_DISP_LO_SIGN) ? 1 :
+    (modrm_mod(modrm) == MOD_DISP_HI_LO) ? 2 : 0;
+  m->segment = MODRM_OFS(eaddr_ds_base);
   switch (modrm_rm(modrm)) {
   case EADDR_BX_SI:
-    i8088_trace_op_dst(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, cpu->bx + cpu->si + disp, value);
+    m->base = MODRM_OFS(bx);
+    m->index = MODRM_OFS(si);
     break;
-
   case EADDR_BX_DI:
-    i8088_trace_op_dst(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, cpu->bx + cpu->di + disp, value);
+    m->base = MODRM_OFS(bx);
+    m->index = MODRM_OFS(di);
     break;
-
   case EADDR_BP_SI:
-    i8088_trace_op_dst(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_16(cpu, mem, cpu->ss, cpu->bp + cpu->si + disp, value);
+    m->base = MODRM_OFS(bp);
+    m->index = MODRM_OFS(si);
+    m->segment = MODRM_OFS(eaddr_ss_base);
     break;
-
   case EADDR_BP_DI:
-    i8088_trace_op_dst(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_16(cpu, mem, cpu->ss, cpu->bp + cpu->di + disp, value);
+    m->base = MODRM_OFS(bp);
+    m->index = MODRM_OFS(di);
+    m->segment = MODRM_OFS(eaddr_ss_base);
     break;
-
   case EADDR_SI:
-    i8088_trace_op_dst(true, "si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, cpu->si + disp, value);
+    m->base = MODRM_OFS(si);
     break;
-
   case EADDR_DI:
-    i8088_trace_op_dst(true, "di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, cpu->di + disp, value);
+    m->base = MODRM_OFS(di);
     break;
-
   case EADDR_BP:
     if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      disp  = fetch(cpu, mem);
-      disp += fetch(cpu, mem) * 0x100;
-      i8088_trace_op_disp(disp);
-      i8088_trace_op_dst(true, "");
-      i8088_trace_op_seg_default("ds");
-      eaddr_write_16(cpu, mem, cpu->ds, disp, value);
+      m->disp = 2; /* Direct Addressing */
     } else {
-      i8088_trace_op_dst(true, "bp");
-      i8088_trace_op_seg_default("ss");
-      eaddr_write_16(cpu, mem, cpu->ss, cpu->bp + disp, value);
+      m->base = MODRM_OFS(bp);
+      m->segment = MODRM_OFS(eaddr_ss_base);
     }
     break;
-
   case EADDR_BX:
-    i8088_trace_op_dst(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, cpu->bx + disp, value);
+  default:
+    m->base = MODRM_OFS(bx);
     break;
   }
+  return m;
 }
+#endif /* I8088_REFERENCE */
 
 
 
-static void modrm_set_rm_eaddr_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
-  uint16_t eaddr, uint16_t value)
+static inline uint8_t *modrm_reg_8(i8088_t *cpu, uint8_t offset)
 {
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG16_AX:
-      i8088_trace_op_dst(false, "ax");
-      cpu->ax = value;
-      return;
-    case REG16_CX:
-      i8088_trace_op_dst(false, "cx");
-      cpu->cx = value;
-      return;
-    case REG16_DX:
-      i8088_trace_op_dst(false, "dx");
-      cpu->dx = value;
-      return;
-    case REG16_BX:
-      i8088_trace_op_dst(false, "bx");
-      cpu->bx = value;
-      return;
-    case REG16_SP:
-      i8088_trace_op_dst(false, "sp");
-      cpu->sp = value;
-      return;
-    case REG16_BP:
-      i8088_trace_op_dst(false, "bp");
-      cpu->bp = value;
-      return;
-    case REG16_SI:
-      i8088_trace_op_dst(false, "si");
-      cpu->si = value;
-      return;
-    case REG16_DI:
-      i8088_trace_op_dst(false, "di");
-      cpu->di = value;
-      return;
-    }
-    break;
+  return (uint8_t *)cpu + offset;
+}
 
-  case MOD_DISP_LO_SIGN:
-  case MOD_DISP_HI_LO:
-  case MOD_DISP_ZERO:
-    break;
-  }
 
-  switch (modrm_rm(modrm)) {
-  case EADDR_BX_SI:
-    i8088_trace_op_dst(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, eaddr, value);
-    break;
 
-  case EADDR_BX_DI:
-    i8088_trace_op_dst(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, eaddr, value);
-    break;
+static inline uint16_t *modrm_reg_16(i8088_t *cpu, uint8_t offset)
+{
+  return (uint16_t *)((uint8_t *)cpu + offset);
+}
 
-  case EADDR_BP_SI:
-    i8088_trace_op_dst(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_16(cpu, mem, cpu->ss, eaddr, value);
-    break;
 
-  case EADDR_BP_DI:
-    i8088_trace_op_dst(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    eaddr_write_16(cpu, mem, cpu->ss, eaddr, value);
-    break;
 
-  case EADDR_SI:
-    i8088_trace_op_dst(true, "si");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, eaddr, value);
-    break;
+static inline uint32_t modrm_base(i8088_t *cpu, const modrm_t *m)
+{
+  return *(uint32_t *)((uint8_t *)cpu + m->segment);
+}
 
-  case EADDR_DI:
-    i8088_trace_op_dst(true, "di");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, eaddr, value);
-    break;
 
-  case EADDR_BP:
-    if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      i8088_trace_op_dst(true, "");
-      i8088_trace_op_seg_default("ds");
-      eaddr_write_16(cpu, mem, cpu->ds, eaddr, value);
+
+static inline uint16_t modrm_eaddr(i8088_t *cpu, mem_t *mem,
+  const modrm_t *m)
+{
+  uint16_t address;
+
+  switch (m->disp) {
+  case 1:
+    if (cpu->decode_hit != NULL) {
+      cpu->ip++;
+      address = cpu->decode_hit->disp;
     } else {
-      i8088_trace_op_dst(true, "bp");
-      i8088_trace_op_seg_default("ss");
-      eaddr_write_16(cpu, mem, cpu->ss, eaddr, value);
+      address = (int8_t)fetch(cpu, mem);
     }
+    i8088_trace_op_disp(address);
     break;
-
-  case EADDR_BX:
-    i8088_trace_op_dst(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    eaddr_write_16(cpu, mem, cpu->ds, eaddr, value);
+  case 2:
+    if (cpu->decode_hit != NULL) {
+      cpu->ip += 2;
+      address = cpu->decode_hit->disp;
+    } else {
+      address  = fetch(cpu, mem);
+      address += fetch(cpu, mem) * 0x100;
+    }
+    i8088_trace_op_disp(address);
     break;
+  default:
+    address = 0;
+    break;
+  }
+  if (cpu->decode_fill != NULL) {
+    cpu->decode_fill->disp = address;
+  }
+
+  if (m->base != MODRM_NONE) {
+    address += *modrm_reg_16(cpu, m->base);
+  }
+  if (m->index != MODRM_NONE) {
+    address += *modrm_reg_16(cpu, m->index);
+  }
+  return address;
+}
+
+
+
+static uint8_t modrm_get_rm_8(i8088_t *cpu, mem_t *mem, uint8_t modrm,
+  uint16_t *eaddr)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(modrm, &buffer);
+  uint16_t address;
+  i8088_trace_op_bit_size(8);
+
+  if (! m->memory) {
+    i8088_trace_op_src(false, m->name_8);
+    return *modrm_reg_8(cpu, m->reg_8);
+  }
+
+  address = modrm_eaddr(cpu, mem, m);
+  i8088_trace_op_src(true, m->name_8);
+  i8088_trace_op_seg_default(m->segment_name);
+  return eaddr_read_8(mem, modrm_base(cpu, m), address,
+    eaddr);
+}
+
+
+
+static void modrm_set_rm_8(i8088_t *cpu, mem_t *mem, uint8_t modrm,
+  uint8_t value)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(modrm, &buffer);
+  uint16_t address;
+  i8088_trace_op_bit_size(8);
+
+  if (! m->memory) {
+    i8088_trace_op_dst(false, m->name_8);
+    *modrm_reg_8(cpu, m->reg_8) = value;
+    return;
+  }
+
+  address = modrm_eaddr(cpu, mem, m);
+  i8088_trace_op_dst(true, m->name_8);
+  i8088_trace_op_seg_default(m->segment_name);
+  eaddr_write_8(mem, modrm_base(cpu, m), address, value);
+}
+
+
+
+static void modrm_set_rm_eaddr_8(i8088_t *cpu, mem_t *mem, uint8_t modrm,
+  uint16_t eaddr, uint8_t value)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(modrm, &buffer);
+
+  if (! m->memory) {
+    i8088_trace_op_dst(false, m->name_8);
+    *modrm_reg_8(cpu, m->reg_8) = value;
+    return;
   }
+
+  i8088_trace_op_dst(true, m->name_8);
+  i8088_trace_op_seg_default(m->segment_name);
+  eaddr_write_8(mem, modrm_base(cpu, m), eaddr, value);
+}
+
+
+
+static uint8_t modrm_get_reg_8(i8088_t *cpu, uint8_t modrm)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(0xC0 | modrm_reg(modrm), &buffer);
+
+  i8088_trace_op_src(false, m->name_8);
+  return *modrm_reg_8(cpu, m->reg_8);
+}
+
+
+
+static void modrm_set_reg_8(i8088_t *cpu, uint8_t modrm, uint8_t value)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(0xC0 | modrm_reg(modrm), &buffer);
+
+  i8088_trace_op_dst(false, m->name_8);
+  *modrm_reg_8(cpu, m->reg_8) = value;
 }
 
 
 
-static void modrm_void_rm_16(i8088_t *cpu, mem_t *mem, uint8_t modrm)
+static uint16_t modrm_get_rm_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
+  uint16_t *eaddr)
 {
-  uint16_t disp;
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(modrm, &buffer);
+  uint16_t address;
   i8088_trace_op_bit_size(16);
 
-  switch (modrm_mod(modrm)) {
-  case MOD_REGISTER:
-    switch (modrm_rm(modrm)) {
-    case REG16_AX:
-      i8088_trace_op_dst(false, "ax");
-      return;
-    case REG16_CX:
-      i8088_trace_op_dst(false, "cx");
-      return;
-    case REG16_DX:
-      i8088_trace_op_dst(false, "dx");
-      return;
-    case REG16_BX:
-      i8088_trace_op_dst(false, "bx");
-      return;
-    case REG16_SP:
-      i8088_trace_op_dst(false, "sp");
-      return;
-    case REG16_BP:
-      i8088_trace_op_dst(false, "bp");
-      return;
-    case REG16_SI:
-      i8088_trace_op_dst(false, "si");
-      return;
-    case REG16_DI:
-      i8088_trace_op_dst(false, "di");
-      return;
-    }
-    break;
+  if (! m->memory) {
+    i8088_trace_op_src(false, m->name_16);
+    return *modrm_reg_16(cpu, m->reg_16);
+  }
 
-  case MOD_DISP_LO_SIGN:
-    disp = (int8_t)fetch(cpu, mem);
-    i8088_trace_op_disp(disp);
-    break;
+  address = modrm_eaddr(cpu, mem, m);
+  i8088_trace_op_src(true, m->name_16);
+  i8088_trace_op_seg_default(m->segment_name);
+  return eaddr_read_16(mem, modrm_base(cpu, m), address,
+    eaddr);
+}
 
-  case MOD_DISP_HI_LO:
-    disp  = fetch(cpu, mem);
-    disp += fetch(cpu, mem) * 0x100;
-    i8088_trace_op_disp(disp);
-    break;
 
-  case MOD_DISP_ZERO:
-    disp = 0;
-    break;
+
+static uint16_t modrm_get_rm_eaddr_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
+  uint16_t eaddr)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(modrm, &buffer);
+
+  if (! m->memory) {
+    i8088_trace_op_src(false, m->name_16);
+    return *modrm_reg_16(cpu, m->reg_16);
   }
 
-  switch (modrm_rm(modrm)) {
-  case EADDR_BX_SI:
-    i8088_trace_op_dst(true, "bx+si");
-    i8088_trace_op_seg_default("ds");
-    break;
+  i8088_trace_op_src(true, m->name_16);
+  i8088_trace_op_seg_default(m->segment_name);
+  return eaddr_read_16(mem, modrm_base(cpu, m), eaddr,
+    NULL);
+}
 
-  case EADDR_BX_DI:
-    i8088_trace_op_dst(true, "bx+di");
-    i8088_trace_op_seg_default("ds");
-    break;
 
-  case EADDR_BP_SI:
-    i8088_trace_op_dst(true, "bp+si");
-    i8088_trace_op_seg_default("ss");
-    break;
 
-  case EADDR_BP_DI:
-    i8088_trace_op_dst(true, "bp+di");
-    i8088_trace_op_seg_default("ss");
-    break;
+static void modrm_set_rm_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
+  uint16_t value)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(modrm, &buffer);
+  uint16_t address;
+  i8088_trace_op_bit_size(16);
 
-  case EADDR_SI:
-    i8088_trace_op_dst(true, "si");
-    i8088_trace_op_seg_default("ds");
-    break;
+  if (! m->memory) {
+    i8088_trace_op_dst(false, m->name_16);
+    *modrm_reg_16(cpu, m->reg_16) = value;
+    return;
+  }
 
-  case EADDR_DI:
-    i8088_trace_op_dst(true, "di");
-    i8088_trace_op_seg_default("ds");
-    break;
+  address = modrm_eaddr(cpu, mem, m);
+  i8088_trace_op_dst(true, m->name_16);
+  i8088_trace_op_seg_default(m->segment_name);
+  eaddr_write_16(mem, modrm_base(cpu, m), address, value);
+}
 
-  case EADDR_BP:
-    if (modrm_mod(modrm) == MOD_DISP_ZERO) {
-      /* Direct Addressing */
-      disp  = fetch(cpu, mem);
-      disp += fetch(cpu, mem) * 0x100;
-      i8088_trace_op_disp(disp);
-      i8088_trace_op_dst(true, "");
-      i8088_trace_op_seg_default("ds");
-    } else {
-      i8088_trace_op_dst(true, "bp");
-      i8088_trace_op_seg_default("ss");
-    }
-    break;
 
-  case EADDR_BX:
-    i8088_trace_op_dst(true, "bx");
-    i8088_trace_op_seg_default("ds");
-    break;
+
+static void modrm_set_rm_eaddr_16(i8088_t *cpu, mem_t *mem, uint8_t modrm,
+  uint16_t eaddr, uint16_t value)
+{
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(modrm, &buffer);
+
+  if (! m->memory) {
+    i8088_trace_op_dst(false, m->name_16);
+    *modrm_reg_16(cpu, m->reg_16) = value;
+    return;
   }
+
+  i8088_trace_op_dst(true, m->name_16);
+  i8088_trace_op_seg_default(m->segment_name);
+  eaddr_write_16(mem, modrm_base(cpu, m), eaddr, value);
 }
 
 
 
 static uint16_t modrm_get_reg_16(i8088_t *cpu, uint8_t modrm)
 {
-  switch (modrm_reg(modrm)) {
-  case REG16_AX:
-    i8088_trace_op_src(false, "ax");
-    return cpu->ax;
-  case REG16_CX:
-    i8088_trace_op_src(false, "cx");
-    return cpu->cx;
-  case REG16_DX:
-    i8088_trace_op_src(false, "dx");
-    return cpu->dx;
-  case REG16_BX:
-    i8088_trace_op_src(false, "bx");
-    return cpu->bx;
-  case REG16_SP:
-    i8088_trace_op_src(false, "sp");
-    return cpu->sp;
-  case REG16_BP:
-    i8088_trace_op_src(false, "bp");
-    return cpu->bp;
-  case REG16_SI:
-    i8088_trace_op_src(false, "si");
-    return cpu->si;
-  case REG16_DI:
-    i8088_trace_op_src(false, "di");
-    return cpu->di;
-  }
-  return 0;
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(0xC0 | modrm_reg(modrm), &buffer);
+
+  i8088_trace_op_src(false, m->name_16);
+  return *modrm_reg_16(cpu, m->reg_16);
 }
 
 
 
 static void modrm_set_reg_16(i8088_t *cpu, uint8_t modrm, uint16_t value)
 {
-  switch (modrm_reg(modrm)) {
-  case REG16_AX:
-    i8088_trace_op_dst(false, "ax");
-    cpu->ax = value;
-    break;
-  case REG16_CX:
-    i8088_trace_op_dst(false, "cx");
-    cpu->cx = value;
-    break;
-  case REG16_DX:
-    i8088_trace_op_dst(false, "dx");
-    cpu->dx = value;
-    break;
-  case REG16_BX:
-    i8088_trace_op_dst(false, "bx");
-    cpu->bx = value;
-    break;
-  case REG16_SP:
-    i8088_trace_op_dst(false, "sp");
-    cpu->sp = value;
-    break;
-  case REG16_BP:
-    i8088_trace_op_dst(false, "bp");
-    cpu->bp = value;
-    break;
-  case REG16_SI:
-    i8088_trace_op_dst(false, "si");
-    cpu->si = value;
-    break;
-  case REG16_DI:
-    i8088_trace_op_dst(false, "di");
-    cpu->di = value;
-    break;
-  }
+  modrm_t buffer;
+  const modrm_t *m = modrm_lookup(0xC0 | modrm_reg(modrm), &buffer);
+
+  i8088_trace_op_dst(false, m->name_16);
+  *modrm_reg_16(cpu, m->reg_16) = value;
 }
 
 
@@ -1252,46 +1095,294 @@ static void modrm_set_reg_seg(i8088_t *cpu, uint8_t modrm, uint16_t value)
   case REGSEG_ES:
     i8088_trace_op_dst(false, "es");
     cpu->es = value;
+    i8088_segment_sync(cpu);
     break;
   case REGSEG_CS:
     i8088_trace_op_dst(false, "cs");
     cpu->cs = value;
+    i8088_segment_sync(cpu);
+    cpu->far_transfer = true;
     break;
   case REGSEG_SS:
     i8088_trace_op_dst(false, "ss");
     cpu->ss = value;
+    i8088_segment_sync(cpu);
     break;
   case REGSEG_DS:
     i8088_trace_op_dst(false, "ds");
     cpu->ds = value;
+    i8088_segment_sync(cpu);
     break;
   }
 }
 
 
 
-static void i8088_interrupt(i8088_t *cpu, mem_t *mem, uint8_t int_no)
+static inline bool flags_eval_c(i8088_t *cpu, uint8_t op, uint16_t input1,
+  uint16_t input2, bool carry, bool kept)
 {
-  i8088_trace_int(int_no, cpu);
-  cpu->sp -= 6;
-  mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ip % 0x100);
-  mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ip / 0x100);
-  mem_write_by_segment(mem, cpu->ss, cpu->sp+2, cpu->cs % 0x100);
-  mem_write_by_segment(mem, cpu->ss, cpu->sp+3, cpu->cs / 0x100);
-  mem_write_by_segment(mem, cpu->ss, cpu->sp+4, cpu->flags % 0x100);
-  mem_write_by_segment(mem, cpu->ss, cpu->sp+5, cpu->flags / 0x100);
-  cpu->ip  = mem_read(mem, (int_no * 4));
-  cpu->ip += mem_read(mem, (int_no * 4) + 1) * 0x100;
-  cpu->cs  = mem_read(mem, (int_no * 4) + 2);
-  cpu->cs += mem_read(mem, (int_no * 4) + 3) * 0x100;
-  cpu->t = 0;
+  switch (op) {
+  case FLAGS_ADD_8:
+    return ((uint16_t)(input1 + input2 + carry) & 0x100) > 0;
+  case FLAGS_ADD_16:
+    return ((uint32_t)(input1 + input2 + carry) & 0x10000) > 0;
+  case FLAGS_SUB_8:
+    return ((uint16_t)(input1 - input2 - carry) & 0x100) > 0;
+  case FLAGS_SUB_16:
+    return ((uint32_t)(input1 - input2 - carry) & 0x10000) > 0;
+  case FLAGS_AND_8:
+  case FLAGS_AND_16:
+  case FLAGS_LOGIC_8:
+  case FLAGS_LOGIC_16:
+    return 0;
+  case FLAGS_INC_8:
+  case FLAGS_INC_16:
+  case FLAGS_DEC_8:
+  case FLAGS_DEC_16:
+    return kept;
+  default:
+    return cpu->c;
+  }
 }
 
 
 
-static void i8088_aaa(i8088_t *cpu)
+static inline bool flags_eval_a(i8088_t *cpu, uint8_t op, uint16_t input1,
+  uint16_t input2, uint16_t result, bool carry, bool kept)
 {
-  uint8_t initial = cpu->al;
+  switch (op) {
+  case FLAGS_ADD_8:
+  case FLAGS_ADD_16:
+    return (((input1 & 0xF) + (input2 & 0xF) + carry) & 0x10) > 0;
+  case FLAGS_SUB_8:
+  case FLAGS_SUB_16:
+    return (((input1 & 0xF) - (input2 & 0xF) - carry) & 0x10) > 0;
+  case FLAGS_AND_8:
+  case FLAGS_AND_16:
+  case FLAGS_LOGIC_8:
+  case FLAGS_LOGIC_16:
+    return kept;
+  case FLAGS_INC_8:
+  case FLAGS_INC_16:
+    return !(result & 0xF);
+  case FLAGS_DEC_8:
+  case FLAGS_DEC_16:
+    return !(input1 & 0xF);
+  default:
+    return cpu->a;
+  }
+}
+
+
+
+static void flags_eval(i8088_t *cpu, uint8_t op, uint16_t input1,
+  uint16_t input2, uint16_t result, bool carry, bool kept)
+{
+  cpu->c = flags_eval_c(cpu, op, input1, input2, carry, kept);
+  cpu->a = flags_eval_a(cpu, op, input1, input2, result, carry, kept);
+
+  switch (op) {
+  case FLAGS_ADD_8:
+  case FLAGS_AND_8:
+    cpu->o = (((input1 & 0x80) && (input2 & 0x80) && !(result & 0x80)) ||
+             (!(input1 & 0x80) && !(input2 & 0x80) && (result & 0x80)));
+    cpu->p = parity_even(result);
+    cpu->s = result >> 7;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_ADD_16:
+  case FLAGS_AND_16:
+    cpu->o = (((input1 & 0x8000) && (input2 & 0x8000) && !(result & 0x8000)) ||
+             (!(input1 & 0x8000) && !(input2 & 0x8000) && (result & 0x8000)));
+    cpu->p = parity_even(result);
+    cpu->s = result >> 15;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_SUB_8:
+    cpu->o = (((input1 & 0x80) && !(input2 & 0x80) && !(result & 0x80)) ||
+             (!(input1 & 0x80) && (input2 & 0x80) && (result & 0x80)));
+    cpu->p = parity_even(result);
+    cpu->s = result >> 7;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_SUB_16:
+    cpu->o = (((input1 & 0x8000) && !(input2 & 0x8000) && !(result & 0x8000)) ||
+             (!(input1 & 0x8000) && (input2 & 0x8000) && (result & 0x8000)));
+    cpu->p = parity_even(result);
+    cpu->s = result >> 15;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_LOGIC_8:
+    cpu->o = 0;
+    cpu->p = parity_even(result);
+    cpu->s = result >> 7;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_LOGIC_16:
+    cpu->o = 0;
+    cpu->p = parity_even(result);
+    cpu->s = result >> 15;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_INC_8:
+    cpu->o = input1 == 0x7F;
+    cpu->p = parity_even(result);
+    cpu->s = result >> 7;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_INC_16:
+    cpu->o = input1 == 0x7FFF;
+    cpu->p = parity_even(result);
+    cpu->s = result >> 15;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_DEC_8:
+    cpu->o = ((input1 & 0x80) && !(result & 0x80));
+    cpu->p = parity_even(result);
+    cpu->s = result >> 7;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_DEC_16:
+    cpu->o = 0;
+    cpu->p = parity_even(result);
+    cpu->s = result >> 15;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_RESULT_8:
+    cpu->p = parity_even(result);
+    cpu->s = result >> 7;
+    cpu->z = result == 0;
+    break;
+
+  case FLAGS_RESULT_16:
+    cpu->p = parity_even(result);
+    cpu->s = result >> 15;
+    cpu->z = result == 0;
+    break;
+
+  default:
+    break;
+  }
+}
+
+
+
+void i8088_flags_sync(i8088_t *cpu)
+{
+  if (cpu->flags_op != FLAGS_NONE) {
+    flags_eval(cpu, cpu->flags_op, cpu->flags_input1, cpu->flags_input2,
+      cpu->flags_result, cpu->flags_carry, cpu->flags_kept);
+    cpu->flags_op = FLAGS_NONE;
+  }
+}
+
+
+
+/* Single flags as the pending operation leaves them, for readers that
+   need no others. */
+static inline bool flags_get_c(i8088_t *cpu)
+{
+  return flags_eval_c(cpu, cpu->flags_op, cpu->flags_input1,
+    cpu->flags_input2, cpu->flags_carry, cpu->flags_kept);
+}
+
+
+
+static inline bool flags_get_a(i8088_t *cpu)
+{
+  return flags_eval_a(cpu, cpu->flags_op, cpu->flags_input1,
+    cpu->flags_input2, cpu->flags_result, cpu->flags_carry, cpu->flags_kept);
+}
+
+
+
+static inline bool flags_get_z(i8088_t *cpu)
+{
+  if (cpu->flags_op == FLAGS_NONE) {
+    return cpu->z;
+  }
+  return cpu->flags_result == 0;
+}
+
+
+
+static inline void flags_set(i8088_t *cpu, uint8_t op, uint16_t input1,
+  uint16_t input2, uint16_t result, bool carry)
+{
+  bool kept;
+
+  /* CF of INC and DEC, and AF of the logic operations, are left alone.
+     They are kept from the operation replaced, without evaluating it. */
+  switch (op) {
+  case FLAGS_INC_8:
+  case FLAGS_INC_16:
+  case FLAGS_DEC_8:
+  case FLAGS_DEC_16:
+    kept = flags_get_c(cpu);
+    break;
+  case FLAGS_AND_8:
+  case FLAGS_AND_16:
+  case FLAGS_LOGIC_8:
+  case FLAGS_LOGIC_16:
+    kept = flags_get_a(cpu);
+    break;
+  default:
+    kept = 0;
+    break;
+  }
+
+#ifdef LAZY_FLAGS
+  /* Replaces any pending operation, so it must define every flag the
+     pending one does, or the caller must synchronize first. */
+  cpu->flags_op = op;
+  cpu->flags_input1 = input1;
+  cpu->flags_input2 = input2;
+  cpu->flags_result = result;
+  cpu->flags_carry = carry;
+  cpu->flags_kept = kept;
+#else
+  flags_eval(cpu, op, input1, input2, result, carry, kept);
+#endif /* LAZY_FLAGS */
+}
+
+
+
+static void i8088_dispatch(i8088_t *cpu, mem_t *mem, uint8_t opcode);
+
+
+
+static void i8088_interrupt(i8088_t *cpu, mem_t *mem, uint8_t int_no)
+{
+  flags_sync(cpu);
+  i8088_trace_int(int_no, cpu);
+  cpu->sp -= 6;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ip);
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp+2, cpu->cs);
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp+4, cpu->flags);
+  cpu->ip = mem_read_16(mem, (int_no * 4));
+  cpu->cs = mem_read_16(mem, (int_no * 4) + 2);
+  i8088_segment_sync(cpu);
+  cpu->far_transfer = true;
+  cpu->t = 0;
+  callgraph_hook_interrupt(cpu, int_no);
+}
+
+
+
+static void i8088_aaa(i8088_t *cpu)
+{
+  uint8_t initial = cpu->al;
+  flags_sync(cpu);
   if (((cpu->al & 0x0F) > 9) || (cpu->a == 1)) {
     cpu->ah = cpu->ah + 1;
     cpu->al = cpu->al + 6;
@@ -1313,6 +1404,7 @@ static void i8088_aaa(i8088_t *cpu)
 static void i8088_aas(i8088_t *cpu)
 {
   uint8_t initial = cpu->al;
+  flags_sync(cpu);
   if (((cpu->al & 0x0F) > 9) || (cpu->a == 1)) {
     cpu->al = cpu->al - 6;
     cpu->ah = cpu->ah - 1;
@@ -1333,14 +1425,10 @@ static void i8088_aas(i8088_t *cpu)
 
 static uint8_t i8088_adc_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 {
-  uint8_t result = input1 + input2 + cpu->c;
-  cpu->a = (((input1 & 0xF) + (input2 & 0xF) + cpu->c) & 0x10) > 0;
-  cpu->c = ((uint16_t)(input1 + input2 + cpu->c) & 0x100) > 0;
-  cpu->o = (((input1 & 0x80) && (input2 & 0x80) && !(result & 0x80)) ||
-           (!(input1 & 0x80) && !(input2 & 0x80) && (result & 0x80)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  uint8_t result;
+  flags_sync(cpu);
+  result = input1 + input2 + cpu->c;
+  flags_set(cpu, FLAGS_ADD_8, input1, input2, result, cpu->c);
   return result;
 }
 
@@ -1348,14 +1436,10 @@ static uint8_t i8088_adc_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 
 static uint16_t i8088_adc_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 {
-  uint16_t result = input1 + input2 + cpu->c;
-  cpu->a = (((input1 & 0xF) + (input2 & 0xF) + cpu->c) & 0x10) > 0;
-  cpu->c = ((uint32_t)(input1 + input2 + cpu->c) & 0x10000) > 0;
-  cpu->o = (((input1 & 0x8000) && (input2 & 0x8000) && !(result & 0x8000)) ||
-           (!(input1 & 0x8000) && !(input2 & 0x8000) && (result & 0x8000)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  uint16_t result;
+  flags_sync(cpu);
+  result = input1 + input2 + cpu->c;
+  flags_set(cpu, FLAGS_ADD_16, input1, input2, result, cpu->c);
   return result;
 }
 
@@ -1364,13 +1448,7 @@ static uint16_t i8088_adc_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 static uint8_t i8088_add_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 {
   uint8_t result = input1 + input2;
-  cpu->a = (((input1 & 0xF) + (input2 & 0xF)) & 0x10) > 0;
-  cpu->c = ((uint16_t)(input1 + input2) & 0x100) > 0;
-  cpu->o = (((input1 & 0x80) && (input2 & 0x80) && !(result & 0x80)) ||
-           (!(input1 & 0x80) && !(input2 & 0x80) && (result & 0x80)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_ADD_8, input1, input2, result, 0);
   return result;
 }
 
@@ -1379,13 +1457,7 @@ static uint8_t i8088_add_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 static uint16_t i8088_add_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 {
   uint16_t result = input1 + input2;
-  cpu->a = (((input1 & 0xF) + (input2 & 0xF)) & 0x10) > 0;
-  cpu->c = ((uint32_t)(input1 + input2) & 0x10000) > 0;
-  cpu->o = (((input1 & 0x8000) && (input2 & 0x8000) && !(result & 0x8000)) ||
-           (!(input1 & 0x8000) && !(input2 & 0x8000) && (result & 0x8000)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_ADD_16, input1, input2, result, 0);
   return result;
 }
 
@@ -1394,12 +1466,7 @@ static uint16_t i8088_add_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 static uint8_t i8088_and_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 {
   uint8_t result = input1 & input2;
-  cpu->c = 0;
-  cpu->o = (((input1 & 0x80) && (input2 & 0x80) && !(result & 0x80)) ||
-           (!(input1 & 0x80) && !(input2 & 0x80) && (result & 0x80)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_AND_8, input1, input2, result, 0);
   return result;
 }
 
@@ -1408,12 +1475,7 @@ static uint8_t i8088_and_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 static uint16_t i8088_and_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 {
   uint16_t result = input1 & input2;
-  cpu->c = 0;
-  cpu->o = (((input1 & 0x8000) && (input2 & 0x8000) && !(result & 0x8000)) ||
-           (!(input1 & 0x8000) && !(input2 & 0x8000) && (result & 0x8000)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_AND_16, input1, input2, result, 0);
   return result;
 }
 
@@ -1422,13 +1484,7 @@ static uint16_t i8088_and_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 static void i8088_cmp_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 {
   uint8_t result = input1 - input2;
-  cpu->a = (((input1 & 0xF) - (input2 & 0xF)) & 0x10) > 0;
-  cpu->c = ((uint16_t)(input1 - input2) & 0x100) > 0;
-  cpu->o = (((input1 & 0x80) && !(input2 & 0x80) && !(result & 0x80)) ||
-           (!(input1 & 0x80) && (input2 & 0x80) && (result & 0x80)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_SUB_8, input1, input2, result, 0);
 }
 
 
@@ -1436,13 +1492,7 @@ static void i8088_cmp_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 static void i8088_cmp_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 {
   uint16_t result = input1 - input2;
-  cpu->a = (((input1 & 0xF) - (input2 & 0xF)) & 0x10) > 0;
-  cpu->c = ((uint32_t)(input1 - input2) & 0x10000) > 0;
-  cpu->o = (((input1 & 0x8000) && !(input2 & 0x8000) && !(result & 0x8000)) ||
-           (!(input1 & 0x8000) && (input2 & 0x8000) && (result & 0x8000)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_SUB_16, input1, input2, result, 0);
 }
 
 
@@ -1450,7 +1500,7 @@ static void i8088_cmp_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 static void i8088_cmpsb(i8088_t *cpu, mem_t *mem)
 {
   i8088_cmp_8(cpu,
-    eaddr_read_8(cpu, mem, cpu->ds, cpu->si, NULL),
+    eaddr_read_8(mem, cpu->eaddr_ds_base, cpu->si, NULL),
     mem_read_by_segment(mem, cpu->es, cpu->di));
   if (cpu->d) {
     cpu->di -= 1;
@@ -1466,9 +1516,8 @@ static void i8088_cmpsb(i8088_t *cpu, mem_t *mem)
 static void i8088_cmpsw(i8088_t *cpu, mem_t *mem)
 {
   uint16_t data;
-  data  = mem_read_by_segment(mem, cpu->es, cpu->di);
-  data += mem_read_by_segment(mem, cpu->es, cpu->di+1) * 0x100;
-  i8088_cmp_16(cpu, eaddr_read_16(cpu, mem, cpu->ds, cpu->si, NULL), data);
+  data = mem_read_16_by_segment(mem, cpu->es, cpu->di);
+  i8088_cmp_16(cpu, eaddr_read_16(mem, cpu->eaddr_ds_base, cpu->si, NULL), data);
   if (cpu->d) {
     cpu->di -= 2;
     cpu->si -= 2;
@@ -1483,7 +1532,9 @@ static void i8088_cmpsw(i8088_t *cpu, mem_t *mem)
 static void i8088_daa(i8088_t *cpu)
 {
   uint8_t initial = cpu->al;
-  bool temp_a = cpu->a;
+  bool temp_a;
+  flags_sync(cpu);
+  temp_a = cpu->a;
   if (((cpu->al & 0x0F) > 9) || (cpu->a == 1)) {
     cpu->al = cpu->al + 6;
     cpu->a = 1;
@@ -1510,7 +1561,9 @@ static void i8088_daa(i8088_t *cpu)
 static void i8088_das(i8088_t *cpu)
 {
   uint8_t initial = cpu->al;
-  bool temp_a = cpu->a;
+  bool temp_a;
+  flags_sync(cpu);
+  temp_a = cpu->a;
   if (((cpu->al & 0x0F) > 9) || (cpu->a == 1)) {
     cpu->al = cpu->al - 6;
     cpu->a = 1;
@@ -1537,11 +1590,7 @@ static void i8088_das(i8088_t *cpu)
 static uint8_t i8088_dec_8(i8088_t *cpu, uint8_t input)
 {
   uint8_t result = input - 1;
-  cpu->a = !(input & 0xF);
-  cpu->o = ((input & 0x80) && !(result & 0x80));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_DEC_8, input, 0, result, 0);
   return result;
 }
 
@@ -1550,11 +1599,7 @@ static uint8_t i8088_dec_8(i8088_t *cpu, uint8_t input)
 static uint16_t i8088_dec_16(i8088_t *cpu, uint16_t input)
 {
   uint16_t result = input - 1;
-  cpu->a = !(input & 0xF);
-  cpu->o = 0;
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_DEC_16, input, 0, result, 0);
   return result;
 }
 
@@ -1650,6 +1695,7 @@ static void i8088_idiv_16(i8088_t *cpu, mem_t *mem, uint16_t input)
 
 static void i8088_imul_8(i8088_t *cpu, uint8_t input)
 {
+  flags_sync(cpu);
   cpu->ax = (int8_t)cpu->al * (int8_t)input;
   cpu->c = (int16_t)cpu->ax != (int8_t)cpu->ax;
   cpu->o = cpu->c;
@@ -1662,7 +1708,9 @@ static void i8088_imul_8(i8088_t *cpu, uint8_t input)
 
 static void i8088_imul_16(i8088_t *cpu, uint16_t input)
 {
-  int32_t result = (int16_t)cpu->ax * (int16_t)input;
+  int32_t result;
+  flags_sync(cpu);
+  result = (int16_t)cpu->ax * (int16_t)input;
   cpu->ax = result & 0xFFFF;
   cpu->dx = result >> 16;
   cpu->c = result != (int16_t)result;
@@ -1674,14 +1722,26 @@ static void i8088_imul_16(i8088_t *cpu, uint16_t input)
 
 
 
+static uint16_t i8088_imul_16_imm(i8088_t *cpu, uint16_t input1,
+  uint16_t input2)
+{
+  int32_t result;
+  flags_sync(cpu);
+  result = (int16_t)input1 * (int16_t)input2;
+  cpu->c = result != (int16_t)result;
+  cpu->o = cpu->c;
+  cpu->p = parity_even(result >> 16);
+  cpu->s = result >> 31;
+  cpu->z = (result >> 16) == 0;
+  return result & 0xFFFF;
+}
+
+
+
 static uint8_t i8088_inc_8(i8088_t *cpu, uint8_t input)
 {
   uint8_t result = input + 1;
-  cpu->a = !(result & 0xF);
-  cpu->o = input == 0x7F;
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_INC_8, input, 0, result, 0);
   return result;
 }
 
@@ -1690,19 +1750,42 @@ static uint8_t i8088_inc_8(i8088_t *cpu, uint8_t input)
 static uint16_t i8088_inc_16(i8088_t *cpu, uint16_t input)
 {
   uint16_t result = input + 1;
-  cpu->a = !(result & 0xF);
-  cpu->o = input == 0x7FFF;
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_INC_16, input, 0, result, 0);
   return result;
 }
 
 
 
+static void i8088_insb(i8088_t *cpu, mem_t *mem)
+{
+  mem_write_by_segment(mem, cpu->es, cpu->di, io_read(cpu->io, cpu->dx));
+  if (cpu->d) {
+    cpu->di -= 1;
+  } else {
+    cpu->di += 1;
+  }
+}
+
+
+
+static void i8088_insw(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data;
+  data  = io_read(cpu->io, cpu->dx);
+  data += io_read(cpu->io, cpu->dx+1) * 0x100;
+  mem_write_16_by_segment(mem, cpu->es, cpu->di, data);
+  if (cpu->d) {
+    cpu->di -= 2;
+  } else {
+    cpu->di += 2;
+  }
+}
+
+
+
 static void i8088_lodsb(i8088_t *cpu, mem_t *mem)
 {
-  cpu->al = eaddr_read_8(cpu, mem, cpu->ds, cpu->si, NULL);
+  cpu->al = eaddr_read_8(mem, cpu->eaddr_ds_base, cpu->si, NULL);
   if (cpu->d) {
     cpu->si -= 1;
   } else {
@@ -1714,8 +1797,7 @@ static void i8088_lodsb(i8088_t *cpu, mem_t *mem)
 
 static void i8088_lodsw(i8088_t *cpu, mem_t *mem)
 {
-  cpu->al = eaddr_read_16(cpu, mem, cpu->ds, cpu->si,   NULL);
-  cpu->ah = eaddr_read_16(cpu, mem, cpu->ds, cpu->si+1, NULL);
+  cpu->ax = eaddr_read_16(mem, cpu->eaddr_ds_base, cpu->si, NULL);
   if (cpu->d) {
     cpu->si -= 2;
   } else {
@@ -1728,7 +1810,7 @@ static void i8088_lodsw(i8088_t *cpu, mem_t *mem)
 static void i8088_movsb(i8088_t *cpu, mem_t *mem)
 {
   mem_write_by_segment(mem, cpu->es, cpu->di,
-    eaddr_read_8(cpu, mem, cpu->ds, cpu->si, NULL));
+    eaddr_read_8(mem, cpu->eaddr_ds_base, cpu->si, NULL));
   if (cpu->d) {
     cpu->di -= 1;
     cpu->si -= 1;
@@ -1743,10 +1825,8 @@ static void i8088_movsb(i8088_t *cpu, mem_t *mem)
 static void i8088_movsw(i8088_t *cpu, mem_t *mem)
 {
   uint16_t data;
-  data  = eaddr_read_8(cpu, mem, cpu->ds, cpu->si, NULL);
-  data += eaddr_read_8(cpu, mem, cpu->ds, cpu->si+1, NULL) * 0x100;
-  mem_write_by_segment(mem, cpu->es, cpu->di,   data % 0x100);
-  mem_write_by_segment(mem, cpu->es, cpu->di+1, data / 0x100);
+  data = eaddr_read_16(mem, cpu->eaddr_ds_base, cpu->si, NULL);
+  mem_write_16_by_segment(mem, cpu->es, cpu->di, data);
   if (cpu->d) {
     cpu->di -= 2;
     cpu->si -= 2;
@@ -1760,6 +1840,7 @@ static void i8088_movsw(i8088_t *cpu, mem_t *mem)
 
 static void i8088_mul_8(i8088_t *cpu, uint8_t input)
 {
+  flags_sync(cpu);
   cpu->ax = cpu->al * input;
   cpu->c = (cpu->ax >> 8) > 0;
   cpu->o = cpu->c;
@@ -1772,7 +1853,9 @@ static void i8088_mul_8(i8088_t *cpu, uint8_t input)
 
 static void i8088_mul_16(i8088_t *cpu, uint16_t input)
 {
-  uint32_t result = cpu->ax * input;
+  uint32_t result;
+  flags_sync(cpu);
+  result = cpu->ax * input;
   cpu->ax = result & 0xFFFF;
   cpu->dx = result >> 16;
   cpu->c = (result >> 16) > 0;
@@ -1787,11 +1870,7 @@ static void i8088_mul_16(i8088_t *cpu, uint16_t input)
 static uint8_t i8088_or_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 {
   uint8_t result = input1 | input2;
-  cpu->c = 0;
-  cpu->o = 0;
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_LOGIC_8, input1, input2, result, 0);
   return result;
 }
 
@@ -1800,19 +1879,62 @@ static uint8_t i8088_or_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 static uint16_t i8088_or_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 {
   uint16_t result = input1 | input2;
-  cpu->c = 0;
-  cpu->o = 0;
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_LOGIC_16, input1, input2, result, 0);
   return result;
 }
 
 
 
+static void i8088_outsb(i8088_t *cpu, mem_t *mem)
+{
+  io_write(cpu->io, cpu->dx,
+    eaddr_read_8(mem, cpu->eaddr_ds_base, cpu->si, NULL));
+  if (cpu->d) {
+    cpu->si -= 1;
+  } else {
+    cpu->si += 1;
+  }
+}
+
+
+
+static void i8088_outsw(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data;
+  data = eaddr_read_16(mem, cpu->eaddr_ds_base, cpu->si, NULL);
+  io_write(cpu->io, cpu->dx,   data % 0x100);
+  io_write(cpu->io, cpu->dx+1, data / 0x100);
+  if (cpu->d) {
+    cpu->si -= 2;
+  } else {
+    cpu->si += 2;
+  }
+}
+
+
+
+static uint16_t i8088_pop_16(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t value;
+  value = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+  return value;
+}
+
+
+
+static void i8088_push_16(i8088_t *cpu, mem_t *mem, uint16_t value)
+{
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, value);
+}
+
+
+
 static uint8_t i8088_rcl_8(i8088_t *cpu, uint8_t input, uint8_t count)
 {
   bool temp_c;
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -1838,6 +1960,7 @@ static uint8_t i8088_rcl_8(i8088_t *cpu, uint8_t input, uint8_t count)
 static uint16_t i8088_rcl_16(i8088_t *cpu, uint16_t input, uint8_t count)
 {
   bool temp_c;
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -1863,6 +1986,7 @@ static uint16_t i8088_rcl_16(i8088_t *cpu, uint16_t input, uint8_t count)
 static uint8_t i8088_rcr_8(i8088_t *cpu, uint8_t input, uint8_t count)
 {
   bool temp_c;
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -1888,6 +2012,7 @@ static uint8_t i8088_rcr_8(i8088_t *cpu, uint8_t input, uint8_t count)
 static uint16_t i8088_rcr_16(i8088_t *cpu, uint16_t input, uint8_t count)
 {
   bool temp_c;
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -1912,6 +2037,7 @@ static uint16_t i8088_rcr_16(i8088_t *cpu, uint16_t input, uint8_t count)
 
 static uint8_t i8088_rol_8(i8088_t *cpu, uint8_t input, uint8_t count)
 {
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -1934,6 +2060,7 @@ static uint8_t i8088_rol_8(i8088_t *cpu, uint8_t input, uint8_t count)
 
 static uint16_t i8088_rol_16(i8088_t *cpu, uint16_t input, uint8_t count)
 {
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -1956,6 +2083,7 @@ static uint16_t i8088_rol_16(i8088_t *cpu, uint16_t input, uint8_t count)
 
 static uint8_t i8088_ror_8(i8088_t *cpu, uint8_t input, uint8_t count)
 {
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -1978,6 +2106,7 @@ static uint8_t i8088_ror_8(i8088_t *cpu, uint8_t input, uint8_t count)
 
 static uint16_t i8088_ror_16(i8088_t *cpu, uint16_t input, uint8_t count)
 {
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -2001,6 +2130,7 @@ static uint16_t i8088_ror_16(i8088_t *cpu, uint16_t input, uint8_t count)
 static uint8_t i8088_sar_8(i8088_t *cpu, uint8_t input, uint8_t count)
 {
   uint8_t result = input;
+  flags_sync(cpu);
   if (count == 0) {
     return result;
   } else if (count == 1) {
@@ -2016,9 +2146,7 @@ static uint8_t i8088_sar_8(i8088_t *cpu, uint8_t input, uint8_t count)
       count--;
     }
   }
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_RESULT_8, 0, 0, result, 0);
   return result;
 }
 
@@ -2027,6 +2155,7 @@ static uint8_t i8088_sar_8(i8088_t *cpu, uint8_t input, uint8_t count)
 static uint16_t i8088_sar_16(i8088_t *cpu, uint16_t input, uint8_t count)
 {
   uint16_t result = input;
+  flags_sync(cpu);
   if (count == 0) {
     return result;
   } else if (count == 1) {
@@ -2042,9 +2171,7 @@ static uint16_t i8088_sar_16(i8088_t *cpu, uint16_t input, uint8_t count)
       count--;
     }
   }
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_RESULT_16, 0, 0, result, 0);
   return result;
 }
 
@@ -2065,8 +2192,7 @@ static void i8088_scasb(i8088_t *cpu, mem_t *mem)
 static void i8088_scasw(i8088_t *cpu, mem_t *mem)
 {
   uint16_t data;
-  data  = mem_read_by_segment(mem, cpu->es, cpu->di);
-  data += mem_read_by_segment(mem, cpu->es, cpu->di+1) * 0x100;
+  data = mem_read_16_by_segment(mem, cpu->es, cpu->di);
   i8088_cmp_16(cpu, cpu->ax, data);
   if (cpu->d) {
     cpu->di -= 2;
@@ -2079,6 +2205,7 @@ static void i8088_scasw(i8088_t *cpu, mem_t *mem)
 
 static uint8_t i8088_shl_8(i8088_t *cpu, uint8_t input, uint8_t count)
 {
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -2092,9 +2219,7 @@ static uint8_t i8088_shl_8(i8088_t *cpu, uint8_t input, uint8_t count)
       count--;
     }
   }
-  cpu->p = parity_even(input);
-  cpu->s = input >> 7;
-  cpu->z = input == 0;
+  flags_set(cpu, FLAGS_RESULT_8, 0, 0, input, 0);
   return input;
 }
 
@@ -2102,6 +2227,7 @@ static uint8_t i8088_shl_8(i8088_t *cpu, uint8_t input, uint8_t count)
 
 static uint16_t i8088_shl_16(i8088_t *cpu, uint16_t input, uint16_t count)
 {
+  flags_sync(cpu);
   if (count == 0) {
     return input;
   } else if (count == 1) {
@@ -2115,9 +2241,7 @@ static uint16_t i8088_shl_16(i8088_t *cpu, uint16_t input, uint16_t count)
       count--;
     }
   }
-  cpu->p = parity_even(input);
-  cpu->s = input >> 15;
-  cpu->z = input == 0;
+  flags_set(cpu, FLAGS_RESULT_16, 0, 0, input, 0);
   return input;
 }
 
@@ -2126,6 +2250,7 @@ static uint16_t i8088_shl_16(i8088_t *cpu, uint16_t input, uint16_t count)
 static uint8_t i8088_shr_8(i8088_t *cpu, uint8_t input, uint8_t count)
 {
   uint8_t result = input;
+  flags_sync(cpu);
   if (count == 0) {
     return result;
   } else if (count == 1) {
@@ -2139,9 +2264,7 @@ static uint8_t i8088_shr_8(i8088_t *cpu, uint8_t input, uint8_t count)
       count--;
     }
   }
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_RESULT_8, 0, 0, result, 0);
   return result;
 }
 
@@ -2150,6 +2273,7 @@ static uint8_t i8088_shr_8(i8088_t *cpu, uint8_t input, uint8_t count)
 static uint16_t i8088_shr_16(i8088_t *cpu, uint16_t input, uint8_t count)
 {
   uint16_t result = input;
+  flags_sync(cpu);
   if (count == 0) {
     return result;
   } else if (count == 1) {
@@ -2163,9 +2287,7 @@ static uint16_t i8088_shr_16(i8088_t *cpu, uint16_t input, uint8_t count)
       count--;
     }
   }
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  flags_set(cpu, FLAGS_RESULT_16, 0, 0, result, 0);
   return result;
 }
 
@@ -2173,14 +2295,10 @@ static uint16_t i8088_shr_16(i8088_t *cpu, uint16_t input, uint8_t count)
 
 static uint8_t i8088_sbb_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 {
-  uint8_t result = input1 - input2 - cpu->c;
-  cpu->a = (((input1 & 0xF) - (input2 & 0xF) - cpu->c) & 0x10) > 0;
-  cpu->c = ((uint16_t)(input1 - input2 - cpu->c) & 0x100) > 0;
-  cpu->o = (((input1 & 0x80) && !(input2 & 0x80) && !(result & 0x80)) ||
-           (!(input1 & 0x80) && (input2 & 0x80) && (result & 0x80)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
+  uint8_t result;
+  flags_sync(cpu);
+  result = input1 - input2 - cpu->c;
+  flags_set(cpu, FLAGS_SUB_8, input1, input2, result, cpu->c);
   return result;
 }
 
@@ -2188,14 +2306,10 @@ static uint8_t i8088_sbb_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
 
 static uint16_t i8088_sbb_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
 {
-  uint16_t result = input1 - input2 - cpu->c;
-  cpu->a = (((input1 & 0xF) - (input2 & 0xF) - cpu->c) & 0x10) > 0;
-  cpu->c = ((uint32_t)(input1 - input2 - cpu->c) & 0x10000) > 0;
-  cpu->o = (((input1 & 0x8000) && !(input2 & 0x8000) && !(result & 0x8000)) ||
-           (!(input1 & 0x8000) && (input2 & 0x8000) && (result & 0x8000)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
+  uint16_t result;
+  flags_sync(cpu);
+  result = input1 - input2 - cpu->c;
+  flags_set(cpu, FLAGS_SUB_16, input1, input2, result, cpu->c);
   return result;
 }
 
@@ -2215,8 +2329,7 @@ static void i8088_stosb(i8088_t *cpu, mem_t *mem)
 
 static void i8088_stosw(i8088_t *cpu, mem_t *mem)
 {
-  mem_write_by_segment(mem, cpu->es, cpu->di,   cpu->al);
-  mem_write_by_segment(mem, cpu->es, cpu->di+1, cpu->ah);
+  mem_write_16_by_segment(mem, cpu->es, cpu->di, cpu->ax);
   if (cpu->d) {
     cpu->di -= 2;
   } else {
@@ -2226,109 +2339,376 @@ static void i8088_stosw(i8088_t *cpu, mem_t *mem)
 
 
 
-static uint8_t i8088_sub_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
+#ifdef I8088_REFERENCE
+static uint32_t rep_run(uint32_t count, uint16_t offset, uint32_t address,
+  uint32_t size, bool down)
 {
-  uint8_t result = input1 - input2;
-  cpu->a = (((input1 & 0xF) - (input2 & 0xF)) & 0x10) > 0;
-  cpu->c = ((uint16_t)(input1 - input2) & 0x100) > 0;
-  cpu->o = (((input1 & 0x80) && !(input2 & 0x80) && !(result & 0x80)) ||
-           (!(input1 & 0x80) && (input2 & 0x80) && (result & 0x80)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
-  return result;
+  (void)count;
+  (void)offset;
+  (void)address;
+  (void)size;
+  (void)down;
+  return 0; /* Element by element, never in bulk. */
+}
+#else
+static uint32_t rep_run(uint32_t count, uint16_t offset, uint32_t address,
+  uint32_t size, bool down)
+{
+  uint32_t n;
+
+  /* Limit to elements that do not wrap the offset or the linear address. */
+  if (down) {
+    if ((offset + size - 1) > 0xFFFF || (address + size - 1) > 0xFFFFF) {
+      return 0;
+    }
+    n = (offset / size) + 1;
+    if ((address / size) + 1 < n) {
+      n = (address / size) + 1;
+    }
+  } else {
+    n = (0x10000 - offset) / size;
+    if ((0x100000 - address) / size < n) {
+      n = (0x100000 - address) / size;
+    }
+  }
+  return (count < n) ? count : n;
 }
+#endif /* I8088_REFERENCE */
 
 
 
-static uint16_t i8088_sub_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
+static bool rep_ram(mem_t *mem, uint32_t count, uint32_t address,
+  uint32_t size, bool down)
 {
-  uint16_t result = input1 - input2;
-  cpu->a = (((input1 & 0xF) - (input2 & 0xF)) & 0x10) > 0;
-  cpu->c = ((uint32_t)(input1 - input2) & 0x10000) > 0;
-  cpu->o = (((input1 & 0x8000) && !(input2 & 0x8000) && !(result & 0x8000)) ||
-           (!(input1 & 0x8000) && (input2 & 0x8000) && (result & 0x8000)));
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
-  return result;
+  /* Elements compared in bulk are read straight from the array, so any
+     hooks of other pages only see them one at a time, like without REP. */
+  if (down) {
+    address -= (count - 1) * size;
+  }
+  return mem_ram(mem, address, count * size);
 }
 
 
 
-static uint8_t i8088_xor_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
+static void i8088_rep_movs(i8088_t *cpu, mem_t *mem, uint32_t size)
 {
-  uint8_t result = input1 ^ input2;
-  cpu->c = 0;
-  cpu->o = 0;
-  cpu->p = parity_even(result);
-  cpu->s = result >> 7;
-  cpu->z = result == 0;
-  return result;
+  uint32_t src;
+  uint32_t dst;
+  uint32_t n;
+
+  while (cpu->cx != 0) {
+    src = (cpu->eaddr_ds_base + cpu->si) & 0xFFFFF;
+    dst = (cpu->es_base + cpu->di) & 0xFFFFF;
+    n = rep_run(cpu->cx, cpu->si, src, size, cpu->d);
+    n = rep_run(n, cpu->di, dst, size, cpu->d);
+    if (cpu->d) {
+      src -= (n - 1) * size;
+      dst -= (n - 1) * size;
+    }
+
+    /* Words are read whole before being written, which a byte copy only
+       matches if the ranges do not overlap. */
+    if (n == 0 || (size == 2 && src != dst &&
+        src < dst + (n * size) && dst < src + (n * size))) {
+      if (size == 1) {
+        i8088_movsb(cpu, mem);
+      } else {
+        i8088_movsw(cpu, mem);
+      }
+      cpu->cx--;
+      continue;
+    }
+
+    mem_copy(mem, dst, src, n * size, cpu->d);
+    if (cpu->d) {
+      cpu->si -= n * size;
+      cpu->di -= n * size;
+    } else {
+      cpu->si += n * size;
+      cpu->di += n * size;
+    }
+    cpu->cx -= n;
+  }
 }
 
 
 
-static uint16_t i8088_xor_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
+static void i8088_rep_stos(i8088_t *cpu, mem_t *mem, uint32_t size)
 {
-  uint16_t result = input1 ^ input2;
-  cpu->c = 0;
-  cpu->o = 0;
-  cpu->p = parity_even(result);
-  cpu->s = result >> 15;
-  cpu->z = result == 0;
-  return result;
+  uint32_t dst;
+  uint32_t n;
+
+  while (cpu->cx != 0) {
+    dst = (cpu->es_base + cpu->di) & 0xFFFFF;
+    n = rep_run(cpu->cx, cpu->di, dst, size, cpu->d);
+    if (n == 0) {
+      if (size == 1) {
+        i8088_stosb(cpu, mem);
+      } else {
+        i8088_stosw(cpu, mem);
+      }
+      cpu->cx--;
+      continue;
+    }
+
+    if (cpu->d) {
+      dst -= (n - 1) * size;
+    }
+    mem_fill(mem, dst, n * size, cpu->al, (size == 1) ? cpu->al : cpu->ah);
+    if (cpu->d) {
+      cpu->di -= n * size;
+    } else {
+      cpu->di += n * size;
+    }
+    cpu->cx -= n;
+  }
 }
 
 
 
-static void i8088_opcode_80(i8088_t *cpu, mem_t *mem)
+static void i8088_rep_cmps(i8088_t *cpu, mem_t *mem, uint32_t size)
 {
-  uint8_t modrm;
-  uint16_t eaddr;
-  uint8_t value;
-  uint8_t data;
-
-  modrm = fetch(cpu, mem);
-  value = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-  data = fetch(cpu, mem);
-  i8088_trace_op_src(false, FMT_U, data);
+  uint32_t src;
+  uint32_t dst;
+  uint32_t n;
+  uint32_t i;
+  bool equal;
+  bool found;
+
+  /* REPNZ stops on the first equal pair, REPZ on the first difference. */
+  equal = (cpu->repeat == REPEAT_NENZ);
+  while (cpu->cx != 0) {
+    src = (cpu->eaddr_ds_base + cpu->si) & 0xFFFFF;
+    dst = (cpu->es_base + cpu->di) & 0xFFFFF;
+    n = rep_run(cpu->cx, cpu->si, src, size, cpu->d);
+    n = rep_run(n, cpu->di, dst, size, cpu->d);
+    if (n == 0 || ! rep_ram(mem, n, src, size, cpu->d) ||
+        ! rep_ram(mem, n, dst, size, cpu->d)) {
+      if (size == 1) {
+        i8088_cmpsb(cpu, mem);
+      } else {
+        i8088_cmpsw(cpu, mem);
+      }
+      cpu->cx--;
+      if (flags_get_z(cpu) == equal) {
+        return;
+      }
+      continue;
+    }
 
-  switch (modrm_opcode(modrm)) {
-  case MODRM_OPCODE_ADD:
-    i8088_trace_op_mnemonic("add");
-    value = i8088_add_8(cpu, value, data);
-    break;
+    i = mem_compare(mem, src, dst, n, size, equal, cpu->d);
+    found = (i < n);
+    if (found) {
+      n = i + 1;
+    }
 
-  case MODRM_OPCODE_OR:
-    i8088_trace_op_mnemonic("or");
-    value = i8088_or_8(cpu, value, data);
-    break;
+    /* Flags are those of the last pair compared. */
+    if (cpu->d) {
+      src -= (n - 1) * size;
+      dst -= (n - 1) * size;
+      cpu->si -= n * size;
+      cpu->di -= n * size;
+    } else {
+      src += (n - 1) * size;
+      dst += (n - 1) * size;
+      cpu->si += n * size;
+      cpu->di += n * size;
+    }
+    cpu->cx -= n;
+    if (size == 1) {
+      i8088_cmp_8(cpu, mem->m[src], mem->m[dst]);
+    } else {
+      i8088_cmp_16(cpu, mem->m[src] + (mem->m[src + 1] * 0x100),
+        mem->m[dst] + (mem->m[dst + 1] * 0x100));
+    }
+    if (found) {
+      return;
+    }
+  }
+}
 
-  case MODRM_OPCODE_ADC:
-    i8088_trace_op_mnemonic("adc");
-    value = i8088_adc_8(cpu, value, data);
-    break;
 
-  case MODRM_OPCODE_SBB:
-    i8088_trace_op_mnemonic("sbb");
-    value = i8088_sbb_8(cpu, value, data);
-    break;
 
-  case MODRM_OPCODE_AND:
-    i8088_trace_op_mnemonic("and");
-    value = i8088_and_8(cpu, value, data);
-    break;
+static void i8088_rep_scas(i8088_t *cpu, mem_t *mem, uint32_t size)
+{
+  uint32_t dst;
+  uint32_t n;
+  uint32_t i;
+  bool equal;
+  bool found;
+
+  /* REPNZ stops on the first equal element, REPZ on the first other. */
+  equal = (cpu->repeat == REPEAT_NENZ);
+  while (cpu->cx != 0) {
+    dst = (cpu->es_base + cpu->di) & 0xFFFFF;
+    n = rep_run(cpu->cx, cpu->di, dst, size, cpu->d);
+    if (n == 0 || ! rep_ram(mem, n, dst, size, cpu->d)) {
+      if (size == 1) {
+        i8088_scasb(cpu, mem);
+      } else {
+        i8088_scasw(cpu, mem);
+      }
+      cpu->cx--;
+      if (flags_get_z(cpu) == equal) {
+        return;
+      }
+      continue;
+    }
 
-  case MODRM_OPCODE_SUB:
-    i8088_trace_op_mnemonic("sub");
-    value = i8088_sub_8(cpu, value, data);
-    break;
+    i = mem_scan(mem, dst, n, size, (size == 1) ? cpu->al : cpu->ax,
+      equal, cpu->d);
+    found = (i < n);
+    if (found) {
+      n = i + 1;
+    }
 
-  case MODRM_OPCODE_XOR:
-    i8088_trace_op_mnemonic("xor");
-    value = i8088_xor_8(cpu, value, data);
-    break;
+    /* Flags are those of the last element compared. */
+    if (cpu->d) {
+      dst -= (n - 1) * size;
+      cpu->di -= n * size;
+    } else {
+      dst += (n - 1) * size;
+      cpu->di += n * size;
+    }
+    cpu->cx -= n;
+    if (size == 1) {
+      i8088_cmp_8(cpu, cpu->al, mem->m[dst]);
+    } else {
+      i8088_cmp_16(cpu, cpu->ax, mem->m[dst] + (mem->m[dst + 1] * 0x100));
+    }
+    if (found) {
+      return;
+    }
+  }
+}
+
+
+
+static void i8088_rep_ins(i8088_t *cpu, mem_t *mem, uint32_t size)
+{
+  /* Every element is a port access, but the instruction is only decoded
+     and dispatched once for the whole block. */
+  while (cpu->cx != 0) {
+    if (size == 1) {
+      i8088_insb(cpu, mem);
+    } else {
+      i8088_insw(cpu, mem);
+    }
+    cpu->cx--;
+  }
+}
+
+
+
+static void i8088_rep_outs(i8088_t *cpu, mem_t *mem, uint32_t size)
+{
+  while (cpu->cx != 0) {
+    if (size == 1) {
+      i8088_outsb(cpu, mem);
+    } else {
+      i8088_outsw(cpu, mem);
+    }
+    cpu->cx--;
+  }
+}
+
+
+
+static uint8_t i8088_sub_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
+{
+  uint8_t result = input1 - input2;
+  flags_set(cpu, FLAGS_SUB_8, input1, input2, result, 0);
+  return result;
+}
+
+
+
+static uint16_t i8088_sub_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
+{
+  uint16_t result = input1 - input2;
+  flags_set(cpu, FLAGS_SUB_16, input1, input2, result, 0);
+  return result;
+}
+
+
+
+static uint8_t i8088_xor_8(i8088_t *cpu, uint8_t input1, uint8_t input2)
+{
+  uint8_t result = input1 ^ input2;
+  flags_set(cpu, FLAGS_LOGIC_8, input1, input2, result, 0);
+  return result;
+}
+
+
+
+static uint16_t i8088_xor_16(i8088_t *cpu, uint16_t input1, uint16_t input2)
+{
+  uint16_t result = input1 ^ input2;
+  flags_set(cpu, FLAGS_LOGIC_16, input1, input2, result, 0);
+  return result;
+}
+
+
+
+static bool v20_opcode(i8088_t *cpu, uint8_t opcode)
+{
+  /* The 80186 instructions are undefined opcodes on the 8088. */
+  if (! cpu->v20) {
+    panic("Unhandled opcode: 0x%02x\n", opcode);
+    return false;
+  }
+  return true;
+}
+
+
+
+static void i8088_opcode_80(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+  uint16_t eaddr;
+  uint8_t value;
+  uint8_t data;
+
+  modrm = fetch_modrm(cpu, mem);
+  value = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  data = fetch_8(cpu, mem);
+  i8088_trace_op_src(false, FMT_U, data);
+
+  switch (modrm_opcode(modrm)) {
+  case MODRM_OPCODE_ADD:
+    i8088_trace_op_mnemonic("add");
+    value = i8088_add_8(cpu, value, data);
+    break;
+
+  case MODRM_OPCODE_OR:
+    i8088_trace_op_mnemonic("or");
+    value = i8088_or_8(cpu, value, data);
+    break;
+
+  case MODRM_OPCODE_ADC:
+    i8088_trace_op_mnemonic("adc");
+    value = i8088_adc_8(cpu, value, data);
+    break;
+
+  case MODRM_OPCODE_SBB:
+    i8088_trace_op_mnemonic("sbb");
+    value = i8088_sbb_8(cpu, value, data);
+    break;
+
+  case MODRM_OPCODE_AND:
+    i8088_trace_op_mnemonic("and");
+    value = i8088_and_8(cpu, value, data);
+    break;
+
+  case MODRM_OPCODE_SUB:
+    i8088_trace_op_mnemonic("sub");
+    value = i8088_sub_8(cpu, value, data);
+    break;
+
+  case MODRM_OPCODE_XOR:
+    i8088_trace_op_mnemonic("xor");
+    value = i8088_xor_8(cpu, value, data);
+    break;
 
   case MODRM_OPCODE_CMP:
     i8088_trace_op_mnemonic("cmp");
@@ -2352,10 +2732,9 @@ static void i8088_opcode_81(i8088_t *cpu, mem_t *mem)
   uint16_t value;
   uint16_t data;
 
-  modrm = fetch(cpu, mem);
+  modrm = fetch_modrm(cpu, mem);
   value = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-  data  = fetch(cpu, mem);
-  data += fetch(cpu, mem) * 0x100;
+  data = fetch_16(cpu, mem);
   i8088_trace_op_src(false, FMT_U, data);
 
   switch (modrm_opcode(modrm)) {
@@ -2415,9 +2794,9 @@ static void i8088_opcode_83(i8088_t *cpu, mem_t *mem)
   uint16_t value;
   int8_t data;
 
-  modrm = fetch(cpu, mem);
+  modrm = fetch_modrm(cpu, mem);
   value = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-  data = fetch(cpu, mem);
+  data = fetch_8(cpu, mem);
   i8088_trace_op_src(false, FMT_N, data);
 
   switch (modrm_opcode(modrm)) {
@@ -2470,16 +2849,9 @@ static void i8088_opcode_83(i8088_t *cpu, mem_t *mem)
 
 
 
-static void i8088_opcode_d0_d2(i8088_t *cpu, mem_t *mem,
+static uint8_t i8088_shift_8(i8088_t *cpu, uint8_t modrm, uint8_t value,
   uint8_t count)
 {
-  uint8_t modrm;
-  uint16_t eaddr;
-  uint8_t value;
-
-  modrm = fetch(cpu, mem);
-  value = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-
   switch (modrm_opcode(modrm)) {
   case MODRM_OPCODE_ROL:
     i8088_trace_op_mnemonic("rol");
@@ -2517,25 +2889,33 @@ static void i8088_opcode_d0_d2(i8088_t *cpu, mem_t *mem,
     break;
 
   default:
-    panic("Unhandled 0xD0/0xD2 opcode: 0x%x\n", modrm_opcode(modrm));
+    panic("Unhandled shift opcode: 0x%x\n", modrm_opcode(modrm));
     break;
   }
 
-  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr, value);
+  return value;
 }
 
 
 
-static void i8088_opcode_d1_d3(i8088_t *cpu, mem_t *mem,
+static void i8088_opcode_d0_d2(i8088_t *cpu, mem_t *mem,
   uint8_t count)
 {
   uint8_t modrm;
   uint16_t eaddr;
-  uint16_t value;
+  uint8_t value;
+
+  modrm = fetch_modrm(cpu, mem);
+  value = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  value = i8088_shift_8(cpu, modrm, value, count);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr, value);
+}
 
-  modrm = fetch(cpu, mem);
-  value = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
 
+
+static uint16_t i8088_shift_16(i8088_t *cpu, uint8_t modrm, uint16_t value,
+  uint8_t count)
+{
   switch (modrm_opcode(modrm)) {
   case MODRM_OPCODE_ROL:
     i8088_trace_op_mnemonic("rol");
@@ -2573,10 +2953,25 @@ static void i8088_opcode_d1_d3(i8088_t *cpu, mem_t *mem,
     break;
 
   default:
-    panic("Unhandled 0xD1/0xD3 opcode: 0x%x\n", modrm_opcode(modrm));
+    panic("Unhandled shift opcode: 0x%x\n", modrm_opcode(modrm));
     break;
   }
 
+  return value;
+}
+
+
+
+static void i8088_opcode_d1_d3(i8088_t *cpu, mem_t *mem,
+  uint8_t count)
+{
+  uint8_t modrm;
+  uint16_t eaddr;
+  uint16_t value;
+
+  modrm = fetch_modrm(cpu, mem);
+  value = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  value = i8088_shift_16(cpu, modrm, value, count);
   modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, value);
 }
 
@@ -2589,14 +2984,14 @@ static void i8088_opcode_f6(i8088_t *cpu, mem_t *mem)
   uint8_t value;
   uint8_t data;
 
-  modrm = fetch(cpu, mem);
+  modrm = fetch_modrm(cpu, mem);
   value = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
 
   switch (modrm_opcode(modrm)) {
   case MODRM_OPCODE_TEST:
   case MODRM_OPCODE_TEST_2:
     i8088_trace_op_mnemonic("test");
-    data = fetch(cpu, mem);
+    data = fetch_8(cpu, mem);
     (void)i8088_and_8(cpu, data, value);
     i8088_trace_op_src(false, FMT_U, data);
     break;
@@ -2657,15 +3052,14 @@ static void i8088_opcode_f7(i8088_t *cpu, mem_t *mem)
   uint16_t value;
   uint16_t data;
 
-  modrm = fetch(cpu, mem);
+  modrm = fetch_modrm(cpu, mem);
   value = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
 
   switch (modrm_opcode(modrm)) {
   case MODRM_OPCODE_TEST:
   case MODRM_OPCODE_TEST_2:
     i8088_trace_op_mnemonic("test");
-    data  = fetch(cpu, mem);
-    data += fetch(cpu, mem) * 0x100;
+    data = fetch_16(cpu, mem);
     (void)i8088_and_16(cpu, data, value);
     i8088_trace_op_src(false, FMT_U, data);
     break;
@@ -2725,7 +3119,7 @@ static void i8088_opcode_fe(i8088_t *cpu, mem_t *mem)
   uint16_t eaddr;
   uint8_t value;
 
-  modrm = fetch(cpu, mem);
+  modrm = fetch_modrm(cpu, mem);
   value = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
 
   switch (modrm_opcode(modrm)) {
@@ -2757,7 +3151,7 @@ static void i8088_opcode_ff(i8088_t *cpu, mem_t *mem)
   uint16_t eaddr;
   uint16_t value;
 
-  modrm = fetch(cpu, mem);
+  modrm = fetch_modrm(cpu, mem);
   value = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
 
   switch (modrm_opcode(modrm)) {
@@ -2776,9 +3170,9 @@ static void i8088_opcode_ff(i8088_t *cpu, mem_t *mem)
   case MODRM_OPCODE_CALL:
     i8088_trace_op_mnemonic("call");
     cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ip % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ip / 0x100);
+    mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ip);
     cpu->ip = value;
+    callgraph_hook_call(cpu);
     i8088_trace_op_dst_modrm_rm(modrm, 16);
     i8088_trace_op_src(false, "");
     return; /* Do NOT write back to memory! */
@@ -2787,12 +3181,13 @@ static void i8088_opcode_ff(i8088_t *cpu, mem_t *mem)
     i8088_trace_op_mnemonic("callf");
     i8088_trace_op_bit_size(16);
     cpu->sp -= 4;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ip % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ip / 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+2, cpu->cs % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+3, cpu->cs / 0x100);
+    mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ip);
+    mem_write_16_by_segment(mem, cpu->ss, cpu->sp+2, cpu->cs);
     cpu->ip = value;
     cpu->cs = modrm_get_rm_eaddr_16(cpu, mem, modrm, eaddr+2);
+    i8088_segment_sync(cpu);
+    cpu->far_transfer = true;
+    callgraph_hook_call(cpu);
     i8088_trace_op_dst_modrm_rm(modrm, 16);
     i8088_trace_op_src(false, "");
     return; /* Do NOT write back to memory! */
@@ -2808,6 +3203,8 @@ static void i8088_opcode_ff(i8088_t *cpu, mem_t *mem)
     i8088_trace_op_mnemonic("jmpf");
     cpu->ip = value;
     cpu->cs = modrm_get_rm_eaddr_16(cpu, mem, modrm, eaddr+2);
+    i8088_segment_sync(cpu);
+    cpu->far_transfer = true;
     i8088_trace_op_dst_modrm_rm(modrm, 16);
     i8088_trace_op_src(false, "");
     return; /* Do NOT write back to memory! */
@@ -2820,8 +3217,7 @@ static void i8088_opcode_ff(i8088_t *cpu, mem_t *mem)
       value -= 2;
     }
     cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   value % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, value / 0x100);
+    mem_write_16_by_segment(mem, cpu->ss, cpu->sp, value);
     i8088_trace_op_dst_modrm_rm(modrm, 16);
     i8088_trace_op_src(false, "");
     return; /* Do NOT write back to memory! */
@@ -2835,2033 +3231,4365 @@ static void i8088_opcode_ff(i8088_t *cpu, mem_t *mem)
 
 
 
-void i8088_reset(i8088_t *cpu)
+static void i8088_opcode_00(i8088_t *cpu, mem_t *mem)
 {
-  cpu->flags = 0x0000;
-  cpu->ip = 0x0000;
-  cpu->cs = 0xFFFF;
-  cpu->ds = 0x0000;
-  cpu->ss = 0x0000;
-  cpu->es = 0x0000;
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("add");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
+    i8088_add_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
 }
 
 
 
-bool i8088_irq(i8088_t *cpu, mem_t *mem, int irq_no)
+static void i8088_opcode_01(i8088_t *cpu, mem_t *mem)
 {
-  cpu->halt = false;
-  if (cpu->i == 0) {
-    return true;
-  }
-  i8088_interrupt(cpu, mem, irq_no + 8);
-  cpu->i = 0;
-  return false;
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("add");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
+    i8088_add_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
 }
 
 
 
-void i8088_init(i8088_t *cpu, io_t *io)
+static void i8088_opcode_02(i8088_t *cpu, mem_t *mem)
 {
-  memset(cpu, 0, sizeof(i8088_t));
-  cpu->io = io;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("add");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm,
+    i8088_add_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
 }
 
 
 
-void i8088_execute(i8088_t *cpu, mem_t *mem)
+static void i8088_opcode_03(i8088_t *cpu, mem_t *mem)
 {
-  uint8_t opcode;
+  uint16_t data_16;
+  uint8_t modrm;
 
-  if (cpu->halt) {
-    return; /* Waiting for IRQ. */
-  }
+  i8088_trace_op_mnemonic("add");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm,
+    i8088_add_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
+}
 
-  cpu->segment_override = SEGMENT_NONE;
-  cpu->repeat = REPEAT_NONE;
 
-  i8088_trace_start(cpu);
-  opcode = fetch(cpu, mem);
 
-  /* Prefix: */
-i8088_execute_segment_override:
-  if (opcode == 0x26) { /* ES segment override. */
-    i8088_trace_op_seg_override("es");
-    cpu->segment_override = SEGMENT_ES;
-    opcode = fetch(cpu, mem);
-  } else if (opcode == 0x2E) { /* CS segment override. */
-    i8088_trace_op_seg_override("cs");
-    cpu->segment_override = SEGMENT_CS;
-    opcode = fetch(cpu, mem);
-  } else if (opcode == 0x36) { /* SS segment override. */
-    i8088_trace_op_seg_override("ss");
-    cpu->segment_override = SEGMENT_SS;
-    opcode = fetch(cpu, mem);
-  } else if (opcode == 0x3E) { /* DS segment override. */
-    i8088_trace_op_seg_override("ds");
-    cpu->segment_override = SEGMENT_DS;
-    opcode = fetch(cpu, mem);
-  } else if (opcode == 0xF0) { /* LOCK */
-    panic("LOCK not implemented!\n");
-    opcode = fetch(cpu, mem);
-  }
+static void i8088_opcode_04(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
 
-  if (opcode == 0xF2) { /* REPNE/REPNZ */
-    i8088_trace_op_prefix("repne");
-    cpu->repeat = REPEAT_NENZ;
-    opcode = fetch(cpu, mem);
-  } else if (opcode == 0xF3) { /* REPE/REPZ */
-    i8088_trace_op_prefix("repe");
-    cpu->repeat = REPEAT_EZ;
-    opcode = fetch(cpu, mem);
-  }
+  i8088_trace_op_mnemonic("add");
+  i8088_trace_op_dst(false, "al");
+  data_8  = fetch_8(cpu, mem);
+  cpu->al = i8088_add_8(cpu, cpu->ax, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
 
-  /* Variables used during opcode decoding: */
-  uint16_t offset;
-  uint16_t segment;
+
+
+static void i8088_opcode_05(i8088_t *cpu, mem_t *mem)
+{
   uint16_t data_16;
-  uint16_t eaddr;
-  uint8_t data_8;
-  uint8_t modrm;
-  int8_t disp;
 
-  /* Opcode: */
-  switch (opcode) {
-  case 0x00: /* ADD */
-    i8088_trace_op_mnemonic("add");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
-      i8088_add_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
-    break;
+  i8088_trace_op_mnemonic("add");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = i8088_add_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
 
-  case 0x01: /* ADD */
-    i8088_trace_op_mnemonic("add");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
-      i8088_add_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
-    break;
 
-  case 0x02: /* ADD */
-    i8088_trace_op_mnemonic("add");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm,
-      i8088_add_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x03: /* ADD */
-    i8088_trace_op_mnemonic("add");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm,
-      i8088_add_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
-    break;
+static void i8088_opcode_06(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "es");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->es);
+}
 
-  case 0x04: /* ADD AL,imm */
-    i8088_trace_op_mnemonic("add");
-    i8088_trace_op_dst(false, "al");
-    data_8  = fetch(cpu, mem);
-    cpu->al = i8088_add_8(cpu, cpu->ax, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
 
-  case 0x05: /* ADD AX,imm */
-    i8088_trace_op_mnemonic("add");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = i8088_add_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
 
-  case 0x06: /* PUSH ES */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "es");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->es % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->es / 0x100);
-    break;
+static void i8088_opcode_07(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "es");
+  cpu->es = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  i8088_segment_sync(cpu);
+  cpu->sp += 2;
+}
 
-  case 0x07: /* POP ES */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "es");
-    cpu->es  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->es += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
 
-  case 0x08: /* OR */
-    i8088_trace_op_mnemonic("or");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
-      i8088_or_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
-    break;
 
-  case 0x09: /* OR */
-    i8088_trace_op_mnemonic("or");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
-      i8088_or_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
-    break;
+static void i8088_opcode_08(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
 
-  case 0x0A: /* OR */
-    i8088_trace_op_mnemonic("or");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm,
-      i8088_or_8(cpu, data_8,  modrm_get_rm_8(cpu, mem, modrm, NULL)));
-    break;
+  i8088_trace_op_mnemonic("or");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
+    i8088_or_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
+}
 
-  case 0x0B: /* OR */
-    i8088_trace_op_mnemonic("or");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm,
-      i8088_or_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x0C: /* OR AL,imm */
-    i8088_trace_op_mnemonic("or");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    cpu->al = i8088_or_8(cpu, cpu->al, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
 
-  case 0x0D: /* OR AX,imm */
-    i8088_trace_op_mnemonic("or");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = i8088_or_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
+static void i8088_opcode_09(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
 
-  case 0x0E: /* PUSH CS */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "cs");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->cs % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->cs / 0x100);
-    break;
+  i8088_trace_op_mnemonic("or");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
+    i8088_or_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
+}
 
-  case 0x0F: /* POP CS */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "cs");
-    cpu->cs  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->cs += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
 
-  case 0x10: /* ADC */
-    i8088_trace_op_mnemonic("adc");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
-      i8088_adc_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
-    break;
 
-  case 0x11: /* ADC */
-    i8088_trace_op_mnemonic("adc");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
-      i8088_adc_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
-    break;
+static void i8088_opcode_0a(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+  uint8_t modrm;
 
-  case 0x12: /* ADC */
-    i8088_trace_op_mnemonic("adc");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm,
-      i8088_adc_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
-    break;
+  i8088_trace_op_mnemonic("or");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm,
+    i8088_or_8(cpu, data_8,  modrm_get_rm_8(cpu, mem, modrm, NULL)));
+}
 
-  case 0x13: /* ADC */
-    i8088_trace_op_mnemonic("adc");
-    modrm = fetch(cpu, mem);
-    data_16 =  modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm,
-      i8088_adc_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x14: /* ADC AL,imm */
-    i8088_trace_op_mnemonic("adc");
-    i8088_trace_op_dst(false, "al");
-    data_8  = fetch(cpu, mem);
-    cpu->al = i8088_adc_8(cpu, cpu->ax, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
 
-  case 0x15: /* ADC AX,imm */
-    i8088_trace_op_mnemonic("adc");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = i8088_adc_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
+static void i8088_opcode_0b(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint8_t modrm;
 
-  case 0x16: /* PUSH SS */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "ss");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ss % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ss / 0x100);
-    break;
+  i8088_trace_op_mnemonic("or");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm,
+    i8088_or_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
+}
 
-  case 0x17: /* POP SS */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "ss");
-    data_16  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    data_16 += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    cpu->ss = data_16;
-    break;
 
-  case 0x18: /* SBB */
-    i8088_trace_op_mnemonic("sbb");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
-      i8088_sbb_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
-    break;
 
-  case 0x19: /* SBB */
-    i8088_trace_op_mnemonic("sbb");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
-      i8088_sbb_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
-    break;
+static void i8088_opcode_0c(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
 
-  case 0x1A: /* SBB */
-    i8088_trace_op_mnemonic("sbb");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm,
-      i8088_sbb_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
-    break;
+  i8088_trace_op_mnemonic("or");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  cpu->al = i8088_or_8(cpu, cpu->al, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
 
-  case 0x1B: /* SBB */
-    i8088_trace_op_mnemonic("sbb");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm,
-      i8088_sbb_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x1C: /* SBB AL,imm */
-    i8088_trace_op_mnemonic("sbb");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    cpu->al = i8088_sbb_8(cpu, cpu->al, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
 
-  case 0x1D: /* SBB AX,imm */
-    i8088_trace_op_mnemonic("sbb");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = i8088_sbb_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
+static void i8088_opcode_0d(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
 
-  case 0x1E: /* PUSH DS */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "ds");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ds % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ds / 0x100);
-    break;
+  i8088_trace_op_mnemonic("or");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = i8088_or_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
 
-  case 0x1F: /* POP DS */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "ds");
-    cpu->ds  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->ds += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
 
-  case 0x20: /* AND */
-    i8088_trace_op_mnemonic("and");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
-      i8088_and_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
-    break;
 
-  case 0x21: /* AND */
-    i8088_trace_op_mnemonic("and");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
-      i8088_and_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
-    break;
+static void i8088_opcode_0e(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "cs");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->cs);
+}
 
-  case 0x22: /* AND */
-    i8088_trace_op_mnemonic("and");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm,
-      i8088_and_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x23: /* AND */
-    i8088_trace_op_mnemonic("and");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm,
-      i8088_and_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x24: /* AND AL,imm */
-    i8088_trace_op_mnemonic("and");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    cpu->al = i8088_and_8(cpu, cpu->al, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
+static void i8088_opcode_0f(i8088_t *cpu, mem_t *mem)
+{
+  if (cpu->v20) {
+    /* Prefix for the NEC specific instructions instead. */
+    panic("Unhandled V20 opcode: 0x0f 0x%02x\n", fetch_8(cpu, mem));
+    return;
+  }
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "cs");
+  cpu->cs = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  i8088_segment_sync(cpu);
+  cpu->far_transfer = true;
+  cpu->sp += 2;
+}
 
-  case 0x25: /* AND AX,imm */
-    i8088_trace_op_mnemonic("and");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = i8088_and_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
 
-  case 0x26:
-    goto i8088_execute_segment_override;
 
-  case 0x27: /* DAA */
-    i8088_trace_op_mnemonic("daa");
-    i8088_daa(cpu);
-    break;
+static void i8088_opcode_10(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
 
-  case 0x28: /* SUB */
-    i8088_trace_op_mnemonic("sub");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
-      i8088_sub_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
-    break;
+  i8088_trace_op_mnemonic("adc");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
+    i8088_adc_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
+}
 
-  case 0x29: /* SUB */
-    i8088_trace_op_mnemonic("sub");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
-      i8088_sub_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
-    break;
 
-  case 0x2A: /* SUB */
-    i8088_trace_op_mnemonic("sub");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm,
-      i8088_sub_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x2B: /* SUB */
-    i8088_trace_op_mnemonic("sub");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm,
-      i8088_sub_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
-    break;
+static void i8088_opcode_11(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
 
-  case 0x2C: /* SUB AL,imm */
-    i8088_trace_op_mnemonic("sub");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    cpu->al = i8088_sub_8(cpu, cpu->al, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
+  i8088_trace_op_mnemonic("adc");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
+    i8088_adc_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
+}
 
-  case 0x2D: /* SUB AX,imm */
-    i8088_trace_op_mnemonic("sub");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = i8088_sub_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
 
-  case 0x2E:
-    goto i8088_execute_segment_override;
 
-  case 0x2F: /* DAS */
-    i8088_trace_op_mnemonic("das");
-    i8088_das(cpu);
-    break;
+static void i8088_opcode_12(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+  uint8_t modrm;
 
-  case 0x30: /* XOR */
-    i8088_trace_op_mnemonic("xor");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
-      i8088_xor_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
-    break;
+  i8088_trace_op_mnemonic("adc");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm,
+    i8088_adc_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
+}
 
-  case 0x31: /* XOR */
-    i8088_trace_op_mnemonic("xor");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
-      i8088_xor_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
-    break;
 
-  case 0x32: /* XOR */
-    i8088_trace_op_mnemonic("xor");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm,
-      i8088_xor_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
-    break;
 
-  case 0x33: /* XOR */
-    i8088_trace_op_mnemonic("xor");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm,
-      i8088_xor_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
-    break;
+static void i8088_opcode_13(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint8_t modrm;
 
-  case 0x34: /* XOR AL,imm */
-    i8088_trace_op_mnemonic("xor");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    cpu->al = i8088_xor_8(cpu, cpu->al, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
+  i8088_trace_op_mnemonic("adc");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 =  modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm,
+    i8088_adc_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
+}
 
-  case 0x35: /* XOR AX,imm */
-    i8088_trace_op_mnemonic("xor");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = i8088_xor_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
 
-  case 0x36:
-    goto i8088_execute_segment_override;
 
-  case 0x37: /* AAA */
-    i8088_trace_op_mnemonic("aaa");
-    i8088_aaa(cpu);
-    break;
+static void i8088_opcode_14(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
 
-  case 0x38: /* CMP */
-    i8088_trace_op_mnemonic("cmp");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    i8088_cmp_8(cpu, data_8, modrm_get_reg_8(cpu, modrm));
-    i8088_trace_op_dst_modrm_rm(modrm, 8);
-    break;
+  i8088_trace_op_mnemonic("adc");
+  i8088_trace_op_dst(false, "al");
+  data_8  = fetch_8(cpu, mem);
+  cpu->al = i8088_adc_8(cpu, cpu->ax, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
 
-  case 0x39: /* CMP */
-    i8088_trace_op_mnemonic("cmp");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    i8088_cmp_16(cpu, data_16, modrm_get_reg_16(cpu, modrm));
-    i8088_trace_op_dst_modrm_rm(modrm, 16);
-    break;
 
-  case 0x3A: /* CMP */
-    i8088_trace_op_mnemonic("cmp");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    i8088_cmp_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL));
-    i8088_trace_op_dst_modrm_reg(modrm, 8);
-    break;
 
-  case 0x3B: /* CMP */
-    i8088_trace_op_mnemonic("cmp");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    i8088_cmp_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL));
-    i8088_trace_op_dst_modrm_reg(modrm, 16);
-    break;
+static void i8088_opcode_15(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
 
-  case 0x3C: /* CMP AL,imm */
-    i8088_trace_op_mnemonic("cmp");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    i8088_cmp_8(cpu, cpu->al, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
+  i8088_trace_op_mnemonic("adc");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = i8088_adc_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
 
-  case 0x3D: /* CMP AX,imm */
-    i8088_trace_op_mnemonic("cmp");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    i8088_cmp_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
 
-  case 0x3E:
-    goto i8088_execute_segment_override;
 
-  case 0x3F: /* AAS */
-    i8088_trace_op_mnemonic("aas");
-    i8088_aas(cpu);
-    break;
+static void i8088_opcode_16(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "ss");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ss);
+}
 
-  case 0x40: /* INC AX */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "ax");
-    cpu->ax = i8088_inc_16(cpu, cpu->ax);
-    break;
 
-  case 0x41: /* INC CX */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "cx");
-    cpu->cx = i8088_inc_16(cpu, cpu->cx);
-    break;
 
-  case 0x42: /* INC DX */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "dx");
-    cpu->dx = i8088_inc_16(cpu, cpu->dx);
-    break;
+static void i8088_opcode_17(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
 
-  case 0x43: /* INC BX */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "bx");
-    cpu->bx = i8088_inc_16(cpu, cpu->bx);
-    break;
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "ss");
+  data_16 = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+  cpu->ss = data_16;
+  i8088_segment_sync(cpu);
+}
 
-  case 0x44: /* INC SP */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "sp");
-    cpu->sp = i8088_inc_16(cpu, cpu->sp);
-    break;
 
-  case 0x45: /* INC BP */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "bp");
-    cpu->bp = i8088_inc_16(cpu, cpu->bp);
-    break;
 
-  case 0x46: /* INC SI */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "si");
-    cpu->si = i8088_inc_16(cpu, cpu->si);
-    break;
+static void i8088_opcode_18(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
 
-  case 0x47: /* INC DI */
-    i8088_trace_op_mnemonic("inc");
-    i8088_trace_op_dst(false, "di");
-    cpu->di = i8088_inc_16(cpu, cpu->di);
-    break;
+  i8088_trace_op_mnemonic("sbb");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
+    i8088_sbb_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
+}
 
-  case 0x48: /* DEC AX */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "ax");
-    cpu->ax = i8088_dec_16(cpu, cpu->ax);
-    break;
 
-  case 0x49: /* DEC CX */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "cx");
-    cpu->cx = i8088_dec_16(cpu, cpu->cx);
-    break;
 
-  case 0x4A: /* DEC DX */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "dx");
-    cpu->dx = i8088_dec_16(cpu, cpu->dx);
-    break;
+static void i8088_opcode_19(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
 
-  case 0x4B: /* DEC BX */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "bx");
-    cpu->bx = i8088_dec_16(cpu, cpu->bx);
-    break;
+  i8088_trace_op_mnemonic("sbb");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
+    i8088_sbb_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
+}
 
-  case 0x4C: /* DEC SP */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "sp");
-    cpu->sp = i8088_dec_16(cpu, cpu->sp);
-    break;
 
-  case 0x4D: /* DEC BP */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "bp");
-    cpu->bp = i8088_dec_16(cpu, cpu->bp);
-    break;
 
-  case 0x4E: /* DEC SI */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "si");
-    cpu->si = i8088_dec_16(cpu, cpu->si);
-    break;
+static void i8088_opcode_1a(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+  uint8_t modrm;
 
-  case 0x4F: /* DEC DI */
-    i8088_trace_op_mnemonic("dec");
-    i8088_trace_op_dst(false, "di");
-    cpu->di = i8088_dec_16(cpu, cpu->di);
-    break;
+  i8088_trace_op_mnemonic("sbb");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm,
+    i8088_sbb_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
+}
 
-  case 0x50: /* PUSH AX */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "ax");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ax % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ax / 0x100);
-    break;
 
-  case 0x51: /* PUSH CX */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "cx");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->cx % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->cx / 0x100);
-    break;
 
-  case 0x52: /* PUSH DX */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "dx");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->dx % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->dx / 0x100);
-    break;
+static void i8088_opcode_1b(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint8_t modrm;
 
-  case 0x53: /* PUSH BX */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "bx");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->bx % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->bx / 0x100);
-    break;
+  i8088_trace_op_mnemonic("sbb");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm,
+    i8088_sbb_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
+}
 
-  case 0x54: /* PUSH SP */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "sp");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->sp % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->sp / 0x100);
-    break;
 
-  case 0x55: /* PUSH BP */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "bp");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->bp % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->bp / 0x100);
-    break;
 
-  case 0x56: /* PUSH SI */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "si");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->si % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->si / 0x100);
-    break;
+static void i8088_opcode_1c(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
 
-  case 0x57: /* PUSH DI */
-    i8088_trace_op_mnemonic("push");
-    i8088_trace_op_dst(false, "di");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->di % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->di / 0x100);
-    break;
+  i8088_trace_op_mnemonic("sbb");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  cpu->al = i8088_sbb_8(cpu, cpu->al, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
 
-  case 0x58: /* POP AX */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "ax");
-    cpu->ax  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->ax += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
 
-  case 0x59: /* POP CX */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "cx");
-    cpu->cx  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->cx += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
 
-  case 0x5A: /* POP DX */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "dx");
-    cpu->dx  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->dx += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
+static void i8088_opcode_1d(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
 
-  case 0x5B: /* POP BX */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "bx");
-    cpu->bx  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->bx += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
+  i8088_trace_op_mnemonic("sbb");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = i8088_sbb_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
 
-  case 0x5C: /* POP SP */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "sp");
-    data_16  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    data_16 += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp = data_16;
-    break;
 
-  case 0x5D: /* POP BP */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "bp");
-    cpu->bp  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->bp += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
 
-  case 0x5E: /* POP SI */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "si");
-    cpu->si  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->si += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
+static void i8088_opcode_1e(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "ds");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ds);
+}
 
-  case 0x5F: /* POP DI */
-    i8088_trace_op_mnemonic("pop");
-    i8088_trace_op_dst(false, "di");
-    cpu->di  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->di += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
 
-  case 0x70: /* JO */
-    i8088_trace_op_mnemonic("jo");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->o == 1) {
-      cpu->ip = cpu->ip + disp;
-    }
-    break;
 
-  case 0x71: /* JNO */
-    i8088_trace_op_mnemonic("jno");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->o == 0) {
-      cpu->ip = cpu->ip + disp;
-    }
-    break;
+static void i8088_opcode_1f(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "ds");
+  cpu->ds = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  i8088_segment_sync(cpu);
+  cpu->sp += 2;
+}
 
-  case 0x72: /* JB/JNAE/JC */
-    i8088_trace_op_mnemonic("jb");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->c == 1) {
-      cpu->ip = cpu->ip + disp;
-    }
-    break;
 
-  case 0x73: /* JNB/JAE/JNC */
-    i8088_trace_op_mnemonic("jnb");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->c == 0) {
-      cpu->ip = cpu->ip + disp;
-    }
-    break;
 
-  case 0x74: /* JZ/JE */
-    i8088_trace_op_mnemonic("jz");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->z == 1) {
-      cpu->ip = cpu->ip + disp;
-    }
-    break;
+static void i8088_opcode_20(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("and");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
+    i8088_and_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
+}
+
+
+
+static void i8088_opcode_21(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("and");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
+    i8088_and_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
+}
+
+
+
+static void i8088_opcode_22(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("and");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm,
+    i8088_and_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
+}
+
+
+
+static void i8088_opcode_23(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("and");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm,
+    i8088_and_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
+}
+
+
+
+static void i8088_opcode_24(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("and");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  cpu->al = i8088_and_8(cpu, cpu->al, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_25(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("and");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = i8088_and_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_26(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_seg_override("es");
+  segment_override_set(cpu, SEGMENT_ES);
+  i8088_dispatch(cpu, mem, fetch(cpu, mem));
+}
+
+
+
+static void i8088_opcode_27(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("daa");
+  i8088_daa(cpu);
+}
+
+
+
+static void i8088_opcode_28(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("sub");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
+    i8088_sub_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
+}
+
+
+
+static void i8088_opcode_29(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("sub");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
+    i8088_sub_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
+}
+
+
+
+static void i8088_opcode_2a(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("sub");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm,
+    i8088_sub_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
+}
+
+
+
+static void i8088_opcode_2b(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("sub");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm,
+    i8088_sub_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
+}
+
+
+
+static void i8088_opcode_2c(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("sub");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  cpu->al = i8088_sub_8(cpu, cpu->al, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_2d(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("sub");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = i8088_sub_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_2e(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_seg_override("cs");
+  segment_override_set(cpu, SEGMENT_CS);
+  i8088_dispatch(cpu, mem, fetch(cpu, mem));
+}
+
+
+
+static void i8088_opcode_2f(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("das");
+  i8088_das(cpu);
+}
+
+
+
+static void i8088_opcode_30(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("xor");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr,
+    i8088_xor_8(cpu, data_8, modrm_get_reg_8(cpu, modrm)));
+}
+
+
+
+static void i8088_opcode_31(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("xor");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr,
+    i8088_xor_16(cpu, data_16, modrm_get_reg_16(cpu, modrm)));
+}
+
+
+
+static void i8088_opcode_32(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("xor");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm,
+    i8088_xor_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL)));
+}
+
+
+
+static void i8088_opcode_33(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("xor");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm,
+    i8088_xor_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL)));
+}
+
+
+
+static void i8088_opcode_34(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("xor");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  cpu->al = i8088_xor_8(cpu, cpu->al, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_35(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xor");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = i8088_xor_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_36(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_seg_override("ss");
+  segment_override_set(cpu, SEGMENT_SS);
+  i8088_dispatch(cpu, mem, fetch(cpu, mem));
+}
+
+
+
+static void i8088_opcode_37(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("aaa");
+  i8088_aaa(cpu);
+}
+
+
+
+static void i8088_opcode_38(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("cmp");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  i8088_cmp_8(cpu, data_8, modrm_get_reg_8(cpu, modrm));
+  i8088_trace_op_dst_modrm_rm(modrm, 8);
+}
+
+
+
+static void i8088_opcode_39(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("cmp");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  i8088_cmp_16(cpu, data_16, modrm_get_reg_16(cpu, modrm));
+  i8088_trace_op_dst_modrm_rm(modrm, 16);
+}
+
+
+
+static void i8088_opcode_3a(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("cmp");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  i8088_cmp_8(cpu, data_8, modrm_get_rm_8(cpu, mem, modrm, NULL));
+  i8088_trace_op_dst_modrm_reg(modrm, 8);
+}
+
+
+
+static void i8088_opcode_3b(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("cmp");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  i8088_cmp_16(cpu, data_16, modrm_get_rm_16(cpu, mem, modrm, NULL));
+  i8088_trace_op_dst_modrm_reg(modrm, 16);
+}
+
+
+
+static void i8088_opcode_3c(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("cmp");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  i8088_cmp_8(cpu, cpu->al, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_3d(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("cmp");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  i8088_cmp_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_3e(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_seg_override("ds");
+  segment_override_set(cpu, SEGMENT_DS);
+  i8088_dispatch(cpu, mem, fetch(cpu, mem));
+}
+
+
+
+static void i8088_opcode_3f(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("aas");
+  i8088_aas(cpu);
+}
+
+
+
+static void i8088_opcode_40(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "ax");
+  cpu->ax = i8088_inc_16(cpu, cpu->ax);
+}
+
+
+
+static void i8088_opcode_41(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "cx");
+  cpu->cx = i8088_inc_16(cpu, cpu->cx);
+}
+
+
+
+static void i8088_opcode_42(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "dx");
+  cpu->dx = i8088_inc_16(cpu, cpu->dx);
+}
+
+
+
+static void i8088_opcode_43(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "bx");
+  cpu->bx = i8088_inc_16(cpu, cpu->bx);
+}
+
+
+
+static void i8088_opcode_44(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "sp");
+  cpu->sp = i8088_inc_16(cpu, cpu->sp);
+}
+
+
+
+static void i8088_opcode_45(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "bp");
+  cpu->bp = i8088_inc_16(cpu, cpu->bp);
+}
+
+
+
+static void i8088_opcode_46(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "si");
+  cpu->si = i8088_inc_16(cpu, cpu->si);
+}
+
+
+
+static void i8088_opcode_47(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("inc");
+  i8088_trace_op_dst(false, "di");
+  cpu->di = i8088_inc_16(cpu, cpu->di);
+}
+
+
+
+static void i8088_opcode_48(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "ax");
+  cpu->ax = i8088_dec_16(cpu, cpu->ax);
+}
+
+
+
+static void i8088_opcode_49(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "cx");
+  cpu->cx = i8088_dec_16(cpu, cpu->cx);
+}
+
+
+
+static void i8088_opcode_4a(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "dx");
+  cpu->dx = i8088_dec_16(cpu, cpu->dx);
+}
+
+
+
+static void i8088_opcode_4b(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "bx");
+  cpu->bx = i8088_dec_16(cpu, cpu->bx);
+}
+
+
+
+static void i8088_opcode_4c(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "sp");
+  cpu->sp = i8088_dec_16(cpu, cpu->sp);
+}
+
+
+
+static void i8088_opcode_4d(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "bp");
+  cpu->bp = i8088_dec_16(cpu, cpu->bp);
+}
+
+
+
+static void i8088_opcode_4e(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "si");
+  cpu->si = i8088_dec_16(cpu, cpu->si);
+}
+
+
+
+static void i8088_opcode_4f(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("dec");
+  i8088_trace_op_dst(false, "di");
+  cpu->di = i8088_dec_16(cpu, cpu->di);
+}
+
+
+
+static void i8088_opcode_50(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "ax");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ax);
+}
+
+
+
+static void i8088_opcode_51(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "cx");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->cx);
+}
+
+
+
+static void i8088_opcode_52(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "dx");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->dx);
+}
+
+
+
+static void i8088_opcode_53(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "bx");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->bx);
+}
+
+
+
+static void i8088_opcode_54(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "sp");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->sp);
+}
+
+
+
+static void i8088_opcode_55(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "bp");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->bp);
+}
+
+
+
+static void i8088_opcode_56(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "si");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->si);
+}
+
+
+
+static void i8088_opcode_57(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("push");
+  i8088_trace_op_dst(false, "di");
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->di);
+}
+
+
+
+static void i8088_opcode_58(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "ax");
+  cpu->ax = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_59(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "cx");
+  cpu->cx = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_5a(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "dx");
+  cpu->dx = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_5b(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "bx");
+  cpu->bx = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_5c(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "sp");
+  data_16 = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp = data_16;
+}
+
+
+
+static void i8088_opcode_5d(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "bp");
+  cpu->bp = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_5e(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "si");
+  cpu->si = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_5f(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pop");
+  i8088_trace_op_dst(false, "di");
+  cpu->di = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_60(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t sp;
+
+  if (! v20_opcode(cpu, 0x60)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("pusha");
+  sp = cpu->sp;
+  i8088_push_16(cpu, mem, cpu->ax);
+  i8088_push_16(cpu, mem, cpu->cx);
+  i8088_push_16(cpu, mem, cpu->dx);
+  i8088_push_16(cpu, mem, cpu->bx);
+  i8088_push_16(cpu, mem, sp);
+  i8088_push_16(cpu, mem, cpu->bp);
+  i8088_push_16(cpu, mem, cpu->si);
+  i8088_push_16(cpu, mem, cpu->di);
+}
+
+
+
+static void i8088_opcode_61(i8088_t *cpu, mem_t *mem)
+{
+  if (! v20_opcode(cpu, 0x61)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("popa");
+  cpu->di = i8088_pop_16(cpu, mem);
+  cpu->si = i8088_pop_16(cpu, mem);
+  cpu->bp = i8088_pop_16(cpu, mem);
+  (void)i8088_pop_16(cpu, mem); /* SP is skipped. */
+  cpu->bx = i8088_pop_16(cpu, mem);
+  cpu->dx = i8088_pop_16(cpu, mem);
+  cpu->cx = i8088_pop_16(cpu, mem);
+  cpu->ax = i8088_pop_16(cpu, mem);
+}
+
+
+
+static void i8088_opcode_62(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t modrm;
+  int16_t lower;
+  int16_t upper;
+  int16_t index;
+
+  if (! v20_opcode(cpu, 0x62)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("bound");
+  modrm = fetch_modrm(cpu, mem);
+  index = modrm_get_reg_16(cpu, modrm);
+  lower = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  upper = modrm_get_rm_eaddr_16(cpu, mem, modrm, eaddr+2);
+  i8088_trace_op_dst_modrm_reg(modrm, 16);
+  i8088_trace_op_bit_size(32);
+  if (index < lower || index > upper) {
+    i8088_interrupt(cpu, mem, INT_BOUND);
+  }
+}
+
+
+
+static void i8088_opcode_68(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  if (! v20_opcode(cpu, 0x68)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("push");
+  data_16 = fetch_16(cpu, mem);
+  i8088_push_16(cpu, mem, data_16);
+  i8088_trace_op_dst(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_69(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t value;
+  uint8_t modrm;
+
+  if (! v20_opcode(cpu, 0x69)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("imul");
+  modrm = fetch_modrm(cpu, mem);
+  value = modrm_get_rm_16(cpu, mem, modrm, NULL);
+  data_16 = fetch_16(cpu, mem);
+  modrm_set_reg_16(cpu, modrm, i8088_imul_16_imm(cpu, value, data_16));
+}
+
+
+
+static void i8088_opcode_6a(i8088_t *cpu, mem_t *mem)
+{
+  int8_t data;
+
+  if (! v20_opcode(cpu, 0x6A)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("push");
+  data = fetch_8(cpu, mem);
+  i8088_push_16(cpu, mem, data);
+  i8088_trace_op_dst(false, FMT_N, data);
+}
+
+
+
+static void i8088_opcode_6b(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t value;
+  uint8_t modrm;
+  int8_t data;
+
+  if (! v20_opcode(cpu, 0x6B)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("imul");
+  modrm = fetch_modrm(cpu, mem);
+  value = modrm_get_rm_16(cpu, mem, modrm, NULL);
+  data = fetch_8(cpu, mem);
+  modrm_set_reg_16(cpu, modrm, i8088_imul_16_imm(cpu, value, data));
+}
+
+
+
+static void i8088_opcode_6c(i8088_t *cpu, mem_t *mem)
+{
+  if (! v20_opcode(cpu, 0x6C)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("insb");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_insb(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_ins(cpu, mem, 1);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_6d(i8088_t *cpu, mem_t *mem)
+{
+  if (! v20_opcode(cpu, 0x6D)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("insw");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_insw(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_ins(cpu, mem, 2);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_6e(i8088_t *cpu, mem_t *mem)
+{
+  if (! v20_opcode(cpu, 0x6E)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("outsb");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_outsb(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_outs(cpu, mem, 1);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_6f(i8088_t *cpu, mem_t *mem)
+{
+  if (! v20_opcode(cpu, 0x6F)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("outsw");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_outsw(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_outs(cpu, mem, 2);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_70(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jo");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->o == 1) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_71(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jno");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->o == 0) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_72(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jb");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (flags_get_c(cpu)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_73(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jnb");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (! flags_get_c(cpu)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_74(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jz");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (flags_get_z(cpu)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_75(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jnz");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (! flags_get_z(cpu)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_76(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jbe");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (flags_get_c(cpu) || flags_get_z(cpu)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_77(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jnbe");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (! flags_get_c(cpu) && ! flags_get_z(cpu)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_78(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("js");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->s == 1) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_79(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jns");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->s == 0) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_7a(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jp");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->p == 1) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_7b(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jnp");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->p == 0) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_7c(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jl");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->s != cpu->o) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_7d(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jnl");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->s == cpu->o) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_7e(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jle");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if ((cpu->z == 1) || (cpu->s != cpu->o)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_7f(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jnle");
+  flags_sync(cpu);
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if ((cpu->z == 0) && (cpu->s == cpu->o)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_84(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("test");
+  modrm = fetch_modrm(cpu, mem);
+  (void)i8088_and_8(cpu,
+    modrm_get_reg_8(cpu, modrm),
+    modrm_get_rm_8(cpu, mem, modrm, NULL));
+  i8088_trace_op_dst_modrm_rm(modrm, 8);
+}
+
+
+
+static void i8088_opcode_85(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("test");
+  modrm = fetch_modrm(cpu, mem);
+  (void)i8088_and_16(cpu,
+    modrm_get_reg_16(cpu, modrm),
+    modrm_get_rm_16(cpu, mem, modrm, NULL));
+  i8088_trace_op_dst_modrm_rm(modrm, 16);
+}
+
+
+
+static void i8088_opcode_86(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("xchg");
+  modrm = fetch_modrm(cpu, mem);
+  data_8 = modrm_get_reg_8(cpu, modrm);
+  modrm_set_reg_8(cpu, modrm, modrm_get_rm_8(cpu, mem, modrm, &eaddr));
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr, data_8);
+  i8088_trace_op_dst_modrm_reg(modrm, 8);
+}
+
+
+
+static void i8088_opcode_87(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("xchg");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_reg_16(cpu, modrm);
+  modrm_set_reg_16(cpu, modrm, modrm_get_rm_16(cpu, mem, modrm, &eaddr));
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, data_16);
+  i8088_trace_op_dst_modrm_reg(modrm, 16);
+}
+
+
+
+static void i8088_opcode_88(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  modrm_set_rm_8(cpu, mem, modrm, modrm_get_reg_8(cpu, modrm));
+}
+
+
+
+static void i8088_opcode_89(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  modrm_set_rm_16(cpu, mem, modrm, modrm_get_reg_16(cpu, modrm));
+}
+
+
+
+static void i8088_opcode_8a(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  modrm_set_reg_8(cpu, modrm, modrm_get_rm_8(cpu, mem, modrm, NULL));
+}
+
+
+
+static void i8088_opcode_8b(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  modrm_set_reg_16(cpu, modrm, modrm_get_rm_16(cpu, mem, modrm, NULL));
+}
+
+
+
+static void i8088_opcode_8c(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  modrm_set_rm_16(cpu, mem, modrm, modrm_get_reg_seg(cpu, modrm));
+}
+
+
+
+static void i8088_opcode_8d(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("lea");
+  modrm = fetch_modrm(cpu, mem);
+  (void)modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_reg_16(cpu, modrm, eaddr);
+  i8088_trace_op_bit_size(0);
+}
+
+
+
+static void i8088_opcode_8e(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  modrm_set_reg_seg(cpu, modrm, modrm_get_rm_16(cpu, mem, modrm, NULL));
+}
+
+
+
+static void i8088_opcode_8f(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("pop");
+  modrm = fetch_modrm(cpu, mem);
+  (void)modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  data_16 = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, data_16);
+  i8088_trace_op_src(false, "");
+}
+
+
+
+static void i8088_opcode_90(i8088_t *cpu, mem_t *mem)
+{
+  (void)cpu;
+  (void)mem;
+  i8088_trace_op_mnemonic("nop");
+}
+
+
+
+static void i8088_opcode_91(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xchg");
+  i8088_trace_op_dst(false, "cx");
+  i8088_trace_op_src(false, "ax");
+  data_16 = cpu->ax;
+  cpu->ax = cpu->cx;
+  cpu->cx = data_16;
+}
+
+
+
+static void i8088_opcode_92(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xchg");
+  i8088_trace_op_dst(false, "dx");
+  i8088_trace_op_src(false, "ax");
+  data_16 = cpu->ax;
+  cpu->ax = cpu->dx;
+  cpu->dx = data_16;
+}
+
+
+
+static void i8088_opcode_93(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xchg");
+  i8088_trace_op_dst(false, "bx");
+  i8088_trace_op_src(false, "ax");
+  data_16 = cpu->ax;
+  cpu->ax = cpu->bx;
+  cpu->bx = data_16;
+}
+
+
+
+static void i8088_opcode_94(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xchg");
+  i8088_trace_op_dst(false, "sp");
+  i8088_trace_op_src(false, "ax");
+  data_16 = cpu->ax;
+  cpu->ax = cpu->sp;
+  cpu->sp = data_16;
+}
+
+
+
+static void i8088_opcode_95(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xchg");
+  i8088_trace_op_dst(false, "bp");
+  i8088_trace_op_src(false, "ax");
+  data_16 = cpu->ax;
+  cpu->ax = cpu->bp;
+  cpu->bp = data_16;
+}
+
+
+
+static void i8088_opcode_96(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xchg");
+  i8088_trace_op_dst(false, "si");
+  i8088_trace_op_src(false, "ax");
+  data_16 = cpu->ax;
+  cpu->ax = cpu->si;
+  cpu->si = data_16;
+}
+
+
+
+static void i8088_opcode_97(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("xchg");
+  i8088_trace_op_dst(false, "di");
+  i8088_trace_op_src(false, "ax");
+  data_16 = cpu->ax;
+  cpu->ax = cpu->di;
+  cpu->di = data_16;
+}
+
+
+
+static void i8088_opcode_98(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("cbw");
+  if (cpu->al < 0x80) {
+    cpu->ah = 0;
+  } else {
+    cpu->ah = 0xFF;
+  }
+}
+
+
+
+static void i8088_opcode_99(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("cwd");
+  if (cpu->ax < 0x8000) {
+    cpu->dx = 0;
+  } else {
+    cpu->dx = 0xFFFF;
+  }
+}
+
+
+
+static void i8088_opcode_9a(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t offset;
+  uint16_t segment;
+
+  i8088_trace_op_mnemonic("callf");
+  offset = fetch_16(cpu, mem);
+  segment = fetch_16(cpu, mem);
+  cpu->sp -= 4;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ip);
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp+2, cpu->cs);
+  cpu->ip = offset;
+  cpu->cs = segment;
+  i8088_segment_sync(cpu);
+  cpu->far_transfer = true;
+  callgraph_hook_call(cpu);
+  i8088_trace_op_dst(false, FMT_S ":" FMT_S, segment, offset);
+}
+
+
+
+static void i8088_opcode_9b(i8088_t *cpu, mem_t *mem)
+{
+  (void)cpu;
+  (void)mem;
+  i8088_trace_op_mnemonic("wait");
+  /* The 8087 finishes each instruction before the next one is fetched,
+     so the TEST input is never busy. */
+}
+
+
+
+static void i8088_opcode_9c(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("pushf");
+  flags_sync(cpu);
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->flags);
+}
+
+
+
+static void i8088_opcode_9d(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("popf");
+  flags_sync(cpu);
+  cpu->flags = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+  cpu->flags |=  0b1111000000000010; /* Set some unused flags. */
+  cpu->flags &= ~0b0000000000101000; /* Reset some unused flags. */
+}
+
+
+
+static void i8088_opcode_9e(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("sahf");
+  flags_sync(cpu);
+  cpu->s = (cpu->ah >> 7) & 1;
+  cpu->z = (cpu->ah >> 6) & 1;
+  cpu->a = (cpu->ah >> 4) & 1;
+  cpu->p = (cpu->ah >> 2) & 1;
+  cpu->c =  cpu->ah       & 1;
+}
+
+
+
+static void i8088_opcode_9f(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("lahf");
+  flags_sync(cpu);
+  cpu->ah = (cpu->s << 7) |
+            (cpu->z << 6) |
+            (cpu->a << 4) |
+            (cpu->p << 2) |
+            (     1 << 1) |
+            (cpu->c);
+}
+
+
+
+static void i8088_opcode_a0(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+
+  i8088_trace_op_mnemonic("mov");
+  eaddr = fetch_16(cpu, mem);
+  cpu->al = eaddr_read_8(mem, cpu->eaddr_ds_base, eaddr, NULL);
+  i8088_trace_op_bit_size(8);
+  i8088_trace_op_seg_default("ds");
+  i8088_trace_op_dst(false, "al");
+  i8088_trace_op_src(true, FMT_U, eaddr);
+}
+
+
+
+static void i8088_opcode_a1(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+
+  i8088_trace_op_mnemonic("mov");
+  eaddr = fetch_16(cpu, mem);
+  cpu->ax = eaddr_read_16(mem, cpu->eaddr_ds_base, eaddr, NULL);
+  i8088_trace_op_bit_size(16);
+  i8088_trace_op_seg_default("ds");
+  i8088_trace_op_dst(false, "ax");
+  i8088_trace_op_src(true, FMT_U, eaddr);
+}
+
+
+
+static void i8088_opcode_a2(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+
+  i8088_trace_op_mnemonic("mov");
+  eaddr = fetch_16(cpu, mem);
+  eaddr_write_8(mem, cpu->eaddr_ds_base, eaddr, cpu->al);
+  i8088_trace_op_bit_size(8);
+  i8088_trace_op_seg_default("ds");
+  i8088_trace_op_dst(true, FMT_U, eaddr);
+  i8088_trace_op_src(false, "al");
+}
+
+
+
+static void i8088_opcode_a3(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+
+  i8088_trace_op_mnemonic("mov");
+  eaddr = fetch_16(cpu, mem);
+  eaddr_write_16(mem, cpu->eaddr_ds_base, eaddr, cpu->ax);
+  i8088_trace_op_bit_size(16);
+  i8088_trace_op_seg_default("ds");
+  i8088_trace_op_dst(true, FMT_U, eaddr);
+  i8088_trace_op_src(false, "ax");
+}
+
+
+
+static void i8088_opcode_a4(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("movsb");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_movsb(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_movs(cpu, mem, 1);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_a5(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("movsw");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_movsw(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_movs(cpu, mem, 2);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_a6(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("cmpsb");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_cmpsb(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_rep_cmps(cpu, mem, 1);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_a7(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("cmpsw");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_cmpsw(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_rep_cmps(cpu, mem, 2);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_a8(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("test");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  (void)i8088_and_8(cpu, cpu->al, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_a9(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("test");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  (void)i8088_and_16(cpu, cpu->ax, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_aa(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("stosb");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_stosb(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_stos(cpu, mem, 1);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_ab(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("stosw");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_stosw(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    i8088_rep_stos(cpu, mem, 2);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_ac(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("lodsb");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_lodsb(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    while (cpu->cx != 0) {
+      i8088_lodsb(cpu, mem);
+      cpu->cx--;
+    }
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_ad(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("lodsw");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_lodsw(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_trace_op_prefix("rep");
+    while (cpu->cx != 0) {
+      i8088_lodsw(cpu, mem);
+      cpu->cx--;
+    }
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_ae(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("scasb");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_scasb(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_rep_scas(cpu, mem, 1);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_af(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("scasw");
+  switch (cpu->repeat) {
+  case REPEAT_NONE:
+    i8088_scasw(cpu, mem);
+    break;
+  case REPEAT_EZ:
+  case REPEAT_NENZ:
+    i8088_rep_scas(cpu, mem, 2);
+    break;
+  }
+}
+
+
+
+static void i8088_opcode_b0(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "al");
+  data_8 = fetch_8(cpu, mem);
+  cpu->al = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b1(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "cl");
+  data_8 = fetch_8(cpu, mem);
+  cpu->cl = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b2(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "dl");
+  data_8 = fetch_8(cpu, mem);
+  cpu->dl = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b3(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "bl");
+  data_8 = fetch_8(cpu, mem);
+  cpu->bl = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b4(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "ah");
+  data_8 = fetch_8(cpu, mem);
+  cpu->ah = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b5(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "ch");
+  data_8 = fetch_8(cpu, mem);
+  cpu->ch = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b6(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "dh");
+  data_8 = fetch_8(cpu, mem);
+  cpu->dh = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b7(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "bh");
+  data_8 = fetch_8(cpu, mem);
+  cpu->bh = data_8;
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_b8(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "ax");
+  data_16 = fetch_16(cpu, mem);
+  cpu->ax = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_b9(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "cx");
+  data_16 = fetch_16(cpu, mem);
+  cpu->cx = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_ba(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "dx");
+  data_16 = fetch_16(cpu, mem);
+  cpu->dx = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_bb(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "bx");
+  data_16 = fetch_16(cpu, mem);
+  cpu->bx = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_bc(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "sp");
+  data_16 = fetch_16(cpu, mem);
+  cpu->sp = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_bd(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "bp");
+  data_16 = fetch_16(cpu, mem);
+  cpu->bp = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_be(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "si");
+  data_16 = fetch_16(cpu, mem);
+  cpu->si = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_bf(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("mov");
+  i8088_trace_op_dst(false, "di");
+  data_16 = fetch_16(cpu, mem);
+  cpu->di = data_16;
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_c0(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+  uint16_t eaddr;
+  uint8_t value;
+  uint8_t count;
+
+  if (! v20_opcode(cpu, 0xC0)) {
+    return;
+  }
+  modrm = fetch_modrm(cpu, mem);
+  value = modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  count = fetch_8(cpu, mem);
+  value = i8088_shift_8(cpu, modrm, value, count);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr, value);
+  i8088_trace_op_src(false, FMT_U, count);
+}
+
+
+
+static void i8088_opcode_c1(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t modrm;
+  uint16_t eaddr;
+  uint16_t value;
+  uint8_t count;
+
+  if (! v20_opcode(cpu, 0xC1)) {
+    return;
+  }
+  modrm = fetch_modrm(cpu, mem);
+  value = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  count = fetch_8(cpu, mem);
+  value = i8088_shift_16(cpu, modrm, value, count);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, value);
+  i8088_trace_op_src(false, FMT_U, count);
+}
+
+
+
+static void i8088_opcode_c2(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("retn");
+  data_16 = fetch_16(cpu, mem);
+  callgraph_hook_return(cpu);
+  cpu->ip = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+  cpu->sp += data_16;
+  i8088_trace_op_dst(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_c3(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("retn");
+  callgraph_hook_return(cpu);
+  cpu->ip = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->sp += 2;
+}
+
+
+
+static void i8088_opcode_c4(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("les");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_reg_16(cpu, modrm, data_16);
+  cpu->es = modrm_get_rm_eaddr_16(cpu, mem, modrm, eaddr+2);
+  i8088_segment_sync(cpu);
+  i8088_trace_op_bit_size(32);
+}
+
+
+
+static void i8088_opcode_c5(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("lds");
+  modrm = fetch_modrm(cpu, mem);
+  data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  modrm_set_reg_16(cpu, modrm, data_16);
+  cpu->ds = modrm_get_rm_eaddr_16(cpu, mem, modrm, eaddr+2);
+  i8088_segment_sync(cpu);
+  i8088_trace_op_bit_size(32);
+}
+
+
+
+static void i8088_opcode_c6(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t eaddr;
+  uint8_t data_8;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  (void)modrm_get_rm_8(cpu, mem, modrm, &eaddr);
+  data_8 = fetch_8(cpu, mem);
+  modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr, data_8);
+  i8088_trace_op_src(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_c7(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t eaddr;
+  uint8_t modrm;
+
+  i8088_trace_op_mnemonic("mov");
+  modrm = fetch_modrm(cpu, mem);
+  (void)modrm_get_rm_16(cpu, mem, modrm, &eaddr);
+  data_16 = fetch_16(cpu, mem);
+  modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, data_16);
+  i8088_trace_op_src(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_c8(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+  uint16_t frame;
+  uint8_t level;
+  int i;
+
+  if (! v20_opcode(cpu, 0xC8)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("enter");
+  data_16 = fetch_16(cpu, mem);
+  level = fetch_8(cpu, mem) % 32;
+  i8088_push_16(cpu, mem, cpu->bp);
+  frame = cpu->sp;
+  if (level > 0) {
+    /* Copy the frame pointers of the enclosing procedures. */
+    for (i = 1; i < level; i++) {
+      cpu->bp -= 2;
+      i8088_push_16(cpu, mem, mem_read_16_by_segment(mem, cpu->ss, cpu->bp));
+    }
+    i8088_push_16(cpu, mem, frame);
+  }
+  cpu->bp = frame;
+  cpu->sp -= data_16;
+  i8088_trace_op_dst(false, FMT_U, data_16);
+  i8088_trace_op_src(false, FMT_U, level);
+}
+
+
+
+static void i8088_opcode_c9(i8088_t *cpu, mem_t *mem)
+{
+  if (! v20_opcode(cpu, 0xC9)) {
+    return;
+  }
+  i8088_trace_op_mnemonic("leave");
+  cpu->sp = cpu->bp;
+  cpu->bp = i8088_pop_16(cpu, mem);
+}
+
+
+
+static void i8088_opcode_ca(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t data_16;
+
+  i8088_trace_op_mnemonic("retf");
+  data_16 = fetch_16(cpu, mem);
+  callgraph_hook_return(cpu);
+  cpu->ip = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->cs = mem_read_16_by_segment(mem, cpu->ss, cpu->sp+2);
+  i8088_segment_sync(cpu);
+  cpu->far_transfer = true;
+  cpu->sp += 4;
+  cpu->sp += data_16;
+  i8088_trace_op_dst(false, FMT_U, data_16);
+}
+
+
+
+static void i8088_opcode_cb(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("retf");
+  callgraph_hook_return(cpu);
+  cpu->ip = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->cs = mem_read_16_by_segment(mem, cpu->ss, cpu->sp+2);
+  i8088_segment_sync(cpu);
+  cpu->far_transfer = true;
+  cpu->sp += 4;
+}
+
+
+
+static void i8088_opcode_cc(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("int3");
+  i8088_interrupt(cpu, mem, INT_1_BYTE);
+}
+
+
+
+static void i8088_opcode_cd(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("int");
+  data_8 = fetch_8(cpu, mem);
+  i8088_interrupt(cpu, mem, data_8);
+  callgraph_hook_service(cpu); /* Function in AH. */
+  i8088_trace_op_dst(false, FMT_U, data_8);
+}
+
+
+
+static void i8088_opcode_ce(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("into");
+  flags_sync(cpu);
+  if (cpu->o) {
+    i8088_interrupt(cpu, mem, INT_OVERFLOW);
+  }
+}
+
+
+
+static void i8088_opcode_cf(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("iret");
+  flags_sync(cpu);
+  callgraph_hook_return(cpu);
+  cpu->ip = mem_read_16_by_segment(mem, cpu->ss, cpu->sp);
+  cpu->cs = mem_read_16_by_segment(mem, cpu->ss, cpu->sp+2);
+  i8088_segment_sync(cpu);
+  cpu->far_transfer = true;
+  cpu->flags = mem_read_16_by_segment(mem, cpu->ss, cpu->sp+4);
+  cpu->sp += 6;
+  cpu->flags |=  0b1111000000000010; /* Set some unused flags. */
+  cpu->flags &= ~0b0000000000101000; /* Reset some unused flags. */
+}
+
+
+
+static void i8088_opcode_d0(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d0_d2(cpu, mem, 1);
+  i8088_trace_op_src(false, "");
+}
+
+
+
+static void i8088_opcode_d1(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d1_d3(cpu, mem, 1);
+  i8088_trace_op_src(false, "");
+}
+
+
+
+static void i8088_opcode_d2(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d0_d2(cpu, mem, cpu->cl);
+  i8088_trace_op_src(false, "cl");
+}
+
+
+
+static void i8088_opcode_d3(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d1_d3(cpu, mem, cpu->cl);
+  i8088_trace_op_src(false, "cl");
+}
+
+
+
+static void i8088_opcode_d4(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("aam");
+  flags_sync(cpu);
+  data_8 = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_U, data_8);
+  if (data_8 == 0) {
+    i8088_interrupt(cpu, mem, INT_DIVIDE_ERROR);
+    return;
+  }
+  cpu->ah = cpu->al / data_8;
+  cpu->al = cpu->al % data_8;
+  cpu->p = parity_even(cpu->al);
+  cpu->s = cpu->al >> 7;
+  cpu->z = cpu->al == 0;
+}
+
+
+
+static void i8088_opcode_d5(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("aad");
+  flags_sync(cpu);
+  data_8 = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_U, data_8);
+  cpu->al = (cpu->ah * data_8) + cpu->al;
+  cpu->ah = 0;
+  cpu->p = parity_even(cpu->al);
+  cpu->s = cpu->al >> 7;
+  cpu->z = cpu->al == 0;
+}
+
+
+
+static void i8088_opcode_d7(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_mnemonic("xlat");
+  cpu->al = eaddr_read_8(mem, cpu->eaddr_ds_base, cpu->bx + cpu->al, NULL);
+}
+
+
+
+static void i8088_opcode_d8_df(i8088_t *cpu, mem_t *mem, uint8_t opcode)
+{
+  modrm_t buffer;
+  const modrm_t *m;
+  uint8_t modrm;
+  uint16_t address;
+
+  modrm = fetch_modrm(cpu, mem);
+  m = modrm_lookup(modrm, &buffer);
+  i8088_trace_op_mnemonic(i8087_mnemonic(opcode, modrm));
+
+  if (! m->memory) {
+    i8088_trace_op_dst(false, "st(%d)", modrm_rm(modrm));
+    if (cpu->fpu != NULL) {
+      i8087_execute(cpu->fpu, mem, opcode, modrm, 0, 0);
+    }
+    return;
+  }
+
+  /* The operand address is needed to advance the instruction pointer
+     correctly, even with no 8087 installed. */
+  address = modrm_eaddr(cpu, mem, m);
+  i8088_trace_op_dst(true, m->name_16);
+  i8088_trace_op_seg_default(m->segment_name);
+  if (cpu->fpu != NULL) {
+    i8087_execute(cpu->fpu, mem, opcode, modrm, modrm_base(cpu, m), address);
+  }
+}
+
+
+
+static void i8088_opcode_d8(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xD8);
+}
+
+
+
+static void i8088_opcode_d9(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xD9);
+}
+
+
+
+static void i8088_opcode_da(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xDA);
+}
+
+
+
+static void i8088_opcode_db(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xDB);
+}
+
+
+
+static void i8088_opcode_dc(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xDC);
+}
+
+
+
+static void i8088_opcode_dd(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xDD);
+}
+
+
+
+static void i8088_opcode_de(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xDE);
+}
+
+
+
+static void i8088_opcode_df(i8088_t *cpu, mem_t *mem)
+{
+  i8088_opcode_d8_df(cpu, mem, 0xDF);
+}
+
+
+
+static void i8088_opcode_e0(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("loopne");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  cpu->cx--;
+  if (! flags_get_z(cpu) && (cpu->cx != 0)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_e1(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("loope");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  cpu->cx--;
+  if (flags_get_z(cpu) && (cpu->cx != 0)) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_e2(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("loop");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  cpu->cx--;
+  if (cpu->cx != 0) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_e3(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jcxz");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  if (cpu->cx == 0) {
+    cpu->ip = cpu->ip + disp;
+  }
+}
+
+
+
+static void i8088_opcode_e4(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("in");
+  data_8 = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, "al");
+  i8088_trace_op_src(false, FMT_U, data_8);
+  cpu->al = io_read(cpu->io, data_8);
+}
+
+
+
+static void i8088_opcode_e5(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("in");
+  data_8 = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, "ax");
+  i8088_trace_op_src(false, FMT_U, data_8);
+  cpu->al = io_read(cpu->io, data_8);
+  cpu->ah = io_read(cpu->io, data_8+1);
+}
+
+
+
+static void i8088_opcode_e6(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("out");
+  data_8 = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_U, data_8);
+  i8088_trace_op_src(false, "al");
+  io_write(cpu->io, data_8, cpu->al);
+}
+
+
+
+static void i8088_opcode_e7(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t data_8;
+
+  i8088_trace_op_mnemonic("out");
+  data_8 = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_U, data_8);
+  i8088_trace_op_src(false, "ax");
+  io_write(cpu->io, data_8, cpu->al);
+  io_write(cpu->io, data_8+1, cpu->ah);
+}
+
+
+
+static void i8088_opcode_e8(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t offset;
+
+  i8088_trace_op_mnemonic("call");
+  offset = fetch_16(cpu, mem);
+  cpu->sp -= 2;
+  mem_write_16_by_segment(mem, cpu->ss, cpu->sp, cpu->ip);
+  cpu->ip += offset;
+  callgraph_hook_call(cpu);
+  i8088_trace_op_dst(false, FMT_S,
+    offset + 3 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+}
+
+
+
+static void i8088_opcode_e9(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t offset;
+
+  i8088_trace_op_mnemonic("jmp");
+  offset = fetch_16(cpu, mem);
+  cpu->ip += offset;
+  i8088_trace_op_dst(false, FMT_S,
+    offset + 3 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+}
+
+
+
+static void i8088_opcode_ea(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t offset;
+  uint16_t segment;
+
+  i8088_trace_op_mnemonic("jmpf");
+  offset = fetch_16(cpu, mem);
+  segment = fetch_16(cpu, mem);
+  cpu->ip = offset;
+  cpu->cs = segment;
+  i8088_segment_sync(cpu);
+  cpu->far_transfer = true;
+  i8088_trace_op_dst(false, FMT_S ":" FMT_S, segment, offset);
+}
+
+
+
+static void i8088_opcode_eb(i8088_t *cpu, mem_t *mem)
+{
+  int8_t disp;
+
+  i8088_trace_op_mnemonic("jmp");
+  disp = fetch_8(cpu, mem);
+  i8088_trace_op_dst(false, FMT_S,
+    disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
+  cpu->ip = cpu->ip + disp;
+}
+
+
+
+static void i8088_opcode_ec(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("in");
+  i8088_trace_op_dst(false, "al");
+  i8088_trace_op_src(false, "dx");
+  cpu->al = io_read(cpu->io, cpu->dx);
+}
+
+
+
+static void i8088_opcode_ed(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("in");
+  i8088_trace_op_dst(false, "ax");
+  i8088_trace_op_src(false, "dx");
+  cpu->al = io_read(cpu->io, cpu->dx);
+  cpu->ah = io_read(cpu->io, cpu->dx+1);
+}
+
+
+
+static void i8088_opcode_ee(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("out");
+  i8088_trace_op_dst(false, "dx");
+  i8088_trace_op_src(false, "al");
+  io_write(cpu->io, cpu->dx, cpu->al);
+}
+
+
+
+static void i8088_opcode_ef(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("out");
+  i8088_trace_op_dst(false, "dx");
+  i8088_trace_op_src(false, "ax");
+  io_write(cpu->io, cpu->dx, cpu->al);
+  io_write(cpu->io, cpu->dx+1, cpu->ah);
+}
+
+
+
+static void i8088_opcode_f0(i8088_t *cpu, mem_t *mem)
+{
+  panic("LOCK not implemented!\n");
+  cpu->decode_fill = NULL;
+  i8088_dispatch(cpu, mem, fetch(cpu, mem));
+}
+
+
+
+static void i8088_opcode_f2(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_prefix("repne");
+  cpu->repeat = REPEAT_NENZ;
+  i8088_dispatch(cpu, mem, fetch(cpu, mem));
+}
+
+
+
+static void i8088_opcode_f3(i8088_t *cpu, mem_t *mem)
+{
+  i8088_trace_op_prefix("repe");
+  cpu->repeat = REPEAT_EZ;
+  i8088_dispatch(cpu, mem, fetch(cpu, mem));
+}
+
+
+
+static void i8088_opcode_f4(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("hlt");
+  cpu->halt = true;
+}
+
+
+
+static void i8088_opcode_f5(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("cmc");
+  flags_sync(cpu);
+  cpu->c = !cpu->c;
+}
 
-  case 0x75: /* JNZ/JNE */
-    i8088_trace_op_mnemonic("jnz");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->z == 0) {
-      cpu->ip = cpu->ip + disp;
-    }
-    break;
 
-  case 0x76: /* JBE/JBA */
-    i8088_trace_op_mnemonic("jbe");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->c == 1 || cpu->z == 1) {
-      cpu->ip = cpu->ip + disp;
+
+static void i8088_opcode_f8(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("clc");
+  flags_sync(cpu);
+  cpu->c = 0;
+}
+
+
+
+static void i8088_opcode_f9(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("stc");
+  flags_sync(cpu);
+  cpu->c = 1;
+}
+
+
+
+static void i8088_opcode_fa(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("cli");
+  cpu->i = 0;
+}
+
+
+
+static void i8088_opcode_fb(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("sti");
+  cpu->i = 1;
+}
+
+
+
+static void i8088_opcode_fc(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("cld");
+  cpu->d = 0;
+}
+
+
+
+static void i8088_opcode_fd(i8088_t *cpu, mem_t *mem)
+{
+  (void)mem;
+  i8088_trace_op_mnemonic("std");
+  cpu->d = 1;
+}
+
+
+
+static const i8088_opcode_t opcode_table[256] = {
+  [0x00] = i8088_opcode_00,        /* ADD */
+  [0x01] = i8088_opcode_01,        /* ADD */
+  [0x02] = i8088_opcode_02,        /* ADD */
+  [0x03] = i8088_opcode_03,        /* ADD */
+  [0x04] = i8088_opcode_04,        /* ADD AL,imm */
+  [0x05] = i8088_opcode_05,        /* ADD AX,imm */
+  [0x06] = i8088_opcode_06,        /* PUSH ES */
+  [0x07] = i8088_opcode_07,        /* POP ES */
+  [0x08] = i8088_opcode_08,        /* OR */
+  [0x09] = i8088_opcode_09,        /* OR */
+  [0x0A] = i8088_opcode_0a,        /* OR */
+  [0x0B] = i8088_opcode_0b,        /* OR */
+  [0x0C] = i8088_opcode_0c,        /* OR AL,imm */
+  [0x0D] = i8088_opcode_0d,        /* OR AX,imm */
+  [0x0E] = i8088_opcode_0e,        /* PUSH CS */
+  [0x0F] = i8088_opcode_0f,        /* POP CS */
+  [0x10] = i8088_opcode_10,        /* ADC */
+  [0x11] = i8088_opcode_11,        /* ADC */
+  [0x12] = i8088_opcode_12,        /* ADC */
+  [0x13] = i8088_opcode_13,        /* ADC */
+  [0x14] = i8088_opcode_14,        /* ADC AL,imm */
+  [0x15] = i8088_opcode_15,        /* ADC AX,imm */
+  [0x16] = i8088_opcode_16,        /* PUSH SS */
+  [0x17] = i8088_opcode_17,        /* POP SS */
+  [0x18] = i8088_opcode_18,        /* SBB */
+  [0x19] = i8088_opcode_19,        /* SBB */
+  [0x1A] = i8088_opcode_1a,        /* SBB */
+  [0x1B] = i8088_opcode_1b,        /* SBB */
+  [0x1C] = i8088_opcode_1c,        /* SBB AL,imm */
+  [0x1D] = i8088_opcode_1d,        /* SBB AX,imm */
+  [0x1E] = i8088_opcode_1e,        /* PUSH DS */
+  [0x1F] = i8088_opcode_1f,        /* POP DS */
+  [0x20] = i8088_opcode_20,        /* AND */
+  [0x21] = i8088_opcode_21,        /* AND */
+  [0x22] = i8088_opcode_22,        /* AND */
+  [0x23] = i8088_opcode_23,        /* AND */
+  [0x24] = i8088_opcode_24,        /* AND AL,imm */
+  [0x25] = i8088_opcode_25,        /* AND AX,imm */
+  [0x26] = i8088_opcode_26,        /* ES segment override */
+  [0x27] = i8088_opcode_27,        /* DAA */
+  [0x28] = i8088_opcode_28,        /* SUB */
+  [0x29] = i8088_opcode_29,        /* SUB */
+  [0x2A] = i8088_opcode_2a,        /* SUB */
+  [0x2B] = i8088_opcode_2b,        /* SUB */
+  [0x2C] = i8088_opcode_2c,        /* SUB AL,imm */
+  [0x2D] = i8088_opcode_2d,        /* SUB AX,imm */
+  [0x2E] = i8088_opcode_2e,        /* CS segment override */
+  [0x2F] = i8088_opcode_2f,        /* DAS */
+  [0x30] = i8088_opcode_30,        /* XOR */
+  [0x31] = i8088_opcode_31,        /* XOR */
+  [0x32] = i8088_opcode_32,        /* XOR */
+  [0x33] = i8088_opcode_33,        /* XOR */
+  [0x34] = i8088_opcode_34,        /* XOR AL,imm */
+  [0x35] = i8088_opcode_35,        /* XOR AX,imm */
+  [0x36] = i8088_opcode_36,        /* SS segment override */
+  [0x37] = i8088_opcode_37,        /* AAA */
+  [0x38] = i8088_opcode_38,        /* CMP */
+  [0x39] = i8088_opcode_39,        /* CMP */
+  [0x3A] = i8088_opcode_3a,        /* CMP */
+  [0x3B] = i8088_opcode_3b,        /* CMP */
+  [0x3C] = i8088_opcode_3c,        /* CMP AL,imm */
+  [0x3D] = i8088_opcode_3d,        /* CMP AX,imm */
+  [0x3E] = i8088_opcode_3e,        /* DS segment override */
+  [0x3F] = i8088_opcode_3f,        /* AAS */
+  [0x40] = i8088_opcode_40,        /* INC AX */
+  [0x41] = i8088_opcode_41,        /* INC CX */
+  [0x42] = i8088_opcode_42,        /* INC DX */
+  [0x43] = i8088_opcode_43,        /* INC BX */
+  [0x44] = i8088_opcode_44,        /* INC SP */
+  [0x45] = i8088_opcode_45,        /* INC BP */
+  [0x46] = i8088_opcode_46,        /* INC SI */
+  [0x47] = i8088_opcode_47,        /* INC DI */
+  [0x48] = i8088_opcode_48,        /* DEC AX */
+  [0x49] = i8088_opcode_49,        /* DEC CX */
+  [0x4A] = i8088_opcode_4a,        /* DEC DX */
+  [0x4B] = i8088_opcode_4b,        /* DEC BX */
+  [0x4C] = i8088_opcode_4c,        /* DEC SP */
+  [0x4D] = i8088_opcode_4d,        /* DEC BP */
+  [0x4E] = i8088_opcode_4e,        /* DEC SI */
+  [0x4F] = i8088_opcode_4f,        /* DEC DI */
+  [0x50] = i8088_opcode_50,        /* PUSH AX */
+  [0x51] = i8088_opcode_51,        /* PUSH CX */
+  [0x52] = i8088_opcode_52,        /* PUSH DX */
+  [0x53] = i8088_opcode_53,        /* PUSH BX */
+  [0x54] = i8088_opcode_54,        /* PUSH SP */
+  [0x55] = i8088_opcode_55,        /* PUSH BP */
+  [0x56] = i8088_opcode_56,        /* PUSH SI */
+  [0x57] = i8088_opcode_57,        /* PUSH DI */
+  [0x58] = i8088_opcode_58,        /* POP AX */
+  [0x59] = i8088_opcode_59,        /* POP CX */
+  [0x5A] = i8088_opcode_5a,        /* POP DX */
+  [0x5B] = i8088_opcode_5b,        /* POP BX */
+  [0x5C] = i8088_opcode_5c,        /* POP SP */
+  [0x5D] = i8088_opcode_5d,        /* POP BP */
+  [0x5E] = i8088_opcode_5e,        /* POP SI */
+  [0x5F] = i8088_opcode_5f,        /* POP DI */
+  [0x60] = i8088_opcode_60,        /* PUSHA */
+  [0x61] = i8088_opcode_61,        /* POPA */
+  [0x62] = i8088_opcode_62,        /* BOUND */
+  [0x68] = i8088_opcode_68,        /* PUSH imm16 */
+  [0x69] = i8088_opcode_69,        /* IMUL reg16,r/m16,imm16 */
+  [0x6A] = i8088_opcode_6a,        /* PUSH imm8 */
+  [0x6B] = i8088_opcode_6b,        /* IMUL reg16,r/m16,imm8 */
+  [0x6C] = i8088_opcode_6c,        /* INSB */
+  [0x6D] = i8088_opcode_6d,        /* INSW */
+  [0x6E] = i8088_opcode_6e,        /* OUTSB */
+  [0x6F] = i8088_opcode_6f,        /* OUTSW */
+  [0x70] = i8088_opcode_70,        /* JO */
+  [0x71] = i8088_opcode_71,        /* JNO */
+  [0x72] = i8088_opcode_72,        /* JB/JNAE/JC */
+  [0x73] = i8088_opcode_73,        /* JNB/JAE/JNC */
+  [0x74] = i8088_opcode_74,        /* JZ/JE */
+  [0x75] = i8088_opcode_75,        /* JNZ/JNE */
+  [0x76] = i8088_opcode_76,        /* JBE/JBA */
+  [0x77] = i8088_opcode_77,        /* JNBE/JA */
+  [0x78] = i8088_opcode_78,        /* JS */
+  [0x79] = i8088_opcode_79,        /* JNS */
+  [0x7A] = i8088_opcode_7a,        /* JP/JPE */
+  [0x7B] = i8088_opcode_7b,        /* JNP/JPO */
+  [0x7C] = i8088_opcode_7c,        /* JL/JNGE */
+  [0x7D] = i8088_opcode_7d,        /* JNL/JGE */
+  [0x7E] = i8088_opcode_7e,        /* JLE/JNG */
+  [0x7F] = i8088_opcode_7f,        /* JNLE/JG */
+  [0x80] = i8088_opcode_80,        /* ALU r/m8,imm8 */
+  [0x81] = i8088_opcode_81,        /* ALU r/m16,imm16 */
+  [0x82] = i8088_opcode_80,        /* Identical to 0x80 */
+  [0x83] = i8088_opcode_83,        /* ALU r/m16,imm8 */
+  [0x84] = i8088_opcode_84,        /* TEST */
+  [0x85] = i8088_opcode_85,        /* TEST */
+  [0x86] = i8088_opcode_86,        /* XCHG */
+  [0x87] = i8088_opcode_87,        /* XCHG */
+  [0x88] = i8088_opcode_88,        /* MOV */
+  [0x89] = i8088_opcode_89,        /* MOV */
+  [0x8A] = i8088_opcode_8a,        /* MOV */
+  [0x8B] = i8088_opcode_8b,        /* MOV */
+  [0x8C] = i8088_opcode_8c,        /* MOV */
+  [0x8D] = i8088_opcode_8d,        /* LEA */
+  [0x8E] = i8088_opcode_8e,        /* MOV */
+  [0x8F] = i8088_opcode_8f,        /* POP */
+  [0x90] = i8088_opcode_90,        /* NOP */
+  [0x91] = i8088_opcode_91,        /* XCHG CX,AX */
+  [0x92] = i8088_opcode_92,        /* XCHG DX,AX */
+  [0x93] = i8088_opcode_93,        /* XCHG BX,AX */
+  [0x94] = i8088_opcode_94,        /* XCHG SP,AX */
+  [0x95] = i8088_opcode_95,        /* XCHG BP,AX */
+  [0x96] = i8088_opcode_96,        /* XCHG SI,AX */
+  [0x97] = i8088_opcode_97,        /* XCHG DI,AX */
+  [0x98] = i8088_opcode_98,        /* CBW */
+  [0x99] = i8088_opcode_99,        /* CWD */
+  [0x9A] = i8088_opcode_9a,        /* CALL FAR */
+  [0x9B] = i8088_opcode_9b,        /* WAIT */
+  [0x9C] = i8088_opcode_9c,        /* PUSHF */
+  [0x9D] = i8088_opcode_9d,        /* POPF */
+  [0x9E] = i8088_opcode_9e,        /* SAHF */
+  [0x9F] = i8088_opcode_9f,        /* LAHF */
+  [0xA0] = i8088_opcode_a0,        /* MOV */
+  [0xA1] = i8088_opcode_a1,        /* MOV */
+  [0xA2] = i8088_opcode_a2,        /* MOV */
+  [0xA3] = i8088_opcode_a3,        /* MOV */
+  [0xA4] = i8088_opcode_a4,        /* MOVSB */
+  [0xA5] = i8088_opcode_a5,        /* MOVSW */
+  [0xA6] = i8088_opcode_a6,        /* CMPSB */
+  [0xA7] = i8088_opcode_a7,        /* CMPSW */
+  [0xA8] = i8088_opcode_a8,        /* TEST AL,imm */
+  [0xA9] = i8088_opcode_a9,        /* TEST AX,imm */
+  [0xAA] = i8088_opcode_aa,        /* STOSB */
+  [0xAB] = i8088_opcode_ab,        /* STOSW */
+  [0xAC] = i8088_opcode_ac,        /* LODSB */
+  [0xAD] = i8088_opcode_ad,        /* LODSW */
+  [0xAE] = i8088_opcode_ae,        /* SCASB */
+  [0xAF] = i8088_opcode_af,        /* SCASW */
+  [0xB0] = i8088_opcode_b0,        /* MOV AL,imm */
+  [0xB1] = i8088_opcode_b1,        /* MOV CL,imm */
+  [0xB2] = i8088_opcode_b2,        /* MOV DL,imm */
+  [0xB3] = i8088_opcode_b3,        /* MOV BL,imm */
+  [0xB4] = i8088_opcode_b4,        /* MOV AH,imm */
+  [0xB5] = i8088_opcode_b5,        /* MOV CH,imm */
+  [0xB6] = i8088_opcode_b6,        /* MOV DH,imm */
+  [0xB7] = i8088_opcode_b7,        /* MOV BH,imm */
+  [0xB8] = i8088_opcode_b8,        /* MOV AX,imm */
+  [0xB9] = i8088_opcode_b9,        /* MOV CX,imm */
+  [0xBA] = i8088_opcode_ba,        /* MOV DX,imm */
+  [0xBB] = i8088_opcode_bb,        /* MOV BX,imm */
+  [0xBC] = i8088_opcode_bc,        /* MOV SP,imm */
+  [0xBD] = i8088_opcode_bd,        /* MOV BP,imm */
+  [0xBE] = i8088_opcode_be,        /* MOV SI,imm */
+  [0xBF] = i8088_opcode_bf,        /* MOV DI,imm */
+  [0xC0] = i8088_opcode_c0,        /* Shift/rotate r/m8,imm8 */
+  [0xC1] = i8088_opcode_c1,        /* Shift/rotate r/m16,imm8 */
+  [0xC2] = i8088_opcode_c2,        /* RET */
+  [0xC3] = i8088_opcode_c3,        /* RET */
+  [0xC4] = i8088_opcode_c4,        /* LES */
+  [0xC5] = i8088_opcode_c5,        /* LDS */
+  [0xC6] = i8088_opcode_c6,        /* MOV */
+  [0xC7] = i8088_opcode_c7,        /* MOV */
+  [0xC8] = i8088_opcode_c8,        /* ENTER */
+  [0xC9] = i8088_opcode_c9,        /* LEAVE */
+  [0xCA] = i8088_opcode_ca,        /* RET */
+  [0xCB] = i8088_opcode_cb,        /* RET */
+  [0xCC] = i8088_opcode_cc,        /* INT 3 */
+  [0xCD] = i8088_opcode_cd,        /* INT */
+  [0xCE] = i8088_opcode_ce,        /* INTO */
+  [0xCF] = i8088_opcode_cf,        /* IRET */
+  [0xD0] = i8088_opcode_d0,        /* Shift/rotate r/m8,1 */
+  [0xD1] = i8088_opcode_d1,        /* Shift/rotate r/m16,1 */
+  [0xD2] = i8088_opcode_d2,        /* Shift/rotate r/m8,CL */
+  [0xD3] = i8088_opcode_d3,        /* Shift/rotate r/m16,CL */
+  [0xD4] = i8088_opcode_d4,        /* AAM */
+  [0xD5] = i8088_opcode_d5,        /* AAD */
+  [0xD7] = i8088_opcode_d7,        /* XLAT */
+  [0xD8] = i8088_opcode_d8,        /* ESC */
+  [0xD9] = i8088_opcode_d9,        /* ESC */
+  [0xDA] = i8088_opcode_da,        /* ESC */
+  [0xDB] = i8088_opcode_db,        /* ESC */
+  [0xDC] = i8088_opcode_dc,        /* ESC */
+  [0xDD] = i8088_opcode_dd,        /* ESC */
+  [0xDE] = i8088_opcode_de,        /* ESC */
+  [0xDF] = i8088_opcode_df,        /* ESC */
+  [0xE0] = i8088_opcode_e0,        /* LOOPNE imm */
+  [0xE1] = i8088_opcode_e1,        /* LOOPE imm */
+  [0xE2] = i8088_opcode_e2,        /* LOOP imm */
+  [0xE3] = i8088_opcode_e3,        /* JCXZ */
+  [0xE4] = i8088_opcode_e4,        /* IN AL,imm */
+  [0xE5] = i8088_opcode_e5,        /* IN AX,imm */
+  [0xE6] = i8088_opcode_e6,        /* OUT imm,AL */
+  [0xE7] = i8088_opcode_e7,        /* OUT imm,AX */
+  [0xE8] = i8088_opcode_e8,        /* CALL */
+  [0xE9] = i8088_opcode_e9,        /* JMP */
+  [0xEA] = i8088_opcode_ea,        /* JMP */
+  [0xEB] = i8088_opcode_eb,        /* JMP */
+  [0xEC] = i8088_opcode_ec,        /* IN AL,DX */
+  [0xED] = i8088_opcode_ed,        /* IN AX,DX */
+  [0xEE] = i8088_opcode_ee,        /* OUT DX,AL */
+  [0xEF] = i8088_opcode_ef,        /* OUT DX,AX */
+  [0xF0] = i8088_opcode_f0,        /* LOCK */
+  [0xF2] = i8088_opcode_f2,        /* REPNE/REPNZ */
+  [0xF3] = i8088_opcode_f3,        /* REPE/REPZ */
+  [0xF4] = i8088_opcode_f4,        /* HLT */
+  [0xF5] = i8088_opcode_f5,        /* CMC */
+  [0xF6] = i8088_opcode_f6,        /* TEST/NOT/NEG/MUL/DIV r/m8 */
+  [0xF7] = i8088_opcode_f7,        /* TEST/NOT/NEG/MUL/DIV r/m16 */
+  [0xF8] = i8088_opcode_f8,        /* CLC */
+  [0xF9] = i8088_opcode_f9,        /* STC */
+  [0xFA] = i8088_opcode_fa,        /* CLI */
+  [0xFB] = i8088_opcode_fb,        /* STI */
+  [0xFC] = i8088_opcode_fc,        /* CLD */
+  [0xFD] = i8088_opcode_fd,        /* STD */
+  [0xFE] = i8088_opcode_fe,        /* INC/DEC r/m8 */
+  [0xFF] = i8088_opcode_ff,        /* INC/DEC/CALL/JMP/PUSH r/m16 */
+};
+
+
+
+/* 8088 clock cycles, from the 8086 figures with 4 more for every word
+   transferred over the 8-bit bus, and the 80186 figures likewise for the
+   V20 instructions. Register or immediate operand form. */
+static const uint8_t cycles_reg[256] = {
+   3,  3,  3,  3,  4,  4, 14, 12,  3,  3,  3,  3,  4,  4, 14, 12, /* 0x00 */
+   3,  3,  3,  3,  4,  4, 14, 12,  3,  3,  3,  3,  4,  4, 14, 12, /* 0x10 */
+   3,  3,  3,  3,  4,  4,  0,  4,  3,  3,  3,  3,  4,  4,  0,  4, /* 0x20 */
+   3,  3,  3,  3,  4,  4,  0,  8,  3,  3,  3,  3,  4,  4,  0,  8, /* 0x30 */
+   2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2, /* 0x40 */
+  15, 15, 15, 15, 15, 15, 15, 15, 12, 12, 12, 12, 12, 12, 12, 12, /* 0x50 */
+  68, 83, 43,  0,  0,  0,  0,  0, 14, 25, 14, 25, 14, 22, 14, 22, /* 0x60 */
+   4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4, /* 0x70 */
+   4,  4,  4,  4,  3,  3,  4,  4,  2,  2,  2,  2,  2,  2,  2, 12, /* 0x80 */
+   3,  3,  3,  3,  3,  3,  3,  3,  2,  5, 36,  4, 14, 12,  4,  4, /* 0x90 */
+  10, 14, 10, 14, 18, 26, 22, 30,  4,  4, 11, 15, 12, 16, 15, 19, /* 0xA0 */
+   4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4, /* 0xB0 */
+   5,  5, 24, 20, 24, 24,  4,  4, 19, 12, 33, 32, 72, 71,  4, 44, /* 0xC0 */
+   2,  2,  8,  8, 83, 60,  0, 11,  2,  2,  2,  2,  2,  2,  2,  2, /* 0xD0 */
+   5,  6,  5,  6, 10, 14, 10, 14, 23, 15, 15, 15,  8, 12,  8, 12, /* 0xE0 */
+   0,  0,  0,  0,  2,  2,  3,  3,  2,  2,  2,  2,  2,  2,  3,  2, /* 0xF0 */
+};
+
+/* Memory operand form, without the EA calculation. Zero if the opcode has
+   no ModRM byte. */
+static const uint8_t cycles_mem[256] = {
+  16, 24,  9, 13,  0,  0,  0,  0, 16, 24,  9, 13,  0,  0,  0,  0, /* 0x00 */
+  16, 24,  9, 13,  0,  0,  0,  0, 16, 24,  9, 13,  0,  0,  0,  0, /* 0x10 */
+  16, 24,  9, 13,  0,  0,  0,  0, 16, 24,  9, 13,  0,  0,  0,  0, /* 0x20 */
+  16, 24,  9, 13,  0,  0,  0,  0,  9, 13,  9, 13,  0,  0,  0,  0, /* 0x30 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0x40 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0x50 */
+   0,  0, 43,  0,  0,  0,  0,  0,  0, 32,  0, 32,  0,  0,  0,  0, /* 0x60 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0x70 */
+  17, 25, 17, 25,  9, 13, 17, 25,  9, 13,  8, 12, 13,  2, 12, 25, /* 0x80 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0x90 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0xA0 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0xB0 */
+  17, 25,  0,  0, 24, 24, 10, 14,  0,  0,  0,  0,  0,  0,  0,  0, /* 0xC0 */
+  15, 23, 20, 28,  0,  0,  0,  0,  8,  8,  8,  8,  8,  8,  8,  8, /* 0xD0 */
+   0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, /* 0xE0 */
+   0,  0,  0,  0,  0,  0, 16, 24,  0,  0,  0,  0,  0,  0, 15, 23, /* 0xF0 */
+};
+
+/* Groups selected by the REG field of the ModRM, register and memory. */
+static const uint8_t cycles_f6[8][2] = {
+  {5, 11}, {5, 11}, {3, 16}, {3, 16}, {74, 80}, {89, 95}, {85, 91},
+  {106, 112},
+};
+
+static const uint8_t cycles_f7[8][2] = {
+  {5, 15}, {5, 15}, {3, 24}, {3, 24}, {125, 135}, {141, 151}, {153, 163},
+  {174, 184},
+};
+
+static const uint8_t cycles_ff[8][2] = {
+  {2, 23}, {2, 23}, {20, 29}, {53, 53}, {11, 22}, {32, 32}, {15, 24},
+  {15, 24},
+};
+
+/* EA calculation by MOD and R/M, 2 more with a segment override. */
+static const uint8_t cycles_ea[3][8] = {
+  { 7,  8,  8,  7,  5,  5,  6,  5},
+  {11, 12, 12, 11,  9,  9,  9,  9},
+  {11, 12, 12, 11,  9,  9,  9,  9},
+};
+
+/* REP string instructions, per element on top of 9 to start. */
+static const uint8_t cycles_rep[12] = {
+  17, 25, 22, 30, 0, 0, 10, 14, 13, 17, 15, 19,
+};
+
+
+
+static uint32_t cycles_static(uint8_t opcode, uint8_t modrm,
+  uint8_t segment_override, uint8_t repeat)
+{
+  uint32_t cycles;
+  bool memory;
+
+  /* Part of the cost known from the instruction bytes and prefixes alone,
+     kept in the decode cache entry. */
+  memory = (cycles_mem[opcode] != 0 && modrm_mod(modrm) != MOD_REGISTER);
+  cycles = memory ? cycles_mem[opcode] : cycles_reg[opcode];
+
+  switch (opcode) {
+  case 0x80: case 0x81: case 0x82: case 0x83:
+    if (memory && modrm_opcode(modrm) == 7) {
+      cycles -= (opcode & 1) ? 11 : 7; /* CMP does not write back. */
     }
     break;
 
-  case 0x77: /* JNBE/JA */
-    i8088_trace_op_mnemonic("jnbe");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->c == 0 && cpu->z == 0) {
-      cpu->ip = cpu->ip + disp;
-    }
+  case 0xF6:
+    cycles = cycles_f6[modrm_opcode(modrm)][memory];
     break;
 
-  case 0x78: /* JS */
-    i8088_trace_op_mnemonic("js");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->s == 1) {
-      cpu->ip = cpu->ip + disp;
-    }
+  case 0xF7:
+    cycles = cycles_f7[modrm_opcode(modrm)][memory];
     break;
 
-  case 0x79: /* JNS */
-    i8088_trace_op_mnemonic("jns");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->s == 0) {
-      cpu->ip = cpu->ip + disp;
-    }
+  case 0xFF:
+    cycles = cycles_ff[modrm_opcode(modrm)][memory];
     break;
 
-  case 0x7A: /* JP/JPE */
-    i8088_trace_op_mnemonic("jp");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->p == 1) {
-      cpu->ip = cpu->ip + disp;
+  case 0xA4: case 0xA5: case 0xA6: case 0xA7:
+  case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+    if (repeat != REPEAT_NONE) {
+      cycles = 9; /* To start, the elements are counted when run. */
     }
     break;
 
-  case 0x7B: /* JNP/JPO */
-    i8088_trace_op_mnemonic("jnp");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->p == 0) {
-      cpu->ip = cpu->ip + disp;
+  case 0x6C: case 0x6D: case 0x6E: case 0x6F:
+    if (repeat != REPEAT_NONE) {
+      cycles = 8;
     }
     break;
 
-  case 0x7C: /* JL/JNGE */
-    i8088_trace_op_mnemonic("jl");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->s != cpu->o) {
-      cpu->ip = cpu->ip + disp;
-    }
+  default:
     break;
+  }
 
-  case 0x7D: /* JNL/JGE */
-    i8088_trace_op_mnemonic("jnl");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->s == cpu->o) {
-      cpu->ip = cpu->ip + disp;
+  if (memory) {
+    cycles += cycles_ea[modrm_mod(modrm)][modrm_rm(modrm)];
+    if (segment_override != SEGMENT_NONE) {
+      cycles += 2;
     }
-    break;
+  }
+  return cycles;
+}
+
+
+
+static bool cycles_dynamic_needed(uint8_t opcode, uint8_t repeat)
+{
+  switch (opcode) {
+  case 0x70: case 0x71: case 0x72: case 0x73:
+  case 0x74: case 0x75: case 0x76: case 0x77:
+  case 0x78: case 0x79: case 0x7A: case 0x7B:
+  case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+  case 0xE0: case 0xE1: case 0xE2: case 0xE3:
+  case 0xCE: case 0xD2: case 0xD3:
+    return true;
+
+  case 0xA4: case 0xA5: case 0xA6: case 0xA7:
+  case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+  case 0x6C: case 0x6D: case 0x6E: case 0x6F:
+    return (repeat != REPEAT_NONE);
 
-  case 0x7E: /* JLE/JNG */
-    i8088_trace_op_mnemonic("jle");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if ((cpu->z == 1) || (cpu->s != cpu->o)) {
-      cpu->ip = cpu->ip + disp;
+  default:
+    return false;
+  }
+}
+
+
+
+static uint32_t cycles_dynamic(i8088_t *cpu, uint8_t opcode, uint16_t cx,
+  uint16_t ip)
+{
+  /* Part of the cost that depends on how the instruction ran, given CX
+     and IP (after the opcode byte) from before it was run. */
+  switch (opcode) {
+  case 0x70: case 0x71: case 0x72: case 0x73:
+  case 0x74: case 0x75: case 0x76: case 0x77:
+  case 0x78: case 0x79: case 0x7A: case 0x7B:
+  case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+  case 0xE1: case 0xE2: case 0xE3:
+    return (cpu->ip != (uint16_t)(ip + 1)) ? 12 : 0; /* Taken. */
+
+  case 0xE0:
+    return (cpu->ip != (uint16_t)(ip + 1)) ? 14 : 0;
+
+  case 0xCE:
+    return (cpu->ip != ip) ? 69 : 0; /* Interrupt taken. */
+
+  case 0xD2: case 0xD3:
+    return (cx & 0xFF) * 4; /* Per bit shifted by CL. */
+
+  case 0xA4: case 0xA5: case 0xA6: case 0xA7:
+  case 0xAA: case 0xAB: case 0xAC: case 0xAD: case 0xAE: case 0xAF:
+    if (cpu->repeat != REPEAT_NONE) {
+      return cycles_rep[opcode - 0xA4] * (uint16_t)(cx - cpu->cx);
     }
-    break;
+    return 0;
 
-  case 0x7F: /* JNLE/JG */
-    i8088_trace_op_mnemonic("jnle");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if ((cpu->z == 0) && (cpu->s == cpu->o)) {
-      cpu->ip = cpu->ip + disp;
+  case 0x6C: case 0x6D: case 0x6E: case 0x6F:
+    if (cpu->repeat != REPEAT_NONE) {
+      return ((opcode & 1) ? 16 : 8) * (uint16_t)(cx - cpu->cx);
     }
-    break;
+    return 0;
 
-  case 0x80:
-    i8088_opcode_80(cpu, mem);
-    break;
+  default:
+    return 0;
+  }
+}
 
-  case 0x81:
-    i8088_opcode_81(cpu, mem);
-    break;
 
-  case 0x82:
-    i8088_opcode_80(cpu, mem); /* 0x82 are identical to 0x80 opcodes. */
-    break;
 
-  case 0x83:
-    i8088_opcode_83(cpu, mem);
-    break;
+#ifdef I8088_INSTRUMENTED
+static void opstat_dispatch(i8088_t *cpu, mem_t *mem, uint8_t opcode)
+{
+  opstat_t *opstat = cpu->opstat;
+  uint64_t start;
+  uint64_t inner;
+  uint64_t ticks;
+
+  opstat->count[opcode]++;
+  if (opstat_group(opcode)) {
+    opstat->group[opcode][modrm_reg((cpu->decode_hit != NULL) ?
+      cpu->decode_hit->modrm : peek(cpu, mem))]++;
+  }
+  if (! opstat->timing) {
+    (opcode_table[opcode])(cpu, mem);
+    return;
+  }
 
-  case 0x84: /* TEST */
-    i8088_trace_op_mnemonic("test");
-    modrm = fetch(cpu, mem);
-    (void)i8088_and_8(cpu,
-      modrm_get_reg_8(cpu, modrm),
-      modrm_get_rm_8(cpu, mem, modrm, NULL));
-    i8088_trace_op_dst_modrm_rm(modrm, 8);
-    break;
+  /* Handlers for prefixes dispatch again, leave out their time. */
+  inner = opstat->inner;
+  opstat->inner = 0;
+  start = opstat_ticks();
+  (opcode_table[opcode])(cpu, mem);
+  ticks = opstat_ticks() - start;
+  opstat->ticks[opcode] += ticks - opstat->inner;
+  opstat->timed[opcode]++;
+  opstat->inner = inner + ticks;
+}
+#endif /* I8088_INSTRUMENTED */
 
-  case 0x85: /* TEST */
-    i8088_trace_op_mnemonic("test");
-    modrm = fetch(cpu, mem);
-    (void)i8088_and_16(cpu,
-      modrm_get_reg_16(cpu, modrm),
-      modrm_get_rm_16(cpu, mem, modrm, NULL));
-    i8088_trace_op_dst_modrm_rm(modrm, 16);
-    break;
 
-  case 0x86: /* XCHG */
-    i8088_trace_op_mnemonic("xchg");
-    modrm = fetch(cpu, mem);
-    data_8 = modrm_get_reg_8(cpu, modrm);
-    modrm_set_reg_8(cpu, modrm, modrm_get_rm_8(cpu, mem, modrm, &eaddr));
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr, data_8);
-    i8088_trace_op_dst_modrm_reg(modrm, 8);
-    break;
 
-  case 0x87: /* XCHG */
-    i8088_trace_op_mnemonic("xchg");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_reg_16(cpu, modrm);
-    modrm_set_reg_16(cpu, modrm, modrm_get_rm_16(cpu, mem, modrm, &eaddr));
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, data_16);
-    i8088_trace_op_dst_modrm_reg(modrm, 16);
-    break;
+static inline void dispatch_handler(i8088_t *cpu, mem_t *mem,
+  uint8_t opcode)
+{
+#ifdef I8088_INSTRUMENTED
+  if (cpu->opstat != NULL) {
+    opstat_dispatch(cpu, mem, opcode);
+  } else {
+    (opcode_table[opcode])(cpu, mem);
+  }
+#else
+  (opcode_table[opcode])(cpu, mem);
+#endif /* I8088_INSTRUMENTED */
+}
 
-  case 0x88: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    modrm_set_rm_8(cpu, mem, modrm, modrm_get_reg_8(cpu, modrm));
-    break;
 
-  case 0x89: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    modrm_set_rm_16(cpu, mem, modrm, modrm_get_reg_16(cpu, modrm));
-    break;
 
-  case 0x8A: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    modrm_set_reg_8(cpu, modrm, modrm_get_rm_8(cpu, mem, modrm, NULL));
-    break;
+static inline void dispatch_opcode(i8088_t *cpu, mem_t *mem,
+  uint8_t opcode)
+{
+  uint16_t cx;
+  uint16_t ip;
+  uint8_t modrm;
+  uint8_t segment_override;
+  uint8_t repeat;
+
+  cx = cpu->cx;
+  ip = cpu->ip;
+  modrm = (cycles_mem[opcode] != 0) ? peek(cpu, mem) : 0;
+  segment_override = cpu->segment_override;
+  repeat = cpu->repeat;
+  dispatch_handler(cpu, mem, opcode);
+  cpu->cycles += cycles_static(opcode, modrm, segment_override, repeat) +
+    cycles_dynamic(cpu, opcode, cx, ip);
+}
 
-  case 0x8B: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    modrm_set_reg_16(cpu, modrm, modrm_get_rm_16(cpu, mem, modrm, NULL));
-    break;
 
-  case 0x8C: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    modrm_set_rm_16(cpu, mem, modrm, modrm_get_reg_seg(cpu, modrm));
-    break;
 
-  case 0x8D: /* LEA */
-    i8088_trace_op_mnemonic("lea");
-    modrm = fetch(cpu, mem);
-    (void)modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_reg_16(cpu, modrm, eaddr);
-    i8088_trace_op_bit_size(0);
-    break;
+static void i8088_dispatch(i8088_t *cpu, mem_t *mem, uint8_t opcode)
+{
+  if (cpu->decode_fill != NULL) {
+    /* Prefixes dispatch again, so the last call sees the final state. */
+    cpu->decode_fill->segment_override = cpu->segment_override;
+    cpu->decode_fill->repeat = cpu->repeat;
+    cpu->decode_fill->prefix_n = cpu->decode_fill->mc_n - 1;
+    cpu->decode_fill->block = decode_block_class(opcode);
+  }
 
-  case 0x8E: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    modrm_set_reg_seg(cpu, modrm, modrm_get_rm_16(cpu, mem, modrm, NULL));
-    break;
+  if (opcode_table[opcode] == NULL) {
+    panic("Unhandled opcode: 0x%02x\n", opcode);
+    cpu->decode_fill = NULL; /* Never replay it. */
+    return;
+  }
+  dispatch_opcode(cpu, mem, opcode);
+}
 
-  case 0x8F: /* POP */
-    i8088_trace_op_mnemonic("pop");
-    modrm = fetch(cpu, mem);
-    (void)modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    data_16  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    data_16 += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, data_16);
-    i8088_trace_op_src(false, "");
-    break;
 
-  case 0x90: /* NOP */
-    i8088_trace_op_mnemonic("nop");
-    break;
 
-  case 0x91: /* XCHG CX,AX */
-    i8088_trace_op_mnemonic("xchg");
-    i8088_trace_op_dst(false, "cx");
-    i8088_trace_op_src(false, "ax");
-    data_16 = cpu->ax;
-    cpu->ax = cpu->cx;
-    cpu->cx = data_16;
-    break;
+static void decode_cycles(i8088_decode_t *entry)
+{
+  uint8_t opcode;
+  uint8_t modrm;
+
+  /* The ModRM was recorded if the opcode has one. */
+  opcode = entry->mc[entry->prefix_n];
+  modrm = (entry->mc_n > entry->prefix_n + 1) ?
+    entry->mc[entry->prefix_n + 1] : 0;
+  entry->cycles = cycles_static(opcode, modrm, entry->segment_override,
+    entry->repeat);
+  entry->cycles_dynamic = cycles_dynamic_needed(opcode, entry->repeat);
+}
+
+
+
+static void decode_replay(i8088_t *cpu, mem_t *mem, i8088_decode_t *entry)
+{
+  uint16_t cx;
+  uint16_t ip;
+  uint8_t opcode;
+#ifdef I8088_INSTRUMENTED
+  int i;
+#endif /* I8088_INSTRUMENTED */
+
+  /* Prefixes were already decoded, go straight to the opcode handler.
+     Only the part of the cost that depends on the outcome is counted. */
+  cx = cpu->cx;
+  decode_replay_prefix(cpu, mem, entry);
+#ifdef I8088_INSTRUMENTED
+  for (i = entry->prefix_n; i < entry->mc_n; i++) {
+    i8088_trace_mc(entry->mc[i]);
+  }
+#endif /* I8088_INSTRUMENTED */
+  opcode = entry->mc[entry->prefix_n];
+  cpu->ip++;
+  ip = cpu->ip;
+  cpu->decode_hit = entry;
+  cpu->decode_imm = 0;
+  dispatch_handler(cpu, mem, opcode);
+  cpu->decode_hit = NULL;
+  cpu->cycles += entry->cycles;
+  if (entry->cycles_dynamic) {
+    cpu->cycles += cycles_dynamic(cpu, opcode, cx, ip);
+  }
+}
+
+
+
+void i8088_reset(i8088_t *cpu)
+{
+  cpu->flags = 0x0000;
+  cpu->flags_op = FLAGS_NONE;
+  cpu->idle = false;
+  cpu->ip = 0x0000;
+  cpu->cs = 0xFFFF;
+  cpu->ds = 0x0000;
+  cpu->ss = 0x0000;
+  cpu->es = 0x0000;
+  i8088_segment_sync(cpu);
+  if (cpu->fpu != NULL) {
+    i8087_init(cpu->fpu);
+  }
+}
+
+
+
+bool i8088_irq(i8088_t *cpu, mem_t *mem, int irq_no)
+{
+#ifdef I8088_LEAN
+  if (instrumented(cpu)) {
+    return i8088_irq_instrumented(cpu, mem, irq_no);
+  }
+#endif /* I8088_LEAN */
+
+  cpu->halt = false;
+  if (cpu->i == 0) {
+    return true;
+  }
+  i8088_interrupt(cpu, mem, irq_no + 8);
+  cpu->cycles += 81; /* Interrupt acknowledge and transfer. */
+  cpu->i = 0;
+  cpu->idle = false;
+  return false;
+}
+
+
+
+void i8088_init(i8088_t *cpu, io_t *io, i8088_decode_cache_t *decode_cache)
+{
+  int i;
+
+  memset(cpu, 0, sizeof(i8088_t));
+  cpu->io = io;
+  cpu->decode_cache = decode_cache;
+  if (decode_cache != NULL) {
+    for (i = 0; i < I8088_DECODE_CACHE_SIZE; i++) {
+      decode_cache->entry[i].address = I8088_DECODE_INVALID;
+    }
+  }
+}
+
+
+
+static bool breakpoint_check(i8088_t *cpu)
+{
+  uint32_t address;
+
+  if (cpu->breakpoint == NULL) {
+    return false;
+  }
+  address = (cpu->cs_base + cpu->ip) & 0xFFFFF;
+  if (cpu->breakpoint->section[address / MEM_SECTION] == 0) {
+    return false;
+  }
+  if (breakpoint_stop(cpu->breakpoint, address)) {
+    cpu->stop = true;
+    return true;
+  }
+  return false;
+}
+
+
+
+static void idle_check(i8088_t *cpu, mem_t *mem)
+{
+  uint16_t state[I8088_IDLE_STATE];
+
+  /* Jumping back to the same place without any memory writes or I/O in
+     between, and with the same registers and flags, means the loop can
+     only repeat until an interrupt. The cheap keys are compared first,
+     so flags are only evaluated for a loop that may be idle. */
+  if (cpu->ip != cpu->idle_ip || cpu->cs != cpu->idle_cs ||
+      cpu->idle_mem_writes != mem->write_count ||
+      cpu->idle_io_accesses != cpu->io->access_count) {
+    cpu->idle_cs = cpu->cs;
+    cpu->idle_ip = cpu->ip;
+    cpu->idle_mem_writes = mem->write_count;
+    cpu->idle_io_accesses = cpu->io->access_count;
+    cpu->idle_state_taken = false;
+    cpu->idle_count = 0;
+    cpu->idle_cycles = cpu->cycles;
+    return;
+  }
+
+  flags_sync(cpu);
+  state[0]  = cpu->ax;
+  state[1]  = cpu->bx;
+  state[2]  = cpu->cx;
+  state[3]  = cpu->dx;
+  state[4]  = cpu->si;
+  state[5]  = cpu->di;
+  state[6]  = cpu->bp;
+  state[7]  = cpu->sp;
+  state[8]  = cpu->ds;
+  state[9]  = cpu->es;
+  state[10] = cpu->ss;
+  state[11] = cpu->flags;
+
+  if (cpu->idle_state_taken &&
+      memcmp(state, cpu->idle_state, sizeof(state)) == 0) {
+    cpu->idle = true;
+    cpu->idle_length = cpu->idle_count;
+    cpu->idle_length_cycles = cpu->cycles - cpu->idle_cycles;
+    cpu->idle_count = 0;
+    cpu->idle_cycles = cpu->cycles;
+    return;
+  }
+
+  memcpy(cpu->idle_state, state, sizeof(state));
+  cpu->idle_state_taken = true;
+  cpu->idle_count = 0;
+  cpu->idle_cycles = cpu->cycles;
+}
+
+
+
+static inline void idle_track(i8088_t *cpu, mem_t *mem, uint16_t cs,
+  uint16_t ip)
+{
+  if (! cpu->idle_detect) {
+    return;
+  }
+  cpu->idle_count++;
+  if (cpu->ip <= ip && cpu->cs == cs) {
+    idle_check(cpu, mem);
+  }
+}
+
+
 
-  case 0x92: /* XCHG DX,AX */
-    i8088_trace_op_mnemonic("xchg");
-    i8088_trace_op_dst(false, "dx");
-    i8088_trace_op_src(false, "ax");
-    data_16 = cpu->ax;
-    cpu->ax = cpu->dx;
-    cpu->dx = data_16;
-    break;
+uint32_t i8088_idle(i8088_t *cpu, mem_t *mem)
+{
+  /* Instructions per pass of the loop being spun in, or 0 if none. */
+  if (cpu->idle_mem_writes != mem->write_count ||
+      cpu->idle_io_accesses != cpu->io->access_count) {
+    cpu->idle = false; /* Changed by a device, like DMA. */
+  }
+  return cpu->idle ? cpu->idle_length : 0;
+}
 
-  case 0x93: /* XCHG BX,AX */
-    i8088_trace_op_mnemonic("xchg");
-    i8088_trace_op_dst(false, "bx");
-    i8088_trace_op_src(false, "ax");
-    data_16 = cpu->ax;
-    cpu->ax = cpu->bx;
-    cpu->bx = data_16;
-    break;
 
-  case 0x94: /* XCHG SP,AX */
-    i8088_trace_op_mnemonic("xchg");
-    i8088_trace_op_dst(false, "sp");
-    i8088_trace_op_src(false, "ax");
-    data_16 = cpu->ax;
-    cpu->ax = cpu->sp;
-    cpu->sp = data_16;
-    break;
 
-  case 0x95: /* XCHG BP,AX */
-    i8088_trace_op_mnemonic("xchg");
-    i8088_trace_op_dst(false, "bp");
-    i8088_trace_op_src(false, "ax");
-    data_16 = cpu->ax;
-    cpu->ax = cpu->bp;
-    cpu->bp = data_16;
-    break;
+void i8088_idle_skip(i8088_t *cpu, uint32_t instructions)
+{
+  uint64_t cycles;
 
-  case 0x96: /* XCHG SI,AX */
-    i8088_trace_op_mnemonic("xchg");
-    i8088_trace_op_dst(false, "si");
-    i8088_trace_op_src(false, "ax");
-    data_16 = cpu->ax;
-    cpu->ax = cpu->si;
-    cpu->si = data_16;
-    break;
+  /* Account for whole passes of the idle loop skipped by the caller. */
+  cycles = (uint64_t)(instructions / cpu->idle_length) *
+    cpu->idle_length_cycles;
+  cpu->cycles += cycles;
+  cpu->idle_cycles += cycles;
+}
 
-  case 0x97: /* XCHG DI,AX */
-    i8088_trace_op_mnemonic("xchg");
-    i8088_trace_op_dst(false, "di");
-    i8088_trace_op_src(false, "ax");
-    data_16 = cpu->ax;
-    cpu->ax = cpu->di;
-    cpu->di = data_16;
-    break;
 
-  case 0x98: /* CBW */
-    i8088_trace_op_mnemonic("cbw");
-    if (cpu->al < 0x80) {
-      cpu->ah = 0;
-    } else {
-      cpu->ah = 0xFF;
-    }
-    break;
 
-  case 0x99: /* CWD */
-    i8088_trace_op_mnemonic("cwd");
-    if (cpu->ax < 0x8000) {
-      cpu->dx = 0;
-    } else {
-      cpu->dx = 0xFFFF;
-    }
-    break;
+void i8088_execute(i8088_t *cpu, mem_t *mem)
+{
+  i8088_decode_t *entry;
+  uint16_t cs;
+  uint16_t ip;
 
-  case 0x9A: /* CALL FAR */
-    i8088_trace_op_mnemonic("callf");
-    offset  = fetch(cpu, mem);
-    offset += fetch(cpu, mem) * 0x100;
-    segment  = fetch(cpu, mem);
-    segment += fetch(cpu, mem) * 0x100;
-    cpu->sp -= 4;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ip % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ip / 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+2, cpu->cs % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+3, cpu->cs / 0x100);
-    cpu->ip = offset;
-    cpu->cs = segment;
-    i8088_trace_op_dst(false, FMT_S ":" FMT_S, segment, offset);
-    break;
+#ifdef I8088_LEAN
+  if (instrumented(cpu)) {
+    i8088_execute_instrumented(cpu, mem);
+    return;
+  }
+#endif /* I8088_LEAN */
 
-  case 0x9B: /* WAIT */
-    i8088_trace_op_mnemonic("wait");
-    panic("WAIT not implemented!\n");
-    break;
+  if (cpu->halt) {
+    return; /* Waiting for IRQ. */
+  }
 
-  case 0x9C: /* PUSHF */
-    i8088_trace_op_mnemonic("pushf");
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->flags % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->flags / 0x100);
-    break;
+  cpu->idle = false;
+  cs = cpu->cs;
+  ip = cpu->ip;
 
-  case 0x9D: /* POPF */
-    i8088_trace_op_mnemonic("popf");
-    cpu->flags  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->flags += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    cpu->flags |=  0b1111000000000010; /* Set some unused flags. */
-    cpu->flags &= ~0b0000000000101000; /* Reset some unused flags. */
-    break;
-
-  case 0x9E: /* SAHF */
-    i8088_trace_op_mnemonic("sahf");
-    cpu->s = (cpu->ah >> 7) & 1;
-    cpu->z = (cpu->ah >> 6) & 1;
-    cpu->a = (cpu->ah >> 4) & 1;
-    cpu->p = (cpu->ah >> 2) & 1;
-    cpu->c =  cpu->ah       & 1;
-    break;
-
-  case 0x9F: /* LAHF */
-    i8088_trace_op_mnemonic("lahf");
-    cpu->ah = (cpu->s << 7) |
-              (cpu->z << 6) |
-              (cpu->a << 4) |
-              (cpu->p << 2) |
-              (     1 << 1) |
-              (cpu->c);
-    break;
-
-  case 0xA0: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    eaddr  = fetch(cpu, mem);
-    eaddr += fetch(cpu, mem) * 0x100;
-    cpu->al = eaddr_read_8(cpu, mem, cpu->ds, eaddr, NULL);
-    i8088_trace_op_bit_size(8);
-    i8088_trace_op_seg_default("ds");
-    i8088_trace_op_dst(false, "al");
-    i8088_trace_op_src(true, FMT_U, eaddr);
-    break;
-
-  case 0xA1: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    eaddr  = fetch(cpu, mem);
-    eaddr += fetch(cpu, mem) * 0x100;
-    cpu->ax = eaddr_read_16(cpu, mem, cpu->ds, eaddr, NULL);
-    i8088_trace_op_bit_size(16);
-    i8088_trace_op_seg_default("ds");
-    i8088_trace_op_dst(false, "ax");
-    i8088_trace_op_src(true, FMT_U, eaddr);
-    break;
-
-  case 0xA2: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    eaddr  = fetch(cpu, mem);
-    eaddr += fetch(cpu, mem) * 0x100;
-    eaddr_write_8(cpu, mem, cpu->ds, eaddr, cpu->al);
-    i8088_trace_op_bit_size(8);
-    i8088_trace_op_seg_default("ds");
-    i8088_trace_op_dst(true, FMT_U, eaddr);
-    i8088_trace_op_src(false, "al");
-    break;
-
-  case 0xA3: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    eaddr  = fetch(cpu, mem);
-    eaddr += fetch(cpu, mem) * 0x100;
-    eaddr_write_16(cpu, mem, cpu->ds, eaddr, cpu->ax);
-    i8088_trace_op_bit_size(16);
-    i8088_trace_op_seg_default("ds");
-    i8088_trace_op_dst(true, FMT_U, eaddr);
-    i8088_trace_op_src(false, "ax");
-    break;
+#ifdef I8088_REFERENCE
+  /* Bases from the segment registers, not as kept by the handlers. */
+  i8088_segment_sync(cpu);
+#endif /* I8088_REFERENCE */
 
-  case 0xA4: /* MOVSB */
-    i8088_trace_op_mnemonic("movsb");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_movsb(cpu, mem);
-      break;
-    case REPEAT_EZ:
-    case REPEAT_NENZ:
-      i8088_trace_op_prefix("rep");
-      while (cpu->cx != 0) {
-        i8088_movsb(cpu, mem);
-        cpu->cx--;
-      }
-      break;
-    }
-    break;
+  i8088_trace_start(cpu);
 
-  case 0xA5: /* MOVSW */
-    i8088_trace_op_mnemonic("movsw");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_movsw(cpu, mem);
-      break;
-    case REPEAT_EZ:
-    case REPEAT_NENZ:
-      i8088_trace_op_prefix("rep");
-      while (cpu->cx != 0) {
-        i8088_movsw(cpu, mem);
-        cpu->cx--;
-      }
-      break;
-    }
-    break;
+  entry = NULL;
+  if (cpu->decode_cache != NULL) {
+    entry = decode_lookup(cpu, mem);
+  }
+  if (entry == NULL && cpu->decode_fill == NULL && breakpoint_check(cpu)) {
+    return; /* Stopped before the instruction, it runs on the next call. */
+  }
 
-  case 0xA6: /* CMPSB */
-    i8088_trace_op_mnemonic("cmpsb");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_cmpsb(cpu, mem);
-      break;
-    case REPEAT_EZ:
-      if (cpu->cx != 0) {
-        i8088_cmpsb(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 1) {
-          while (cpu->cx != 0 && cpu->z == 1) {
-            i8088_cmpsb(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
-    case REPEAT_NENZ:
-      if (cpu->cx != 0) {
-        i8088_cmpsb(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 0) {
-          while (cpu->cx != 0 && cpu->z == 0) {
-            i8088_cmpsb(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
-    }
-    break;
+#ifdef I8088_INSTRUMENTED
+  if (cpu->callgraph != NULL) {
+    callgraph_count(cpu->callgraph, (cpu->cs_base + ip) & 0xFFFFF);
+  }
+#endif /* I8088_INSTRUMENTED */
 
-  case 0xA7: /* CMPSW */
-    i8088_trace_op_mnemonic("cmpsw");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_cmpsw(cpu, mem);
-      break;
-    case REPEAT_EZ:
-      if (cpu->cx != 0) {
-        i8088_cmpsw(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 1) {
-          while (cpu->cx != 0 && cpu->z == 1) {
-            i8088_cmpsw(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
-    case REPEAT_NENZ:
-      if (cpu->cx != 0) {
-        i8088_cmpsw(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 0) {
-          while (cpu->cx != 0 && cpu->z == 0) {
-            i8088_cmpsw(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
+  if (entry != NULL) {
+    decode_replay(cpu, mem, entry);
+  } else {
+    segment_override_set(cpu, SEGMENT_NONE);
+    cpu->repeat = REPEAT_NONE;
+    i8088_dispatch(cpu, mem, fetch(cpu, mem));
+    if (cpu->decode_fill != NULL) {
+      decode_cycles(cpu->decode_fill);
+      cpu->decode_fill->fuse = decode_fuse(mem, cpu->decode_fill,
+        cpu->decode_address, ip);
+      cpu->decode_fill->address = cpu->decode_address; /* Now valid. */
+      cpu->decode_fill = NULL;
     }
-    break;
+  }
 
-  case 0xA8: /* TEST AL,imm */
-    i8088_trace_op_mnemonic("test");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    (void)i8088_and_8(cpu, cpu->al, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
+  i8088_trace_end();
+  idle_track(cpu, mem, cs, ip);
+}
 
-  case 0xA9: /* TEST AX,imm */
-    i8088_trace_op_mnemonic("test");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    (void)i8088_and_16(cpu, cpu->ax, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xAA: /* STOSB */
-    i8088_trace_op_mnemonic("stosb");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_stosb(cpu, mem);
-      break;
-    case REPEAT_EZ:
-    case REPEAT_NENZ:
-      i8088_trace_op_prefix("rep");
-      while (cpu->cx != 0) {
-        i8088_stosb(cpu, mem);
-        cpu->cx--;
-      }
-      break;
-    }
-    break;
 
-  case 0xAB: /* STOSW */
-    i8088_trace_op_mnemonic("stosw");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_stosw(cpu, mem);
-      break;
-    case REPEAT_EZ:
-    case REPEAT_NENZ:
-      i8088_trace_op_prefix("rep");
-      while (cpu->cx != 0) {
-        i8088_stosw(cpu, mem);
-        cpu->cx--;
-      }
-      break;
-    }
-    break;
 
-  case 0xAC: /* LODSB */
-    i8088_trace_op_mnemonic("lodsb");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_lodsb(cpu, mem);
-      break;
-    case REPEAT_EZ:
-    case REPEAT_NENZ:
-      i8088_trace_op_prefix("rep");
-      while (cpu->cx != 0) {
-        i8088_lodsb(cpu, mem);
-        cpu->cx--;
-      }
-      break;
-    }
-    break;
+static void fuse_trace(i8088_t *cpu, const uint8_t *mc, int mc_n,
+  const char *mnemonic)
+{
+#ifdef CPU_TRACE
+  int i;
 
-  case 0xAD: /* LODSW */
-    i8088_trace_op_mnemonic("lodsw");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_lodsw(cpu, mem);
-      break;
-    case REPEAT_EZ:
-    case REPEAT_NENZ:
-      i8088_trace_op_prefix("rep");
-      while (cpu->cx != 0) {
-        i8088_lodsw(cpu, mem);
-        cpu->cx--;
-      }
-      break;
-    }
-    break;
+  /* Only the state before and the instruction bytes, no operands. */
+  i8088_trace_start(cpu);
+  for (i = 0; i < mc_n; i++) {
+    i8088_trace_mc(mc[i]);
+  }
+  i8088_trace_op_mnemonic(mnemonic);
+  i8088_trace_end();
+#else
+  (void)cpu;
+  (void)mc;
+  (void)mc_n;
+  (void)mnemonic;
+#endif /* CPU_TRACE */
+}
 
-  case 0xAE: /* SCASB */
-    i8088_trace_op_mnemonic("scasb");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_scasb(cpu, mem);
-      break;
-    case REPEAT_EZ:
-      if (cpu->cx != 0) {
-        i8088_scasb(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 1) {
-          while (cpu->cx != 0 && cpu->z == 1) {
-            i8088_scasb(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
-    case REPEAT_NENZ:
-      if (cpu->cx != 0) {
-        i8088_scasb(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 0) {
-          while (cpu->cx != 0 && cpu->z == 0) {
-            i8088_scasb(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
-    }
-    break;
 
-  case 0xAF: /* SCASW */
-    i8088_trace_op_mnemonic("scasw");
-    switch (cpu->repeat) {
-    case REPEAT_NONE:
-      i8088_scasw(cpu, mem);
-      break;
-    case REPEAT_EZ:
-      if (cpu->cx != 0) {
-        i8088_scasw(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 1) {
-          while (cpu->cx != 0 && cpu->z == 1) {
-            i8088_scasw(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
-    case REPEAT_NENZ:
-      if (cpu->cx != 0) {
-        i8088_scasw(cpu, mem);
-        cpu->cx--;
-        if (cpu->z == 0) {
-          while (cpu->cx != 0 && cpu->z == 0) {
-            i8088_scasw(cpu, mem);
-            cpu->cx--;
-          }
-        }
-      }
-      break;
-    }
-    break;
 
-  case 0xB0: /* MOV AL,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "al");
-    data_8 = fetch(cpu, mem);
-    cpu->al = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
+static const char *jcc_mnemonic[16] = {
+  "jo", "jno", "jb", "jnb", "jz", "jnz", "jbe", "jnbe",
+  "js", "jns", "jp", "jnp", "jl", "jnl", "jle", "jnle",
+};
 
-  case 0xB1: /* MOV CL,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "cl");
-    data_8 = fetch(cpu, mem);
-    cpu->cl = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xB2: /* MOV DL,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "dl");
-    data_8 = fetch(cpu, mem);
-    cpu->dl = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xB3: /* MOV BL,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "bl");
-    data_8 = fetch(cpu, mem);
-    cpu->bl = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xB4: /* MOV AH,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "ah");
-    data_8 = fetch(cpu, mem);
-    cpu->ah = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xB5: /* MOV CH,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "ch");
-    data_8 = fetch(cpu, mem);
-    cpu->ch = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xB6: /* MOV DH,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "dh");
-    data_8 = fetch(cpu, mem);
-    cpu->dh = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xB7: /* MOV BH,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "bh");
-    data_8 = fetch(cpu, mem);
-    cpu->bh = data_8;
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xB8: /* MOV AX,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "ax");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ax = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xB9: /* MOV CX,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "cx");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->cx = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xBA: /* MOV DX,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "dx");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->dx = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xBB: /* MOV BX,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "bx");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->bx = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xBC: /* MOV SP,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "sp");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->sp = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xBD: /* MOV BP,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "bp");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->bp = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xBE: /* MOV SI,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "si");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->si = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xBF: /* MOV DI,imm */
-    i8088_trace_op_mnemonic("mov");
-    i8088_trace_op_dst(false, "di");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->di = data_16;
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xC2: /* RET */
-    i8088_trace_op_mnemonic("retn");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ip  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->ip += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    cpu->sp += data_16;
-    i8088_trace_op_dst(false, FMT_U, data_16);
-    break;
-
-  case 0xC3: /* RET */
-    i8088_trace_op_mnemonic("retn");
-    cpu->ip  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->ip += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->sp += 2;
-    break;
-
-  case 0xC4: /* LES */
-    i8088_trace_op_mnemonic("les");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_reg_16(cpu, modrm, data_16);
-    cpu->es = modrm_get_rm_eaddr_16(cpu, mem, modrm, eaddr+2);
-    i8088_trace_op_bit_size(32);
-    break;
-
-  case 0xC5: /* LDS */
-    i8088_trace_op_mnemonic("lds");
-    modrm = fetch(cpu, mem);
-    data_16 = modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    modrm_set_reg_16(cpu, modrm, data_16);
-    cpu->ds = modrm_get_rm_eaddr_16(cpu, mem, modrm, eaddr+2);
-    i8088_trace_op_bit_size(32);
-    break;
-
-  case 0xC6: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    (void)modrm_get_rm_8(cpu, mem, modrm, &eaddr);
-    data_8 = fetch(cpu, mem);
-    modrm_set_rm_eaddr_8(cpu, mem, modrm, eaddr, data_8);
-    i8088_trace_op_src(false, FMT_U, data_8);
-    break;
-
-  case 0xC7: /* MOV */
-    i8088_trace_op_mnemonic("mov");
-    modrm = fetch(cpu, mem);
-    (void)modrm_get_rm_16(cpu, mem, modrm, &eaddr);
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    modrm_set_rm_eaddr_16(cpu, mem, modrm, eaddr, data_16);
-    i8088_trace_op_src(false, FMT_U, data_16);
-    break;
-
-  case 0xCA: /* RET */
-    i8088_trace_op_mnemonic("retf");
-    data_16  = fetch(cpu, mem);
-    data_16 += fetch(cpu, mem) * 0x100;
-    cpu->ip  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->ip += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->cs  = mem_read_by_segment(mem, cpu->ss, cpu->sp+2);
-    cpu->cs += mem_read_by_segment(mem, cpu->ss, cpu->sp+3) * 0x100;
-    cpu->sp += 4;
-    cpu->sp += data_16;
-    i8088_trace_op_dst(false, FMT_U, data_16);
-    break;
-
-  case 0xCB: /* RET */
-    i8088_trace_op_mnemonic("retf");
-    cpu->ip  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->ip += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->cs  = mem_read_by_segment(mem, cpu->ss, cpu->sp+2);
-    cpu->cs += mem_read_by_segment(mem, cpu->ss, cpu->sp+3) * 0x100;
-    cpu->sp += 4;
-    break;
-
-  case 0xCC: /* INT 3 */
-    i8088_trace_op_mnemonic("int3");
-    i8088_interrupt(cpu, mem, INT_1_BYTE);
-    break;
-
-  case 0xCD: /* INT */
-    i8088_trace_op_mnemonic("int");
-    data_8 = fetch(cpu, mem);
-    i8088_interrupt(cpu, mem, data_8);
-    i8088_trace_op_dst(false, FMT_U, data_8);
-    break;
-
-  case 0xCE: /* INTO */
-    i8088_trace_op_mnemonic("into");
-    if (cpu->o) {
-      i8088_interrupt(cpu, mem, INT_OVERFLOW);
-    }
-    break;
 
-  case 0xCF: /* IRET */
-    i8088_trace_op_mnemonic("iret");
-    cpu->ip  = mem_read_by_segment(mem, cpu->ss, cpu->sp);
-    cpu->ip += mem_read_by_segment(mem, cpu->ss, cpu->sp+1) * 0x100;
-    cpu->cs  = mem_read_by_segment(mem, cpu->ss, cpu->sp+2);
-    cpu->cs += mem_read_by_segment(mem, cpu->ss, cpu->sp+3) * 0x100;
-    cpu->flags  = mem_read_by_segment(mem, cpu->ss, cpu->sp+4);
-    cpu->flags += mem_read_by_segment(mem, cpu->ss, cpu->sp+5) * 0x100;
-    cpu->sp += 6;
-    cpu->flags |=  0b1111000000000010; /* Set some unused flags. */
-    cpu->flags &= ~0b0000000000101000; /* Reset some unused flags. */
-    break;
 
-  case 0xD0:
-    i8088_opcode_d0_d2(cpu, mem, 1);
-    i8088_trace_op_src(false, "");
+static bool jcc_condition(i8088_t *cpu, uint8_t opcode)
+{
+  switch (opcode) {
+  case 0x72: return flags_get_c(cpu);
+  case 0x73: return ! flags_get_c(cpu);
+  case 0x74: return flags_get_z(cpu);
+  case 0x75: return ! flags_get_z(cpu);
+  case 0x76: return flags_get_c(cpu) || flags_get_z(cpu);
+  case 0x77: return ! flags_get_c(cpu) && ! flags_get_z(cpu);
+  default:
     break;
+  }
 
-  case 0xD1:
-    i8088_opcode_d1_d3(cpu, mem, 1);
-    i8088_trace_op_src(false, "");
-    break;
+  flags_sync(cpu);
+  switch (opcode) {
+  case 0x70: return cpu->o == 1;
+  case 0x71: return cpu->o == 0;
+  case 0x78: return cpu->s == 1;
+  case 0x79: return cpu->s == 0;
+  case 0x7A: return cpu->p == 1;
+  case 0x7B: return cpu->p == 0;
+  case 0x7C: return cpu->s != cpu->o;
+  case 0x7D: return cpu->s == cpu->o;
+  case 0x7E: return (cpu->z == 1) || (cpu->s != cpu->o);
+  default:   return (cpu->z == 0) && (cpu->s == cpu->o);
+  }
+}
 
-  case 0xD2:
-    i8088_opcode_d0_d2(cpu, mem, cpu->cl);
-    i8088_trace_op_src(false, "cl");
-    break;
 
-  case 0xD3:
-    i8088_opcode_d1_d3(cpu, mem, cpu->cl);
-    i8088_trace_op_src(false, "cl");
-    break;
 
-  case 0xD4: /* AAM */
-    i8088_trace_op_mnemonic("aam");
-    data_8 = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_U, data_8);
-    if (data_8 == 0) {
-      i8088_interrupt(cpu, mem, INT_DIVIDE_ERROR);
-      return;
+static int i8088_execute_fused(i8088_t *cpu, mem_t *mem, i8088_decode_t *a,
+  int budget, uint8_t *block)
+{
+  const uint8_t *b;
+  uint16_t value;
+  uint16_t ip;
+  uint8_t reg;
+  int n;
+
+  *block = BLOCK_END;
+
+  if (a->fuse == FUSE_LOOP) {
+    /* Each pass counts as one LOOP instruction. */
+    for (n = 1; n <= budget; n++) {
+      fuse_trace(cpu, a->mc, a->mc_n, "loop");
+      cpu->cx--;
+      if (cpu->cx == 0) {
+        cpu->ip += 2;
+        cpu->cycles += a->cycles;
+        break;
+      }
+      cpu->cycles += a->cycles + 12; /* Taken. */
     }
-    cpu->ah = cpu->al / data_8;
-    cpu->al = cpu->al % data_8;
-    cpu->p = parity_even(cpu->al);
-    cpu->s = cpu->al >> 7;
-    cpu->z = cpu->al == 0;
-    break;
-
-  case 0xD5: /* AAD */
-    i8088_trace_op_mnemonic("aad");
-    data_8 = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_U, data_8);
-    cpu->al = (cpu->ah * data_8) + cpu->al;
-    cpu->ah = 0;
-    cpu->p = parity_even(cpu->al);
-    cpu->s = cpu->al >> 7;
-    cpu->z = cpu->al == 0;
-    break;
-
-  case 0xD7:
-    i8088_trace_op_mnemonic("xlat");
-    cpu->al = eaddr_read_8(cpu, mem, cpu->ds, cpu->bx + cpu->al, NULL);
-    break;
-
-  case 0xD8:
-  case 0xD9:
-  case 0xDA:
-  case 0xDB:
-  case 0xDC:
-  case 0xDD:
-  case 0xDE:
-  case 0xDF:
-    i8088_trace_op_mnemonic("esc");
-    /* This is needed to advance the instruction pointer correctly. */
-    modrm = fetch(cpu, mem);
-    modrm_void_rm_16(cpu, mem, modrm);
-    break;
-
-  case 0xE0: /* LOOPNE imm */
-    i8088_trace_op_mnemonic("loopne");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    cpu->cx--;
-    if ((cpu->z == 0) && (cpu->cx != 0)) {
-      cpu->ip = cpu->ip + disp;
+    n = (n > budget) ? budget : n;
+    if (cpu->idle_detect) {
+      cpu->idle_count += n;
     }
-    break;
+    return n;
+  }
 
-  case 0xE1: /* LOOPE imm */
-    i8088_trace_op_mnemonic("loope");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    cpu->cx--;
-    if ((cpu->z == 1) && (cpu->cx != 0)) {
-      cpu->ip = cpu->ip + disp;
-    }
-    break;
+  /* Both instructions have to fit in what is left of the block. */
+  if (budget < 2) {
+    return 0;
+  }
+  b = &a->mc[a->mc_n]; /* Recorded along with the first. */
 
-  case 0xE2: /* LOOP imm */
-    i8088_trace_op_mnemonic("loop");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    cpu->cx--;
-    if (cpu->cx != 0) {
-      cpu->ip = cpu->ip + disp;
+  segment_override_set(cpu, SEGMENT_NONE);
+  cpu->repeat = REPEAT_NONE;
+  ip = cpu->ip;
+  reg = modrm_rm(a->mc[0]) << 3; /* As the REG field of a ModRM. */
+
+  switch (a->fuse) {
+  case FUSE_DEC_JNZ:
+    fuse_trace(cpu, a->mc, a->mc_n, "dec");
+    cpu->ip += a->mc_n;
+    value = i8088_dec_16(cpu, modrm_get_reg_16(cpu, reg));
+    modrm_set_reg_16(cpu, reg, value);
+    fuse_trace(cpu, b, 2, "jnz");
+    cpu->ip += 2;
+    if (value != 0) { /* Z is not needed from the flags. */
+      cpu->ip += (int8_t)b[1];
     }
-    break;
-
-  case 0xE3: /* JCXZ */
-    i8088_trace_op_mnemonic("jcxz");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    if (cpu->cx == 0) {
-      cpu->ip = cpu->ip + disp;
+    cpu->cycles += a->cycles + cycles_reg[b[0]] +
+      cycles_dynamic(cpu, b[0], 0, ip + a->mc_n + 1);
+    break;
+
+  case FUSE_CMP_JCC:
+    fuse_trace(cpu, a->mc, a->mc_n, "cmp");
+    cpu->ip += a->mc_n;
+    reg = modrm_rm(a->mc[1]) << 3;
+    if (a->mc[0] == 0x81) {
+      i8088_cmp_16(cpu, modrm_get_reg_16(cpu, reg),
+        a->mc[2] + (a->mc[3] * 0x100));
+    } else if (a->mc[0] == 0x83) {
+      i8088_cmp_16(cpu, modrm_get_reg_16(cpu, reg), (int8_t)a->mc[2]);
+    } else {
+      i8088_cmp_8(cpu, modrm_get_reg_8(cpu, reg), a->mc[2]);
     }
+    fuse_trace(cpu, b, 2, jcc_mnemonic[b[0] & 0x0F]);
+    cpu->ip += 2;
+    if (jcc_condition(cpu, b[0])) {
+      cpu->ip += (int8_t)b[1];
+    }
+    cpu->cycles += a->cycles + cycles_reg[b[0]] +
+      cycles_dynamic(cpu, b[0], 0, ip + a->mc_n + 1);
     break;
 
-  case 0xE4: /* IN AL,imm */
-    i8088_trace_op_mnemonic("in");
-    data_8 = fetch(cpu, mem);
-    i8088_trace_op_dst(false, "al");
-    i8088_trace_op_src(false, FMT_U, data_8);
-    cpu->al = io_read(cpu->io, data_8);
-    break;
-
-  case 0xE5: /* IN AX,imm */
-    i8088_trace_op_mnemonic("in");
-    data_8 = fetch(cpu, mem);
-    i8088_trace_op_dst(false, "ax");
-    i8088_trace_op_src(false, FMT_U, data_8);
-    cpu->al = io_read(cpu->io, data_8);
-    cpu->ah = io_read(cpu->io, data_8+1);
+  case FUSE_INC_SI_DI:
+    fuse_trace(cpu, a->mc, a->mc_n, "inc");
+    cpu->ip += a->mc_n;
+    cpu->si = i8088_inc_16(cpu, cpu->si);
+    fuse_trace(cpu, b, 1, "inc");
+    cpu->ip += 1;
+    cpu->di = i8088_inc_16(cpu, cpu->di);
+    cpu->cycles += a->cycles + cycles_reg[b[0]];
+    *block = BLOCK_NONE;
     break;
 
-  case 0xE6: /* OUT imm,AL */
-    i8088_trace_op_mnemonic("out");
-    data_8 = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_U, data_8);
-    i8088_trace_op_src(false, "al");
-    io_write(cpu->io, data_8, cpu->al);
+  case FUSE_LODSB_STOSB:
+    fuse_trace(cpu, a->mc, a->mc_n, "lodsb");
+    cpu->ip += a->mc_n;
+    i8088_lodsb(cpu, mem);
+    fuse_trace(cpu, b, 1, "stosb");
+    cpu->ip += 1;
+    i8088_stosb(cpu, mem);
+    cpu->cycles += a->cycles + cycles_reg[b[0]];
+    *block = BLOCK_NONE;
     break;
+  }
 
-  case 0xE7: /* OUT imm,AX */
-    i8088_trace_op_mnemonic("out");
-    data_8 = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_U, data_8);
-    i8088_trace_op_src(false, "ax");
-    io_write(cpu->io, data_8, cpu->al);
-    io_write(cpu->io, data_8+1, cpu->ah);
-    break;
+  if (cpu->idle_detect) {
+    cpu->idle_count += 2;
+    if (cpu->ip <= ip) {
+      idle_check(cpu, mem);
+    }
+  }
+  return 2;
+}
 
-  case 0xE8: /* CALL */
-    i8088_trace_op_mnemonic("call");
-    offset  = fetch(cpu, mem);
-    offset += fetch(cpu, mem) * 0x100;
-    cpu->sp -= 2;
-    mem_write_by_segment(mem, cpu->ss, cpu->sp,   cpu->ip % 0x100);
-    mem_write_by_segment(mem, cpu->ss, cpu->sp+1, cpu->ip / 0x100);
-    cpu->ip += offset;
-    i8088_trace_op_dst(false, FMT_S,
-      offset + 3 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    break;
 
-  case 0xE9: /* JMP */
-    i8088_trace_op_mnemonic("jmp");
-    offset  = fetch(cpu, mem);
-    offset += fetch(cpu, mem) * 0x100;
-    cpu->ip += offset;
-    i8088_trace_op_dst(false, FMT_S,
-      offset + 3 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    break;
 
-  case 0xEA: /* JMP */
-    i8088_trace_op_mnemonic("jmpf");
-    offset  = fetch(cpu, mem);
-    offset += fetch(cpu, mem) * 0x100;
-    segment  = fetch(cpu, mem);
-    segment += fetch(cpu, mem) * 0x100;
-    cpu->ip = offset;
-    cpu->cs = segment;
-    i8088_trace_op_dst(false, FMT_S ":" FMT_S, segment, offset);
-    break;
+static inline bool opcode_prefix(uint8_t opcode)
+{
+  switch (opcode) {
+  case 0x26: case 0x2E: case 0x36: case 0x3E:
+  case 0xF0: case 0xF2: case 0xF3:
+    return true;
+  default:
+    return false;
+  }
+}
 
-  case 0xEB: /* JMP */
-    i8088_trace_op_mnemonic("jmp");
-    disp = fetch(cpu, mem);
-    i8088_trace_op_dst(false, FMT_S,
-      disp + 2 + ((cpu->segment_override == SEGMENT_NONE) ? 0 : 1));
-    cpu->ip = cpu->ip + disp;
-    break;
 
-  case 0xEC: /* IN AL,DX */
-    i8088_trace_op_mnemonic("in");
-    i8088_trace_op_dst(false, "al");
-    i8088_trace_op_src(false, "dx");
-    cpu->al = io_read(cpu->io, cpu->dx);
-    break;
 
-  case 0xED: /* IN AX,DX */
-    i8088_trace_op_mnemonic("in");
-    i8088_trace_op_dst(false, "ax");
-    i8088_trace_op_src(false, "dx");
-    cpu->al = io_read(cpu->io, cpu->dx);
-    cpu->ah = io_read(cpu->io, cpu->dx+1);
-    break;
+static bool prefixed_io(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t opcode;
+  uint16_t ip;
+  int i;
+
+  ip = cpu->ip;
+  for (i = 0; i < I8088_DECODE_MC_MAX; i++) {
+    opcode = mem->m[(cpu->cs_base + ip) & 0xFFFFF];
+    if (! opcode_prefix(opcode)) {
+      return decode_block_class(opcode) == BLOCK_IO;
+    }
+    ip++;
+  }
+  return false;
+}
 
-  case 0xEE: /* OUT DX,AL */
-    i8088_trace_op_mnemonic("out");
-    i8088_trace_op_dst(false, "dx");
-    i8088_trace_op_src(false, "al");
-    io_write(cpu->io, cpu->dx, cpu->al);
-    break;
 
-  case 0xEF: /* OUT DX,AX */
-    i8088_trace_op_mnemonic("out");
-    i8088_trace_op_dst(false, "dx");
-    i8088_trace_op_src(false, "ax");
-    io_write(cpu->io, cpu->dx, cpu->al);
-    io_write(cpu->io, cpu->dx+1, cpu->ah);
-    break;
 
-  case 0xF4: /* HLT */
-    i8088_trace_op_mnemonic("hlt");
-    cpu->halt = true;
-    break;
+static inline bool next_io(i8088_t *cpu, mem_t *mem)
+{
+  uint8_t opcode;
 
-  case 0xF5: /* CMC */
-    i8088_trace_op_mnemonic("cmc");
-    cpu->c = !cpu->c;
-    break;
+  /* Whether the next instruction is I/O, read straight from the backing
+     store as MMIO hooks must only see the actual fetch. Prefixes are only
+     looked past when there is one. */
+  opcode = mem->m[(cpu->cs_base + cpu->ip) & 0xFFFFF];
+  if (opcode_prefix(opcode)) {
+    return prefixed_io(cpu, mem);
+  }
+  return decode_block_class(opcode) == BLOCK_IO;
+}
 
-  case 0xF6:
-    i8088_opcode_f6(cpu, mem);
-    break;
 
-  case 0xF7:
-    i8088_opcode_f7(cpu, mem);
-    break;
 
-  case 0xF8: /* CLC */
-    i8088_trace_op_mnemonic("clc");
-    cpu->c = 0;
-    break;
+int i8088_run(i8088_t *cpu, mem_t *mem, int budget)
+{
+  uint32_t io_accesses;
+  int n;
 
-  case 0xF9: /* STC */
-    i8088_trace_op_mnemonic("stc");
-    cpu->c = 1;
-    break;
+#ifdef I8088_LEAN
+  if (instrumented(cpu)) {
+    return i8088_run_instrumented(cpu, mem, budget);
+  }
+#endif /* I8088_LEAN */
 
-  case 0xFA: /* CLI */
-    i8088_trace_op_mnemonic("cli");
-    cpu->i = 0;
-    break;
+  /* The caller picks a budget that ends with the next device event, so
+     a halted CPU can only be woken up after the last instruction. */
+  if (cpu->halt) {
+    return budget;
+  }
 
-  case 0xFB: /* STI */
-    i8088_trace_op_mnemonic("sti");
-    cpu->i = 1;
-    break;
+  cpu->stop = false;
+  cpu->far_transfer = false;
+  n = 0;
+  while (n < budget) {
+    /* I/O is run alone, so devices are up to date before and after. */
+    if (n > 0 && next_io(cpu, mem)) {
+      break;
+    }
 
-  case 0xFC: /* CLD */
-    i8088_trace_op_mnemonic("cld");
-    cpu->d = 0;
-    break;
+    io_accesses = cpu->io->access_count;
+    i8088_execute(cpu, mem);
+    if (cpu->breakpoint != NULL && cpu->breakpoint->hit) {
+      break; /* Stopped before the instruction, it has not run. */
+    }
+    n++;
 
-  case 0xFD: /* STD */
-    i8088_trace_op_mnemonic("std");
-    cpu->d = 1;
-    break;
+    if (cpu->halt || cpu->idle || cpu->stop) {
+      break;
+    }
+    if (cpu->io->access_count != io_accesses) {
+      break;
+    }
+    if (cpu->far_transfer) {
+      break; /* Interrupt or far call, for hooks on the entry point. */
+    }
+  }
+  return n;
+}
 
-  case 0xFE:
-    i8088_opcode_fe(cpu, mem);
-    break;
 
-  case 0xFF:
-    i8088_opcode_ff(cpu, mem);
-    break;
 
-  default:
-    panic("Unhandled opcode: 0x%02x\n", opcode);
-    break;
+int i8088_execute_block(i8088_t *cpu, mem_t *mem, int budget)
+{
+  i8088_decode_t *entry;
+  uint32_t address;
+  uint16_t cs;
+  uint16_t ip;
+  uint8_t block;
+  int fused;
+  int n;
+
+#ifdef I8088_LEAN
+  if (instrumented(cpu)) {
+    return i8088_execute_block_instrumented(cpu, mem, budget);
   }
+#endif /* I8088_LEAN */
 
-  i8088_trace_end();
-}
+  /* Counting needs every instruction to go through i8088_execute(). */
+  if (cpu->halt || cpu->decode_cache == NULL || cpu->callgraph != NULL ||
+      cpu->opstat != NULL) {
+    return i8088_run(cpu, mem, budget);
+  }
+  cpu->idle = false;
+
+  /* Run already decoded instructions back to back. Anything not in the
+     cache, including code invalidated by writes, stops the block and is
+     left to the interpreter. */
+  n = 0;
+  while (n < budget) {
+    address = (cpu->cs_base + cpu->ip) & 0xFFFFF;
+    entry = decode_entry(cpu, address);
+    if (! decode_valid(mem, entry, address)) {
+      break;
+    }
+    block = entry->block;
+    if (block == BLOCK_IO) {
+      break;
+    }
 
+    if (entry->fuse != FUSE_NONE) {
+      fused = i8088_execute_fused(cpu, mem, entry, budget - n,
+        &block);
+      if (fused > 0) {
+        n += fused;
+        if (block == BLOCK_END || cpu->idle) {
+          break;
+        }
+        continue;
+      }
+    }
 
+    /* Replay the entry just looked up, without going through
+       i8088_execute() and the cache again. */
+    cs = cpu->cs;
+    ip = cpu->ip;
+    i8088_trace_start(cpu);
+    decode_replay(cpu, mem, entry);
+    i8088_trace_end();
+    idle_track(cpu, mem, cs, ip);
+    n++;
+    if (block == BLOCK_END || cpu->halt || cpu->idle) {
+      break;
+    }
+  }
 
+  if (n == 0) {
+    return i8088_run(cpu, mem, 1);
+  }
+  return n;
+}
@@ -5,6 +5,10 @@
 #include <stdbool.h>
 #include "mem.h"
 #include "io.h"
+#include "i8087.h"
+#include "breakpoint.h"
+#include "callgraph.h"
+#include "opstat.h"
 
 typedef enum {
   SEGMENT_NONE = 0,
@@ -20,12 +24,54 @@ typedef enum {
   REPEAT_NENZ,
 } repeat_t;
 
+#define I8088_DECODE_CACHE_SIZE 8192 /* Must be a power of two. */
+#define I8088_DECODE_MC_MAX 12
+#define I8088_DECODE_IMM_MAX 2
+#define I8088_DECODE_INVALID 0xFFFFFFFF
+#define I8088_IDLE_STATE 12 /* Registers and flags, less CS:IP. */
+
+typedef struct i8088_decode_s {
+  uint32_t address; /* Linear address of first prefix or opcode. */
+  uint32_t generation; /* Code generation of the memory granule. */
+  uint16_t cycles; /* Clock cycles known without running it. */
+  bool cycles_dynamic; /* More depending on how it ran. */
+  uint8_t segment_override; /* As segment_t. */
+  uint8_t repeat; /* As repeat_t. */
+  uint8_t prefix_n; /* Number of prefix bytes before the opcode. */
+  uint8_t block; /* Block engine class of the opcode. */
+  uint8_t fuse; /* Fusion class together with the next instruction. */
+  uint8_t mc_n;
+  uint8_t mc[I8088_DECODE_MC_MAX]; /* Then the next one, if fused. */
+
+  /* Operands as decoded, for the handler to take instead of fetching. */
+  uint8_t modrm;
+  uint8_t imm_n;
+  uint16_t disp; /* Sign extended if only one byte. */
+  uint16_t imm[I8088_DECODE_IMM_MAX]; /* Immediates, offsets and rel8. */
+} i8088_decode_t;
+
+typedef struct i8088_decode_cache_s {
+  i8088_decode_t entry[I8088_DECODE_CACHE_SIZE];
+} i8088_decode_cache_t;
+
 typedef struct i8088_s {
   uint16_t es; /* Extra Segment */
   uint16_t cs; /* Code Segment */
   uint16_t ss; /* Stack Segment */
   uint16_t ds; /* Data Segment */
 
+  /* Linear base addresses of the segments, kept up to date by
+     i8088_segment_sync() whenever a segment register is loaded. */
+  uint32_t es_base;
+  uint32_t cs_base;
+  uint32_t ss_base;
+  uint32_t ds_base;
+
+  /* Bases for memory operands that default to DS or SS, with the segment
+     override of the current instruction applied. */
+  uint32_t eaddr_ds_base;
+  uint32_t eaddr_ss_base;
+
   uint16_t ip; /* Instruction Pointer */
   uint16_t sp; /* Stack Pointer */
   uint16_t bp; /* Base Pointer */
@@ -83,11 +129,50 @@ typedef struct i8088_s {
     uint16_t flags;
   };
 
+  /* Last flag setting operation, if not yet evaluated into flags. */
+  uint8_t flags_op;
+  uint16_t flags_input1;
+  uint16_t flags_input2;
+  uint16_t flags_result;
+  bool flags_carry;
+  bool flags_kept; /* CF of INC and DEC, AF of logic ops, from before. */
+
   segment_t segment_override;
   repeat_t repeat;
   bool halt;
+  bool stop; /* Ends i8088_run() early, like on a panic. */
+  bool far_transfer; /* CS loaded by a far jump, call, return or interrupt. */
+  bool instrumented; /* Run the build with tracing and counting. */
+  bool v20; /* NEC V20, also decoding the 80186 instructions. */
+  uint64_t cycles; /* Clock cycles run, not counting time halted. */
 
   io_t *io;
+
+  i8087_t *fpu; /* Optional, NULL if no 8087 is installed. */
+  breakpoint_t *breakpoint; /* Optional, NULL if none are checked. */
+  callgraph_t *callgraph; /* Optional, NULL if execution is not counted. */
+  opstat_t *opstat; /* Optional, NULL if opcodes are not counted. */
+
+  i8088_decode_cache_t *decode_cache; /* Optional, NULL if disabled. */
+  i8088_decode_t *decode_fill; /* Entry being recorded. */
+  i8088_decode_t *decode_hit; /* Entry being replayed. */
+  uint8_t decode_imm; /* Next immediate taken from the replayed entry. */
+  uint32_t decode_address;
+
+  /* State at the last backward jump, to detect idle loops. The cheap keys
+     are kept on every such jump, the registers only once those repeat. */
+  bool idle_detect; /* Look for idle loops, for the caller to skip. */
+  bool idle;
+  uint32_t idle_count; /* Instructions run since the state was taken. */
+  uint32_t idle_length; /* Instructions per pass of the idle loop. */
+  uint32_t idle_length_cycles; /* Clock cycles per pass. */
+  uint64_t idle_cycles; /* Clock cycles when the state was taken. */
+  uint16_t idle_cs;
+  uint16_t idle_ip;
+  uint32_t idle_mem_writes;
+  uint32_t idle_io_accesses;
+  bool idle_state_taken;
+  uint16_t idle_state[I8088_IDLE_STATE];
 } i8088_t;
 
 #define MOD_DISP_ZERO      0b00
@@ -134,7 +219,14 @@ typedef struct i8088_s {
 
 void i8088_reset(i8088_t *cpu);
 bool i8088_irq(i8088_t *cpu, mem_t *mem, int irq_no);
-void i8088_init(i8088_t *cpu, io_t *io);
+void i8088_init(i8088_t *cpu, io_t *io, i8088_decode_cache_t *decode_cache);
 void i8088_execute(i8088_t *cpu, mem_t *mem);
+int i8088_run(i8088_t *cpu, mem_t *mem, int budget);
+int i8088_execute_block(i8088_t *cpu, mem_t *mem, int budget);
+void i8088_flags_sync(i8088_t *cpu);
+void i8088_segment_sync(i8088_t *cpu);
+uint32_t i8088_idle(i8088_t *cpu, mem_t *mem);
+void i8088_idle_skip(i8088_t *cpu, uint32_t instructions);
+void i8088_execute_reference(i8088_t *cpu, mem_t *mem); /* For lockstep. */
 
 #endif /* _I8088_H */
@@ -41,11 +41,13 @@ typedef struct i8088_trace_s {
   uint8_t op_bit_size;
 } i8088_trace_t;
 
-static i8088_trace_t trace_buffer[I8088_TRACE_BUFFER_SIZE];
-static int trace_buffer_n = 0;
+/* Kept per thread, for machines running on separate threads. */
+static _Thread_local i8088_trace_t trace_buffer[I8088_TRACE_BUFFER_SIZE];
+static _Thread_local int trace_buffer_n = 0;
 
-static char trace_int_buffer[I8088_TRACE_INT_BUFFER_SIZE][I8088_TRACE_INT_MAX];
-static int trace_int_buffer_n = 0;
+static _Thread_local char
+  trace_int_buffer[I8088_TRACE_INT_BUFFER_SIZE][I8088_TRACE_INT_MAX];
+static _Thread_local int trace_int_buffer_n = 0;
 
 
 
@@ -529,6 +531,7 @@ static void i8088_trace_print(FILE *fh, i8088_trace_t *trace, bool extended)
     fprintf(fh, "%04x:", trace->cpu.es);
     fprintf(fh, "%04x ", trace->cpu.di);
   }
+  i8088_flags_sync(&trace->cpu); /* Flags may still be pending. */
   fprintf(fh, "%c", trace->cpu.o ? 'O' : '-');
   fprintf(fh, "%c", trace->cpu.d ? 'D' : '-');
   fprintf(fh, "%c", trace->cpu.i ? 'I' : '-');
@@ -54,8 +54,9 @@
 #define I8250_MSR_DATA_SET_READY 0x20
 #define I8250_MSR_CLEAR_TO_SEND  0x10
 
-static char i8250_trace_buffer[I8250_TRACE_BUFFER_SIZE][I8250_TRACE_MAX];
-static int i8250_trace_buffer_n = 0;
+static _Thread_local char
+  i8250_trace_buffer[I8250_TRACE_BUFFER_SIZE][I8250_TRACE_MAX];
+static _Thread_local int i8250_trace_buffer_n = 0;
 
 
 
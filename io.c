@@ -10,20 +10,31 @@
 
 uint8_t io_read(io_t *io, uint16_t port)
 {
+  uint8_t value;
+
+  io->access_count++;
   if (io->read[port].func != NULL) {
-    return (io->read[port].func)(io->read[port].cookie, port);
+    value = (io->read[port].func)(io->read[port].cookie, port);
   } else {
-    return 0xFF;
+    value = 0xFF;
+  }
+  if (io->read_tap.func != NULL) {
+    (io->read_tap.func)(io->read_tap.cookie, port, value);
   }
+  return value;
 }
 
 
 
 void io_write(io_t *io, uint16_t port, uint8_t value)
 {
+  io->access_count++;
   if (io->write[port].func != NULL) {
     (io->write[port].func)(io->write[port].cookie, port, value);
   }
+  if (io->write_tap.func != NULL) {
+    (io->write_tap.func)(io->write_tap.cookie, port, value);
+  }
 }
 
 
@@ -16,6 +16,9 @@ typedef struct io_write_hook_s {
 typedef struct io_s {
   io_read_hook_t  read[UINT16_MAX + 1];
   io_write_hook_t write[UINT16_MAX + 1];
+  uint32_t access_count; /* Bumped on any read or write. */
+  io_write_hook_t read_tap; /* Optional, passed every value read. */
+  io_write_hook_t write_tap; /* Optional, passed every value written. */
 } io_t;
 
 uint8_t io_read(io_t *io, uint16_t port);
@@ -0,0 +1,327 @@
+#include "lockstep.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "i8088.h"
+#include "i8087.h"
+#include "mem.h"
+#include "io.h"
+#include "panic.h"
+
+static const char *lockstep_state_name[LOCKSTEP_STATE] = {
+  "AX", "BX", "CX", "DX", "SI", "DI", "BP", "SP",
+  "CS", "DS", "ES", "SS", "IP", "FL", "HLT",
+  "FCW", "FSW", "FTW",
+};
+
+
+
+static void lockstep_log(lockstep_t *ls, uint16_t port, uint8_t value,
+  bool write)
+{
+  if (ls->log_n >= LOCKSTEP_LOG_MAX) {
+    ls->log_overflow = true;
+    return;
+  }
+  ls->log[ls->log_n].port = port;
+  ls->log[ls->log_n].value = value;
+  ls->log[ls->log_n].write = write;
+  ls->log_n++;
+}
+
+
+
+static void lockstep_log_read(void *ls, uint16_t port, uint8_t value)
+{
+  lockstep_log((lockstep_t *)ls, port, value, false);
+}
+
+
+
+static void lockstep_log_write(void *ls, uint16_t port, uint8_t value)
+{
+  lockstep_log((lockstep_t *)ls, port, value, true);
+}
+
+
+
+static lockstep_io_t *lockstep_replay(lockstep_t *ls, uint16_t port,
+  bool write)
+{
+  lockstep_io_t *entry;
+
+  /* The reference has to access the same ports in the same order. */
+  ls->replay_n++;
+  if (ls->replay_n > ls->log_n) {
+    ls->replay_mismatch = true;
+    return NULL;
+  }
+  entry = &ls->log[ls->replay_n - 1];
+  if (entry->port != port || entry->write != write) {
+    ls->replay_mismatch = true;
+  }
+  return entry;
+}
+
+
+
+static uint8_t lockstep_replay_read(void *ls, uint16_t port)
+{
+  lockstep_io_t *entry;
+
+  entry = lockstep_replay((lockstep_t *)ls, port, false);
+  return (entry != NULL) ? entry->value : 0xFF;
+}
+
+
+
+static void lockstep_replay_write(void *ls, uint16_t port, uint8_t value)
+{
+  lockstep_io_t *entry;
+
+  entry = lockstep_replay((lockstep_t *)ls, port, true);
+  if (entry != NULL && entry->value != value) {
+    ((lockstep_t *)ls)->replay_mismatch = true;
+  }
+}
+
+
+
+static void lockstep_state(i8088_t *cpu, uint16_t state[])
+{
+  i8088_t copy;
+
+  /* Evaluate lazy flags on a copy, leaving the CPU as it is. */
+  copy = *cpu;
+  i8088_flags_sync(&copy);
+
+  state[0]  = copy.ax;
+  state[1]  = copy.bx;
+  state[2]  = copy.cx;
+  state[3]  = copy.dx;
+  state[4]  = copy.si;
+  state[5]  = copy.di;
+  state[6]  = copy.bp;
+  state[7]  = copy.sp;
+  state[8]  = copy.cs;
+  state[9]  = copy.ds;
+  state[10] = copy.es;
+  state[11] = copy.ss;
+  state[12] = copy.ip;
+  state[13] = copy.flags;
+  state[14] = copy.halt;
+  state[15] = (copy.fpu != NULL) ? copy.fpu->cw : 0;
+  state[16] = (copy.fpu != NULL) ? copy.fpu->sw | (copy.fpu->top << 11) : 0;
+  state[17] = (copy.fpu != NULL) ? copy.fpu->tw : 0;
+}
+
+
+
+static void lockstep_diverged(lockstep_t *ls, i8088_t *cpu, const char *what,
+  uint32_t value, uint32_t ref_value)
+{
+  ls->divergences++;
+  ls->synced = false; /* Carry on from the checked CPU. */
+
+  snprintf(ls->report, LOCKSTEP_REPORT_MAX,
+    "%s %X != %X, in slice from %04X:%04X", what, value, ref_value,
+    ls->start_cs, ls->start_ip);
+  lockstep_state(cpu, ls->report_state);
+  lockstep_state(&ls->cpu, ls->report_ref_state);
+
+  panic("Lockstep divergence: %s %X != %X\n", what, value, ref_value);
+}
+
+
+
+void lockstep_init(lockstep_t *ls, mem_t *mem, io_t *io)
+{
+  int i;
+
+  mem_init(&ls->mem);
+  io_init(&ls->io);
+  for (i = 0; i <= UINT16_MAX; i++) {
+    ls->io.read[i].func = lockstep_replay_read;
+    ls->io.read[i].cookie = ls;
+    ls->io.write[i].func = lockstep_replay_write;
+    ls->io.write[i].cookie = ls;
+  }
+
+  mem->dirty = (uint8_t *)ls->dirty;
+  ls->mem.dirty = (uint8_t *)ls->ref_dirty;
+  io->read_tap.func = lockstep_log_read;
+  io->read_tap.cookie = ls;
+  io->write_tap.func = lockstep_log_write;
+  io->write_tap.cookie = ls;
+
+  ls->synced = false;
+  ls->log_n = 0;
+  ls->slices = 0;
+  ls->instructions = 0;
+  ls->resyncs = 0;
+  ls->divergences = 0;
+  ls->report[0] = '\0';
+}
+
+
+
+void lockstep_begin(lockstep_t *ls, i8088_t *cpu, mem_t *mem)
+{
+  uint32_t address;
+  uint32_t i;
+
+  /* Bring over anything changed outside the CPU since the last check,
+     like DMA, interrupts or the debugger. */
+  if (! ls->synced) {
+    memcpy(ls->mem.m, mem->m, MEM_SIZE_MAX);
+    for (i = 0; i < MEM_SIZE_MAX / MEM_SECTION; i++) {
+      /* The reference sees MMIO as the RAM backing it, without hooks. */
+      ls->mem.page[i].type =
+        (mem->page[i].type == MEM_ROM) ? MEM_ROM : MEM_RAM;
+    }
+    memset(ls->dirty, 0, sizeof(ls->dirty));
+    memset(ls->ref_dirty, 0, sizeof(ls->ref_dirty));
+    ls->synced = true;
+  } else if (mem->write_count != ls->write_count) {
+    for (i = 0; i < LOCKSTEP_GRANULES; i++) {
+      if (ls->dirty[i / 8] == 0) {
+        i += 7; /* Whole word clear. */
+      } else if (mem->dirty[i]) {
+        address = i * MEM_CODE_GRANULE;
+        memcpy(&ls->mem.m[address], &mem->m[address], MEM_CODE_GRANULE);
+      }
+    }
+    memset(ls->dirty, 0, sizeof(ls->dirty));
+  }
+  ls->write_count = mem->write_count;
+  ls->ref_write_count = ls->mem.write_count;
+
+  ls->cpu = *cpu;
+  ls->cpu.io = &ls->io;
+  ls->cpu.decode_cache = NULL;
+  ls->cpu.breakpoint = NULL;
+  ls->cpu.callgraph = NULL;
+  ls->cpu.opstat = NULL;
+  ls->cpu.instrumented = false;
+  ls->cpu.idle_detect = false;
+  i8088_flags_sync(&ls->cpu); /* The reference has no lazy flags. */
+  if (cpu->fpu != NULL) {
+    ls->fpu = *cpu->fpu;
+    ls->cpu.fpu = &ls->fpu;
+  }
+
+  ls->start_cs = cpu->cs;
+  ls->start_ip = cpu->ip;
+  ls->log_n = 0;
+  ls->replay_n = 0;
+  ls->log_overflow = false;
+  ls->replay_mismatch = false;
+}
+
+
+
+void lockstep_check(lockstep_t *ls, i8088_t *cpu, mem_t *mem,
+  uint32_t instructions)
+{
+  uint16_t state[LOCKSTEP_STATE];
+  uint16_t ref_state[LOCKSTEP_STATE];
+  char what[12];
+  uint32_t address;
+  uint32_t i;
+
+  if (ls->log_overflow) {
+    ls->resyncs++;
+    ls->synced = false;
+    return;
+  }
+
+  for (i = 0; i < instructions && ! ls->cpu.halt; i++) {
+    i8088_execute_reference(&ls->cpu, &ls->mem);
+  }
+  ls->slices++;
+  ls->instructions += instructions;
+
+  if (ls->replay_mismatch || ls->replay_n != ls->log_n) {
+    lockstep_diverged(ls, cpu, "Ports", ls->log_n, ls->replay_n);
+    return;
+  }
+
+  lockstep_state(cpu, state);
+  lockstep_state(&ls->cpu, ref_state);
+  for (i = 0; i < LOCKSTEP_STATE; i++) {
+    if (state[i] != ref_state[i]) {
+      lockstep_diverged(ls, cpu, lockstep_state_name[i],
+        state[i], ref_state[i]);
+      return;
+    }
+  }
+
+  if (mem->write_count == ls->write_count &&
+      ls->mem.write_count == ls->ref_write_count) {
+    return; /* Nothing written on either side. */
+  }
+
+  for (i = 0; i < LOCKSTEP_GRANULES; i++) {
+    if ((ls->dirty[i / 8] | ls->ref_dirty[i / 8]) == 0) {
+      i += 7; /* Whole word clear. */
+      continue;
+    }
+    if (mem->dirty[i] == 0 && ls->mem.dirty[i] == 0) {
+      continue;
+    }
+    address = i * MEM_CODE_GRANULE;
+    if (memcmp(&mem->m[address], &ls->mem.m[address],
+      MEM_CODE_GRANULE) == 0) {
+      continue;
+    }
+    if (ls->mem.dirty[i] == 0 && ls->log_n > 0) {
+      /* Only written on the checked side during a port access, by DMA. */
+      memcpy(&ls->mem.m[address], &mem->m[address], MEM_CODE_GRANULE);
+      continue;
+    }
+    while (mem->m[address] == ls->mem.m[address]) {
+      address++;
+    }
+    snprintf(what, sizeof(what), "[%05X]", address);
+    lockstep_diverged(ls, cpu, what, mem->m[address], ls->mem.m[address]);
+    return;
+  }
+
+  memset(ls->dirty, 0, sizeof(ls->dirty));
+  memset(ls->ref_dirty, 0, sizeof(ls->ref_dirty));
+  ls->write_count = mem->write_count;
+  ls->ref_write_count = ls->mem.write_count;
+}
+
+
+
+void lockstep_dump(FILE *fh, lockstep_t *ls)
+{
+  int i;
+
+  fprintf(fh, "Slices checked      : %llu\n",
+    (unsigned long long)ls->slices);
+  fprintf(fh, "Instructions checked: %llu\n",
+    (unsigned long long)ls->instructions);
+  fprintf(fh, "Resyncs             : %llu\n",
+    (unsigned long long)ls->resyncs);
+  fprintf(fh, "Divergences         : %llu\n",
+    (unsigned long long)ls->divergences);
+  if (ls->report[0] == '\0') {
+    return;
+  }
+
+  fprintf(fh, "Last: %s\n", ls->report);
+  fprintf(fh, "     Checked  Reference\n");
+  for (i = 0; i < LOCKSTEP_STATE; i++) {
+    fprintf(fh, "%-3s  %04X     %04X%s\n", lockstep_state_name[i],
+      ls->report_state[i], ls->report_ref_state[i],
+      (ls->report_state[i] != ls->report_ref_state[i]) ? "  <" : "");
+  }
+}
+
+
+
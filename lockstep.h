@@ -0,0 +1,64 @@
+#ifndef _LOCKSTEP_H
+#define _LOCKSTEP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "i8088.h"
+#include "i8087.h"
+#include "mem.h"
+#include "io.h"
+
+#define LOCKSTEP_GRANULES (MEM_SIZE_MAX / MEM_CODE_GRANULE)
+#define LOCKSTEP_LOG_MAX 0x20000 /* Enough for a REP INSW over 64K. */
+#define LOCKSTEP_STATE 18
+#define LOCKSTEP_REPORT_MAX 64
+
+typedef struct lockstep_io_s {
+  uint16_t port;
+  uint8_t value;
+  bool write;
+} lockstep_io_t;
+
+/* Reference CPU run on its own copy of memory after each slice of the
+   checked CPU, using the separate plain build of the interpreter.
+   Port accesses of the checked CPU are replayed instead of reaching the
+   devices a second time. */
+typedef struct lockstep_s {
+  i8088_t cpu;
+  i8087_t fpu;
+  mem_t mem;
+  io_t io;
+
+  /* A byte per granule written, scanned a word at a time. */
+  uint64_t dirty[LOCKSTEP_GRANULES / 8]; /* In the checked memory. */
+  uint64_t ref_dirty[LOCKSTEP_GRANULES / 8]; /* In the reference. */
+  bool synced; /* Memory copied over in full. */
+  uint32_t write_count; /* Of the checked memory, when last scanned. */
+  uint32_t ref_write_count;
+
+  lockstep_io_t log[LOCKSTEP_LOG_MAX];
+  uint32_t log_n;
+  uint32_t replay_n;
+  bool log_overflow;
+  bool replay_mismatch;
+
+  uint16_t start_cs; /* First instruction of the slice. */
+  uint16_t start_ip;
+  uint64_t slices;
+  uint64_t instructions;
+  uint64_t resyncs;
+  uint64_t divergences;
+
+  char report[LOCKSTEP_REPORT_MAX]; /* First difference seen, if any. */
+  uint16_t report_state[LOCKSTEP_STATE];
+  uint16_t report_ref_state[LOCKSTEP_STATE];
+} lockstep_t;
+
+void lockstep_init(lockstep_t *ls, mem_t *mem, io_t *io);
+void lockstep_begin(lockstep_t *ls, i8088_t *cpu, mem_t *mem);
+void lockstep_check(lockstep_t *ls, i8088_t *cpu, mem_t *mem,
+  uint32_t instructions);
+void lockstep_dump(FILE *fh, lockstep_t *ls);
+
+#endif /* _LOCKSTEP_H */
@@ -0,0 +1,227 @@
+#include "machine.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <unistd.h>
+#ifdef CPU_RELAX
+#include <poll.h>
+#endif /* CPU_RELAX */
+
+#include "i8088.h"
+#include "i8088_trace.h"
+#include "console.h"
+#include "panic.h"
+
+/* The machine being run by this thread, for panic() to stop. */
+static _Thread_local machine_t *machine_current = NULL;
+
+
+
+void panic(const char *format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(machine_current->panic_msg, MACHINE_PANIC_MSG_MAX, format, args);
+  va_end(args);
+
+  machine_current->debugger_break = true;
+  machine_current->cpu.stop = true;
+}
+
+
+
+void machine_init(machine_t *machine)
+{
+  machine_current = machine;
+
+  i8088_trace_init();
+  i8088_init(&machine->cpu, &machine->io, &machine->decode_cache);
+  breakpoint_init(&machine->breakpoint);
+  machine->cpu.breakpoint = &machine->breakpoint;
+  mem_init(&machine->mem);
+  io_init(&machine->io);
+
+  fe2010_init(&machine->fe2010, &machine->io, &machine->cpu, &machine->mem);
+  mos5720_init(&machine->mos5720, &machine->io, &machine->fe2010);
+  fdc9268_init(&machine->fdc9268, &machine->io, &machine->fe2010);
+  m6242_init(&machine->m6242, &machine->io);
+  net_init(&machine->net);
+  dp8390_init(&machine->dp8390, &machine->io, &machine->fe2010,
+    &machine->net);
+  console_init(&machine->console, &machine->io);
+
+  machine->lockstep = NULL;
+  machine->cycle = 0;
+  machine->sleep_cycles = 0;
+  machine->block_engine = false;
+  machine->idle_forward = false;
+  machine->serial = false;
+  machine->terminal = false;
+  machine->debugger_break = false;
+  machine->panic_msg[0] = '\0';
+}
+
+
+
+#ifdef CPU_RELAX
+static void machine_sleep(machine_t *machine, uint32_t cycles)
+{
+  struct pollfd fds[2 + NET_POLL_FDS_MAX];
+  int n;
+
+  /* Sleep for the emulated time skipped by a halted CPU, once it adds up
+     to a millisecond, but wake up early on any host input. */
+  machine->sleep_cycles += cycles;
+  if (machine->sleep_cycles < MACHINE_CYCLES_PER_MS) {
+    return;
+  }
+
+  n = 0;
+  if (machine->terminal) {
+    fds[n].fd = STDIN_FILENO;
+    fds[n].events = POLLIN;
+    n++;
+  }
+  if (machine->serial) {
+    fds[n].fd = machine->i8250.tty_fd;
+    fds[n].events = POLLIN;
+    n++;
+  }
+  n += net_poll_fds(&machine->net, &fds[n]);
+
+  if (poll(fds, n, machine->sleep_cycles / MACHINE_CYCLES_PER_MS) > 0) {
+    machine->sleep_cycles = 0; /* Catch up with the input right away. */
+  } else {
+    machine->sleep_cycles %= MACHINE_CYCLES_PER_MS;
+  }
+}
+#endif /* CPU_RELAX */
+
+
+
+void machine_execute(machine_t *machine)
+{
+  i8088_t *cpu = &machine->cpu;
+  mem_t *mem = &machine->mem;
+  int n;
+  int budget;
+  uint32_t period;
+  uint32_t skip;
+  uint32_t idle_length;
+  bool single_step;
+
+  machine_current = machine;
+
+  /* Single step when the debugger is active. */
+  single_step = machine->debugger_break;
+
+  /* Run up to and including the instruction after which the next timer
+     event or periodic device update is due. Devices only count down
+     until then, so they can catch up afterwards. */
+  period = machine->serial ? 100 : 10000;
+  skip = (period - (machine->cycle % period)) % period;
+  if (fe2010_idle_cycles(&machine->fe2010) < skip) {
+    skip = fe2010_idle_cycles(&machine->fe2010);
+  }
+  budget = machine->debugger_break ? 1 : skip + 1;
+
+  if (machine->lockstep != NULL) {
+    lockstep_begin(machine->lockstep, cpu, mem);
+  }
+
+  /* Passes skipped would not be counted. */
+  idle_length = 0;
+  if (machine->idle_forward && ! single_step && cpu->callgraph == NULL &&
+      cpu->opstat == NULL) {
+    idle_length = i8088_idle(cpu, mem);
+  }
+  if (idle_length > 0) {
+    /* The CPU would only spin, so skip whole passes of the loop. The
+       rest is run as usual so any interrupt hits the exact same
+       instruction. */
+    skip -= skip % idle_length;
+    fe2010_idle_skip(&machine->fe2010, skip);
+    i8088_idle_skip(cpu, skip);
+    machine->cycle += skip;
+    budget -= skip;
+  }
+
+#ifdef CPU_RELAX
+  if (cpu->halt && ! single_step) {
+    machine_sleep(machine, budget - 1);
+  }
+#endif /* CPU_RELAX */
+
+  if (machine->block_engine && ! single_step) {
+    n = i8088_execute_block(cpu, mem, budget);
+  } else {
+    n = i8088_run(cpu, mem, budget);
+  }
+
+  if (machine->lockstep != NULL) {
+    /* The reference also runs the idle passes skipped. */
+    lockstep_check(machine->lockstep, cpu, mem,
+      ((idle_length > 0) ? skip : 0) + n);
+  }
+
+  if (n == 0) {
+    /* A breakpoint stopped the CPU before anything ran, no time passed. */
+    machine->breakpoint.hit = false;
+    machine->debugger_break = true;
+    return;
+  }
+
+  fe2010_idle_skip(&machine->fe2010, n - 1);
+  machine->cycle += n - 1;
+  fe2010_execute(&machine->fe2010);
+
+  if ((machine->cycle % 10000) == 0) {
+    if (machine->terminal) {
+      console_execute_keyboard(&machine->console, &machine->fe2010,
+        &machine->mos5720);
+      console_execute_screen(&machine->console, mem);
+    }
+    net_execute(&machine->net);
+    dp8390_execute(&machine->dp8390);
+  }
+
+  if (machine->serial) {
+    if ((machine->cycle % 100) == 0) {
+      i8250_execute(&machine->i8250);
+    }
+  }
+
+  machine->cycle++;
+
+#ifdef CPU_RELAX
+  /* Check if BIOS int16h gets called for keyboard services. Slices end
+     on any interrupt or far transfer, so its entry is always seen here. */
+  if (machine->terminal &&
+      cpu->cs == (mem->m[0x5A] + (mem->m[0x5B] * 0x100)) &&
+      cpu->ip == (mem->m[0x58] + (mem->m[0x59] * 0x100))) {
+    console_execute_screen(&machine->console, mem);
+    struct pollfd fds[1];
+    fds[0].fd = STDIN_FILENO;
+    fds[0].events = POLLIN;
+#if CPU_RELAX == CPM
+    /* CP/M-86 calls with AH=0 and waits indefinitely. */
+    if (cpu->ah == 0) {
+      while (poll(fds, 1, 10) == 0);
+    }
+#else /* CPU_RELAX == DOS */
+    /* DOS typically calls with AH=1 to poll once in while. */
+    poll(fds, 1, 1);
+#endif
+  }
+#endif /* CPU_RELAX */
+
+  if (machine->breakpoint.hit) {
+    machine->breakpoint.hit = false;
+    machine->debugger_break = true;
+  }
+}
+
+
+
@@ -0,0 +1,61 @@
+#ifndef _MACHINE_H
+#define _MACHINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i8088.h"
+#include "i8087.h"
+#include "breakpoint.h"
+#include "lockstep.h"
+#include "mem.h"
+#include "io.h"
+#include "fe2010.h"
+#include "mos5720.h"
+#include "fdc9268.h"
+#include "m6242.h"
+#include "xthdc.h"
+#include "i8250.h"
+#include "dp8390.h"
+#include "net.h"
+#include "edfs.h"
+#include "console.h"
+
+#define MACHINE_PANIC_MSG_MAX 80
+#define MACHINE_CYCLES_PER_MS 2784 /* 7 per 3 PIT clocks at 1.193 MHz. */
+
+/* Everything for one emulated PC 20-III. Several can run in the same
+   process, each on its own thread. */
+typedef struct machine_s {
+  i8088_t cpu;
+  i8088_decode_cache_t decode_cache;
+  i8087_t fpu;
+  breakpoint_t breakpoint;
+  mem_t mem;
+  io_t io;
+  fe2010_t fe2010;
+  mos5720_t mos5720;
+  fdc9268_t fdc9268;
+  m6242_t m6242;
+  xthdc_t xthdc;
+  i8250_t i8250;
+  dp8390_t dp8390;
+  net_t net;
+  edfs_t edfs;
+  console_t console;
+  lockstep_t *lockstep; /* Optional, NULL if not checked. */
+
+  uint32_t cycle;
+  uint32_t sleep_cycles; /* Spent halted, not yet slept for. */
+  bool block_engine;
+  bool idle_forward;
+  bool serial;   /* COM1 passed through to a TTY. */
+  bool terminal; /* Keyboard and screen on the curses console. */
+
+  bool debugger_break;
+  char panic_msg[MACHINE_PANIC_MSG_MAX];
+} machine_t;
+
+void machine_init(machine_t *machine);
+void machine_execute(machine_t *machine);
+
+#endif /* _MACHINE_H */
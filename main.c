@@ -4,67 +4,69 @@
 #include <stdio.h>
 #include <signal.h>
 #include <unistd.h>
-#ifdef CPU_RELAX
-#include <poll.h>
-#endif /* CPU_RELAX */
 
+#include "machine.h"
 #include "i8088.h"
-#include "i8088_trace.h"
-#include "mem.h"
-#include "io.h"
 #include "fe2010.h"
-#include "mos5720.h"
+#include "mem.h"
 #include "fdc9268.h"
-#include "m6242.h"
 #include "xthdc.h"
 #include "i8250.h"
-#include "dp8390.h"
-#include "net.h"
 #include "edfs.h"
 #include "console.h"
 #include "debugger.h"
-#include "panic.h"
+#include "profile.h"
+#include "callgraph.h"
+#include "opstat.h"
 
 #define BIOS_ROM_FILENAME "rom/cbm-pc10sd-bios-v4.38-318085-05-C72A.bin"
 #define BIOS_ROM_ADDRESS 0xF8000
 
-static i8088_t cpu;
-static mem_t mem;
-static io_t io;
-static fe2010_t fe2010;
-static mos5720_t mos5720;
-static fdc9268_t fdc9268;
-static m6242_t m6242;
-static xthdc_t xthdc;
-static i8250_t i8250;
-static dp8390_t dp8390;
-static net_t net;
+static machine_t machine;
+static lockstep_t lockstep;
+static profile_t profile;
+static char *profile_filename = NULL;
+static callgraph_t callgraph;
+static char *callgraph_filename = NULL;
+static opstat_t opstat;
+static char *opstat_filename = NULL;
 
-static bool debugger_break = false;
-static char panic_msg[80];
 
 
+static void sig_handler(int sig)
+{
+  switch (sig) {
+  case SIGINT:
+    machine.debugger_break = true;
+    machine.cpu.stop = true;
+    return;
 
-void panic(const char *format, ...)
+  case SIGPROF:
+    profile_sample(&profile, &machine.cpu, &machine.mem);
+    return;
+  }
+}
+
+
+
+static void profile_exit(void)
 {
-  va_list args;
+  profile_stop(&profile);
+  profile_write(&profile, profile_filename);
+}
+
 
-  va_start(args, format);
-  vsnprintf(panic_msg, sizeof(panic_msg), format, args);
-  va_end(args);
 
-  debugger_break = true;
+static void callgraph_exit(void)
+{
+  callgraph_write(&callgraph, callgraph_filename);
 }
 
 
 
-static void sig_handler(int sig)
+static void opstat_exit(void)
 {
-  switch (sig) {
-  case SIGINT:
-    debugger_break = true;
-    return;
-  }
+  opstat_write(&opstat, opstat_filename);
 }
 
 
@@ -83,6 +85,16 @@ static void display_help(const char *progname)
     "  -x ADDR   Load BIOS ROM at (hex) ADDR instead of the default.\n"
     "  -t TTY    Passthrough COM1 to TTY device.\n"
     "  -e DIR    Serve EtherDFS requests from DIR root.\n"
+    "  -j        Run cached code in blocks between device updates.\n"
+    "  -i        Fast-forward idle loops to the next device event.\n"
+    "  -I        Start with CPU trace enabled.\n"
+    "  -f        Install an 8087 FPU.\n"
+    "  -v        Emulate a NEC V20 with the 80186 instructions.\n"
+    "  -l        Check the CPU in lockstep with the reference interpreter.\n"
+    "  -p FILE   Profile guest code, written to FILE and FILE.folded at exit.\n"
+    "  -c FILE   Count instructions and calls, to FILE and FILE.csv at exit.\n"
+    "  -o FILE   Count opcodes, written to FILE as JSON at exit.\n"
+    "  -O FILE   Count opcodes and time their handlers on the host.\n"
     "\n");
   fprintf(stdout,
     "Default BIOS ROM '%s' @ 0x%05x\n", BIOS_ROM_FILENAME, BIOS_ROM_ADDRESS);
@@ -95,7 +107,14 @@ static void display_help(const char *progname)
 int main(int argc, char *argv[])
 {
   int c;
-  uint32_t cycle;
+  bool debugger_break = false;
+  bool block_engine = false;
+  bool idle_forward = false;
+  bool instrumented = false;
+  bool fpu = false;
+  bool v20 = false;
+  bool check_lockstep = false;
+  bool opstat_timing = false;
   char *bios_rom_filename = BIOS_ROM_FILENAME;
   uint32_t bios_rom_address = BIOS_ROM_ADDRESS;
   char *floppy_a_image = NULL;
@@ -105,10 +124,9 @@ int main(int argc, char *argv[])
   char *edfs_root = NULL;
   int floppy_image_spt = 0;
 
-  panic_msg[0] = '\0';
   signal(SIGINT, sig_handler);
 
-  while ((c = getopt(argc, argv, "hda:b:w:s:r:x:t:e:")) != -1) {
+  while ((c = getopt(argc, argv, "hda:b:w:s:r:x:t:e:jiIfvlp:c:o:O:")) != -1) {
     switch (c) {
     case 'h':
       display_help(argv[0]);
@@ -150,6 +168,47 @@ int main(int argc, char *argv[])
       edfs_root = optarg;
       break;
 
+    case 'j':
+      block_engine = true;
+      break;
+
+    case 'i':
+      idle_forward = true;
+      break;
+
+    case 'I':
+      instrumented = true;
+      break;
+
+    case 'f':
+      fpu = true;
+      break;
+
+    case 'v':
+      v20 = true;
+      break;
+
+    case 'l':
+      check_lockstep = true;
+      break;
+
+    case 'p':
+      profile_filename = optarg;
+      break;
+
+    case 'c':
+      callgraph_filename = optarg;
+      break;
+
+    case 'o':
+      opstat_filename = optarg;
+      break;
+
+    case 'O':
+      opstat_filename = optarg;
+      opstat_timing = true;
+      break;
+
     case '?':
     default:
       display_help(argv[0]);
@@ -157,115 +216,107 @@ int main(int argc, char *argv[])
     }
   }
 
-  i8088_trace_init();
-  i8088_init(&cpu, &io);
-  mem_init(&mem);
-  io_init(&io);
+  machine_init(&machine);
+  machine.block_engine = block_engine;
+  machine.idle_forward = idle_forward;
+  machine.cpu.idle_detect = idle_forward;
+  machine.debugger_break = debugger_break;
+  machine.cpu.v20 = v20;
 
-  fe2010_init(&fe2010, &io, &cpu, &mem);
-  mos5720_init(&mos5720, &io, &fe2010);
-  fdc9268_init(&fdc9268, &io, &fe2010);
-  m6242_init(&m6242, &io);
-  net_init(&net);
-  dp8390_init(&dp8390, &io, &fe2010, &net);
+  if (check_lockstep) {
+    lockstep_init(&lockstep, &machine.mem, &machine.io);
+    machine.lockstep = &lockstep;
+  }
+
+  if (fpu) {
+    machine.cpu.fpu = &machine.fpu;
+    machine.fe2010.switches |= FE2010_SWITCH_8087;
+  }
 
   if (tty_device) {
-    if (i8250_init(&i8250, &io, &fe2010, &mos5720, tty_device) != 0) {
+    if (i8250_init(&machine.i8250, &machine.io, &machine.fe2010,
+      &machine.mos5720, tty_device) != 0) {
       return EXIT_FAILURE;
     }
+    machine.serial = true;
   }
 
   if (edfs_root) {
-    edfs_init(edfs_root);
+    edfs_init(&machine.edfs, &machine.net, edfs_root);
   }
 
-  console_init(&io);
+  console_start();
+  machine.terminal = true;
 
-  if (mem_load_rom(&mem, bios_rom_filename, bios_rom_address) != 0) {
+  if (mem_load_rom(&machine.mem, bios_rom_filename, bios_rom_address) != 0) {
     return EXIT_FAILURE;
   }
 
   if (floppy_a_image) {
-    if (fdc9268_image_load(&fdc9268, 0, floppy_a_image,
+    if (fdc9268_image_load(&machine.fdc9268, 0, floppy_a_image,
       floppy_image_spt) != 0) {
       return EXIT_FAILURE;
     }
   }
 
   if (floppy_b_image) {
-    if (fdc9268_image_load(&fdc9268, 1, floppy_b_image,
+    if (fdc9268_image_load(&machine.fdc9268, 1, floppy_b_image,
       floppy_image_spt) != 0) {
       return EXIT_FAILURE;
     }
   }
 
   if (hard_disk_image) {
-    xthdc_init(&xthdc, &io, &fe2010);
-    if (xthdc_image_load(&xthdc, hard_disk_image) != 0) {
+    xthdc_init(&machine.xthdc, &machine.io, &machine.fe2010);
+    if (xthdc_image_load(&machine.xthdc, hard_disk_image) != 0) {
       return EXIT_FAILURE;
     }
   }
 
-  cycle = 0;
-  i8088_reset(&cpu);
-  while (1) {
-    i8088_execute(&cpu, &mem);
-    fe2010_execute(&fe2010);
-
-    if ((cycle % 10000) == 0) {
-      console_execute_keyboard(&fe2010, &mos5720);
-      console_execute_screen(&mem);
-      net_execute(&net);
-      dp8390_execute(&dp8390);
-    }
+  i8088_reset(&machine.cpu);
+  machine.cpu.instrumented = instrumented;
 
-    if (tty_device) {
-      if ((cycle % 100) == 0) {
-        i8250_execute(&i8250);
-      }
-    }
+  if (callgraph_filename) {
+    callgraph_init(&callgraph);
+    atexit(callgraph_exit);
+    machine.cpu.callgraph = &callgraph;
+  }
 
-#ifdef CPU_RELAX
-    /* Check if BIOS int16h gets called for keyboard services. */
-    if (cpu.cs == (mem.m[0x5A] + (mem.m[0x5B] * 0x100)) &&
-        cpu.ip == (mem.m[0x58] + (mem.m[0x59] * 0x100))) {
-      console_execute_screen(&mem);
-      struct pollfd fds[1];
-      fds[0].fd = STDIN_FILENO;
-      fds[0].events = POLLIN;
-#if CPU_RELAX == CPM
-      /* CP/M-86 calls with AH=0 and waits indefinitely. */
-      if (cpu.ah == 0) {
-        while (poll(fds, 1, 10) == 0);
-      }
-#else /* CPU_RELAX == DOS */
-      /* DOS typically calls with AH=1 to poll once in while. */
-      poll(fds, 1, 1);
-#endif
-    }
-#endif /* CPU_RELAX */
+  if (opstat_filename) {
+    opstat_init(&opstat, opstat_timing);
+    atexit(opstat_exit);
+    machine.cpu.opstat = &opstat;
+  }
 
-#ifdef BREAKPOINT
-    if (cpu.ip == debugger_breakpoint_ip) {
-      if (cpu.cs == debugger_breakpoint_cs || debugger_breakpoint_cs == -1) {
-        debugger_break = true;
-      }
-    }
-#endif /* BREAKPOINT */
+  if (profile_filename) {
+    profile_init(&profile);
+    atexit(profile_exit);
+    signal(SIGPROF, sig_handler);
+    profile_start(&profile);
+  }
 
-    if (debugger_break) {
+  while (1) {
+    machine_execute(&machine);
+
+    if (machine.debugger_break) {
+      if (profile_filename) {
+        profile_stop(&profile);
+      }
       console_pause();
-      if (panic_msg[0] != '\0') {
-        fprintf(stdout, "%s", panic_msg);
-        panic_msg[0] = '\0';
+      if (machine.panic_msg[0] != '\0') {
+        fprintf(stdout, "%s", machine.panic_msg);
+        machine.panic_msg[0] = '\0';
       }
-      debugger_break = debugger(&cpu, &mem, &fe2010, &fdc9268, &xthdc);
-      if (! debugger_break) {
+      machine.debugger_break = debugger(&machine.cpu, &machine.mem,
+        &machine.fe2010, &machine.fdc9268, &machine.xthdc, machine.lockstep,
+        profile_filename ? &profile : NULL);
+      if (! machine.debugger_break) {
         console_resume();
+        if (profile_filename) {
+          profile_start(&profile);
+        }
       }
     }
-
-    cycle++;
   }
 
   return EXIT_SUCCESS;
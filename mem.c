@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <ctype.h>
+#include <string.h>
 
 #include "console.h"
 #include "panic.h"
@@ -12,6 +13,8 @@
 #include "debugger.h"
 #endif /* MEM_BREAKPOINT */
 
+#define MEM_COMPARE_BLOCK 64
+
 
 
 void mem_init(mem_t *mem)
@@ -22,8 +25,31 @@ void mem_init(mem_t *mem)
     mem->m[i] = 0x00;
   }
   for (i = 0; i < MEM_SIZE_MAX / MEM_SECTION; i++) {
-    mem->readonly[i] = false;
+    mem->page[i].type = MEM_RAM;
+    mem->page[i].read.cookie = NULL;
+    mem->page[i].read.func = NULL;
+    mem->page[i].write.cookie = NULL;
+    mem->page[i].write.func = NULL;
+    mem->code[i] = false;
+  }
+  mem->mmio = 0;
+  for (i = 0; i < MEM_SIZE_MAX / MEM_CODE_GRANULE; i++) {
+    mem->code_generation[i] = 0;
   }
+  mem->dirty = NULL;
+}
+
+
+
+static uint8_t mem_read_mmio(mem_t *mem, uint32_t address)
+{
+  mem_page_t *page;
+
+  page = &mem->page[address / MEM_SECTION];
+  if (page->read.func != NULL) {
+    return (page->read.func)(page->read.cookie, address);
+  }
+  return mem->m[address];
 }
 
 
@@ -33,6 +59,8 @@ uint8_t mem_read(mem_t *mem, uint32_t address)
   if (address >= MEM_SIZE_MAX) {
     panic("Memory read above 1MB: 0x%08x\n", address);
     return 0xFF;
+  } else if (mem->page[address / MEM_SECTION].type == MEM_MMIO) {
+    return mem_read_mmio(mem, address);
   } else {
     return mem->m[address];
   }
@@ -49,11 +77,25 @@ uint8_t mem_read_by_segment(mem_t *mem, uint16_t segment, uint16_t offset)
 
 void mem_write(mem_t *mem, uint32_t address, uint8_t value)
 {
+  mem_page_t *page;
+
   if (address >= MEM_SIZE_MAX) {
     panic("Memory write above 1MB: 0x%08x\n", address);
   } else {
-    if (mem->readonly[address / MEM_SECTION] == false) {
+    mem->write_count++;
+    page = &mem->page[address / MEM_SECTION];
+    if (page->type != MEM_ROM) {
       mem->m[address] = value;
+      if (mem->dirty != NULL) {
+        mem->dirty[address / MEM_CODE_GRANULE] = 1;
+      }
+      if (mem->code[address / MEM_SECTION]) {
+        /* Invalidate any decoded instructions cached by the CPU. */
+        mem->code_generation[address / MEM_CODE_GRANULE]++;
+      }
+      if (page->type == MEM_MMIO && page->write.func != NULL) {
+        (page->write.func)(page->write.cookie, address, value);
+      }
 #ifdef MEM_BREAKPOINT
       if ((int32_t)address == debugger_breakpoint_mem) {
         panic("Memory write breakpoint: 0x%05x < 0x%02x\n", address, value);
@@ -73,10 +115,451 @@ void mem_write_by_segment(mem_t *mem, uint16_t segment, uint16_t offset,
 
 
 
+void mem_code_invalidate(mem_t *mem, uint32_t address, uint32_t size)
+{
+  uint32_t i;
+
+  if (mem->code[address / MEM_SECTION]) {
+    for (i = address / MEM_CODE_GRANULE;
+         i <= (address + size - 1) / MEM_CODE_GRANULE; i++) {
+      mem->code_generation[i]++;
+    }
+  }
+}
+
+
+
+static void mem_map(mem_t *mem, uint32_t address, uint32_t size,
+  mem_type_t type, void *cookie, uint8_t (*read)(void *, uint32_t),
+  void (*write)(void *, uint32_t, uint8_t))
+{
+  uint32_t i;
+
+  if (size == 0) {
+    return;
+  }
+  if (address + size > MEM_SIZE_MAX) {
+    panic("Memory map above 1MB: 0x%08x\n", address + size);
+    return;
+  }
+
+  /* Whole sections, so the range is rounded out to them. */
+  for (i = address / MEM_SECTION;
+       i <= (address + size - 1) / MEM_SECTION; i++) {
+    if (mem->page[i].type == MEM_MMIO) {
+      mem->mmio--;
+    }
+    if (type == MEM_MMIO) {
+      mem->mmio++;
+    }
+    mem->page[i].type = type;
+    mem->page[i].read.cookie = cookie;
+    mem->page[i].read.func = read;
+    mem->page[i].write.cookie = cookie;
+    mem->page[i].write.func = write;
+  }
+}
+
+
+
+static void mem_dirty(mem_t *mem, uint32_t address, uint32_t size)
+{
+  uint32_t i;
+
+  if (mem->dirty != NULL) {
+    for (i = address / MEM_CODE_GRANULE;
+         i <= (address + size - 1) / MEM_CODE_GRANULE; i++) {
+      mem->dirty[i] = 1;
+    }
+  }
+}
+
+
+
+void mem_map_rom(mem_t *mem, uint32_t address, uint32_t size)
+{
+  mem_map(mem, address, size, MEM_ROM, NULL, NULL, NULL);
+}
+
+
+
+void mem_map_mmio(mem_t *mem, uint32_t address, uint32_t size,
+  void *cookie, uint8_t (*read)(void *, uint32_t),
+  void (*write)(void *, uint32_t, uint8_t))
+{
+  mem_map(mem, address, size, MEM_MMIO, cookie, read, write);
+}
+
+
+
+static bool mem_mmio(mem_t *mem, uint32_t address, uint32_t size)
+{
+  uint32_t i;
+
+  if (mem->mmio == 0 || size == 0) {
+    return false;
+  }
+  for (i = address / MEM_SECTION;
+       i <= (address + size - 1) / MEM_SECTION; i++) {
+    if (mem->page[i].type == MEM_MMIO) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+
+bool mem_ram(mem_t *mem, uint32_t address, uint32_t size)
+{
+  uint32_t i;
+
+  /* Whether the whole range is RAM, to be read straight from the array. */
+  if (size == 0) {
+    return true;
+  }
+  for (i = address / MEM_SECTION;
+       i <= (address + size - 1) / MEM_SECTION; i++) {
+    if (mem->page[i].type != MEM_RAM) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+static bool mem_write_bytewise(uint32_t address, uint32_t size)
+{
+#ifdef MEM_BREAKPOINT
+  if (debugger_breakpoint_mem >= (int32_t)address &&
+      debugger_breakpoint_mem < (int32_t)(address + size)) {
+    return true; /* Let mem_write() trigger the breakpoint. */
+  }
+#else
+  (void)address;
+  (void)size;
+#endif /* MEM_BREAKPOINT */
+  return false;
+}
+
+
+
+uint16_t mem_read_16(mem_t *mem, uint32_t address)
+{
+  uint16_t value;
+
+  if (address >= MEM_SIZE_MAX - 1 ||
+      mem->page[address / MEM_SECTION].type == MEM_MMIO ||
+      mem->page[(address + 1) / MEM_SECTION].type == MEM_MMIO) {
+    /* Second byte may wrap around to the start of memory. */
+    return mem_read(mem, address) +
+      (mem_read(mem, (address + 1) & 0xFFFFF) * 0x100);
+  }
+  memcpy(&value, &mem->m[address], sizeof(value)); /* Host little-endian. */
+  return value;
+}
+
+
+
+uint16_t mem_read_16_by_segment(mem_t *mem, uint16_t segment,
+  uint16_t offset)
+{
+  if (offset == 0xFFFF) {
+    /* Second byte wraps around to the start of the segment. */
+    return mem_read_by_segment(mem, segment, offset) +
+      (mem_read_by_segment(mem, segment, 0) * 0x100);
+  }
+  return mem_read_16(mem, ((segment << 4) + offset) & 0xFFFFF);
+}
+
+
+
+void mem_write_16(mem_t *mem, uint32_t address, uint16_t value)
+{
+  /* Byte by byte if the word straddles 1MB or a section that could be
+     read-only, or goes to MMIO, otherwise one store. */
+  if (address >= MEM_SIZE_MAX - 1 ||
+      (address % MEM_SECTION) == MEM_SECTION - 1 ||
+      mem->page[address / MEM_SECTION].type == MEM_MMIO ||
+      mem_write_bytewise(address, 2)) {
+    mem_write(mem, address, value % 0x100);
+    mem_write(mem, (address + 1) & 0xFFFFF, value / 0x100);
+    return;
+  }
+
+  mem->write_count++;
+  if (mem->page[address / MEM_SECTION].type == MEM_RAM) {
+    memcpy(&mem->m[address], &value, sizeof(value)); /* Host little-endian. */
+    mem_code_invalidate(mem, address, 2);
+    mem_dirty(mem, address, 2);
+  }
+}
+
+
+
+void mem_write_16_by_segment(mem_t *mem, uint16_t segment, uint16_t offset,
+  uint16_t value)
+{
+  if (offset == 0xFFFF) {
+    /* Second byte wraps around to the start of the segment. */
+    mem_write_by_segment(mem, segment, offset, value % 0x100);
+    mem_write_by_segment(mem, segment, 0, value / 0x100);
+    return;
+  }
+  mem_write_16(mem, ((segment << 4) + offset) & 0xFFFFF, value);
+}
+
+
+
+void mem_copy(mem_t *mem, uint32_t dst, uint32_t src, uint32_t size,
+  bool descending)
+{
+  uint32_t i;
+  uint32_t n;
+
+  if (size == 0) {
+    return;
+  }
+  if (dst + size > MEM_SIZE_MAX || src + size > MEM_SIZE_MAX) {
+    panic("Memory copy above 1MB: 0x%08x\n", dst + size);
+    return;
+  }
+  mem->write_count++;
+
+  /* Same result as a mem_read() and mem_write() per byte in ascending or
+     descending order. A copy that reads back its own output, like moving
+     a buffer one byte up to fill it, has to be done byte by byte. So
+     does one from or to MMIO, for the hooks to see every byte. */
+  if ((descending == false && src < dst && dst < src + size) ||
+      (descending == true  && dst < src && src < dst + size) ||
+      mem_mmio(mem, dst, size) || mem_mmio(mem, src, size) ||
+      mem_write_bytewise(dst, size)) {
+    if (descending) {
+      for (i = size; i > 0; i--) {
+        mem_write(mem, dst + i - 1, mem_read(mem, src + i - 1));
+      }
+    } else {
+      for (i = 0; i < size; i++) {
+        mem_write(mem, dst + i, mem_read(mem, src + i));
+      }
+    }
+    return;
+  }
+
+  /* Otherwise every byte gets the original source value. Go a section at
+     a time to skip read-only ones, in the direction memmove() would. */
+  if (dst > src) {
+    while (size > 0) {
+      n = ((dst + size - 1) % MEM_SECTION) + 1;
+      if (n > size) {
+        n = size;
+      }
+      size -= n;
+      if (mem->page[(dst + size) / MEM_SECTION].type == MEM_RAM) {
+        memmove(&mem->m[dst + size], &mem->m[src + size], n);
+        mem_code_invalidate(mem, dst + size, n);
+        mem_dirty(mem, dst + size, n);
+      }
+    }
+  } else {
+    while (size > 0) {
+      n = MEM_SECTION - (dst % MEM_SECTION);
+      if (n > size) {
+        n = size;
+      }
+      if (mem->page[dst / MEM_SECTION].type == MEM_RAM) {
+        memmove(&mem->m[dst], &mem->m[src], n);
+        mem_code_invalidate(mem, dst, n);
+        mem_dirty(mem, dst, n);
+      }
+      dst += n;
+      src += n;
+      size -= n;
+    }
+  }
+}
+
+
+
+void mem_fill(mem_t *mem, uint32_t address, uint32_t size,
+  uint8_t even, uint8_t odd)
+{
+  uint32_t i;
+  uint32_t n;
+  uint32_t start;
+
+  if (size == 0) {
+    return;
+  }
+  if (address + size > MEM_SIZE_MAX) {
+    panic("Memory fill above 1MB: 0x%08x\n", address + size);
+    return;
+  }
+  mem->write_count++;
+
+  if (mem_mmio(mem, address, size) || mem_write_bytewise(address, size)) {
+    for (i = 0; i < size; i++) {
+      mem_write(mem, address + i, (i % 2) ? odd : even);
+    }
+    return;
+  }
+
+  start = address;
+  while (size > 0) {
+    n = MEM_SECTION - (address % MEM_SECTION);
+    if (n > size) {
+      n = size;
+    }
+    if (mem->page[address / MEM_SECTION].type == MEM_RAM) {
+      if (even == odd) {
+        memset(&mem->m[address], even, n);
+      } else {
+        for (i = 0; i < n; i++) {
+          mem->m[address + i] = ((address + i - start) % 2) ? odd : even;
+        }
+      }
+      mem_code_invalidate(mem, address, n);
+      mem_dirty(mem, address, n);
+    }
+    address += n;
+    size -= n;
+  }
+}
+
+
+
+static uint16_t mem_element(mem_t *mem, uint32_t address, uint32_t size,
+  bool mmio)
+{
+  if (mmio) {
+    return (size == 1) ? mem_read(mem, address) :
+      mem_read(mem, address) + (mem_read(mem, address + 1) * 0x100);
+  } else if (size == 1) {
+    return mem->m[address];
+  } else {
+    return mem->m[address] + (mem->m[address + 1] * 0x100);
+  }
+}
+
+
+
+static bool mem_elements_outside(uint32_t address, uint32_t count,
+  uint32_t size, bool descending)
+{
+  if (descending) {
+    return (count - 1) * size > address ||
+      address + size > MEM_SIZE_MAX;
+  } else {
+    return address + (count * size) > MEM_SIZE_MAX;
+  }
+}
+
+
+
+static bool mem_elements_mmio(mem_t *mem, uint32_t address, uint32_t count,
+  uint32_t size, bool descending)
+{
+  if (descending) {
+    return mem_mmio(mem, address + size - (count * size), count * size);
+  } else {
+    return mem_mmio(mem, address, count * size);
+  }
+}
+
+
+
+uint32_t mem_scan(mem_t *mem, uint32_t address, uint32_t count,
+  uint32_t size, uint16_t value, bool equal, bool descending)
+{
+  const uint8_t *p;
+  uint32_t i;
+  bool mmio;
+
+  /* Index of the first element that is equal (or not equal) to value, or
+     count if none are. Elements go up or down from address. */
+  if (count == 0) {
+    return 0;
+  }
+  if (mem_elements_outside(address, count, size, descending)) {
+    panic("Memory scan above 1MB: 0x%08x\n", address);
+    return count;
+  }
+
+  mmio = mem_elements_mmio(mem, address, count, size, descending);
+  if (size == 1 && equal && ! descending && ! mmio) {
+    p = memchr(&mem->m[address], value, count);
+    return (p == NULL) ? count : (uint32_t)(p - &mem->m[address]);
+  }
+
+  for (i = 0; i < count; i++) {
+    if ((mem_element(mem, address, size, mmio) == value) == equal) {
+      break;
+    }
+    if (descending) {
+      address -= size;
+    } else {
+      address += size;
+    }
+  }
+  return i;
+}
+
+
+
+uint32_t mem_compare(mem_t *mem, uint32_t src, uint32_t dst, uint32_t count,
+  uint32_t size, bool equal, bool descending)
+{
+  uint32_t i;
+  bool mmio;
+
+  /* Index of the first element pair that is equal (or not equal), or
+     count if none are. Elements go up or down from src and dst. */
+  if (count == 0) {
+    return 0;
+  }
+  if (mem_elements_outside(src, count, size, descending) ||
+      mem_elements_outside(dst, count, size, descending)) {
+    panic("Memory compare above 1MB: 0x%08x\n", dst);
+    return count;
+  }
+
+  mmio = mem_elements_mmio(mem, src, count, size, descending) ||
+    mem_elements_mmio(mem, dst, count, size, descending);
+  i = 0;
+  if (! equal && ! descending && ! mmio) {
+    /* Skip ahead over identical blocks to find the first difference. */
+    while ((count - i) * size >= MEM_COMPARE_BLOCK &&
+      memcmp(&mem->m[src], &mem->m[dst], MEM_COMPARE_BLOCK) == 0) {
+      i += MEM_COMPARE_BLOCK / size;
+      src += MEM_COMPARE_BLOCK;
+      dst += MEM_COMPARE_BLOCK;
+    }
+  }
+
+  for (; i < count; i++) {
+    if ((mem_element(mem, src, size, mmio) ==
+         mem_element(mem, dst, size, mmio)) == equal) {
+      break;
+    }
+    if (descending) {
+      src -= size;
+      dst -= size;
+    } else {
+      src += size;
+      dst += size;
+    }
+  }
+  return i;
+}
+
+
+
 int mem_load_rom(mem_t *mem, const char *filename, uint32_t address)
 {
   FILE *fh;
   int c;
+  uint32_t start;
 
   if (address >= MEM_SIZE_MAX) {
     return -2;
@@ -90,17 +573,14 @@ int mem_load_rom(mem_t *mem, const char *filename, uint32_t address)
     return -1;
   }
 
-  while ((c = fgetc(fh)) != EOF) {
+  start = address;
+  while (address < MEM_SIZE_MAX && (c = fgetc(fh)) != EOF) {
     mem->m[address] = c;
-    mem->readonly[address / MEM_SECTION] = true;
     address++;
-    if (address >= MEM_SIZE_MAX) {
-      fclose(fh);
-      return 0;
-    }
   }
 
   fclose(fh);
+  mem_map_rom(mem, start, address - start);
   return 0;
 }
 
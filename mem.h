@@ -7,10 +7,41 @@
 
 #define MEM_SIZE_MAX 0x100000
 #define MEM_SECTION 0x2000 /* 8192 bytes */
+#define MEM_CODE_GRANULE 0x100 /* 256 bytes */
+
+typedef enum {
+  MEM_RAM = 0,
+  MEM_ROM,
+  MEM_MMIO,
+} mem_type_t;
+
+typedef struct mem_read_hook_s {
+  void *cookie;
+  uint8_t (*func)(void *, uint32_t);
+} mem_read_hook_t;
+
+typedef struct mem_write_hook_s {
+  void *cookie;
+  void (*func)(void *, uint32_t, uint8_t);
+} mem_write_hook_t;
+
+/* What is mapped at a section of the address space. RAM and ROM are
+   accessed straight in the backing array, only MMIO sections take the
+   slow path through their hooks. */
+typedef struct mem_page_s {
+  mem_type_t type;
+  mem_read_hook_t read; /* Optional, backing byte is read if NULL. */
+  mem_write_hook_t write; /* Optional, called after the backing write. */
+} mem_page_t;
 
 typedef struct mem_s {
-  uint8_t m[MEM_SIZE_MAX];
-  bool readonly[MEM_SIZE_MAX / MEM_SECTION];
+  uint8_t m[MEM_SIZE_MAX]; /* Backing store for all pages. */
+  mem_page_t page[MEM_SIZE_MAX / MEM_SECTION];
+  uint32_t mmio; /* Sections mapped as MMIO, to skip checks if none. */
+  bool code[MEM_SIZE_MAX / MEM_SECTION]; /* Section has decoded code cached. */
+  uint32_t code_generation[MEM_SIZE_MAX / MEM_CODE_GRANULE];
+  uint32_t write_count; /* Bumped on any write, to detect idle loops. */
+  uint8_t *dirty; /* Optional, set per code granule written to. */
 } mem_t;
 
 void mem_init(mem_t *mem);
@@ -19,6 +50,26 @@ uint8_t mem_read_by_segment(mem_t *mem, uint16_t segment, uint16_t offset);
 void mem_write(mem_t *mem, uint32_t address, uint8_t value);
 void mem_write_by_segment(mem_t *mem, uint16_t segment, uint16_t offset,
   uint8_t value);
+uint16_t mem_read_16(mem_t *mem, uint32_t address);
+uint16_t mem_read_16_by_segment(mem_t *mem, uint16_t segment,
+  uint16_t offset);
+void mem_write_16(mem_t *mem, uint32_t address, uint16_t value);
+void mem_write_16_by_segment(mem_t *mem, uint16_t segment, uint16_t offset,
+  uint16_t value);
+void mem_copy(mem_t *mem, uint32_t dst, uint32_t src, uint32_t size,
+  bool descending);
+void mem_fill(mem_t *mem, uint32_t address, uint32_t size,
+  uint8_t even, uint8_t odd);
+uint32_t mem_scan(mem_t *mem, uint32_t address, uint32_t count,
+  uint32_t size, uint16_t value, bool equal, bool descending);
+uint32_t mem_compare(mem_t *mem, uint32_t src, uint32_t dst, uint32_t count,
+  uint32_t size, bool equal, bool descending);
+bool mem_ram(mem_t *mem, uint32_t address, uint32_t size);
+void mem_code_invalidate(mem_t *mem, uint32_t address, uint32_t size);
+void mem_map_rom(mem_t *mem, uint32_t address, uint32_t size);
+void mem_map_mmio(mem_t *mem, uint32_t address, uint32_t size,
+  void *cookie, uint8_t (*read)(void *, uint32_t),
+  void (*write)(void *, uint32_t, uint8_t));
 int mem_load_rom(mem_t *mem, const char *filename, uint32_t address);
 void mem_dump(FILE *fh, mem_t *mem, uint32_t start, uint32_t end);
 
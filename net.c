@@ -26,8 +26,9 @@
 #define FLAGS_RST_ACK 0x14
 #define FLAGS_PSH_ACK 0x18
 
-static char net_trace_buffer[NET_TRACE_BUFFER_SIZE][NET_TRACE_MAX];
-static int net_trace_buffer_n = 0;
+static _Thread_local char
+  net_trace_buffer[NET_TRACE_BUFFER_SIZE][NET_TRACE_MAX];
+static _Thread_local int net_trace_buffer_n = 0;
 
 
 
@@ -50,7 +51,7 @@ static void net_trace(const char *format, ...)
 
 static char *net_trace_ip(uint32_t ip)
 {
-  static char s[16];
+  static _Thread_local char s[16];
   uint32_t net_ip = htonl(ip);
   inet_ntop(AF_INET, &net_ip, s, 16);
   return s;
@@ -933,7 +934,9 @@ void net_tx_frame(net_t *net, uint8_t tx_frame[], uint16_t tx_len)
     net_handle_ipv4(net, tx_frame, tx_len);
     break;
   case 0xEDF5: /* EtherDFS */
-    edfs_handle_packet(net, tx_frame, tx_len);
+    if (net->edfs != NULL) {
+      edfs_handle_packet(net->edfs, net, tx_frame, tx_len);
+    }
     break;
   default:
     break;
@@ -989,6 +992,35 @@ void net_execute(net_t *net)
 
 
 
+int net_poll_fds(net_t *net, struct pollfd fds[])
+{
+  int i;
+  int n;
+
+  /* Open sockets to wait on for incoming data, if it can be taken. */
+  n = 0;
+  if (net->rx_ready == true) {
+    return n;
+  }
+  for (i = 0; i < NET_SOCKETS_MAX; i++) {
+    if (net->udp_sockets[i].fd != -1) {
+      fds[n].fd = net->udp_sockets[i].fd;
+      fds[n].events = POLLIN;
+      n++;
+    }
+  }
+  for (i = 0; i < NET_SOCKETS_MAX; i++) {
+    if (net->tcp_sockets[i].fd != -1) {
+      fds[n].fd = net->tcp_sockets[i].fd;
+      fds[n].events = POLLIN;
+      n++;
+    }
+  }
+  return n;
+}
+
+
+
 void net_trace_dump(FILE *fh)
 {
   int i;
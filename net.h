@@ -4,11 +4,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <poll.h>
 
 #define NET_MTU 1514
 #define NET_SOCKETS_MAX 5
 #define NET_SOCKET_INACTIVITY_TIMEOUT 1000000
 #define NET_SOCKET_ACK_WAIT 100
+#define NET_POLL_FDS_MAX (NET_SOCKETS_MAX * 2)
 
 /* The local MAC is the address for the emulated network card,
    while the remote MAC is the address for the one and only remote host on
@@ -49,12 +51,14 @@ typedef struct net_s {
   uint16_t ip_id;
   net_udp_socket_t udp_sockets[NET_SOCKETS_MAX];
   net_tcp_socket_t tcp_sockets[NET_SOCKETS_MAX];
+  struct edfs_s *edfs; /* EtherDFS server, if any. */
 } net_t;
 
 void net_tx_frame(net_t *net, uint8_t tx_frame[],
   uint16_t tx_len);
 void net_init(net_t *net);
 void net_execute(net_t *net);
+int net_poll_fds(net_t *net, struct pollfd fds[]);
 void net_trace_dump(FILE *fh);
 
 #endif /* _NET_H */
@@ -0,0 +1,176 @@
+#include "opstat.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+
+static int opstat_compare(const void *a, const void *b)
+{
+  const opstat_sorted_t *x = a;
+  const opstat_sorted_t *y = b;
+
+  /* Most executed first. */
+  return (x->count < y->count) - (x->count > y->count);
+}
+
+
+
+void opstat_init(opstat_t *opstat, bool timing)
+{
+  opstat_clear(opstat);
+  opstat->timing = timing;
+}
+
+
+
+void opstat_clear(opstat_t *opstat)
+{
+  memset(opstat->count, 0, sizeof(opstat->count));
+  memset(opstat->group, 0, sizeof(opstat->group));
+  memset(opstat->ticks, 0, sizeof(opstat->ticks));
+  memset(opstat->timed, 0, sizeof(opstat->timed));
+  opstat->inner = 0;
+}
+
+
+
+bool opstat_group(uint8_t opcode)
+{
+  switch (opcode) {
+  case 0x80: case 0x81: case 0x82: case 0x83:
+  case 0xC0: case 0xC1: /* V20 */
+  case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+  case 0xF6: case 0xF7: case 0xFE: case 0xFF:
+    return true;
+  default:
+    return false;
+  }
+}
+
+
+
+uint64_t opstat_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+
+  /* Nanoseconds where there is no time stamp counter. */
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#endif
+}
+
+
+
+void opstat_dump(FILE *fh, opstat_t *opstat)
+{
+  opstat_sorted_t sorted[256];
+  uint64_t total;
+  uint8_t opcode;
+  int n;
+  int i;
+  int reg;
+
+  total = 0;
+  n = 0;
+  for (i = 0; i < 256; i++) {
+    if (opstat->count[i] != 0) {
+      total += opstat->count[i];
+      sorted[n].opcode = i;
+      sorted[n].count = opstat->count[i];
+      n++;
+    }
+  }
+  qsort(sorted, n, sizeof(opstat_sorted_t), opstat_compare);
+
+  fprintf(fh, "Executions: %llu\n", (unsigned long long)total);
+  fprintf(fh, "Opcode          Count       %%   Ticks/Exec\n");
+  for (i = 0; i < n; i++) {
+    opcode = sorted[i].opcode;
+    fprintf(fh, "%02X     %14llu  %6.2f", opcode,
+      (unsigned long long)opstat->count[opcode],
+      (opstat->count[opcode] * 100.0) / total);
+    if (opstat->timed[opcode] > 0) {
+      fprintf(fh, " %12.1f", (double)opstat->ticks[opcode] /
+        opstat->timed[opcode]);
+    }
+    fprintf(fh, "\n");
+
+    if (! opstat_group(opcode)) {
+      continue;
+    }
+    for (reg = 0; reg < 8; reg++) {
+      if (opstat->group[opcode][reg] != 0) {
+        fprintf(fh, "  /%d   %14llu  %6.2f\n", reg,
+          (unsigned long long)opstat->group[opcode][reg],
+          (opstat->group[opcode][reg] * 100.0) / total);
+      }
+    }
+  }
+}
+
+
+
+void opstat_json(FILE *fh, opstat_t *opstat)
+{
+  bool first;
+  int i;
+  int reg;
+
+  fprintf(fh, "{\n  \"timing\": %s,\n  \"opcodes\": [",
+    opstat->timing ? "true" : "false");
+  first = true;
+  for (i = 0; i < 256; i++) {
+    if (opstat->count[i] == 0) {
+      continue;
+    }
+    fprintf(fh, "%s\n    {\"opcode\": %d, \"count\": %llu", first ? "" : ",",
+      i, (unsigned long long)opstat->count[i]);
+    first = false;
+    if (opstat->timed[i] > 0) {
+      fprintf(fh, ", \"timed\": %llu, \"ticks\": %llu",
+        (unsigned long long)opstat->timed[i],
+        (unsigned long long)opstat->ticks[i]);
+    }
+    if (opstat_group(i)) {
+      fprintf(fh, ", \"group\": [");
+      for (reg = 0; reg < 8; reg++) {
+        fprintf(fh, "%s%llu", (reg > 0) ? ", " : "",
+          (unsigned long long)opstat->group[i][reg]);
+      }
+      fprintf(fh, "]");
+    }
+    fprintf(fh, "}");
+  }
+  fprintf(fh, "\n  ]\n}\n");
+}
+
+
+
+int opstat_write(opstat_t *opstat, const char *filename)
+{
+  FILE *fh;
+
+  fh = fopen(filename, "w");
+  if (fh == NULL) {
+    fprintf(stderr, "fopen() for '%s' failed with errno: %d\n",
+      filename, errno);
+    return -1;
+  }
+  opstat_json(fh, opstat);
+  fclose(fh);
+  return 0;
+}
+
+
+
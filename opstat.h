@@ -0,0 +1,35 @@
+#ifndef _OPSTAT_H
+#define _OPSTAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct opstat_sorted_s {
+  uint8_t opcode;
+  uint64_t count;
+} opstat_sorted_t;
+
+/* Executions per opcode, and per REG field of the ModRM byte for the
+   opcodes that use it to select the operation. Optionally also the host
+   time spent in each handler, in ticks of the host time stamp counter.
+   Prefixes are counted on their own and their time excludes that of the
+   instruction they prefix. */
+typedef struct opstat_s {
+  uint64_t count[256];
+  uint64_t group[256][8];
+  uint64_t ticks[256];
+  uint64_t timed[256]; /* Executions the ticks were taken over. */
+  uint64_t inner; /* Ticks of handlers dispatched from the current one. */
+  bool timing;
+} opstat_t;
+
+void opstat_init(opstat_t *opstat, bool timing);
+void opstat_clear(opstat_t *opstat);
+bool opstat_group(uint8_t opcode);
+uint64_t opstat_ticks(void);
+void opstat_dump(FILE *fh, opstat_t *opstat);
+void opstat_json(FILE *fh, opstat_t *opstat);
+int opstat_write(opstat_t *opstat, const char *filename);
+
+#endif /* _OPSTAT_H */
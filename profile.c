@@ -0,0 +1,337 @@
+#include "profile.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include "i8088.h"
+#include "mem.h"
+
+#define PROFILE_STACKS_MAX (PROFILE_STACKS / 4 * 3) /* Keeps probing short. */
+#define PROFILE_SITES_MAX (PROFILE_SITES / 4 * 3)
+
+
+
+/* Called from the signal handler, so only plain reads of memory. */
+static inline uint8_t profile_read(mem_t *mem, uint16_t segment,
+  uint16_t offset)
+{
+  return mem->m[((segment << 4) + offset) & (MEM_SIZE_MAX - 1)];
+}
+
+
+
+static bool profile_near_call(mem_t *mem, uint16_t segment, uint16_t offset)
+{
+  uint8_t modrm;
+
+  /* CALL rel16 */
+  if (profile_read(mem, segment, offset - 3) == 0xE8) {
+    return true;
+  }
+
+  /* CALL r/m16 with no, 8-bit and 16-bit displacement. */
+  if (profile_read(mem, segment, offset - 2) == 0xFF) {
+    modrm = profile_read(mem, segment, offset - 1);
+    if ((modrm & 0x38) == 0x10 &&
+        ((modrm & 0xC0) == 0xC0 ||
+        ((modrm & 0xC0) == 0x00 && (modrm & 0x07) != 0x06))) {
+      return true;
+    }
+  }
+  if (profile_read(mem, segment, offset - 3) == 0xFF) {
+    modrm = profile_read(mem, segment, offset - 2);
+    if ((modrm & 0xF8) == 0x50) {
+      return true;
+    }
+  }
+  if (profile_read(mem, segment, offset - 4) == 0xFF) {
+    modrm = profile_read(mem, segment, offset - 3);
+    if ((modrm & 0xF8) == 0x90 || modrm == 0x16) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+static bool profile_far_call(mem_t *mem, uint16_t segment, uint16_t offset)
+{
+  uint8_t modrm;
+
+  /* CALL ptr16:16 */
+  if (profile_read(mem, segment, offset - 5) == 0x9A) {
+    return true;
+  }
+
+  /* CALL m16:16 with no, 8-bit and 16-bit displacement. */
+  if (profile_read(mem, segment, offset - 2) == 0xFF) {
+    modrm = profile_read(mem, segment, offset - 1);
+    if ((modrm & 0xF8) == 0x18 && (modrm & 0x07) != 0x06) {
+      return true;
+    }
+  }
+  if (profile_read(mem, segment, offset - 3) == 0xFF) {
+    modrm = profile_read(mem, segment, offset - 2);
+    if ((modrm & 0xF8) == 0x58) {
+      return true;
+    }
+  }
+  if (profile_read(mem, segment, offset - 4) == 0xFF) {
+    modrm = profile_read(mem, segment, offset - 3);
+    if ((modrm & 0xF8) == 0x98 || modrm == 0x1E) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+
+static void profile_count_site(profile_t *profile, uint32_t address)
+{
+  uint32_t i;
+
+  i = (address ^ (address >> 13)) & (PROFILE_SITES - 1);
+  while (profile->site[i].count != 0 && profile->site[i].address != address) {
+    i = (i + 1) & (PROFILE_SITES - 1);
+  }
+
+  if (profile->site[i].count == 0) {
+    if (profile->sites >= PROFILE_SITES_MAX) {
+      profile->dropped++;
+      return;
+    }
+    profile->site[i].address = address;
+    profile->sites++;
+  }
+  profile->site[i].count++;
+}
+
+
+
+static void profile_count_stack(profile_t *profile, uint32_t frame[],
+  uint32_t depth)
+{
+  uint32_t hash;
+  uint32_t i;
+
+  hash = depth;
+  for (i = 0; i < depth; i++) {
+    hash = (hash * 31) ^ frame[i] ^ (frame[i] >> 13);
+  }
+
+  i = hash & (PROFILE_STACKS - 1);
+  while (profile->stack[i].depth != 0) {
+    if (profile->stack[i].depth == depth &&
+        memcmp(profile->stack[i].frame, frame,
+        depth * sizeof(uint32_t)) == 0) {
+      profile->stack[i].count++;
+      return;
+    }
+    i = (i + 1) & (PROFILE_STACKS - 1);
+  }
+
+  if (profile->stacks >= PROFILE_STACKS_MAX) {
+    profile->dropped++;
+    return;
+  }
+  memcpy(profile->stack[i].frame, frame, depth * sizeof(uint32_t));
+  profile->stack[i].depth = depth;
+  profile->stack[i].count = 1;
+  profile->stacks++;
+}
+
+
+
+static int profile_compare(const void *a, const void *b)
+{
+  const profile_site_t *x = a;
+  const profile_site_t *y = b;
+
+  /* Highest count first, then by address. */
+  if (x->count != y->count) {
+    return (x->count < y->count) - (x->count > y->count);
+  }
+  return (x->address > y->address) - (x->address < y->address);
+}
+
+
+
+void profile_init(profile_t *profile)
+{
+  profile->running = false;
+  profile_clear(profile);
+}
+
+
+
+void profile_clear(profile_t *profile)
+{
+  memset(profile->stack, 0, sizeof(profile->stack));
+  memset(profile->site, 0, sizeof(profile->site));
+  profile->stacks = 0;
+  profile->sites = 0;
+  profile->samples = 0;
+  profile->dropped = 0;
+}
+
+
+
+void profile_start(profile_t *profile)
+{
+  struct itimerval timer;
+
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = 1000000 / PROFILE_HZ;
+  timer.it_value = timer.it_interval;
+  profile->running = true;
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+
+
+void profile_stop(profile_t *profile)
+{
+  struct itimerval timer;
+
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, NULL);
+  profile->running = false;
+}
+
+
+
+void profile_sample(profile_t *profile, i8088_t *cpu, mem_t *mem)
+{
+  uint32_t frame[PROFILE_DEPTH];
+  uint32_t depth;
+  uint16_t segment;
+  uint16_t offset;
+  uint16_t cs;
+  uint16_t sp;
+  int i;
+
+  if (! profile->running) {
+    return;
+  }
+  profile->samples++;
+
+  frame[0] = ((uint32_t)cpu->cs << 16) | cpu->ip;
+  profile_count_site(profile, frame[0]);
+
+  /* No frame pointers to follow, so take any word on the stack just after
+     a CALL instruction as a return address. Far returns are checked first
+     and change the code segment for near returns further up. */
+  cs = cpu->cs;
+  sp = cpu->sp;
+  depth = 1;
+  for (i = 0; i < PROFILE_SCAN && depth < PROFILE_DEPTH; i++) {
+    offset = profile_read(mem, cpu->ss, sp) |
+      (profile_read(mem, cpu->ss, sp + 1) << 8);
+    segment = profile_read(mem, cpu->ss, sp + 2) |
+      (profile_read(mem, cpu->ss, sp + 3) << 8);
+    if (profile_far_call(mem, segment, offset)) {
+      frame[depth++] = ((uint32_t)segment << 16) | offset;
+      cs = segment;
+      sp += 4;
+      i++;
+    } else {
+      if (profile_near_call(mem, cs, offset)) {
+        frame[depth++] = ((uint32_t)cs << 16) | offset;
+      }
+      sp += 2;
+    }
+  }
+
+  profile_count_stack(profile, frame, depth);
+}
+
+
+
+void profile_dump(FILE *fh, profile_t *profile, uint32_t top)
+{
+  uint32_t n;
+  uint32_t i;
+
+  fprintf(fh, "Samples: %llu, dropped: %llu\n",
+    (unsigned long long)profile->samples,
+    (unsigned long long)profile->dropped);
+
+  n = 0;
+  for (i = 0; i < PROFILE_SITES; i++) {
+    if (profile->site[i].count != 0) {
+      profile->sorted[n++] = profile->site[i];
+    }
+  }
+  if (n == 0) {
+    return;
+  }
+  qsort(profile->sorted, n, sizeof(profile_site_t), profile_compare);
+
+  fprintf(fh, "   Count       %%  Address\n");
+  for (i = 0; i < n && i < top; i++) {
+    fprintf(fh, "%8u  %6.2f  %04X:%04X\n", profile->sorted[i].count,
+      (profile->sorted[i].count * 100.0) / profile->samples,
+      profile->sorted[i].address >> 16, profile->sorted[i].address & 0xFFFF);
+  }
+}
+
+
+
+void profile_folded(FILE *fh, profile_t *profile)
+{
+  uint32_t i;
+  int j;
+
+  /* One line per stack, outermost frame first, as used by flame graphs. */
+  for (i = 0; i < PROFILE_STACKS; i++) {
+    if (profile->stack[i].depth == 0) {
+      continue;
+    }
+    for (j = profile->stack[i].depth - 1; j >= 0; j--) {
+      fprintf(fh, "%04X:%04X%c", profile->stack[i].frame[j] >> 16,
+        profile->stack[i].frame[j] & 0xFFFF, (j > 0) ? ';' : ' ');
+    }
+    fprintf(fh, "%u\n", profile->stack[i].count);
+  }
+}
+
+
+
+int profile_write(profile_t *profile, const char *filename)
+{
+  char folded_filename[PATH_MAX];
+  FILE *fh;
+
+  fh = fopen(filename, "w");
+  if (fh == NULL) {
+    fprintf(stderr, "fopen() for '%s' failed with errno: %d\n",
+      filename, errno);
+    return -1;
+  }
+  profile_dump(fh, profile, PROFILE_SITES);
+  fclose(fh);
+
+  snprintf(folded_filename, PATH_MAX, "%s.folded", filename);
+  fh = fopen(folded_filename, "w");
+  if (fh == NULL) {
+    fprintf(stderr, "fopen() for '%s' failed with errno: %d\n",
+      folded_filename, errno);
+    return -1;
+  }
+  profile_folded(fh, profile);
+  fclose(fh);
+
+  return 0;
+}
+
+
+
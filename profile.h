@@ -0,0 +1,51 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "i8088.h"
+#include "mem.h"
+
+#define PROFILE_HZ 1000 /* Samples per second of host CPU time. */
+#define PROFILE_DEPTH 8 /* Frames per sample, CS:IP and return addresses. */
+#define PROFILE_SCAN 32 /* Stack words searched for return addresses. */
+#define PROFILE_STACKS 8192 /* Must be a power of two. */
+#define PROFILE_SITES 8192 /* Must be a power of two. */
+#define PROFILE_TOP 20
+
+typedef struct profile_stack_s {
+  uint32_t frame[PROFILE_DEPTH]; /* Segment and offset, innermost first. */
+  uint32_t depth; /* Zero if free. */
+  uint32_t count;
+} profile_stack_t;
+
+typedef struct profile_site_s {
+  uint32_t address; /* Segment and offset. */
+  uint32_t count; /* Zero if free. */
+} profile_site_t;
+
+/* Samples of the guest CS:IP taken from SIGPROF, counted per address for a
+   flat profile and per stack for folded stacks. Both are hashed tables of
+   fixed size, samples not fitting are only counted as dropped. */
+typedef struct profile_s {
+  profile_stack_t stack[PROFILE_STACKS];
+  profile_site_t site[PROFILE_SITES];
+  profile_site_t sorted[PROFILE_SITES]; /* Scratch for dumping. */
+  uint32_t stacks;
+  uint32_t sites;
+  uint64_t samples;
+  uint64_t dropped;
+  bool running;
+} profile_t;
+
+void profile_init(profile_t *profile);
+void profile_clear(profile_t *profile);
+void profile_start(profile_t *profile);
+void profile_stop(profile_t *profile);
+void profile_sample(profile_t *profile, i8088_t *cpu, mem_t *mem);
+void profile_dump(FILE *fh, profile_t *profile, uint32_t top);
+void profile_folded(FILE *fh, profile_t *profile);
+int profile_write(profile_t *profile, const char *filename);
+
+#endif /* _PROFILE_H */
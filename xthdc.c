@@ -55,8 +55,9 @@
 #define xthdc_status_set(x, bit)   (((xthdc_t *)x)->status |=  (1 << bit));
 #define xthdc_status_clear(x, bit) (((xthdc_t *)x)->status &= ~(1 << bit));
 
-static char xthdc_trace_buffer[XTHDC_TRACE_BUFFER_SIZE][XTHDC_TRACE_MAX];
-static int xthdc_trace_buffer_n = 0;
+static _Thread_local char
+  xthdc_trace_buffer[XTHDC_TRACE_BUFFER_SIZE][XTHDC_TRACE_MAX];
+static _Thread_local int xthdc_trace_buffer_n = 0;
 
 
 